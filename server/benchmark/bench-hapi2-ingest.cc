@@ -0,0 +1,503 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * bench-hapi2-ingest drives HatoholArmPluginGateHAPI2 with HAPI2
+ * messages without a broker and reports the ingestion throughput.
+ *
+ * The messages are either replayed from a capture file, which the server
+ * writes when HATOHOL_HAPI2_CAPTURE_DIR is set, or synthesized:
+ *
+ *   bench-hapi2-ingest --capture /tmp/hapi2-1.capture --speed 0
+ *   bench-hapi2-ingest --procedure putEvents --servers 4 --batch 100 \
+ *                      --messages 1000 --rate 50
+ *
+ * Every --all-interval th synthesized putTriggers or putHosts message is
+ * a full update (updateType ALL) with the same contents as the previous
+ * message, so that the unchanged elements are skipped by fingerprints.
+ *
+ * The data are stored into the DB given by --db-name and so on. Use a DB
+ * only for the benchmark because the servers with the IDs from
+ * --first-server-id are replaced.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include <glib.h>
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <StringUtils.h>
+#include <SmartTime.h>
+#include <Hatohol.h>
+#include <DBHatohol.h>
+#include <ThreadLocalDBCache.h>
+#include <HatoholArmPluginGateHAPI2.h>
+#include <IngestionPipeline.h>
+#include <JSONBuilder.h>
+#include <JSONParser.h>
+#include <HAPI2Capture.h>
+
+using namespace std;
+using namespace mlpl;
+
+struct BenchmarkOptions {
+	gchar  *capturePath;
+	gdouble speed;
+	gchar  *procedure;
+	gint    numServers;
+	gint    numMessages;
+	gint    batchSize;
+	gdouble rate;
+	gint    allInterval;
+	gint    firstServerId;
+	gchar  *dbName;
+	gchar  *dbUser;
+	gchar  *dbPassword;
+
+	BenchmarkOptions(void)
+	: capturePath(NULL),
+	  speed(0.0),
+	  procedure(NULL),
+	  numServers(1),
+	  numMessages(1000),
+	  batchSize(100),
+	  rate(0.0),
+	  allInterval(10),
+	  firstServerId(10001),
+	  dbName(NULL),
+	  dbUser(NULL),
+	  dbPassword(NULL)
+	{
+	}
+};
+
+struct BenchmarkMessage {
+	uint64_t    offsetUSec;
+	string      methodName;
+	size_t      numElements;
+	AMQPMessage message;
+};
+
+class LatencyRecorder {
+public:
+	void add(const string &methodName, const double &latencyMSec,
+		 const size_t &numElements)
+	{
+		lock_guard<mutex> lock(m_lock);
+		m_latencyMap[methodName].push_back(latencyMSec);
+		m_numElements += numElements;
+	}
+
+	void report(const double &elapsedSec)
+	{
+		using StringUtils::sprintf;
+		size_t numMessages = 0;
+		cout << sprintf("%-24s %8s %10s %10s %10s %10s",
+				"Procedure", "Count", "p50(ms)", "p90(ms)",
+				"p99(ms)", "max(ms)") << endl;
+		for (auto &pair : m_latencyMap) {
+			vector<double> &latencies = pair.second;
+			sort(latencies.begin(), latencies.end());
+			numMessages += latencies.size();
+			cout << sprintf("%-24s %8zd %10.3f %10.3f %10.3f %10.3f",
+					pair.first.c_str(), latencies.size(),
+					percentile(latencies, 50),
+					percentile(latencies, 90),
+					percentile(latencies, 99),
+					latencies.back()) << endl;
+		}
+		cout << endl;
+		cout << sprintf("Elapsed:    %.3f s", elapsedSec) << endl;
+		cout << sprintf("Messages:   %zd (%.1f msg/s)", numMessages,
+				numMessages / elapsedSec) << endl;
+		cout << sprintf("Elements:   %zd (%.1f elements/s)",
+				m_numElements,
+				m_numElements / elapsedSec) << endl;
+	}
+
+private:
+	static double percentile(const vector<double> &sorted,
+				 const size_t &percent)
+	{
+		if (sorted.empty())
+			return 0.0;
+		size_t index = (sorted.size() * percent + 99) / 100;
+		if (index > 0)
+			index--;
+		return sorted[min(index, sorted.size() - 1)];
+	}
+
+	mutex                          m_lock;
+	map<string, vector<double> >   m_latencyMap;
+	size_t                         m_numElements = 0;
+};
+
+// ---------------------------------------------------------------------------
+// Message sources
+// ---------------------------------------------------------------------------
+static string makeTimeStamp(const time_t &sec)
+{
+	struct tm tm;
+	gmtime_r(&sec, &tm);
+	char buf[32];
+	strftime(buf, sizeof(buf), "%Y%m%d%H%M%S", &tm);
+	return buf;
+}
+
+static size_t countElements(JSONParser &parser)
+{
+	static const char *arrayNames[] = {
+	  "events", "triggers", "items", "hosts", "hostGroups",
+	  "hostGroupMembership", "samples",
+	};
+	if (!parser.isMember("params"))
+		return 0;
+	size_t count = 0;
+	parser.startObject("params");
+	for (size_t i = 0; i < G_N_ELEMENTS(arrayNames); i++) {
+		if (!parser.isMember(arrayNames[i]))
+			continue;
+		parser.startObject(arrayNames[i]);
+		count += parser.countElements();
+		parser.endObject();
+	}
+	parser.endObject();
+	return count;
+}
+
+static bool loadCapture(const string &path, vector<BenchmarkMessage> &messages)
+{
+	HAPI2Capture capture;
+	if (!capture.openForRead(path))
+		return false;
+	HAPI2Capture::Record record;
+	while (capture.read(record)) {
+		BenchmarkMessage message;
+		message.offsetUSec = record.offsetUSec;
+		message.message = record.message;
+		const JSONParser::DataFormat format =
+		  (record.message.contentType ==
+		   HAPI2_CONTENT_TYPE_MESSAGE_PACK) ?
+		    JSONParser::DATA_FORMAT_MESSAGE_PACK :
+		    JSONParser::DATA_FORMAT_JSON;
+		JSONParser parser(record.message.body, format);
+		if (parser.hasError() ||
+		    !parser.read("method", message.methodName)) {
+			// A response to a procedure called by the server.
+			message.methodName = "(response)";
+			message.numElements = 0;
+		} else {
+			message.numElements = countElements(parser);
+		}
+		messages.push_back(message);
+	}
+	return true;
+}
+
+static void buildElement(JSONBuilder &builder, const string &procedure,
+			 const size_t &seq, const size_t &index,
+			 const string &timeStamp)
+{
+	const string id = StringUtils::sprintf("%zd", seq * 1000000 + index);
+	const string hostId = StringUtils::sprintf("%zd", index % 100);
+	const string hostName = "bench-host-" + hostId;
+	builder.startObject();
+	if (procedure == HAPI2_PUT_EVENTS) {
+		builder.add("eventId", id);
+		builder.add("time", timeStamp);
+		builder.add("type", (seq % 2) ? "BAD" : "GOOD");
+		builder.add("triggerId", StringUtils::sprintf("%zd", index));
+		builder.add("status", (seq % 2) ? "NG" : "OK");
+		builder.add("severity", "WARNING");
+		builder.add("hostId", hostId);
+		builder.add("hostName", hostName);
+		builder.add("brief", "benchmark event " + id);
+	} else if (procedure == HAPI2_PUT_TRIGGERS) {
+		builder.add("triggerId", StringUtils::sprintf("%zd", index));
+		builder.add("status", (seq % 2) ? "NG" : "OK");
+		builder.add("severity", "WARNING");
+		builder.add("lastChangeTime", timeStamp);
+		builder.add("hostId", hostId);
+		builder.add("hostName", hostName);
+		builder.add("brief", "benchmark trigger");
+	} else if (procedure == HAPI2_PUT_ITEMS) {
+		builder.add("itemId", StringUtils::sprintf("%zd", index));
+		builder.add("hostId", hostId);
+		builder.add("brief", "benchmark item");
+		builder.add("lastValueTime", timeStamp);
+		builder.add("lastValue", StringUtils::sprintf("%zd", seq));
+		builder.add("itemGroupName", "benchmark");
+		builder.add("unit", "");
+	} else {
+		builder.add("hostId", StringUtils::sprintf("%zd", index));
+		// Change names in every message not to be skipped as
+		// unchanged hosts.
+		builder.add("hostName",
+			    StringUtils::sprintf("bench-host-%zd-%zd",
+						 index, seq));
+	}
+	builder.endObject();
+}
+
+static string arrayNameOf(const string &procedure)
+{
+	if (procedure == HAPI2_PUT_EVENTS)
+		return "events";
+	if (procedure == HAPI2_PUT_TRIGGERS)
+		return "triggers";
+	if (procedure == HAPI2_PUT_ITEMS)
+		return "items";
+	return "hosts";
+}
+
+static void synthesize(const BenchmarkOptions &options,
+		       vector<BenchmarkMessage> &messages)
+{
+	const string procedure = options.procedure;
+	const time_t now = time(NULL);
+	const bool hasUpdateType = (procedure == HAPI2_PUT_TRIGGERS ||
+				    procedure == HAPI2_PUT_HOSTS);
+	for (gint seq = 0; seq < options.numMessages; seq++) {
+		const bool fullUpdate =
+		  hasUpdateType && options.allInterval > 0 && seq > 0 &&
+		  seq % options.allInterval == 0;
+		// A full update repeats the state of the previous message.
+		const gint elementSeq = fullUpdate ? seq - 1 : seq;
+		const string timeStamp = makeTimeStamp(now + elementSeq);
+		JSONBuilder builder;
+		builder.startObject();
+		builder.add("jsonrpc", "2.0");
+		builder.add("method", procedure);
+		builder.startObject("params");
+		builder.startArray(arrayNameOf(procedure));
+		for (gint i = 0; i < options.batchSize; i++)
+			buildElement(builder, procedure, elementSeq, i,
+				     timeStamp);
+		builder.endArray();
+		if (procedure == HAPI2_PUT_EVENTS ||
+		    procedure == HAPI2_PUT_TRIGGERS ||
+		    procedure == HAPI2_PUT_HOSTS) {
+			builder.add("lastInfo", timeStamp);
+		}
+		if (hasUpdateType) {
+			builder.add("updateType",
+				    fullUpdate ? "ALL" : "UPDATED");
+		}
+		builder.endObject();
+		builder.add("id", seq + 1);
+		builder.endObject();
+
+		BenchmarkMessage message;
+		message.offsetUSec =
+		  (options.rate > 0) ? seq * G_USEC_PER_SEC / options.rate : 0;
+		message.methodName =
+		  fullUpdate ? procedure + "(ALL)" : procedure;
+		message.numElements = options.batchSize;
+		message.message.contentType = HAPI2_CONTENT_TYPE_JSON;
+		message.message.body = builder.generate();
+		messages.push_back(message);
+	}
+}
+
+// ---------------------------------------------------------------------------
+// Gates
+// ---------------------------------------------------------------------------
+static bool setupServer(const ServerIdType &serverId,
+			MonitoringServerInfo &serverInfo)
+{
+	MonitoringServerInfo::initialize(serverInfo);
+	serverInfo.id = serverId;
+	serverInfo.type = MONITORING_SYSTEM_HAPI2;
+	serverInfo.hostName = StringUtils::sprintf("bench-%" FMT_SERVER_ID,
+						   serverId);
+	serverInfo.nickname = serverInfo.hostName;
+	serverInfo.ipAddress = "127.0.0.1";
+
+	ArmPluginInfo pluginInfo;
+	ArmPluginInfo::initialize(pluginInfo);
+	pluginInfo.type = MONITORING_SYSTEM_HAPI2;
+	pluginInfo.serverId = serverId;
+	pluginInfo.uuid = "8e632c14-d1f7-11e4-8350-d43d7e3146fb";
+
+	ThreadLocalDBCache cache;
+	DBTablesConfig &dbConfig = cache.getConfig();
+	OperationPrivilege privilege(ALL_PRIVILEGES);
+	dbConfig.deleteTargetServer(serverId, privilege);
+	HatoholError err =
+	  dbConfig.addTargetServer(&serverInfo, privilege, &pluginInfo);
+	if (err != HTERR_OK) {
+		cerr << "Failed to add a server: " << serverId
+		     << ", " << err.getCode() << endl;
+		return false;
+	}
+	return true;
+}
+
+static void runGate(const MonitoringServerInfo &serverInfo,
+		    const vector<BenchmarkMessage> &messages,
+		    const double speed, LatencyRecorder &recorder)
+{
+	// The gate isn't started, so it doesn't connect to a broker.
+	// The messages are passed in the same way as the consumer does.
+	const bool autoStart = false;
+	HatoholArmPluginGateHAPI2Ptr gate(
+	  new HatoholArmPluginGateHAPI2(serverInfo, autoStart), false);
+	gate->setEstablished(true);
+
+	SmartTime startTime(SmartTime::INIT_CURR_TIME);
+	for (auto &message : messages) {
+		if (speed > 0) {
+			SmartTime elapsed(SmartTime::INIT_CURR_TIME);
+			elapsed -= startTime;
+			const double waitUSec =
+			  message.offsetUSec / speed -
+			  elapsed.getAsMSec() * 1000;
+			if (waitUSec > 0)
+				g_usleep(waitUSec);
+		}
+		string response;
+		SmartTime sentTime(SmartTime::INIT_CURR_TIME);
+		gate->processMessage(message.message, response);
+		SmartTime latency(SmartTime::INIT_CURR_TIME);
+		latency -= sentTime;
+		recorder.add(message.methodName, latency.getAsMSec(),
+			     message.numElements);
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	BenchmarkOptions options;
+	GOptionEntry entries[] = {
+	  {"capture", 'c', 0, G_OPTION_ARG_FILENAME, &options.capturePath,
+	   "Replay a capture file", "PATH"},
+	  {"speed", 0, 0, G_OPTION_ARG_DOUBLE, &options.speed,
+	   "Replay speed. 1 is the recorded pace. 0 is as fast as possible",
+	   "X"},
+	  {"procedure", 'p', 0, G_OPTION_ARG_STRING, &options.procedure,
+	   "putEvents, putTriggers, putItems or putHosts", "NAME"},
+	  {"servers", 's', 0, G_OPTION_ARG_INT, &options.numServers,
+	   "The number of gates that run concurrently", "N"},
+	  {"messages", 'n', 0, G_OPTION_ARG_INT, &options.numMessages,
+	   "The number of synthesized messages per gate", "N"},
+	  {"batch", 'b', 0, G_OPTION_ARG_INT, &options.batchSize,
+	   "The number of elements in a synthesized message", "N"},
+	  {"rate", 'r', 0, G_OPTION_ARG_DOUBLE, &options.rate,
+	   "Synthesized messages per second per gate. 0 is unlimited", "N"},
+	  {"all-interval", 0, 0, G_OPTION_ARG_INT, &options.allInterval,
+	   "Make every Nth putTriggers or putHosts message a full update. "
+	   "0 disables", "N"},
+	  {"first-server-id", 0, 0, G_OPTION_ARG_INT, &options.firstServerId,
+	   "The ID of the first server", "ID"},
+	  {"db-name", 0, 0, G_OPTION_ARG_STRING, &options.dbName,
+	   "DB name", "NAME"},
+	  {"db-user", 0, 0, G_OPTION_ARG_STRING, &options.dbUser,
+	   "DB user", "USER"},
+	  {"db-password", 0, 0, G_OPTION_ARG_STRING, &options.dbPassword,
+	   "DB password", "PASSWORD"},
+	  {NULL}
+	};
+	GOptionContext *context =
+	  g_option_context_new("- benchmark of HAPI2 ingestion");
+	g_option_context_add_main_entries(context, entries, NULL);
+	GError *error = NULL;
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		cerr << error->message << endl;
+		g_error_free(error);
+		g_option_context_free(context);
+		return EXIT_FAILURE;
+	}
+	g_option_context_free(context);
+
+	const string procedure =
+	  options.procedure ? options.procedure : HAPI2_PUT_EVENTS;
+	if (!options.procedure)
+		options.procedure = g_strdup(procedure.c_str());
+	if (procedure != HAPI2_PUT_EVENTS && procedure != HAPI2_PUT_TRIGGERS &&
+	    procedure != HAPI2_PUT_ITEMS && procedure != HAPI2_PUT_HOSTS) {
+		cerr << "Unsupported procedure: " << procedure << endl;
+		return EXIT_FAILURE;
+	}
+
+	hatoholInit();
+	DBHatohol::setDefaultDBParams(options.dbName, options.dbUser,
+				      options.dbPassword);
+
+	vector<BenchmarkMessage> messages;
+	if (options.capturePath) {
+		if (!loadCapture(options.capturePath, messages))
+			return EXIT_FAILURE;
+	} else {
+		synthesize(options, messages);
+	}
+	if (!options.capturePath && options.rate > 0)
+		options.speed = 1.0;
+
+	vector<MonitoringServerInfo> servers(options.numServers);
+	for (gint i = 0; i < options.numServers; i++) {
+		if (!setupServer(options.firstServerId + i, servers[i]))
+			return EXIT_FAILURE;
+	}
+
+	LatencyRecorder recorder;
+	IngestionPipeline::Stat statBefore, statAfter;
+	IngestionPipeline::getInstance().getStat(statBefore);
+	SmartTime startTime(SmartTime::INIT_CURR_TIME);
+	vector<thread> threads;
+	for (auto &serverInfo : servers) {
+		threads.push_back(thread(runGate, cref(serverInfo),
+					 cref(messages), options.speed,
+					 ref(recorder)));
+	}
+	for (auto &t : threads)
+		t.join();
+	SmartTime elapsed(SmartTime::INIT_CURR_TIME);
+	elapsed -= startTime;
+	IngestionPipeline::getInstance().getStat(statAfter);
+
+	recorder.report(elapsed.getAsSec());
+	// putTriggers and putHosts write the DB in the handler, so their
+	// DB time is included in the latency.
+	const uint64_t numCommits =
+	  statAfter.numCommits - statBefore.numCommits;
+	const double commitTimeMSec =
+	  statAfter.commitTimeMSec - statBefore.commitTimeMSec;
+	cout << StringUtils::sprintf(
+	  "Commits:    %" PRIu64 " (%.1f batches/commit)",
+	  numCommits,
+	  numCommits ?
+	    double(statAfter.numBatches - statBefore.numBatches) / numCommits :
+	    0.0) << endl;
+	cout << StringUtils::sprintf(
+	  "DB time:    %.3f s (%.3f ms/commit)",
+	  commitTimeMSec / 1000,
+	  numCommits ? commitTimeMSec / numCommits : 0.0) << endl;
+
+	g_free(options.capturePath);
+	g_free(options.procedure);
+	g_free(options.dbName);
+	g_free(options.dbUser);
+	g_free(options.dbPassword);
+	return EXIT_SUCCESS;
+}
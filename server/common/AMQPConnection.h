@@ -35,6 +35,14 @@ typedef UsedCountablePtr<AMQPConnection> AMQPConnectionPtr;
 struct AMQPMessage {
 	std::string contentType;
 	std::string body;
+	// Only set for a message consumed by AMQPConsumerPool in the manual
+	// ack mode.
+	uint64_t deliveryTag;
+
+	AMQPMessage(void)
+	: deliveryTag(0)
+	{
+	}
 };
 
 struct AMQPJSONMessage : public AMQPMessage {
@@ -27,6 +27,7 @@
 
 static const char  *DEFAULT_URL     = "amqp://localhost";
 static const time_t DEFAULT_TIMEOUT = 1;
+static const uint16_t DEFAULT_PREFETCH_COUNT = 0;
 
 using namespace std;
 using namespace mlpl;
@@ -35,7 +36,10 @@ struct AMQPConnectionInfo::Impl {
 	Impl()
 	: m_URLBuf(NULL),
 	  m_parsedURL(),
-	  m_timeout(DEFAULT_TIMEOUT)
+	  m_timeout(DEFAULT_TIMEOUT),
+	  m_isTLSVerifyEnabled(false),
+	  m_isManualAckEnabled(false),
+	  m_prefetchCount(DEFAULT_PREFETCH_COUNT)
 	{
 		amqp_default_connection_info(&m_parsedURL);
 		setURL(DEFAULT_URL);
@@ -58,6 +62,8 @@ struct AMQPConnectionInfo::Impl {
 		m_tlsKeyPath = rhs.m_tlsKeyPath;
 		m_tlsCACertificatePath = rhs.m_tlsCACertificatePath;
 		m_isTLSVerifyEnabled = rhs.m_isTLSVerifyEnabled;
+		m_isManualAckEnabled = rhs.m_isManualAckEnabled;
+		m_prefetchCount = rhs.m_prefetchCount;
 		setURL(m_URL);
 	}
 
@@ -73,6 +79,8 @@ struct AMQPConnectionInfo::Impl {
 		m_tlsKeyPath = rhs.m_tlsKeyPath;
 		m_tlsCACertificatePath = rhs.m_tlsCACertificatePath;
 		m_isTLSVerifyEnabled = rhs.m_isTLSVerifyEnabled;
+		m_isManualAckEnabled = rhs.m_isManualAckEnabled;
+		m_prefetchCount = rhs.m_prefetchCount;
 		setURL(m_URL);
 		return *this;
 	}
@@ -102,6 +110,8 @@ struct AMQPConnectionInfo::Impl {
 	string m_tlsKeyPath;
 	string m_tlsCACertificatePath;
 	bool m_isTLSVerifyEnabled;
+	bool m_isManualAckEnabled;
+	uint16_t m_prefetchCount;
 
 private:
 	string normalizeURL(const string &URL)
@@ -246,3 +256,22 @@ void AMQPConnectionInfo::setTLSVerifyEnabled(const bool &enabled)
 	m_impl->m_isTLSVerifyEnabled = enabled;
 }
 
+bool AMQPConnectionInfo::isManualAckEnabled(void) const
+{
+	return m_impl->m_isManualAckEnabled;
+}
+
+void AMQPConnectionInfo::setManualAckEnabled(const bool &enabled)
+{
+	m_impl->m_isManualAckEnabled = enabled;
+}
+
+uint16_t AMQPConnectionInfo::getPrefetchCount(void) const
+{
+	return m_impl->m_prefetchCount;
+}
+
+void AMQPConnectionInfo::setPrefetchCount(const uint16_t &count)
+{
+	m_impl->m_prefetchCount = count;
+}
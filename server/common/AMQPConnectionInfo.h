@@ -61,6 +61,27 @@ public:
 	bool isTLSVerifyEnabled(void) const;
 	void setTLSVerifyEnabled(const bool &enabled);
 
+	/**
+	 * Enable the manual acknowledgement mode of AMQPConsumerPool.
+	 * AMQPConsumer always consumes messages without acknowledgements.
+	 *
+	 * In this mode a consumed message is acknowledged after its handler
+	 * returns, and the broker doesn't send more messages than the
+	 * prefetch count until they are acknowledged.
+	 *
+	 * @param enabled true to enable the mode.
+	 */
+	void setManualAckEnabled(const bool &enabled);
+	bool isManualAckEnabled(void) const;
+
+	/**
+	 * Set the number of unacknowledged messages that the broker sends.
+	 *
+	 * @param count The prefetch count. 0 means no limit.
+	 */
+	void setPrefetchCount(const uint16_t &count);
+	uint16_t getPrefetchCount(void) const;
+
 private:
 	struct Impl;
 	std::unique_ptr<Impl> m_impl;
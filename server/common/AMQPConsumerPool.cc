@@ -0,0 +1,1169 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <deque>
+#include <map>
+#include <vector>
+#include <Logger.h>
+#include <Mutex.h>
+#include <SimpleSemaphore.h>
+#include <EventSemaphore.h>
+#include "AMQPConsumerPool.h"
+#include "HatoholThreadBase.h"
+
+using namespace std;
+using namespace mlpl;
+
+const size_t AMQPConsumerPool::DEFAULT_NUM_CONNECTIONS_PER_BROKER = 4;
+const size_t AMQPConsumerPool::DEFAULT_NUM_WORKERS = 8;
+
+// Channel 1 is opened by AMQPConnection::connect() and isn't used here.
+static const amqp_channel_t FIRST_CHANNEL = 2;
+static const int    EPOLL_TIMEOUT_MSEC = 1000;
+static const time_t RETRY_INTERVAL_SEC = 5;
+// The interval to check the number of messages in the consumer queues.
+static const time_t BACKLOG_CHECK_INTERVAL_SEC = 5;
+// The number of messages read from a connection at once, so that
+// a busy connection doesn't block the others.
+static const size_t MAX_CONSUME_BURST = 256;
+
+struct PooledDelivery {
+	AMQPMessage message;
+	uint64_t    epoch;
+};
+
+struct PooledAck {
+	uint64_t deliveryTag;
+	uint64_t epoch;
+};
+
+enum ChannelResult {
+	CHANNEL_OK,
+	// The broker closed only the channel. The connection is still usable.
+	CHANNEL_CLOSED,
+	CONNECTION_LOST,
+};
+
+class PooledConnection;
+
+class AMQPConsumerPool::Subscription {
+public:
+	Subscription(const AMQPConnectionInfo &_info, Handler &_handler)
+	: info(_info),
+	  handler(_handler),
+	  connection(NULL),
+	  channel(0),
+	  started(false),
+	  publisherQueueDeclared(false),
+	  lastStartTime(0),
+	  lastBacklogCheckTime(0),
+	  epoch(0),
+	  removed(false),
+	  scheduled(false),
+	  running(false),
+	  waitingRemoval(false),
+	  backlog(0),
+	  idleSem(0)
+	{
+	}
+
+	const AMQPConnectionInfo info;
+	Handler                 &handler;
+
+	// Only the I/O thread touches the following members.
+	PooledConnection        *connection;
+	amqp_channel_t           channel;
+	bool                     started;
+	bool                     publisherQueueDeclared;
+	time_t                   lastStartTime;
+	time_t                   lastBacklogCheckTime;
+
+	// The following members are protected by Impl::lock.
+	uint64_t                 epoch;
+	bool                     removed;
+	bool                     scheduled;
+	bool                     running;
+	bool                     waitingRemoval;
+	size_t                   backlog;
+	deque<PooledDelivery>    inbox;
+	deque<AMQPMessage>       outbox;
+	deque<PooledAck>         acks;
+	SimpleSemaphore          idleSem;
+};
+
+typedef AMQPConsumerPool::Subscription Subscription;
+
+// ---------------------------------------------------------------------------
+// PooledConnection
+// ---------------------------------------------------------------------------
+class PooledConnection : public AMQPConnection {
+public:
+	PooledConnection(const AMQPConnectionInfo &info)
+	: AMQPConnection(info),
+	  numSubscriptions(0),
+	  lastConnectTime(0),
+	  socketFd(-1)
+	{
+	}
+
+	amqp_channel_t allocateChannel(void)
+	{
+		amqp_channel_t channel = FIRST_CHANNEL;
+		while (channelMap.find(channel) != channelMap.end())
+			channel++;
+		return channel;
+	}
+
+	ChannelResult startChannel(Subscription &subscription)
+	{
+		amqp_connection_state_t state = getConnection();
+		const amqp_channel_t channel = subscription.channel;
+		if (!amqp_channel_open(state, channel))
+			return checkReply("open channel", channel);
+
+		const AMQPConnectionInfo &info = subscription.info;
+		const bool manualAck = info.isManualAckEnabled();
+		if (manualAck && info.getPrefetchCount() > 0) {
+			const uint32_t prefetchSize = 0;
+			const amqp_boolean_t global = false;
+			if (!amqp_basic_qos(state, channel, prefetchSize,
+					    info.getPrefetchCount(), global))
+				return checkReply("set QoS", channel);
+		}
+
+		const string &queueName = info.getConsumerQueueName();
+		const ChannelResult result = declareQueue(channel, queueName);
+		if (result != CHANNEL_OK)
+			return result;
+
+		const amqp_bytes_t queue = amqp_cstring_bytes(queueName.c_str());
+		const amqp_boolean_t noLocal = false;
+		const amqp_boolean_t noAck = !manualAck;
+		const amqp_boolean_t exclusive = false;
+		if (!amqp_basic_consume(state, channel, queue, amqp_empty_bytes,
+					noLocal, noAck, exclusive,
+					amqp_empty_table))
+			return checkReply("start consuming", channel);
+		subscription.started = true;
+		subscription.publisherQueueDeclared = false;
+		return CHANNEL_OK;
+	}
+
+	ChannelResult declareQueue(const amqp_channel_t &channel,
+				   const string &name,
+				   const bool &passive = false,
+				   size_t *numMessages = NULL)
+	{
+		amqp_connection_state_t state = getConnection();
+		const amqp_boolean_t durable = false;
+		const amqp_boolean_t exclusive = false;
+		const amqp_boolean_t autoDelete = false;
+		const amqp_queue_declare_ok_t *response =
+		  amqp_queue_declare(state, channel,
+				     amqp_cstring_bytes(name.c_str()),
+				     passive, durable, exclusive, autoDelete,
+				     amqp_empty_table);
+		if (!response)
+			return checkReply("declare queue", channel);
+		if (numMessages)
+			*numMessages = response->message_count;
+		return CHANNEL_OK;
+	}
+
+	ChannelResult getBacklog(Subscription &subscription,
+				 size_t &numMessages)
+	{
+		const bool passive = true;
+		return declareQueue(subscription.channel,
+				    subscription.info.getConsumerQueueName(),
+				    passive, &numMessages);
+	}
+
+	void closeChannel(Subscription &subscription)
+	{
+		if (!subscription.started)
+			return;
+		amqp_connection_state_t state = getConnection();
+		logErrorResponse("close channel",
+				 amqp_channel_close(state, subscription.channel,
+						    AMQP_REPLY_SUCCESS));
+		subscription.started = false;
+	}
+
+	ChannelResult publish(Subscription &subscription,
+			      const AMQPMessage &message)
+	{
+		const string &queueName = subscription.info.getPublisherQueueName();
+		if (!subscription.publisherQueueDeclared) {
+			const ChannelResult result =
+			  declareQueue(subscription.channel, queueName);
+			if (result != CHANNEL_OK)
+				return result;
+			subscription.publisherQueueDeclared = true;
+		}
+
+		amqp_basic_properties_t props;
+		props._flags =
+		  AMQP_BASIC_CONTENT_TYPE_FLAG | AMQP_BASIC_DELIVERY_MODE_FLAG;
+		props.content_type = message.contentType.empty() ?
+		  amqp_cstring_bytes("application/octet-stream") :
+		  amqp_cstring_bytes(message.contentType.c_str());
+		props.delivery_mode = 2;
+		amqp_bytes_t body;
+		body.bytes = const_cast<char *>(message.body.data());
+		body.len = message.body.length();
+		const amqp_boolean_t mandatory = false;
+		const amqp_boolean_t immediate = false;
+		const int status =
+		  amqp_basic_publish(getConnection(), subscription.channel,
+				     amqp_empty_bytes,
+				     amqp_cstring_bytes(queueName.c_str()),
+				     mandatory, immediate, &props, body);
+		if (status != AMQP_STATUS_OK) {
+			MLPL_ERR("Failed to publish a message: %s\n",
+				 amqp_error_string2(status));
+			return CONNECTION_LOST;
+		}
+		return CHANNEL_OK;
+	}
+
+	bool ack(Subscription &subscription, const uint64_t &deliveryTag)
+	{
+		const amqp_boolean_t multiple = false;
+		const int status = amqp_basic_ack(getConnection(),
+						  subscription.channel,
+						  deliveryTag, multiple);
+		if (status != AMQP_STATUS_OK) {
+			MLPL_ERR("Failed to ack a message: %s\n",
+				 amqp_error_string2(status));
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	 * Read a frame that amqp_consume_message() didn't expect.
+	 *
+	 * @param closedChannel
+	 * A channel closed by the broker is stored when CHANNEL_CLOSED is
+	 * returned.
+	 * @return A state of the connection after the frame.
+	 */
+	ChannelResult readUnexpectedFrame(amqp_channel_t &closedChannel)
+	{
+		amqp_connection_state_t state = getConnection();
+		amqp_frame_t frame;
+		const int status = amqp_simple_wait_frame(state, &frame);
+		if (status != AMQP_STATUS_OK) {
+			MLPL_ERR("Failed to read a frame: %s\n",
+				 amqp_error_string2(status));
+			return CONNECTION_LOST;
+		}
+		if (frame.frame_type != AMQP_FRAME_METHOD)
+			return CHANNEL_OK;
+
+		switch (frame.payload.method.id) {
+		case AMQP_BASIC_RETURN_METHOD:
+		{
+			amqp_message_t message;
+			const int flags = 0;
+			const amqp_rpc_reply_t reply =
+			  amqp_read_message(state, frame.channel, &message,
+					    flags);
+			if (reply.reply_type != AMQP_RESPONSE_NORMAL) {
+				logErrorResponse("read a returned message",
+						 reply);
+				return CONNECTION_LOST;
+			}
+			amqp_destroy_message(&message);
+			return CHANNEL_OK;
+		}
+		case AMQP_CHANNEL_CLOSE_METHOD:
+		{
+			const amqp_channel_close_t *close =
+			  static_cast<amqp_channel_close_t *>(
+			    frame.payload.method.decoded);
+			MLPL_ERR("Channel %u was closed by the broker: "
+				 "%u: %.*s\n", frame.channel, close->reply_code,
+				 static_cast<int>(close->reply_text.len),
+				 static_cast<char *>(close->reply_text.bytes));
+			if (!sendChannelCloseOk(frame.channel))
+				return CONNECTION_LOST;
+			closedChannel = frame.channel;
+			return CHANNEL_CLOSED;
+		}
+		case AMQP_CONNECTION_CLOSE_METHOD:
+			MLPL_ERR("The connection was closed by the broker.\n");
+			return CONNECTION_LOST;
+		default:
+			MLPL_WARN("Ignored an unexpected method: 0x%08x\n",
+				  frame.payload.method.id);
+			return CHANNEL_OK;
+		}
+	}
+
+	bool hasBufferedData(void)
+	{
+		amqp_connection_state_t state = getConnection();
+		return amqp_data_in_buffer(state) || amqp_frames_enqueued(state);
+	}
+
+	void dispose(void)
+	{
+		disposeConnection();
+	}
+
+	using AMQPConnection::getConnection;
+
+	string                               key;
+	// The number of subscriptions assigned including the ones that
+	// haven't been attached yet. It's protected by Impl::lock.
+	size_t                               numSubscriptions;
+	time_t                               lastConnectTime;
+	int                                  socketFd;
+	// Only the I/O thread changes it with Impl::lock held.
+	map<amqp_channel_t, Subscription *>  channelMap;
+
+private:
+	ChannelResult checkReply(const char *context,
+				 const amqp_channel_t &channel)
+	{
+		const amqp_rpc_reply_t reply =
+		  amqp_get_rpc_reply(getConnection());
+		logErrorResponse(context, reply);
+		if (reply.reply_type != AMQP_RESPONSE_SERVER_EXCEPTION ||
+		    reply.reply.id != AMQP_CHANNEL_CLOSE_METHOD)
+			return CONNECTION_LOST;
+		// e.g. A queue declared with other attributes. The other
+		// channels on the connection aren't affected.
+		if (!sendChannelCloseOk(channel))
+			return CONNECTION_LOST;
+		return CHANNEL_CLOSED;
+	}
+
+	bool sendChannelCloseOk(const amqp_channel_t &channel)
+	{
+		// The channel number can't be used again until the broker
+		// gets channel.close-ok.
+		amqp_channel_close_ok_t closeOk;
+		memset(&closeOk, 0, sizeof(closeOk));
+		const int status = amqp_send_method(getConnection(), channel,
+						    AMQP_CHANNEL_CLOSE_OK_METHOD,
+						    &closeOk);
+		if (status != AMQP_STATUS_OK) {
+			MLPL_ERR("Failed to send channel.close-ok: %s\n",
+				 amqp_error_string2(status));
+			return false;
+		}
+		return true;
+	}
+};
+
+// ---------------------------------------------------------------------------
+// Impl
+// ---------------------------------------------------------------------------
+struct AMQPConsumerPool::Impl {
+	class Worker;
+	class IOThread;
+
+	static AMQPConsumerPool instance;
+
+	// The I/O thread doesn't hold lock while it talks to brokers, so
+	// a slow broker doesn't block the workers and the callers.
+	Mutex                               lock;
+	bool                                started;
+	int                                 epollFd;
+	EventSemaphore                      wakeSem;
+	SimpleSemaphore                     readySem;
+	deque<Subscription *>               readyQueue;
+	// connections and newSubscriptions are protected by lock.
+	// Only the I/O thread changes the state of the connections.
+	multimap<string, PooledConnection *> connections;
+	vector<Subscription *>              newSubscriptions;
+	vector<Subscription *>              removedSubscriptions;
+	Stat                                stat;
+	unique_ptr<IOThread>                ioThread;
+	vector<unique_ptr<Worker> >         workers;
+
+	Impl(void);
+	~Impl();
+	void startIfNeeded(void);
+	void stop(void);
+
+	void wake(void)
+	{
+		wakeSem.post();
+	}
+
+	void addToEpoll(const int &fd, PooledConnection *connection)
+	{
+		if (epollFd < 0)
+			return;
+		struct epoll_event event;
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN;
+		event.data.ptr = connection;
+		if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+			MLPL_ERR("Failed to add fd %d to epoll: %s\n",
+				 fd, strerror(errno));
+		}
+	}
+
+	void removeFromEpoll(const int &fd)
+	{
+		if (epollFd < 0 || fd < 0)
+			return;
+		struct epoll_event event;
+		epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, &event);
+	}
+
+	static string makeConnectionKey(const AMQPConnectionInfo &info)
+	{
+		// Queues on the same broker with the same credentials share
+		// connections.
+		string key = info.getURL();
+		key += "\n" + info.getTLSCertificatePath();
+		key += "\n" + info.getTLSKeyPath();
+		key += "\n" + info.getTLSCACertificatePath();
+		key += info.isTLSVerifyEnabled() ? "\n1" : "\n0";
+		return key;
+	}
+
+	PooledConnection *assignConnection(const AMQPConnectionInfo &info)
+	{
+		// lock has to be held by the caller.
+		const string key = makeConnectionKey(info);
+		auto range = connections.equal_range(key);
+		PooledConnection *leastLoaded = NULL;
+		size_t numConnections = 0;
+		for (auto it = range.first; it != range.second; ++it) {
+			PooledConnection *connection = it->second;
+			numConnections++;
+			if (!leastLoaded ||
+			    connection->numSubscriptions <
+			    leastLoaded->numSubscriptions) {
+				leastLoaded = connection;
+			}
+		}
+		// Subscriptions are spread over new connections until the
+		// number of them reaches the limit.
+		if (!leastLoaded || (leastLoaded->numSubscriptions > 0 &&
+		    numConnections < DEFAULT_NUM_CONNECTIONS_PER_BROKER)) {
+			leastLoaded = new PooledConnection(info);
+			leastLoaded->key = key;
+			connections.insert(make_pair(key, leastLoaded));
+		}
+		leastLoaded->numSubscriptions++;
+		return leastLoaded;
+	}
+
+	vector<PooledConnection *> getConnections(void)
+	{
+		// Connections are never deleted while the I/O thread runs.
+		AutoMutex autoLock(&lock);
+		vector<PooledConnection *> list;
+		list.reserve(connections.size());
+		for (auto &pair : connections)
+			list.push_back(pair.second);
+		return list;
+	}
+
+	// -------------------------------------------------------------------
+	// Worker
+	// -------------------------------------------------------------------
+	void schedule(Subscription *subscription)
+	{
+		// lock has to be held by the caller.
+		if (subscription->scheduled || subscription->running)
+			return;
+		subscription->scheduled = true;
+		readyQueue.push_back(subscription);
+		readySem.post();
+	}
+
+	void runWorker(HatoholThreadBase &worker)
+	{
+		while (true) {
+			readySem.wait();
+			if (worker.isExitRequested())
+				break;
+
+			Subscription *subscription = NULL;
+			PooledDelivery delivery;
+			{
+				AutoMutex autoLock(&lock);
+				if (readyQueue.empty())
+					continue;
+				subscription = readyQueue.front();
+				readyQueue.pop_front();
+				subscription->scheduled = false;
+				if (subscription->removed ||
+				    subscription->inbox.empty())
+					continue;
+				delivery = move(subscription->inbox.front());
+				subscription->inbox.pop_front();
+				subscription->running = true;
+			}
+
+			try {
+				subscription->handler.handle(*subscription,
+							     delivery.message);
+			} catch (const exception &e) {
+				MLPL_ERR("Failed to handle a message: %s\n",
+					 e.what());
+			}
+
+			AutoMutex autoLock(&lock);
+			subscription->running = false;
+			if (subscription->waitingRemoval) {
+				subscription->idleSem.post();
+				continue;
+			}
+			if (subscription->removed)
+				continue;
+			if (subscription->info.isManualAckEnabled()) {
+				PooledAck ack;
+				ack.deliveryTag = delivery.message.deliveryTag;
+				ack.epoch = delivery.epoch;
+				subscription->acks.push_back(ack);
+				wake();
+			}
+			if (!subscription->inbox.empty())
+				schedule(subscription);
+		}
+	}
+
+	// -------------------------------------------------------------------
+	// I/O thread
+	// -------------------------------------------------------------------
+	void runIOThread(HatoholThreadBase &thread)
+	{
+		while (!thread.isExitRequested()) {
+			attachNewSubscriptions();
+			detachRemovedSubscriptions();
+			connectAll();
+			restartClosedChannels();
+			flushAll();
+			consumeAll();
+			checkBacklogs();
+			waitEvents();
+		}
+
+		for (auto connection : getConnections()) {
+			if (connection->isConnected())
+				disconnect(*connection);
+		}
+	}
+
+	void attachNewSubscriptions(void)
+	{
+		vector<Subscription *> attached;
+		{
+			AutoMutex autoLock(&lock);
+			for (auto subscription : newSubscriptions) {
+				PooledConnection *connection =
+				  subscription->connection;
+				subscription->channel =
+				  connection->allocateChannel();
+				connection->channelMap[subscription->channel] =
+				  subscription;
+			}
+			// unsubscribe() passes them to this thread via
+			// removedSubscriptions from now on.
+			attached.swap(newSubscriptions);
+		}
+		for (auto subscription : attached) {
+			PooledConnection &connection = *subscription->connection;
+			if (connection.isConnected())
+				startChannel(connection, *subscription);
+		}
+	}
+
+	void detachRemovedSubscriptions(void)
+	{
+		vector<Subscription *> detached;
+		{
+			AutoMutex autoLock(&lock);
+			auto it = removedSubscriptions.begin();
+			while (it != removedSubscriptions.end()) {
+				Subscription *subscription = *it;
+				// A worker may still have it in the ready queue.
+				if (subscription->scheduled ||
+				    subscription->running) {
+					++it;
+					continue;
+				}
+				subscription->connection->channelMap.erase(
+				  subscription->channel);
+				detached.push_back(subscription);
+				it = removedSubscriptions.erase(it);
+			}
+		}
+		for (auto subscription : detached) {
+			PooledConnection *connection = subscription->connection;
+			if (connection->isConnected())
+				connection->closeChannel(*subscription);
+			delete subscription;
+		}
+	}
+
+	void startChannel(PooledConnection &connection,
+			  Subscription &subscription)
+	{
+		{
+			AutoMutex autoLock(&lock);
+			if (subscription.removed)
+				return;
+		}
+		subscription.lastStartTime = time(NULL);
+		const ChannelResult result =
+		  connection.startChannel(subscription);
+		if (result != CHANNEL_OK) {
+			handleChannelResult(connection, &subscription, result);
+			return;
+		}
+		// Deliveries and acks of the old channel are invalid.
+		AutoMutex autoLock(&lock);
+		subscription.epoch++;
+		subscription.inbox.clear();
+		subscription.acks.clear();
+	}
+
+	void handleChannelResult(PooledConnection &connection,
+				 Subscription *subscription,
+				 const ChannelResult &result)
+	{
+		if (result == CONNECTION_LOST) {
+			disconnect(connection);
+			return;
+		}
+		if (result != CHANNEL_CLOSED || !subscription)
+			return;
+
+		// Only this channel is reopened by restartClosedChannels().
+		subscription->started = false;
+		subscription->publisherQueueDeclared = false;
+		subscription->lastStartTime = time(NULL);
+		AutoMutex autoLock(&lock);
+		subscription->epoch++;
+		subscription->inbox.clear();
+		subscription->acks.clear();
+	}
+
+	void connectAll(void)
+	{
+		vector<PooledConnection *> targets;
+		{
+			AutoMutex autoLock(&lock);
+			const time_t now = time(NULL);
+			for (auto &pair : connections) {
+				PooledConnection &connection = *pair.second;
+				if (connection.isConnected())
+					continue;
+				if (connection.channelMap.empty())
+					continue;
+				if (now - connection.lastConnectTime <
+				    RETRY_INTERVAL_SEC)
+					continue;
+				connection.lastConnectTime = now;
+				targets.push_back(&connection);
+			}
+		}
+
+		for (auto connection : targets) {
+			// Connecting may take long. It's done without the lock
+			// because only this thread changes the connection.
+			if (!connection->connect())
+				continue;
+			connection->socketFd =
+			  amqp_get_sockfd(connection->getConnection());
+			addToEpoll(connection->socketFd, connection);
+			{
+				AutoMutex autoLock(&lock);
+				stat.numConnected++;
+			}
+			for (auto &channelPair : connection->channelMap) {
+				startChannel(*connection, *channelPair.second);
+				if (!connection->isConnected())
+					break;
+			}
+		}
+	}
+
+	void restartClosedChannels(void)
+	{
+		const time_t now = time(NULL);
+		for (auto connection : getConnections()) {
+			for (auto &channelPair : connection->channelMap) {
+				if (!connection->isConnected())
+					break;
+				Subscription &subscription = *channelPair.second;
+				if (subscription.started)
+					continue;
+				if (now - subscription.lastStartTime <
+				    RETRY_INTERVAL_SEC)
+					continue;
+				startChannel(*connection, subscription);
+			}
+		}
+	}
+
+	void disconnect(PooledConnection &connection)
+	{
+		removeFromEpoll(connection.socketFd);
+		connection.socketFd = -1;
+		connection.dispose();
+		for (auto &pair : connection.channelMap) {
+			pair.second->started = false;
+			pair.second->publisherQueueDeclared = false;
+		}
+		AutoMutex autoLock(&lock);
+		if (stat.numConnected > 0)
+			stat.numConnected--;
+	}
+
+	void flushAll(void)
+	{
+		for (auto connection : getConnections()) {
+			for (auto &channelPair : connection->channelMap) {
+				if (!connection->isConnected())
+					break;
+				flush(*connection, *channelPair.second);
+			}
+		}
+	}
+
+	void flush(PooledConnection &connection, Subscription &subscription)
+	{
+		if (!subscription.started)
+			return;
+		uint64_t epoch;
+		deque<PooledAck> acks;
+		deque<AMQPMessage> outbox;
+		{
+			AutoMutex autoLock(&lock);
+			if (subscription.acks.empty() &&
+			    subscription.outbox.empty())
+				return;
+			epoch = subscription.epoch;
+			acks.swap(subscription.acks);
+			outbox.swap(subscription.outbox);
+		}
+
+		// Sending may block while the socket buffer is full.
+		ChannelResult result = CHANNEL_OK;
+		for (auto &ack : acks) {
+			if (ack.epoch != epoch)
+				continue;
+			if (!connection.ack(subscription, ack.deliveryTag)) {
+				result = CONNECTION_LOST;
+				break;
+			}
+		}
+		size_t numPublished = 0;
+		while (result == CHANNEL_OK && !outbox.empty()) {
+			result = connection.publish(subscription,
+						    outbox.front());
+			if (result != CHANNEL_OK)
+				break;
+			outbox.pop_front();
+			numPublished++;
+		}
+
+		{
+			AutoMutex autoLock(&lock);
+			stat.numPublished += numPublished;
+			// Unsent messages go out after the recovery ahead of
+			// the ones queued in the meantime. Unsent acks are
+			// invalid after that.
+			if (!subscription.removed) {
+				subscription.outbox.insert(
+				  subscription.outbox.begin(),
+				  outbox.begin(), outbox.end());
+			}
+		}
+		handleChannelResult(connection, &subscription, result);
+	}
+
+	void consumeAll(void)
+	{
+		for (auto connection : getConnections()) {
+			for (size_t i = 0; i < MAX_CONSUME_BURST; i++) {
+				if (!connection->isConnected())
+					break;
+				if (!consume(*connection))
+					break;
+			}
+		}
+	}
+
+	bool consume(PooledConnection &connection)
+	{
+		// A zero timeout makes amqp_consume_message() return without
+		// blocking.
+		amqp_connection_state_t state = connection.getConnection();
+		amqp_maybe_release_buffers(state);
+		struct timeval timeout = { 0, 0 };
+		amqp_envelope_t envelope;
+		const int flags = 0;
+		amqp_rpc_reply_t reply =
+		  amqp_consume_message(state, &envelope, &timeout, flags);
+		if (reply.reply_type == AMQP_RESPONSE_LIBRARY_EXCEPTION &&
+		    reply.library_error == AMQP_STATUS_TIMEOUT) {
+			return false;
+		}
+		if (reply.reply_type == AMQP_RESPONSE_LIBRARY_EXCEPTION &&
+		    reply.library_error == AMQP_STATUS_UNEXPECTED_STATE) {
+			// A frame other than a delivery such as channel.close.
+			amqp_channel_t channel = 0;
+			const ChannelResult result =
+			  connection.readUnexpectedFrame(channel);
+			Subscription *subscription = NULL;
+			auto it = connection.channelMap.find(channel);
+			if (it != connection.channelMap.end())
+				subscription = it->second;
+			handleChannelResult(connection, subscription, result);
+			return result != CONNECTION_LOST;
+		}
+		if (reply.reply_type != AMQP_RESPONSE_NORMAL) {
+			MLPL_ERR("Failed to consume a message: %d\n",
+				 reply.reply_type);
+			disconnect(connection);
+			return false;
+		}
+
+		auto it = connection.channelMap.find(envelope.channel);
+		// A delivery left from a closed channel can't be acked.
+		if (it != connection.channelMap.end() && it->second->started) {
+			Subscription *subscription = it->second;
+			PooledDelivery delivery;
+			const amqp_bytes_t &contentType =
+			  envelope.message.properties.content_type;
+			const amqp_bytes_t &body = envelope.message.body;
+			delivery.message.contentType.assign(
+			  static_cast<char *>(contentType.bytes),
+			  contentType.len);
+			delivery.message.body.assign(
+			  static_cast<char *>(body.bytes), body.len);
+			delivery.message.deliveryTag = envelope.delivery_tag;
+
+			AutoMutex autoLock(&lock);
+			if (!subscription->removed) {
+				delivery.epoch = subscription->epoch;
+				subscription->inbox.push_back(move(delivery));
+				stat.numConsumed++;
+				schedule(subscription);
+			}
+		}
+		amqp_destroy_envelope(&envelope);
+		return true;
+	}
+
+	void checkBacklogs(void)
+	{
+		const time_t now = time(NULL);
+		for (auto connection : getConnections()) {
+			for (auto &channelPair : connection->channelMap) {
+				if (!connection->isConnected())
+					break;
+				Subscription &subscription = *channelPair.second;
+				if (!subscription.started)
+					continue;
+				if (now - subscription.lastBacklogCheckTime <
+				    BACKLOG_CHECK_INTERVAL_SEC)
+					continue;
+				subscription.lastBacklogCheckTime = now;
+				size_t numMessages = 0;
+				const ChannelResult result =
+				  connection->getBacklog(subscription,
+							 numMessages);
+				if (result != CHANNEL_OK) {
+					handleChannelResult(*connection,
+							    &subscription,
+							    result);
+					continue;
+				}
+				AutoMutex autoLock(&lock);
+				subscription.backlog = numMessages;
+			}
+		}
+	}
+
+	void waitEvents(void)
+	{
+		// Data may already be in the buffer of librabbitmq.
+		for (auto connection : getConnections()) {
+			if (connection->isConnected() &&
+			    connection->hasBufferedData())
+				return;
+		}
+		if (epollFd < 0) {
+			usleep(EPOLL_TIMEOUT_MSEC * 1000);
+			return;
+		}
+
+		const int maxEvents = 64;
+		struct epoll_event events[maxEvents];
+		const int numEvents = epoll_wait(epollFd, events, maxEvents,
+						 EPOLL_TIMEOUT_MSEC);
+		for (int i = 0; i < numEvents; i++) {
+			// Connections are read by consumeAll() in any case.
+			if (!events[i].data.ptr)
+				wakeSem.wait();
+		}
+	}
+};
+
+// ---------------------------------------------------------------------------
+// Threads
+// ---------------------------------------------------------------------------
+class AMQPConsumerPool::Impl::Worker : public HatoholThreadBase {
+public:
+	Worker(AMQPConsumerPool::Impl &impl)
+	: m_impl(impl)
+	{
+	}
+
+	void stop(void)
+	{
+		requestExit();
+	}
+
+protected:
+	virtual gpointer mainThread(HatoholThreadArg *arg) override
+	{
+		m_impl.runWorker(*this);
+		return NULL;
+	}
+
+private:
+	AMQPConsumerPool::Impl &m_impl;
+};
+
+class AMQPConsumerPool::Impl::IOThread : public HatoholThreadBase {
+public:
+	IOThread(AMQPConsumerPool::Impl &impl)
+	: m_impl(impl)
+	{
+	}
+
+	virtual void waitExit(void) override
+	{
+		m_impl.wake();
+		HatoholThreadBase::waitExit();
+	}
+
+protected:
+	virtual gpointer mainThread(HatoholThreadArg *arg) override
+	{
+		m_impl.runIOThread(*this);
+		return NULL;
+	}
+
+private:
+	AMQPConsumerPool::Impl &m_impl;
+};
+
+AMQPConsumerPool AMQPConsumerPool::Impl::instance;
+
+AMQPConsumerPool::Impl::Impl(void)
+: started(false),
+  epollFd(-1),
+  wakeSem(0),
+  readySem(0)
+{
+}
+
+AMQPConsumerPool::Impl::~Impl()
+{
+	stop();
+	for (auto &pair : connections)
+		delete pair.second;
+	for (auto subscription : newSubscriptions)
+		delete subscription;
+	for (auto subscription : removedSubscriptions)
+		delete subscription;
+	if (epollFd >= 0)
+		close(epollFd);
+}
+
+void AMQPConsumerPool::Impl::startIfNeeded(void)
+{
+	// lock has to be held by the caller.
+	if (started)
+		return;
+	epollFd = epoll_create1(EPOLL_CLOEXEC);
+	if (epollFd < 0) {
+		MLPL_ERR("Failed to create epoll: %s\n", strerror(errno));
+	} else {
+		addToEpoll(wakeSem.getEventFd(), NULL);
+	}
+	for (size_t i = 0; i < DEFAULT_NUM_WORKERS; i++) {
+		workers.push_back(unique_ptr<Worker>(new Worker(*this)));
+		workers.back()->start();
+	}
+	ioThread.reset(new IOThread(*this));
+	ioThread->start();
+	started = true;
+}
+
+void AMQPConsumerPool::Impl::stop(void)
+{
+	if (!started)
+		return;
+	ioThread->exitSync();
+	ioThread.reset();
+	// All flags have to be set before waking up the workers, because
+	// any of them may take a post of the shared semaphore.
+	for (auto &worker : workers)
+		worker->stop();
+	for (size_t i = 0; i < workers.size(); i++)
+		readySem.post();
+	for (auto &worker : workers)
+		worker->exitSync();
+	workers.clear();
+	started = false;
+}
+
+// ---------------------------------------------------------------------------
+// AMQPConsumerPool
+// ---------------------------------------------------------------------------
+AMQPConsumerPool::Handler::~Handler()
+{
+}
+
+AMQPConsumerPool::Stat::Stat(void)
+: numConnections(0),
+  numConnected(0),
+  numSubscriptions(0),
+  numQueuedMessages(0),
+  numConsumed(0),
+  numPublished(0),
+  numInFlight(0),
+  numBacklog(0)
+{
+}
+
+AMQPConsumerPool &AMQPConsumerPool::getInstance(void)
+{
+	return Impl::instance;
+}
+
+Subscription *AMQPConsumerPool::subscribe(const AMQPConnectionInfo &info,
+					  Handler &handler)
+{
+	Subscription *subscription = new Subscription(info, handler);
+	AutoMutex autoLock(&m_impl->lock);
+	m_impl->startIfNeeded();
+	subscription->connection = m_impl->assignConnection(info);
+	m_impl->newSubscriptions.push_back(subscription);
+	m_impl->stat.numSubscriptions++;
+	m_impl->wake();
+	return subscription;
+}
+
+void AMQPConsumerPool::unsubscribe(Subscription *subscription)
+{
+	if (!subscription)
+		return;
+	bool waitIdle = false;
+	{
+		AutoMutex autoLock(&m_impl->lock);
+		subscription->removed = true;
+		subscription->inbox.clear();
+		subscription->outbox.clear();
+		subscription->acks.clear();
+		if (subscription->running) {
+			subscription->waitingRemoval = true;
+			waitIdle = true;
+		}
+	}
+	if (waitIdle)
+		subscription->idleSem.wait();
+
+	// The I/O thread closes the channel and frees the subscription.
+	AutoMutex autoLock(&m_impl->lock);
+	subscription->waitingRemoval = false;
+	subscription->connection->numSubscriptions--;
+	vector<Subscription *> &newSubscriptions = m_impl->newSubscriptions;
+	for (auto it = newSubscriptions.begin();
+	     it != newSubscriptions.end(); ++it) {
+		if (*it == subscription) {
+			newSubscriptions.erase(it);
+			m_impl->stat.numSubscriptions--;
+			delete subscription;
+			return;
+		}
+	}
+	m_impl->removedSubscriptions.push_back(subscription);
+	m_impl->stat.numSubscriptions--;
+	m_impl->wake();
+}
+
+void AMQPConsumerPool::publish(Subscription *subscription,
+			       const AMQPMessage &message)
+{
+	AutoMutex autoLock(&m_impl->lock);
+	if (subscription->removed)
+		return;
+	subscription->outbox.push_back(message);
+	m_impl->wake();
+}
+
+void AMQPConsumerPool::getStat(Stat &stat)
+{
+	AutoMutex autoLock(&m_impl->lock);
+	stat = m_impl->stat;
+	stat.numConnections = m_impl->connections.size();
+	size_t numQueuedMessages = 0;
+	size_t numInFlight = 0;
+	size_t numBacklog = 0;
+	for (auto &pair : m_impl->connections) {
+		for (auto &channelPair : pair.second->channelMap) {
+			const Subscription &subscription = *channelPair.second;
+			if (subscription.removed)
+				continue;
+			numQueuedMessages += subscription.inbox.size();
+			numInFlight += subscription.inbox.size();
+			numInFlight += subscription.acks.size();
+			if (subscription.running)
+				numInFlight++;
+			numBacklog += subscription.backlog;
+		}
+	}
+	stat.numQueuedMessages = numQueuedMessages;
+	stat.numInFlight = numInFlight;
+	stat.numBacklog = numBacklog;
+}
+
+// ---------------------------------------------------------------------------
+// Protected methods
+// ---------------------------------------------------------------------------
+AMQPConsumerPool::AMQPConsumerPool(void)
+: m_impl(new Impl())
+{
+}
+
+AMQPConsumerPool::~AMQPConsumerPool()
+{
+}
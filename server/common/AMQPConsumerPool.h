@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AMQPConsumerPool_h
+#define AMQPConsumerPool_h
+
+#include <memory>
+#include "AMQPConnectionInfo.h"
+#include "AMQPConnection.h"
+
+/**
+ * AMQPConsumerPool shares a few broker connections among many queues.
+ *
+ * Each subscription gets its own channel on one of the connections of
+ * the same broker. One I/O thread waits for all connections with epoll,
+ * and sends acknowledgements and the queued messages to be published in
+ * a batch. Received messages are dispatched to a fixed number of worker
+ * threads. The messages of one subscription are handled one by one in
+ * the order of arrival.
+ */
+class AMQPConsumerPool {
+public:
+	static const size_t DEFAULT_NUM_CONNECTIONS_PER_BROKER;
+	static const size_t DEFAULT_NUM_WORKERS;
+
+	class Subscription;
+
+	class Handler {
+	public:
+		virtual ~Handler();
+
+		/**
+		 * Handle a message. This is called on a worker thread.
+		 * The message is acknowledged after this method returns.
+		 *
+		 * @param subscription A subscription that got the message.
+		 * @param message A received message.
+		 */
+		virtual void handle(Subscription &subscription,
+				    const AMQPMessage &message) = 0;
+	};
+
+	struct Stat {
+		size_t   numConnections;
+		size_t   numConnected;
+		size_t   numSubscriptions;
+		size_t   numQueuedMessages;
+		uint64_t numConsumed;
+		uint64_t numPublished;
+		// Messages received but not acknowledged yet.
+		size_t   numInFlight;
+		// Messages waiting in the broker's queues at the last check.
+		size_t   numBacklog;
+
+		Stat(void);
+	};
+
+	static AMQPConsumerPool &getInstance(void);
+
+	/**
+	 * Start consuming a queue.
+	 *
+	 * @param info
+	 * Connection information. The consumer queue is consumed and the
+	 * messages passed to publish() are sent to the publisher queue.
+	 * @param handler A handler for the received messages.
+	 * @return A subscription that is valid until unsubscribe().
+	 */
+	Subscription *subscribe(const AMQPConnectionInfo &info,
+				Handler &handler);
+
+	/**
+	 * Stop consuming. After this method returns, the handler isn't
+	 * called any more.
+	 *
+	 * @param subscription A subscription returned by subscribe().
+	 */
+	void unsubscribe(Subscription *subscription);
+
+	/**
+	 * Queue a message to the publisher queue of a subscription.
+	 * The message is sent by the I/O thread. It waits for the
+	 * reconnection if the connection is lost.
+	 *
+	 * @param subscription A subscription returned by subscribe().
+	 * @param message A message to be sent.
+	 */
+	void publish(Subscription *subscription, const AMQPMessage &message);
+
+	void getStat(Stat &stat);
+
+protected:
+	AMQPConsumerPool(void);
+	virtual ~AMQPConsumerPool();
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> m_impl;
+};
+
+#endif // AMQPConsumerPool_h
@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <inttypes.h>
+#include <Logger.h>
+#include <Mutex.h>
+#include <SmartTime.h>
+#include "HAPI2Capture.h"
+
+using namespace std;
+using namespace mlpl;
+
+const char *HAPI2Capture::ENV_NAME_CAPTURE_DIR = "HATOHOL_HAPI2_CAPTURE_DIR";
+
+static const size_t MAX_CONTENT_TYPE_LENGTH = 255;
+// A larger body is regarded as a broken record.
+static const size_t MAX_BODY_LENGTH = 256 * 1024 * 1024;
+
+struct HAPI2Capture::Impl {
+	FILE     *file;
+	Mutex     lock;
+	bool      started;
+	SmartTime startTime;
+	// Used by read() to join sessions.
+	uint64_t  lastOffsetUSec;
+	uint64_t  sessionBaseUSec;
+
+	Impl(void)
+	: file(NULL),
+	  started(false),
+	  lastOffsetUSec(0),
+	  sessionBaseUSec(0)
+	{
+	}
+
+	~Impl()
+	{
+		close();
+	}
+
+	bool open(const string &path, const char *mode)
+	{
+		close();
+		file = fopen(path.c_str(), mode);
+		if (!file) {
+			MLPL_ERR("Failed to open %s: %s\n",
+				 path.c_str(), strerror(errno));
+			return false;
+		}
+		started = false;
+		lastOffsetUSec = 0;
+		sessionBaseUSec = 0;
+		return true;
+	}
+
+	void close(void)
+	{
+		if (!file)
+			return;
+		fclose(file);
+		file = NULL;
+	}
+};
+
+HAPI2Capture::Record::Record(void)
+: offsetUSec(0)
+{
+}
+
+// ---------------------------------------------------------------------------
+// Public methods
+// ---------------------------------------------------------------------------
+HAPI2Capture::HAPI2Capture(void)
+: m_impl(new Impl())
+{
+}
+
+HAPI2Capture::~HAPI2Capture()
+{
+}
+
+bool HAPI2Capture::openForWrite(const string &path)
+{
+	AutoMutex autoLock(&m_impl->lock);
+	// A reopened capture mustn't lose the records of the last run.
+	return m_impl->open(path, "a");
+}
+
+bool HAPI2Capture::openForRead(const string &path)
+{
+	AutoMutex autoLock(&m_impl->lock);
+	return m_impl->open(path, "r");
+}
+
+bool HAPI2Capture::write(const AMQPMessage &message)
+{
+	AutoMutex autoLock(&m_impl->lock);
+	if (!m_impl->file)
+		return false;
+
+	SmartTime now(SmartTime::INIT_CURR_TIME);
+	if (!m_impl->started) {
+		m_impl->startTime = now;
+		m_impl->started = true;
+	}
+	SmartTime offset(now);
+	offset -= m_impl->startTime;
+	const uint64_t offsetUSec = offset.getAsMSec() * 1000;
+
+	const string contentType =
+	  message.contentType.empty() ? "-" : message.contentType;
+	FILE *file = m_impl->file;
+	fprintf(file, "HAPI2 %" PRIu64 " %s %zd\n",
+		offsetUSec, contentType.c_str(), message.body.size());
+	fwrite(message.body.data(), 1, message.body.size(), file);
+	fputc('\n', file);
+	if (fflush(file) != 0) {
+		MLPL_ERR("Failed to write a capture: %s\n", strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+bool HAPI2Capture::read(Record &record)
+{
+	AutoMutex autoLock(&m_impl->lock);
+	FILE *file = m_impl->file;
+	if (!file)
+		return false;
+
+	char contentType[MAX_CONTENT_TYPE_LENGTH + 1];
+	uint64_t offsetUSec;
+	size_t bodyLength;
+	const int numFields = fscanf(file, "HAPI2 %" SCNu64 " %255s %zu",
+				     &offsetUSec, contentType, &bodyLength);
+	if (numFields == EOF)
+		return false;
+	if (numFields != 3 || fgetc(file) != '\n' ||
+	    bodyLength > MAX_BODY_LENGTH) {
+		MLPL_ERR("Broken capture record at %ld\n", ftell(file));
+		return false;
+	}
+
+	// A smaller offset is the first record of the next session.
+	const uint64_t lastRawOffsetUSec =
+	  m_impl->lastOffsetUSec - m_impl->sessionBaseUSec;
+	if (offsetUSec < lastRawOffsetUSec)
+		m_impl->sessionBaseUSec = m_impl->lastOffsetUSec;
+	m_impl->lastOffsetUSec = m_impl->sessionBaseUSec + offsetUSec;
+	record.offsetUSec = m_impl->lastOffsetUSec;
+	record.message.contentType =
+	  (strcmp(contentType, "-") == 0) ? "" : contentType;
+	record.message.body.resize(bodyLength);
+	if (bodyLength > 0 &&
+	    fread(&record.message.body[0], 1, bodyLength, file) != bodyLength) {
+		MLPL_ERR("Truncated capture record\n");
+		return false;
+	}
+	if (fgetc(file) != '\n') {
+		MLPL_ERR("Broken capture record at %ld\n", ftell(file));
+		return false;
+	}
+	return true;
+}
+
+void HAPI2Capture::close(void)
+{
+	AutoMutex autoLock(&m_impl->lock);
+	m_impl->close();
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HAPI2Capture_h
+#define HAPI2Capture_h
+
+#include <memory>
+#include "AMQPConnection.h"
+
+/**
+ * HAPI2Capture writes or reads a file of HAPI2 messages.
+ *
+ * Each record consists of a header line and the body:
+ *   HAPI2 <offset in usec> <content type> <body length>\n<body>\n
+ * The offset is the time from the first record of a session. The body
+ * may be binary (MessagePack). A file can hold several sessions, e.g.
+ * after a restart of the server. The offsets restart from 0 in each one.
+ */
+class HAPI2Capture {
+public:
+	static const char *ENV_NAME_CAPTURE_DIR;
+
+	struct Record {
+		uint64_t    offsetUSec;
+		AMQPMessage message;
+
+		Record(void);
+	};
+
+	HAPI2Capture(void);
+	virtual ~HAPI2Capture();
+
+	/**
+	 * Open a file to append records. Records in an existing file are
+	 * kept and the new ones are added as a new session.
+	 *
+	 * @param path A path of the file.
+	 * @return true on success. Otherwise false.
+	 */
+	bool openForWrite(const std::string &path);
+
+	/**
+	 * Open a file to read records.
+	 *
+	 * @param path A path of the file.
+	 * @return true on success. Otherwise false.
+	 */
+	bool openForRead(const std::string &path);
+
+	/**
+	 * Append a message with the current time. This is thread safe.
+	 *
+	 * @param message A message to be recorded.
+	 * @return true on success. Otherwise false.
+	 */
+	bool write(const AMQPMessage &message);
+
+	/**
+	 * Read the next record.
+	 *
+	 * The offset of a record in a later session is shifted so that
+	 * the offsets never decrease.
+	 *
+	 * @param record The read record is stored.
+	 * @return true if a record is read. false at the end of the file
+	 * or on a broken record.
+	 */
+	bool read(Record &record);
+
+	void close(void);
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> m_impl;
+};
+
+#endif // HAPI2Capture_h
@@ -0,0 +1,278 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include "HapiItemTableView.h"
+
+using namespace std;
+using namespace mlpl;
+
+// ---------------------------------------------------------------------------
+// HapiItemDataView
+// ---------------------------------------------------------------------------
+HapiItemDataView::HapiItemDataView(const HapiItemDataHeader *header)
+: m_header(header)
+{
+}
+
+ItemId HapiItemDataView::getId(void) const
+{
+	return EndianConverter::LtoN(m_header->itemId);
+}
+
+ItemDataType HapiItemDataView::getItemType(void) const
+{
+	return static_cast<ItemDataType>(EndianConverter::LtoN(m_header->type));
+}
+
+bool HapiItemDataView::isNull(void) const
+{
+	const uint8_t flags = EndianConverter::LtoN(m_header->flags);
+	return flags & HAPI_ITEM_DATA_HEADER_FLAG_NULL;
+}
+
+bool HapiItemDataView::getBool(void) const
+{
+	const uint8_t *body =
+	  static_cast<const uint8_t *>(getBody(ITEM_TYPE_BOOL));
+	return EndianConverter::LtoN(*body);
+}
+
+int HapiItemDataView::getInt(void) const
+{
+	const uint64_t *body =
+	  static_cast<const uint64_t *>(getBody(ITEM_TYPE_INT));
+	return EndianConverter::LtoN(*body);
+}
+
+uint64_t HapiItemDataView::getUint64(void) const
+{
+	// ItemInt can also be casted to uint64_t.
+	const ItemDataType type = getItemType();
+	const ItemDataType expectedType =
+	  (type == ITEM_TYPE_INT) ? ITEM_TYPE_INT : ITEM_TYPE_UINT64;
+	const uint64_t *body =
+	  static_cast<const uint64_t *>(getBody(expectedType));
+	if (type != ITEM_TYPE_INT)
+		return EndianConverter::LtoN(*body);
+	const int val = EndianConverter::LtoN(*body);
+	if (val < 0) {
+		THROW_HATOHOL_EXCEPTION(
+		  "Failed to cast a negative value: %d, ID: %" PRIu64,
+		  val, getId());
+	}
+	return val;
+}
+
+double HapiItemDataView::getDouble(void) const
+{
+	const double *body =
+	  static_cast<const double *>(getBody(ITEM_TYPE_DOUBLE));
+	return EndianConverter::LtoN(*body);
+}
+
+const char *HapiItemDataView::getString(void) const
+{
+	const uint32_t *length =
+	  static_cast<const uint32_t *>(getBody(ITEM_TYPE_STRING));
+	return reinterpret_cast<const char *>(length + 1);
+}
+
+size_t HapiItemDataView::getStringLength(void) const
+{
+	const uint32_t *length =
+	  static_cast<const uint32_t *>(getBody(ITEM_TYPE_STRING));
+	return EndianConverter::LtoN(*length);
+}
+
+void HapiItemDataView::operator>>(int &rhs) const
+{
+	rhs = getInt();
+}
+
+void HapiItemDataView::operator>>(uint64_t &rhs) const
+{
+	rhs = getUint64();
+}
+
+void HapiItemDataView::operator>>(double &rhs) const
+{
+	rhs = getDouble();
+}
+
+void HapiItemDataView::operator>>(string &rhs) const
+{
+	rhs.assign(getString(), getStringLength());
+}
+
+void HapiItemDataView::operator>>(time_t &rhs) const
+{
+	rhs = getInt();
+}
+
+const void *HapiItemDataView::getBody(const ItemDataType &expectedType) const
+{
+	const ItemDataType type = getItemType();
+	if (type != expectedType) {
+		THROW_HATOHOL_EXCEPTION(
+		  "Unexpected item type: %d (expect: %d), ID: %" PRIu64,
+		  type, expectedType, getId());
+	}
+	return m_header + 1;
+}
+
+// ---------------------------------------------------------------------------
+// HapiItemGroupView
+// ---------------------------------------------------------------------------
+HapiItemGroupView::HapiItemGroupView(
+  const HapiItemDataHeader * const *items, const size_t &numItems)
+: m_items(items),
+  m_numItems(numItems)
+{
+}
+
+size_t HapiItemGroupView::getNumberOfItems(void) const
+{
+	return m_numItems;
+}
+
+HapiItemDataView HapiItemGroupView::getItemAt(const size_t &index) const
+{
+	HATOHOL_ASSERT(index < m_numItems,
+	               "index: %zd, numItems: %zd", index, m_numItems);
+	return HapiItemDataView(m_items[index]);
+}
+
+HapiItemDataView HapiItemGroupView::getItem(const ItemId &itemId) const
+{
+	// The number of items in a group is small. A linear search
+	// is faster than building an index.
+	for (size_t i = 0; i < m_numItems; i++) {
+		if (EndianConverter::LtoN(m_items[i]->itemId) == itemId)
+			return HapiItemDataView(m_items[i]);
+	}
+	THROW_ITEM_DATA_EXCEPTION_ITEM_NOT_FOUND(itemId);
+}
+
+// ---------------------------------------------------------------------------
+// HapiItemTableView
+// ---------------------------------------------------------------------------
+static void validateItemData(SmartBuffer &sbuf)
+{
+	HATOHOL_ASSERT(sbuf.remainingSize() >= sizeof(HapiItemDataHeader),
+	 "Remain size (header) is too small: %zd\n", sbuf.remainingSize());
+	const HapiItemDataHeader *header =
+	  sbuf.getPointerAndIncIndex<HapiItemDataHeader>();
+	const ItemDataType type =
+	  static_cast<ItemDataType>(EndianConverter::LtoN(header->type));
+	HATOHOL_ASSERT(type < NUM_ITEM_TYPE, "Invalid type: %d\n", type);
+
+	const size_t requiredBodySize = HAPI_ITEM_DATA_BODY_SIZE[type];
+	HATOHOL_ASSERT(
+	  sbuf.remainingSize() >= requiredBodySize,
+	  "Remain size (body) is too small: %zd (expect: %zd), type: %d\n",
+	  sbuf.remainingSize(), requiredBodySize, type);
+	if (type != ITEM_TYPE_STRING) {
+		sbuf.incIndex(requiredBodySize);
+		return;
+	}
+
+	const uint32_t length =
+	  EndianConverter::LtoN(*sbuf.getPointerAndIncIndex<uint32_t>());
+	HATOHOL_ASSERT(
+	  sbuf.remainingSize() >= length + 1,
+	  "Remain size (body) is too small: %zd (expect: %" PRIu32 ")\n",
+	  sbuf.remainingSize(), length + 1);
+	// getString() returns the pointer in the buffer as it is.
+	HATOHOL_ASSERT(sbuf.getPointer<char>()[length] == '\0',
+	               "The string is not terminated: length: %" PRIu32,
+	               length);
+	sbuf.incIndex(length + 1);
+}
+
+HapiItemTableView::HapiItemTableView(SmartBuffer &sbuf)
+  throw(HatoholException)
+{
+	HATOHOL_ASSERT(sbuf.remainingSize() >= sizeof(HapiItemTableHeader),
+	 "Remaining size (header) is too small: %zd\n", sbuf.remainingSize());
+	const size_t tableIndex0 = sbuf.index();
+	const HapiItemTableHeader *tableHeader =
+	  sbuf.getPointerAndIncIndex<HapiItemTableHeader>();
+	const uint32_t numGroups =
+	  EndianConverter::LtoN(tableHeader->numGroups);
+	const uint32_t tableLength =
+	  EndianConverter::LtoN(tableHeader->length);
+	HATOHOL_ASSERT(sbuf.remainingSize() + sizeof(HapiItemTableHeader)
+	                 >= tableLength,
+	               "Remaining size is too small: %zd (expect: %" PRIu32 ")",
+	               sbuf.remainingSize() + sizeof(HapiItemTableHeader),
+	               tableLength);
+
+	HATOHOL_ASSERT(numGroups * sizeof(HapiItemGroupHeader)
+	                 <= static_cast<uint64_t>(tableLength),
+	               "Too many groups: %" PRIu32 " (length: %" PRIu32 ")",
+	               numGroups, tableLength);
+	m_groupTops.reserve(numGroups + 1);
+	for (size_t grpIdx = 0; grpIdx < numGroups; grpIdx++) {
+		HATOHOL_ASSERT(
+		  sbuf.remainingSize() >= sizeof(HapiItemGroupHeader),
+		  "Remain size (header) is too small: %zd\n",
+		  sbuf.remainingSize());
+		const size_t groupIndex0 = sbuf.index();
+		const HapiItemGroupHeader *groupHeader =
+		  sbuf.getPointerAndIncIndex<HapiItemGroupHeader>();
+		const uint32_t numItems =
+		  EndianConverter::LtoN(groupHeader->numItems);
+		const uint32_t groupLength =
+		  EndianConverter::LtoN(groupHeader->length);
+
+		m_groupTops.push_back(m_items.size());
+		for (size_t idx = 0; idx < numItems; idx++) {
+			m_items.push_back(
+			  sbuf.getPointer<HapiItemDataHeader>());
+			validateItemData(sbuf);
+		}
+
+		const size_t actualLength = sbuf.index() - groupIndex0;
+		HATOHOL_ASSERT(actualLength == groupLength,
+		  "Actual length is different from that in the header: "
+		  " %zd (expect: %" PRIu32 ")", actualLength, groupLength);
+	}
+	m_groupTops.push_back(m_items.size());
+
+	const size_t actualLength = sbuf.index() - tableIndex0;
+	HATOHOL_ASSERT(actualLength == tableLength,
+	               "Actual length is different from that in the header: "
+	               " %zd (expect: %" PRIu32 ")", actualLength, tableLength);
+}
+
+size_t HapiItemTableView::getNumberOfGroups(void) const
+{
+	return m_groupTops.size() - 1;
+}
+
+HapiItemGroupView HapiItemTableView::getGroupAt(const size_t &index) const
+{
+	HATOHOL_ASSERT(index < getNumberOfGroups(),
+	               "index: %zd, numGroups: %zd",
+	               index, getNumberOfGroups());
+	const size_t top = m_groupTops[index];
+	return HapiItemGroupView(m_items.data() + top,
+	                         m_groupTops[index + 1] - top);
+}
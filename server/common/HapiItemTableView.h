@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HapiItemTableView_h
+#define HapiItemTableView_h
+
+#include <string>
+#include <vector>
+#include "HatoholArmPluginInterface.h"
+
+/**
+ * A read-only accessor of an ItemData encoded in a SmartBuffer.
+ *
+ * The value is read from the buffer when it is requested. The getters
+ * have the same casting rules as ItemData's cast operators, i.e.,
+ * a HatoholException is thrown when the type doesn't match.
+ * Only an INT item can be also read as an unsigned 64bit integer.
+ */
+class HapiItemDataView {
+public:
+	HapiItemDataView(const HapiItemDataHeader *header);
+
+	ItemId getId(void) const;
+	ItemDataType getItemType(void) const;
+	bool isNull(void) const;
+
+	bool getBool(void) const;
+	int getInt(void) const;
+	uint64_t getUint64(void) const;
+	double getDouble(void) const;
+
+	/**
+	 * Get the string body in the buffer.
+	 *
+	 * @return
+	 * A pointer to the null-terminated string. It is valid as long as
+	 * the buffer is alive.
+	 */
+	const char *getString(void) const;
+	size_t getStringLength(void) const;
+
+	void operator>>(int &rhs) const;
+	void operator>>(uint64_t &rhs) const;
+	void operator>>(double &rhs) const;
+	void operator>>(std::string &rhs) const;
+	void operator>>(time_t &rhs) const;
+
+private:
+	const void *getBody(const ItemDataType &expectedType) const;
+
+	const HapiItemDataHeader *m_header;
+};
+
+class HapiItemGroupView {
+public:
+	size_t getNumberOfItems(void) const;
+	HapiItemDataView getItemAt(const size_t &index) const;
+
+	/**
+	 * Find the item with the given ID.
+	 *
+	 * If the item is not found, ItemDataException is thrown as
+	 * ItemGroupStream::seek() does.
+	 *
+	 * @param itemId An item ID.
+	 * @return A view of the found item.
+	 */
+	HapiItemDataView getItem(const ItemId &itemId) const;
+
+private:
+	friend class HapiItemTableView;
+	HapiItemGroupView(const HapiItemDataHeader * const *items,
+	                  const size_t &numItems);
+
+	const HapiItemDataHeader * const *m_items;
+	size_t                            m_numItems;
+};
+
+/**
+ * A read-only view of an ItemTable encoded by
+ * HatoholArmPluginInterface::appendItemTable().
+ *
+ * Unlike HatoholArmPluginInterface::createItemTable(), no ItemData,
+ * ItemGroup and string instances are created. The layout is validated
+ * once in the constructor and the values are read from the buffer in
+ * place. So the SmartBuffer must not be modified or freed while the view
+ * and the HapiItemGroupView/HapiItemDataView instances from it are used.
+ */
+class HapiItemTableView {
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param sbuf
+	 * A SmartBuffer instance. The index shall be at the top of
+	 * the HapiItemTableHeader region.
+	 * After this constructor returns, the index of 'sbuf' is forwarded
+	 * to the next of the table.
+	 */
+	HapiItemTableView(mlpl::SmartBuffer &sbuf) throw(HatoholException);
+
+	size_t getNumberOfGroups(void) const;
+	HapiItemGroupView getGroupAt(const size_t &index) const;
+
+private:
+	// Pointers to the item headers of all groups in order.
+	std::vector<const HapiItemDataHeader *> m_items;
+	// The index in m_items of the first item of each group.
+	// The last element is the number of all items.
+	std::vector<size_t>                     m_groupTops;
+};
+
+#endif // HapiItemTableView_h
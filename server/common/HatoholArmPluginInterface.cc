@@ -439,12 +439,32 @@ void HatoholArmPluginInterface::completeItemTable(
 void HatoholArmPluginInterface::appendItemTable(
   mlpl::SmartBuffer &sbuf, ItemTablePtr itemTablePtr)
 {
-	const size_t numGroups = itemTablePtr->getNumberOfRows();
-	const size_t headerIndex = appendItemTableHeader(sbuf, numGroups);
+	// Compute the entire size at first, so that the buffer is extended
+	// at most once and the ItemData instances are written without
+	// the check of the remaining size.
 	const ItemGroupList &itemGrpList = itemTablePtr->getItemGroupList();
+	size_t requiredSize = sizeof(HapiItemTableHeader);
 	ItemGroupListConstIterator grpIt = itemGrpList.begin();
-	for (; grpIt != itemGrpList.end(); ++grpIt)
-		appendItemGroup(sbuf, *grpIt);
+	for (; grpIt != itemGrpList.end(); ++grpIt) {
+		const ItemGroup *itemGrp = *grpIt;
+		requiredSize += sizeof(HapiItemGroupHeader);
+		const size_t numItems = itemGrp->getNumberOfItems();
+		for (size_t idx = 0; idx < numItems; idx++)
+			requiredSize += getItemDataSize(itemGrp->getItemAt(idx));
+	}
+	sbuf.ensureRemainingSize(requiredSize);
+
+	const size_t numGroups = itemTablePtr->getNumberOfRows();
+	const size_t headerIndex = appendItemTableHeader(sbuf, numGroups);
+	for (grpIt = itemGrpList.begin(); grpIt != itemGrpList.end(); ++grpIt) {
+		const ItemGroup *itemGrp = *grpIt;
+		const size_t numItems = itemGrp->getNumberOfItems();
+		const size_t grpHeaderIndex =
+		  appendItemGroupHeader(sbuf, numItems);
+		for (size_t idx = 0; idx < numItems; idx++)
+			putItemData(sbuf, itemGrp->getItemAt(idx));
+		completeItemGroup(sbuf, grpHeaderIndex);
+	}
 	completeItemTable(sbuf, headerIndex);
 }
 
@@ -477,7 +497,7 @@ void HatoholArmPluginInterface::completeItemGroup(
 	completeItemTemplate<HapiItemGroupHeader>(sbuf, headerIndex);
 }
 
-static const size_t ITEM_DATA_BODY_SIZE[NUM_ITEM_TYPE] = {
+const size_t HAPI_ITEM_DATA_BODY_SIZE[NUM_ITEM_TYPE] = {
 	1, // BOOL
 	8, // INT
 	8, // UINT64
@@ -487,27 +507,33 @@ static const size_t ITEM_DATA_BODY_SIZE[NUM_ITEM_TYPE] = {
 	sizeof(uint32_t),
 };
 
-void HatoholArmPluginInterface::appendItemData(
-  SmartBuffer &sbuf, ItemDataPtr itemData)
+size_t HatoholArmPluginInterface::getItemDataSize(const ItemData *itemData)
 {
 	const ItemDataType type = itemData->getItemType();
 	HATOHOL_ASSERT(type < NUM_ITEM_TYPE, "Invalid type: %d", type);
-	size_t requiredSize =
-	  sizeof(HapiItemDataHeader) + ITEM_DATA_BODY_SIZE[type];
-
-	// To reduce frequency of a call of ensureRemainingSize(),
-	// We do preprocessing for the string item.
-	const char *stringPtr = NULL;
-	size_t stringLength = 0;
-	size_t stringLengthWithNullTerm = 0;
+	size_t size =
+	  sizeof(HapiItemDataHeader) + HAPI_ITEM_DATA_BODY_SIZE[type];
 	if (type == ITEM_TYPE_STRING) {
 		const string &val = *itemData;
-		stringLength = val.size();
-		stringLengthWithNullTerm = stringLength + 1;
-		stringPtr = val.c_str();
-		requiredSize += stringLengthWithNullTerm;
+		size += val.size() + 1; // +1: NULL terminator
 	}
-	sbuf.ensureRemainingSize(requiredSize);
+	return size;
+}
+
+void HatoholArmPluginInterface::appendItemData(
+  SmartBuffer &sbuf, ItemDataPtr itemData)
+{
+	sbuf.ensureRemainingSize(getItemDataSize(itemData));
+	putItemData(sbuf, itemData);
+}
+
+void HatoholArmPluginInterface::putItemData(
+  SmartBuffer &sbuf, const ItemData *itemData)
+{
+	const ItemDataType type = itemData->getItemType();
+	HATOHOL_ASSERT(type < NUM_ITEM_TYPE, "Invalid type: %d", type);
+	size_t writtenSize =
+	  sizeof(HapiItemDataHeader) + HAPI_ITEM_DATA_BODY_SIZE[type];
 
 	// Header
 	HapiItemDataHeader *header = sbuf.getPointer<HapiItemDataHeader>();
@@ -536,14 +562,17 @@ void HatoholArmPluginInterface::appendItemData(
 		double *ptrDouble = static_cast<double *>(ptr);
 		*ptrDouble = NtoL(val);
 	} else if (type == ITEM_TYPE_STRING) {
+		const string &val = *itemData;
+		const size_t stringLength = val.size();
 		uint32_t *length = static_cast<uint32_t *>(ptr);
 		*length = NtoL(stringLength);
 		void *dest = length + 1;
-		memcpy(dest, stringPtr, stringLengthWithNullTerm);
+		memcpy(dest, val.c_str(), stringLength + 1);
+		writtenSize += stringLength + 1;
 	} else {
 		HATOHOL_ASSERT(false, "Unknown item type: %d", type);
 	}
-	sbuf.incIndex(requiredSize);
+	sbuf.incIndex(writtenSize);
 }
 
 ItemTablePtr HatoholArmPluginInterface::createItemTable(mlpl::SmartBuffer &sbuf)
@@ -621,7 +650,7 @@ ItemDataPtr HatoholArmPluginInterface::createItemData(SmartBuffer &sbuf)
 	HATOHOL_ASSERT(type < NUM_ITEM_TYPE, "Invalid type: %d\n", type);
 
 	// check the body size
-	const size_t requiredBodySize = ITEM_DATA_BODY_SIZE[type];
+	const size_t requiredBodySize = HAPI_ITEM_DATA_BODY_SIZE[type];
 	HATOHOL_ASSERT(
 	  sbuf.remainingSize() >= requiredBodySize,
 	  "Remain size (body) is too small: %zd (expect: %zd), type: %d\n",
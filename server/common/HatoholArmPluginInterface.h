@@ -186,6 +186,10 @@ struct HapiItemDataHeader {
 
 } __attribute__((__packed__));
 
+// Sizes of the data body of each ItemDataType. For ITEM_TYPE_STRING,
+// it is the size of the length field. The string body follows it.
+extern const size_t HAPI_ITEM_DATA_BODY_SIZE[NUM_ITEM_TYPE];
+
 struct HapiItemStringHeader {
 	HapiItemDataHeader dataHeader;
 	uint32_t           length;  // not count a NULL terminator.
@@ -660,6 +664,28 @@ protected:
 	void load(mlpl::SmartBuffer &sbuf,
 	          const qpid::messaging::Message &message);
 
+	/**
+	 * Get the size of the encoded ItemData.
+	 *
+	 * @param itemData An ItemData instance.
+	 *
+	 * @return The size including the HapiItemDataHeader.
+	 */
+	static size_t getItemDataSize(const ItemData *itemData);
+
+	/**
+	 * Write HapiItemData to the SmartBuffer without extending it.
+	 *
+	 * @param sbuf
+	 * A SmartBuffer instance. The remaining size shall be equal to
+	 * or larger than the return value of getItemDataSize().
+	 * After this method is called, the index of 'sbuf' is forwarded.
+	 *
+	 * @param itemData An ItemData to be written.
+	 */
+	static void putItemData(mlpl::SmartBuffer &sbuf,
+	                        const ItemData *itemData);
+
 	void parseCommand(const HapiCommandHeader *header,
 	                  mlpl::SmartBuffer &cmdBuf);
 	void parseResponse(const HapiResponseHeader *header,
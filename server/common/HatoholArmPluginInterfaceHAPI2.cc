@@ -20,7 +20,9 @@
 #include "AMQPMessageHandler.h"
 #include "AMQPConnectionInfo.h"
 #include "AMQPConsumer.h"
+#include "AMQPConsumerPool.h"
 #include "AMQPPublisher.h"
+#include "HAPI2Capture.h"
 #include "HatoholArmPluginInterfaceHAPI2.h"
 #include "JSONBuilder.h"
 #include <mutex>
@@ -28,6 +30,8 @@
 using namespace std;
 using namespace mlpl;
 
+const uint16_t HatoholArmPluginInterfaceHAPI2::DEFAULT_PREFETCH_COUNT = 64;
+
 std::list<HAPI2ProcedureDef> defaultValidProcedureList = {
 	{BOTH,   PROCEDURE,    HAPI2_EXCHANGE_PROFILE,          MANDATORY},
 	{SERVER, PROCEDURE,    HAPI2_MONITORING_SERVER_INFO,    MANDATORY},
@@ -62,12 +66,20 @@ struct JSONRPCObject {
 	string m_id;
 	string m_errorMessage;
 
-	JSONRPCObject(const string &json)
-	: m_parser(json), m_type(Type::INVALID)
+	JSONRPCObject(const AMQPMessage &message)
+	: m_parser(message.body, getDataFormat(message.contentType)),
+	  m_type(Type::INVALID)
 	{
 		parse(m_parser);
 	}
 
+	static JSONParser::DataFormat getDataFormat(const string &contentType)
+	{
+		if (contentType == HAPI2_CONTENT_TYPE_MESSAGE_PACK)
+			return JSONParser::DATA_FORMAT_MESSAGE_PACK;
+		return JSONParser::DATA_FORMAT_JSON;
+	}
+
 	void parse(JSONParser &parser)
 	{
 		if (parser.hasError()) {
@@ -206,7 +218,7 @@ struct JSONRPCObject {
 };
 
 class HatoholArmPluginInterfaceHAPI2::AMQPHAPI2MessageHandler
-  : public AMQPMessageHandler
+  : public AMQPMessageHandler, public AMQPConsumerPool::Handler
 {
 public:
 	AMQPHAPI2MessageHandler(HatoholArmPluginInterfaceHAPI2 &hapi2)
@@ -216,31 +228,59 @@ public:
 
 	bool handle(AMQPConsumer &consumer, const AMQPMessage &message)
 	{
-		MLPL_DBG("message: <%s>/<%s>\n",
-			 message.contentType.c_str(),
-			 message.body.c_str());
+		AMQPJSONMessage response;
+		if (m_hapi2.processMessage(message, response.body))
+			sendResponse(consumer, response);
+		return true;
+	}
 
-		JSONRPCObject object(message.body);
+	void handle(AMQPConsumerPool::Subscription &subscription,
+		    const AMQPMessage &message)
+	{
 		AMQPJSONMessage response;
+		if (m_hapi2.processMessage(message, response.body)) {
+			AMQPConsumerPool::getInstance().publish(&subscription,
+								response);
+		}
+	}
+
+	/**
+	 * Interpret a received message.
+	 *
+	 * @param message A received message.
+	 * @param response A response to be sent back is set.
+	 * @return true if the response has to be sent, or false.
+	 */
+	bool process(const AMQPMessage &message, string &response)
+	{
+		if (message.contentType == HAPI2_CONTENT_TYPE_MESSAGE_PACK) {
+			MLPL_DBG("message: <%s>/<%zd bytes>\n",
+				 message.contentType.c_str(),
+				 message.body.size());
+		} else {
+			MLPL_DBG("message: <%s>/<%s>\n",
+				 message.contentType.c_str(),
+				 message.body.c_str());
+		}
+
+		JSONRPCObject object(message);
 
 		if (object.m_parser.hasError()) {
-			response.body =
+			response =
 			  m_hapi2.buildErrorResponse(JSON_RPC_PARSE_ERROR,
 						     "Invalid JSON",
 						     NULL);
 			MLPL_WARN("Invalid JSON: %s\n",
 				  object.m_errorMessage.c_str());
-			sendResponse(consumer, response);
 			return true;
 		}
 
 		switch(object.m_type) {
 		case JSONRPCObject::Type::PROCEDURE:
-			response.body = m_hapi2.interpretHandler(
+			response = m_hapi2.interpretHandler(
 					  object.m_methodName,
 					  object.m_parser);
-			sendResponse(consumer, response);
-			break;
+			return true;
 		case JSONRPCObject::Type::NOTIFICATION:
 			m_hapi2.interpretHandler(object.m_methodName,
 						 object.m_parser);
@@ -250,18 +290,17 @@ public:
 			break;
 		case JSONRPCObject::Type::INVALID:
 		default:
-			response.body =
+			response =
 			  m_hapi2.buildErrorResponse(JSON_RPC_INVALID_REQUEST,
 						     object.m_errorMessage,
 						     NULL,
 						     &object.m_parser);
 			MLPL_WARN("Invalid JSON-RPC object: %s\n",
 				  object.m_errorMessage.c_str());
-			sendResponse(consumer, response);
-			break;
+			return true;
 		}
 
-		return true;
+		return false;
 	}
 
 	void sendResponse(AMQPConsumer &consumer,
@@ -302,7 +341,9 @@ struct HatoholArmPluginInterfaceHAPI2::Impl
 	map<string, ProcedureCallContextPtr> m_procedureCallContextMap;
 	AMQPConnectionInfo m_connectionInfo;
 	AMQPConsumer *m_consumer;
+	AMQPConsumerPool::Subscription *m_subscription;
 	AMQPHAPI2MessageHandler m_handler;
+	unique_ptr<HAPI2Capture> m_capture;
 
 	Impl(HatoholArmPluginInterfaceHAPI2 &hapi2,
 	     const CommunicationMode mode)
@@ -310,6 +351,7 @@ struct HatoholArmPluginInterfaceHAPI2::Impl
 	  m_hapi2(hapi2),
 	  m_established(false),
 	  m_consumer(NULL),
+	  m_subscription(NULL),
 	  m_handler(m_hapi2)
 	{
 	}
@@ -348,6 +390,10 @@ struct HatoholArmPluginInterfaceHAPI2::Impl
 		if (m_communicationMode == MODE_SERVER) {
 			info.setConsumerQueueName(queueNamePluginToServer);
 			info.setPublisherQueueName(queueNameServerToPlugin);
+			// Messages are acknowledged after they are committed,
+			// so that a slow DB throttles plugins.
+			info.setManualAckEnabled(true);
+			info.setPrefetchCount(DEFAULT_PREFETCH_COUNT);
 		} else {
 			info.setConsumerQueueName(queueNameServerToPlugin);
 			info.setPublisherQueueName(queueNamePluginToServer);
@@ -356,6 +402,25 @@ struct HatoholArmPluginInterfaceHAPI2::Impl
 		info.setTLSKeyPath(m_pluginInfo.tlsKeyPath);
 		info.setTLSCACertificatePath(m_pluginInfo.tlsCACertificatePath);
 		info.setTLSVerifyEnabled(m_pluginInfo.isTLSVerifyEnabled());
+
+		if (m_communicationMode == MODE_SERVER)
+			setupCapture();
+	}
+
+	void setupCapture(void)
+	{
+		const char *dir = getenv(HAPI2Capture::ENV_NAME_CAPTURE_DIR);
+		if (!dir || m_capture)
+			return;
+		string path = StringUtils::sprintf(
+		  "%s/hapi2-%" FMT_SERVER_ID ".capture",
+		  dir, m_pluginInfo.serverId);
+		m_capture.reset(new HAPI2Capture());
+		if (!m_capture->openForWrite(path)) {
+			m_capture.reset();
+			return;
+		}
+		MLPL_INFO("Capture HAPI2 messages to %s\n", path.c_str());
 	}
 
 	void setupAMQPConnection(void)
@@ -373,6 +438,10 @@ struct HatoholArmPluginInterfaceHAPI2::Impl
 
 	void start(void)
 	{
+		if (m_communicationMode == MODE_SERVER) {
+			subscribe();
+			return;
+		}
 		if (!m_consumer)
 			setupAMQPConnection();
 		if (!m_consumer) {
@@ -384,6 +453,19 @@ struct HatoholArmPluginInterfaceHAPI2::Impl
 		onConnect();
 	}
 
+	void subscribe(void)
+	{
+		// Gates in the server share a few connections for each broker
+		// instead of having a connection and a thread for each.
+		if (!m_subscription) {
+			setupAMQPConnectionInfo();
+			m_subscription =
+			  AMQPConsumerPool::getInstance().subscribe(
+			    m_connectionInfo, m_handler);
+		}
+		onConnect();
+	}
+
 	void queueProcedureCallback(const string id,
 				    ProcedureCallbackPtr callback)
 	{
@@ -442,6 +524,11 @@ struct HatoholArmPluginInterfaceHAPI2::Impl
 
 	void stop(void)
 	{
+		if (m_subscription) {
+			AMQPConsumerPool::getInstance().unsubscribe(
+			  m_subscription);
+			m_subscription = NULL;
+		}
 		if (m_consumer) {
 			m_consumer->exitSync();
 			delete m_consumer;
@@ -532,6 +619,14 @@ void HatoholArmPluginInterfaceHAPI2::handleResponse(
 	}
 }
 
+bool HatoholArmPluginInterfaceHAPI2::processMessage(
+  const AMQPMessage &message, string &response)
+{
+	if (m_impl->m_capture)
+		m_impl->m_capture->write(message);
+	return m_impl->m_handler.process(message, response);
+}
+
 void HatoholArmPluginInterfaceHAPI2::start(void)
 {
 	onSetPluginInitialInfo();
@@ -545,10 +640,16 @@ void HatoholArmPluginInterfaceHAPI2::stop(void)
 
 void HatoholArmPluginInterfaceHAPI2::send(const std::string &message)
 {
-	// TODO: Should use only one conection per one thread
-	AMQPPublisher publisher(m_impl->m_connectionInfo);
 	AMQPJSONMessage amqpMessage;
 	amqpMessage.body = message;
+	if (m_impl->m_subscription) {
+		AMQPConsumerPool::getInstance().publish(
+		  m_impl->m_subscription, amqpMessage);
+		return;
+	}
+
+	// TODO: Should use only one conection per one thread
+	AMQPPublisher publisher(m_impl->m_connectionInfo);
 	publisher.setMessage(amqpMessage);
 	publisher.publish();
 }
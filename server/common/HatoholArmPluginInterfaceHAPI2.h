@@ -32,6 +32,7 @@
 #include "Utils.h"
 #include "MonitoringServerInfo.h"
 #include "ArmPluginInfo.h"
+#include "AMQPConnection.h"
 
 // Invalid JSON was received by the server.
 // An error occurred on the server while parsing the JSON text.
@@ -93,6 +94,13 @@ const HAPI2ProcedureName HAPI2_FETCH_EVENTS
 const HAPI2ProcedureName HAPI2_UPDATE_MONITORING_SERVER_INFO
   = "updateMonitoringServerInfo";
 
+// Encodings of messages, which are negotiated by exchangeProfile.
+// The encoding of a received message is chosen by its content type.
+const std::string HAPI2_ENCODING_JSON = "json";
+const std::string HAPI2_ENCODING_MESSAGE_PACK = "msgpack";
+const std::string HAPI2_CONTENT_TYPE_JSON = "application/json";
+const std::string HAPI2_CONTENT_TYPE_MESSAGE_PACK = "application/x-msgpack";
+
 enum MethodOwner {
 	SERVER,
 	HAP,
@@ -142,6 +150,8 @@ public:
 		MODE_SERVER
 	} CommunicationMode;
 
+	static const uint16_t DEFAULT_PREFETCH_COUNT;
+
 	HatoholArmPluginInterfaceHAPI2(const CommunicationMode mode = MODE_PLUGIN);
 	typedef std::string (HatoholArmPluginInterfaceHAPI2::*ProcedureHandler)
 	  (JSONParser &parser);
@@ -167,6 +177,16 @@ public:
 				     JSONParser &parser);
 	void handleResponse(const std::string id, JSONParser &parser);
 
+	/**
+	 * Handle a message in the same way as the one from the broker.
+	 * It's used to drive the interface without a broker.
+	 *
+	 * @param message A received message.
+	 * @param response A response to be sent back is stored.
+	 * @return true if there's a response. Otherwise false.
+	 */
+	bool processMessage(const AMQPMessage &message, std::string &response);
+
 	virtual void start(void);
 	virtual void stop(void);
 	virtual void send(const std::string &message);
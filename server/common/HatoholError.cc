@@ -195,6 +195,8 @@ void HatoholError::init(void)
 		   "HAP2 connection unavailable.");
 	DEFINE_ERR(INVALID_OBJECT_PASSED_BY_HAP2,
 		   "Invalid object passed by HAP2.");
+	DEFINE_ERR(SERVER_BUSY,
+		   "The server is too busy. Please retry later.");
 }
 
 void HatoholError::defineError(const HatoholErrorCode errorCode,
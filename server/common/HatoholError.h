@@ -123,6 +123,7 @@ enum HatoholErrorCode
         // 15.11
 	HTERR_FAILED_CONNECT_HAP2, // for HAPI 2.0
 	HTERR_INVALID_OBJECT_PASSED_BY_HAP2, // for HAPI 2.0
+	HTERR_SERVER_BUSY, // FaceRest
 
 	// End of code
 	NUM_HATOHOL_ERROR_CODE
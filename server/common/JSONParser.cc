@@ -21,22 +21,29 @@
 #include <string.h>
 #include <stdexcept>
 #include "JSONParser.h"
+#include "MessagePackDecoder.h"
 using namespace std;
 using namespace mlpl;
 
 struct JSONParser::Impl
 {
 	JsonParser *parser;
+	JsonNode *decodedRoot;
 	JsonNode *currentNode;
 	JsonNode *previousNode;
 	GError *error;
 
-	Impl(const string &data)
+	Impl(const string &data, const DataFormat &format)
 	: parser(NULL),
+	  decodedRoot(NULL),
 	  currentNode(NULL),
 	  previousNode(NULL),
 	  error(NULL)
 	{
+		if (format == DATA_FORMAT_MESSAGE_PACK) {
+			decodeMessagePack(data);
+			return;
+		}
 		parser = json_parser_new();
 		if (!json_parser_load_from_data(parser, data.c_str(), -1, &error))
 			return;
@@ -49,6 +56,21 @@ struct JSONParser::Impl
 			g_error_free(error);
 		if (parser)
 			g_object_unref(parser);
+		if (decodedRoot)
+			json_node_free(decodedRoot);
+	}
+
+	void decodeMessagePack(const string &data)
+	{
+		string errorMessage;
+		decodedRoot = MessagePackDecoder::decode(data, errorMessage);
+		if (!decodedRoot) {
+			error = g_error_new_literal(JSON_PARSER_ERROR,
+						    JSON_PARSER_ERROR_PARSE,
+						    errorMessage.c_str());
+			return;
+		}
+		currentNode = decodedRoot;
 	}
 };
 
@@ -56,7 +78,12 @@ struct JSONParser::Impl
 // Public methods
 // ---------------------------------------------------------------------------
 JSONParser::JSONParser(const string &data)
-: m_impl(new Impl(data))
+: m_impl(new Impl(data, DATA_FORMAT_JSON))
+{
+}
+
+JSONParser::JSONParser(const string &data, const DataFormat &format)
+: m_impl(new Impl(data, format))
 {
 }
 
@@ -44,6 +44,11 @@ public:
 		VALUE_TYPE_ARRAY
 	};
 
+	enum DataFormat {
+		DATA_FORMAT_JSON,
+		DATA_FORMAT_MESSAGE_PACK,
+	};
+
 	class PositionStack {
 	public:
 		PositionStack(JSONParser &parser);
@@ -58,6 +63,17 @@ public:
 	};
 
 	JSONParser(const std::string &data);
+
+	/**
+	 * Parse a document in the given format.
+	 *
+	 * A MessagePack document is converted into the same tree as JSON,
+	 * so that it can be read with the same methods.
+	 *
+	 * @param data A document to be parsed.
+	 * @param format The format of data.
+	 */
+	JSONParser(const std::string &data, const DataFormat &format);
 	virtual ~JSONParser();
 	const char *getErrorMessage(void);
 	bool hasError(void);
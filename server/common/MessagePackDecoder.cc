@@ -0,0 +1,293 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <StringUtils.h>
+#include "MessagePackDecoder.h"
+
+using namespace std;
+using namespace mlpl;
+
+const size_t MessagePackDecoder::MAX_DEPTH = 64;
+
+struct MessagePackReader {
+	const uint8_t *data;
+	size_t         size;
+	size_t         pos;
+	string        &errorMessage;
+
+	MessagePackReader(const string &src, string &_errorMessage)
+	: data(reinterpret_cast<const uint8_t *>(src.data())),
+	  size(src.size()),
+	  pos(0),
+	  errorMessage(_errorMessage)
+	{
+	}
+
+	bool fail(const char *reason)
+	{
+		errorMessage = StringUtils::sprintf("%s at %zd", reason, pos);
+		return false;
+	}
+
+	bool readUInt(const size_t &numBytes, uint64_t &value)
+	{
+		if (size - pos < numBytes)
+			return fail("Unexpected end of data");
+		value = 0;
+		// MessagePack uses the big endian.
+		for (size_t i = 0; i < numBytes; i++)
+			value = (value << 8) | data[pos++];
+		return true;
+	}
+
+	bool readString(const size_t &length, string &value)
+	{
+		if (size - pos < length)
+			return fail("Unexpected end of data");
+		value.assign(reinterpret_cast<const char *>(data + pos),
+			     length);
+		pos += length;
+		return true;
+	}
+
+	bool readStringLength(const uint8_t &type, size_t &length)
+	{
+		uint64_t value;
+		if (type >= 0xa0 && type <= 0xbf) {
+			length = type & 0x1f;
+			return true;
+		}
+		switch (type) {
+		case 0xc4: case 0xd9:
+			if (!readUInt(1, value))
+				return false;
+			break;
+		case 0xc5: case 0xda:
+			if (!readUInt(2, value))
+				return false;
+			break;
+		case 0xc6: case 0xdb:
+			if (!readUInt(4, value))
+				return false;
+			break;
+		default:
+			return fail("Not a string");
+		}
+		length = value;
+		return true;
+	}
+
+	JsonNode *newIntNode(const int64_t &value)
+	{
+		JsonNode *node = json_node_new(JSON_NODE_VALUE);
+		json_node_set_int(node, value);
+		return node;
+	}
+
+	JsonNode *newStringNode(const size_t &length)
+	{
+		string value;
+		if (!readString(length, value))
+			return NULL;
+		JsonNode *node = json_node_new(JSON_NODE_VALUE);
+		json_node_set_string(node, value.c_str());
+		return node;
+	}
+
+	bool checkCount(const size_t &count)
+	{
+		// Each element takes one byte at least.
+		if (count > size - pos)
+			return fail("Too many elements");
+		return true;
+	}
+
+	JsonNode *readArray(const size_t &numElements, const size_t &depth)
+	{
+		if (!checkCount(numElements))
+			return NULL;
+		JsonArray *array = json_array_sized_new(numElements);
+		for (size_t i = 0; i < numElements; i++) {
+			JsonNode *element = readNode(depth + 1);
+			if (!element) {
+				json_array_unref(array);
+				return NULL;
+			}
+			json_array_add_element(array, element);
+		}
+		JsonNode *node = json_node_new(JSON_NODE_ARRAY);
+		json_node_take_array(node, array);
+		return node;
+	}
+
+	JsonNode *readMap(const size_t &numMembers, const size_t &depth)
+	{
+		if (!checkCount(numMembers))
+			return NULL;
+		JsonObject *object = json_object_new();
+		for (size_t i = 0; i < numMembers; i++) {
+			string key;
+			size_t length;
+			if (pos >= size) {
+				fail("Unexpected end of data");
+				json_object_unref(object);
+				return NULL;
+			}
+			const uint8_t type = data[pos++];
+			if (!readStringLength(type, length) ||
+			    !readString(length, key)) {
+				json_object_unref(object);
+				return NULL;
+			}
+			JsonNode *member = readNode(depth + 1);
+			if (!member) {
+				json_object_unref(object);
+				return NULL;
+			}
+			json_object_set_member(object, key.c_str(), member);
+		}
+		JsonNode *node = json_node_new(JSON_NODE_OBJECT);
+		json_node_take_object(node, object);
+		return node;
+	}
+
+	JsonNode *readNode(const size_t &depth)
+	{
+		if (depth > MessagePackDecoder::MAX_DEPTH) {
+			fail("Too deep nesting");
+			return NULL;
+		}
+		if (pos >= size) {
+			fail("Unexpected end of data");
+			return NULL;
+		}
+
+		const uint8_t type = data[pos++];
+		uint64_t value;
+		if (type <= 0x7f)
+			return newIntNode(type);
+		if (type >= 0xe0)
+			return newIntNode(static_cast<int8_t>(type));
+		if (type >= 0x80 && type <= 0x8f)
+			return readMap(type & 0x0f, depth);
+		if (type >= 0x90 && type <= 0x9f)
+			return readArray(type & 0x0f, depth);
+		if (type >= 0xa0 && type <= 0xbf)
+			return newStringNode(type & 0x1f);
+
+		switch (type) {
+		case 0xc0:
+			return json_node_new(JSON_NODE_NULL);
+		case 0xc2:
+		case 0xc3:
+		{
+			JsonNode *node = json_node_new(JSON_NODE_VALUE);
+			json_node_set_boolean(node, type == 0xc3);
+			return node;
+		}
+		case 0xc4: case 0xc5: case 0xc6:
+		case 0xd9: case 0xda: case 0xdb:
+		{
+			size_t length;
+			if (!readStringLength(type, length))
+				return NULL;
+			return newStringNode(length);
+		}
+		case 0xca:
+		{
+			if (!readUInt(4, value))
+				return NULL;
+			const uint32_t bits = value;
+			float floatValue;
+			memcpy(&floatValue, &bits, sizeof(floatValue));
+			JsonNode *node = json_node_new(JSON_NODE_VALUE);
+			json_node_set_double(node, floatValue);
+			return node;
+		}
+		case 0xcb:
+		{
+			if (!readUInt(8, value))
+				return NULL;
+			double doubleValue;
+			memcpy(&doubleValue, &value, sizeof(doubleValue));
+			JsonNode *node = json_node_new(JSON_NODE_VALUE);
+			json_node_set_double(node, doubleValue);
+			return node;
+		}
+		case 0xcc: case 0xcd: case 0xce: case 0xcf:
+		{
+			const size_t numBytes = 1 << (type - 0xcc);
+			if (!readUInt(numBytes, value))
+				return NULL;
+			if (value > INT64_MAX) {
+				fail("Too large integer");
+				return NULL;
+			}
+			return newIntNode(value);
+		}
+		case 0xd0: case 0xd1: case 0xd2: case 0xd3:
+		{
+			const size_t numBytes = 1 << (type - 0xd0);
+			if (!readUInt(numBytes, value))
+				return NULL;
+			// Extend the sign bit.
+			const size_t shift = 64 - numBytes * 8;
+			const int64_t signedValue =
+			  static_cast<int64_t>(value << shift) >> shift;
+			return newIntNode(signedValue);
+		}
+		case 0xdc: case 0xdd:
+		{
+			if (!readUInt(type == 0xdc ? 2 : 4, value))
+				return NULL;
+			return readArray(value, depth);
+		}
+		case 0xde: case 0xdf:
+		{
+			if (!readUInt(type == 0xde ? 2 : 4, value))
+				return NULL;
+			return readMap(value, depth);
+		}
+		default:
+			break;
+		}
+		pos--;
+		fail("Unsupported type");
+		return NULL;
+	}
+};
+
+// ---------------------------------------------------------------------------
+// Public methods
+// ---------------------------------------------------------------------------
+JsonNode *MessagePackDecoder::decode(const string &data, string &errorMessage)
+{
+	MessagePackReader reader(data, errorMessage);
+	JsonNode *root = reader.readNode(0);
+	if (!root)
+		return NULL;
+	if (reader.pos != reader.size) {
+		reader.fail("Trailing data");
+		json_node_free(root);
+		return NULL;
+	}
+	return root;
+}
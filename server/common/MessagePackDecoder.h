@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MessagePackDecoder_h
+#define MessagePackDecoder_h
+
+#include <string>
+#include <json-glib/json-glib.h>
+
+/**
+ * MessagePackDecoder converts a MessagePack document into a JSON tree.
+ *
+ * The tree is built node by node without a text representation, so that
+ * a JSONParser can read a MessagePack message with the same code as
+ * a JSON message. Extension types and map keys other than strings are
+ * rejected because they don't appear in HAPI2 messages.
+ */
+class MessagePackDecoder
+{
+public:
+	static const size_t MAX_DEPTH;
+
+	/**
+	 * Decode a MessagePack document.
+	 *
+	 * @param data A MessagePack document.
+	 * @param errorMessage A reason is stored when the decode fails.
+	 * @return
+	 * A root node of the decoded tree. The caller has to free it with
+	 * json_node_free(). NULL is returned on failure.
+	 */
+	static JsonNode *decode(const std::string &data,
+				std::string &errorMessage);
+};
+
+#endif // MessagePackDecoder_h
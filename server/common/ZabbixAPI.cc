@@ -19,12 +19,18 @@
 
 #include <cstdio>
 #include <string>
+#include <deque>
+#include <map>
 #include <Reaper.h>
+#include <Mutex.h>
+#include <SimpleSemaphore.h>
 #include "JSONParser.h"
 #include "ZabbixAPI.h"
 #include "StringUtils.h"
 #include "DataStoreException.h"
 #include "HatoholError.h"
+#include "HatoholThreadBase.h"
+#include "Utils.h"
 
 using namespace std;
 using namespace mlpl;
@@ -32,10 +38,105 @@ using namespace mlpl;
 static const char *MIME_JSON_RPC = "application/json-rpc";
 static const guint DEFAULT_TIMEOUT = 60;
 static const size_t HISTORY_LIMIT_PER_ONCE = 1000;
+// The number of worker threads that send prefetched queries.
+static const size_t NUM_QUERY_SENDERS = 4;
 
 const uint64_t ZabbixAPI::EVENT_ID_NOT_FOUND = -1;
 const size_t ZabbixAPI::EVENT_ID_DIGIT_NUM = 20;
 
+struct ZabbixQuery {
+	SoupMessage     *msg;
+	guint            status;
+	SimpleSemaphore  completion;
+
+	ZabbixQuery(SoupMessage *_msg)
+	: msg(_msg),
+	  status(SOUP_STATUS_NONE),
+	  completion(0)
+	{
+	}
+
+	~ZabbixQuery()
+	{
+		if (msg)
+			g_object_unref(msg);
+	}
+};
+
+/**
+ * A worker thread that sends queries with a shared synchronous session.
+ * SoupSessionSync can be used from multiple threads and keeps
+ * the connections alive, so the queries of the workers run concurrently
+ * on the persistent connections.
+ */
+class ZabbixQuerySender : public HatoholThreadBase {
+public:
+	ZabbixQuerySender(SoupSession *session)
+	: m_session(session),
+	  m_jobSemaphore(0)
+	{
+	}
+
+	virtual ~ZabbixQuerySender()
+	{
+		exitSync();
+	}
+
+	virtual void waitExit(void) override
+	{
+		m_jobSemaphore.post();
+		HatoholThreadBase::waitExit();
+	}
+
+	void push(ZabbixQuery *query)
+	{
+		AutoMutex autoLock(&m_lock);
+		m_queue.push_back(query);
+		m_jobSemaphore.post();
+	}
+
+protected:
+	virtual gpointer mainThread(HatoholThreadArg *arg) override
+	{
+		while (true) {
+			m_jobSemaphore.wait();
+			if (isExitRequested())
+				break;
+			ZabbixQuery *query = pop();
+			if (!query)
+				continue;
+			query->status =
+			  soup_session_send_message(m_session, query->msg);
+			query->completion.post();
+		}
+		AutoMutex autoLock(&m_lock);
+		for (auto query : m_queue) {
+			query->status = SOUP_STATUS_CANCELLED;
+			query->completion.post();
+		}
+		m_queue.clear();
+		return NULL;
+	}
+
+	ZabbixQuery *pop(void)
+	{
+		AutoMutex autoLock(&m_lock);
+		if (m_queue.empty())
+			return NULL;
+		ZabbixQuery *query = m_queue.front();
+		m_queue.pop_front();
+		return query;
+	}
+
+private:
+	SoupSession           *m_session;
+	Mutex                  m_lock;
+	deque<ZabbixQuery *>   m_queue;
+	SimpleSemaphore        m_jobSemaphore;
+};
+
+typedef multimap<string, ZabbixQuery *> ZabbixQueryMap;
+
 struct ZabbixAPI::Impl {
 
 	string         uri;
@@ -51,22 +152,72 @@ struct ZabbixAPI::Impl {
 	bool                 gotTriggers;
 	VariableItemTablePtr functionsTablePtr;
 
+	bool                 prefetching;
+	// The key is the request body.
+	ZabbixQueryMap       prefetchedQueries;
+	vector<unique_ptr<ZabbixQuerySender> > senders;
+	size_t               nextSender;
+
 	// constructors and destructor
 	Impl(void)
 	: apiVersionMajor(0),
 	  apiVersionMinor(0),
 	  apiVersionMicro(0),
 	  session(NULL),
-	  gotTriggers(false)
+	  gotTriggers(false),
+	  prefetching(false),
+	  nextSender(0)
 	{
 	}
 
 	virtual ~Impl()
 	{
+		if (session && !senders.empty())
+			soup_session_abort(session);
+		senders.clear();
+		discardPrefetchedQueries();
 		if (session)
 			g_object_unref(session);
 	}
 
+	void prefetch(const string &requestBody, ZabbixQuery *query)
+	{
+		if (senders.empty()) {
+			for (size_t i = 0; i < NUM_QUERY_SENDERS; i++) {
+				ZabbixQuerySender *sender =
+				  new ZabbixQuerySender(session);
+				senders.push_back(
+				  unique_ptr<ZabbixQuerySender>(sender));
+				sender->start();
+			}
+		}
+		prefetchedQueries.insert(
+		  pair<string, ZabbixQuery *>(requestBody, query));
+		senders[nextSender]->push(query);
+		nextSender = (nextSender + 1) % senders.size();
+	}
+
+	ZabbixQuery *takePrefetchedQuery(const string &requestBody)
+	{
+		ZabbixQueryMap::iterator it =
+		  prefetchedQueries.find(requestBody);
+		if (it == prefetchedQueries.end())
+			return NULL;
+		ZabbixQuery *query = it->second;
+		prefetchedQueries.erase(it);
+		return query;
+	}
+
+	void discardPrefetchedQueries(void)
+	{
+		for (auto &pair : prefetchedQueries) {
+			ZabbixQuery *query = pair.second;
+			query->completion.wait();
+			delete query;
+		}
+		prefetchedQueries.clear();
+	}
+
 	void setMonitoringServerInfo(const MonitoringServerInfo &serverInfo)
 	{
 		const bool forURI = true;
@@ -80,6 +231,20 @@ struct ZabbixAPI::Impl {
 	}
 };
 
+// ---------------------------------------------------------------------------
+// ObjectStat
+// ---------------------------------------------------------------------------
+ZabbixAPI::ObjectStat::ObjectStat(void)
+: count(0),
+  maxId(0)
+{
+}
+
+bool ZabbixAPI::ObjectStat::operator==(const ObjectStat &rhs) const
+{
+	return count == rhs.count && maxId == rhs.maxId;
+}
+
 // ---------------------------------------------------------------------------
 // Public methods
 // ---------------------------------------------------------------------------
@@ -216,6 +381,8 @@ SoupSession *ZabbixAPI::getSession(void)
 	if (!m_impl->session)
 		m_impl->session = soup_session_sync_new_with_options(
 			SOUP_SESSION_TIMEOUT,      DEFAULT_TIMEOUT,
+			// The senders and the caller's thread
+			SOUP_SESSION_MAX_CONNS_PER_HOST, NUM_QUERY_SENDERS + 1,
 			//FIXME: Sometimes it causes crash (issue #98)
 			//SOUP_SESSION_IDLE_TIMEOUT, DEFAULT_IDLE_TIMEOUT,
 			NULL);
@@ -247,6 +414,23 @@ void ZabbixAPI::clearAuthToken(void)
 	onUpdatedAuthToken(m_impl->authToken);
 }
 
+void ZabbixAPI::beginPrefetch(void)
+{
+	// The session is created in this thread before the senders use it.
+	getSession();
+	m_impl->prefetching = true;
+}
+
+void ZabbixAPI::endPrefetch(void)
+{
+	m_impl->prefetching = false;
+}
+
+void ZabbixAPI::discardPrefetchedQueries(void)
+{
+	m_impl->discardPrefetchedQueries();
+}
+
 ItemTablePtr ZabbixAPI::getTrigger(int requestSince)
 {
 	HatoholError queryRet;
@@ -426,48 +610,88 @@ ItemTablePtr ZabbixAPI::getHistory(const ItemIdType &itemId,
 				   const time_t &beginTime,
 				   const time_t &endTime)
 {
-	HatoholError queryRet;
-	SoupMessage *msg = queryHistory(queryRet, itemId, valueType,
-					beginTime, endTime);
-	if (!msg) {
-		if (queryRet == HTERR_INTERNAL_ERROR) {
-			THROW_HATOHOL_EXCEPTION_WITH_ERROR_CODE(
-			  HTERR_INTERNAL_ERROR,
-			  "Failed to query history.");
-		} else {
+	// A reply has HISTORY_LIMIT_PER_ONCE samples at most. Callers such as
+	// HistoryStore regard the result as the whole history in the range,
+	// so the rest is requested again from the clock of the last sample.
+	VariableItemTablePtr tablePtr;
+	time_t timeFrom = beginTime;
+	uint64_t lastClock = 0;
+	uint64_t lastNs = 0;
+	bool hasLast = false;
+	while (true) {
+		HatoholError queryRet;
+		SoupMessage *msg = queryHistory(queryRet, itemId, valueType,
+						timeFrom, endTime);
+		if (!msg) {
+			if (queryRet == HTERR_INTERNAL_ERROR) {
+				THROW_HATOHOL_EXCEPTION_WITH_ERROR_CODE(
+				  HTERR_INTERNAL_ERROR,
+				  "Failed to query history.");
+			} else {
+				THROW_HATOHOL_EXCEPTION_WITH_ERROR_CODE(
+				  HTERR_FAILED_CONNECT_ZABBIX,
+				  "%s", queryRet.getMessage().c_str());
+			}
+		}
+		JSONParser parser(msg->response_body->data);
+		g_object_unref(msg);
+		if (parser.hasError()) {
 			THROW_HATOHOL_EXCEPTION_WITH_ERROR_CODE(
-			  HTERR_FAILED_CONNECT_ZABBIX,
-			  "%s", queryRet.getMessage().c_str());
+			  HTERR_FAILED_TO_PARSE_JSON_DATA,
+			  "Failed to parser: %s", parser.getErrorMessage());
 		}
-	}
-	JSONParser parser(msg->response_body->data);
-	g_object_unref(msg);
-	if (parser.hasError()) {
-		THROW_HATOHOL_EXCEPTION_WITH_ERROR_CODE(
-		  HTERR_FAILED_TO_PARSE_JSON_DATA,
-		  "Failed to parser: %s", parser.getErrorMessage());
-	}
 
-	startObject(parser, "result");
-	VariableItemTablePtr tablePtr;
-	int numData = parser.countElements();
-	MLPL_DBG("The number of history: %d\n", numData);
-	for (int i = 0; i < numData; i++) {
-		startElement(parser, i);
-		VariableItemGroupPtr grp;
-		pushString(parser, grp, "itemid", ITEM_ID_ZBX_HISTORY_ITEMID);
-		pushUint64(parser, grp, "clock",  ITEM_ID_ZBX_HISTORY_CLOCK);
-		pushUint64(parser, grp, "ns",     ITEM_ID_ZBX_HISTORY_NS);
-		pushString(parser, grp, "value",  ITEM_ID_ZBX_HISTORY_VALUE);
-		tablePtr->add(grp);
-		parser.endElement();
+		startObject(parser, "result");
+		const int numData = parser.countElements();
+		MLPL_DBG("The number of history: %d (from: %ld)\n",
+			 numData, (long)timeFrom);
+		for (int i = 0; i < numData; i++) {
+			startElement(parser, i);
+			VariableItemGroupPtr grp;
+			pushString(parser, grp, "itemid",
+				   ITEM_ID_ZBX_HISTORY_ITEMID);
+			const uint64_t clock =
+			  pushUint64(parser, grp, "clock",
+				     ITEM_ID_ZBX_HISTORY_CLOCK);
+			const uint64_t ns =
+			  pushUint64(parser, grp, "ns",
+				     ITEM_ID_ZBX_HISTORY_NS);
+			pushString(parser, grp, "value",
+				   ITEM_ID_ZBX_HISTORY_VALUE);
+			parser.endElement();
+			// The first samples of a following page can be the
+			// ones at the boundary clock we already have.
+			if (hasLast && (clock < lastClock ||
+			    (clock == lastClock && ns <= lastNs)))
+				continue;
+			tablePtr->add(grp);
+			lastClock = clock;
+			lastNs = ns;
+			hasLast = true;
+		}
+
+		if ((size_t)numData < HISTORY_LIMIT_PER_ONCE)
+			break;
+		if (!hasLast || (time_t)lastClock >= endTime)
+			break;
+		time_t nextFrom = lastClock;
+		if (nextFrom <= timeFrom) {
+			// Every sample in the page has the same clock.
+			// We can't page within a second.
+			MLPL_WARN("Too many history samples at %ld: "
+				  "itemid: %" FMT_ITEM_ID "\n",
+				  (long)timeFrom, itemId.c_str());
+			nextFrom = timeFrom + 1;
+		}
+		timeFrom = nextFrom;
 	}
 
 	return ItemTablePtr(tablePtr);
 }
 
 void ZabbixAPI::getHosts(
-  ItemTablePtr &hostsTablePtr, ItemTablePtr &hostsGroupsTablePtr)
+  ItemTablePtr &hostsTablePtr, ItemTablePtr &hostsGroupsTablePtr,
+  string *digest)
 {
 	HatoholError queryRet;
 	SoupMessage *msg = queryHost(queryRet);
@@ -482,6 +706,8 @@ void ZabbixAPI::getHosts(
 			  "%s", queryRet.getMessage().c_str());
 		}
 	}
+	if (digest)
+		*digest = Utils::sha256(msg->response_body->data);
 	JSONParser parser(msg->response_body->data);
 	g_object_unref(msg);
 	if (parser.hasError()) {
@@ -506,7 +732,7 @@ void ZabbixAPI::getHosts(
 	hostsGroupsTablePtr = ItemTablePtr(variableHostsGroupsTablePtr);
 }
 
-void ZabbixAPI::getGroups(ItemTablePtr &groupsTablePtr)
+void ZabbixAPI::getGroups(ItemTablePtr &groupsTablePtr, string *digest)
 {
 	HatoholError queryRet;
 	SoupMessage *msg = queryGroup(queryRet);
@@ -521,6 +747,8 @@ void ZabbixAPI::getGroups(ItemTablePtr &groupsTablePtr)
 			  "%s", queryRet.getMessage().c_str());
 		}
 	}
+	if (digest)
+		*digest = Utils::sha256(msg->response_body->data);
 	JSONParser parser(msg->response_body->data);
 	g_object_unref(msg);
 	if (parser.hasError()) {
@@ -540,6 +768,16 @@ void ZabbixAPI::getGroups(ItemTablePtr &groupsTablePtr)
 	groupsTablePtr = ItemTablePtr(variableGroupsTablePtr);
 }
 
+void ZabbixAPI::getHostStat(ObjectStat &stat)
+{
+	getObjectStat(stat, "host.get", "hostid", "monitored_hosts");
+}
+
+void ZabbixAPI::getGroupStat(ObjectStat &stat)
+{
+	getObjectStat(stat, "hostgroup.get", "groupid", "real_hosts");
+}
+
 ItemTablePtr ZabbixAPI::getApplications(const ItemCategoryIdVector &appIdVector)
 {
 	HatoholError queryRet;
@@ -857,6 +1095,20 @@ SoupMessage *ZabbixAPI::queryGroup(HatoholError &queryRet)
 	return queryCommon(agent, queryRet);
 }
 
+SoupMessage *ZabbixAPI::queryHostStat(const bool &countOutput,
+                                      HatoholError &queryRet)
+{
+	return queryObjectStat("host.get", "hostid", "monitored_hosts",
+	                       countOutput, queryRet);
+}
+
+SoupMessage *ZabbixAPI::queryGroupStat(const bool &countOutput,
+                                       HatoholError &queryRet)
+{
+	return queryObjectStat("hostgroup.get", "groupid", "real_hosts",
+	                       countOutput, queryRet);
+}
+
 SoupMessage *ZabbixAPI::queryApplication(
   const ItemCategoryIdVector &appIdVector, HatoholError &queryRet)
 {
@@ -898,20 +1150,35 @@ ItemTablePtr ZabbixAPI::getFunctions(void)
 SoupMessage *ZabbixAPI::queryCommon(JSONBuilder &agent, HatoholError &queryRet)
 {
 	string request_body = agent.generate();
-	SoupMessage *msg = soup_message_new(SOUP_METHOD_POST, m_impl->uri.c_str());
-	if (!msg) {
-		MLPL_ERR("Failed to call: soup_message_new: uri: %s\n",
-		         m_impl->uri.c_str());
-		queryRet = HTERR_INTERNAL_ERROR;
-		return NULL;
+	unique_ptr<ZabbixQuery> query(
+	  m_impl->takePrefetchedQuery(request_body));
+	if (query) {
+		query->completion.wait();
+	} else {
+		SoupMessage *msg =
+		  soup_message_new(SOUP_METHOD_POST, m_impl->uri.c_str());
+		if (!msg) {
+			MLPL_ERR("Failed to call: soup_message_new: uri: %s\n",
+			         m_impl->uri.c_str());
+			queryRet = HTERR_INTERNAL_ERROR;
+			return NULL;
+		}
+		soup_message_headers_set_content_type(msg->request_headers,
+		                                      MIME_JSON_RPC, NULL);
+		soup_message_body_append(msg->request_body, SOUP_MEMORY_COPY,
+		                         request_body.c_str(),
+		                         request_body.size());
+		query.reset(new ZabbixQuery(msg));
+		if (m_impl->prefetching) {
+			m_impl->prefetch(request_body, query.release());
+			queryRet = HTERR_OK;
+			return NULL;
+		}
+		query->status = soup_session_send_message(getSession(), msg);
 	}
-	soup_message_headers_set_content_type(msg->request_headers,
-	                                      MIME_JSON_RPC, NULL);
-	soup_message_body_append(msg->request_body, SOUP_MEMORY_TEMPORARY,
-	                         request_body.c_str(), request_body.size());
-	guint ret = soup_session_send_message(getSession(), msg);
+
+	const guint ret = query->status;
 	if (ret != SOUP_STATUS_OK) {
-		g_object_unref(msg);
 		MLPL_ERR("Failed to get from %s, Status: %d (%s)\n",
 	                 m_impl->uri.c_str(),
 			 ret, soup_status_get_phrase(ret));
@@ -919,6 +1186,8 @@ SoupMessage *ZabbixAPI::queryCommon(JSONBuilder &agent, HatoholError &queryRet)
 		return NULL;
 	}
 	queryRet = HTERR_OK;
+	SoupMessage *msg = query->msg;
+	query->msg = NULL;
 	return msg;
 }
 
@@ -969,6 +1238,93 @@ bool ZabbixAPI::parseInitialResponse(SoupMessage *msg)
 	return true;
 }
 
+SoupMessage *ZabbixAPI::queryObjectStat(
+  const string &method, const string &idName, const string &filterName,
+  const bool &countOutput, HatoholError &queryRet)
+{
+	JSONBuilder agent;
+	agent.startObject();
+	agent.add("jsonrpc", "2.0");
+	agent.add("method", method);
+
+	agent.startObject("params");
+	if (countOutput) {
+		agent.addTrue("countOutput");
+	} else {
+		agent.startArray("output");
+		agent.add(idName);
+		agent.endArray();
+		agent.add("sortfield", idName);
+		agent.add("sortorder", "DESC");
+		agent.add("limit", 1);
+	}
+	agent.addTrue(filterName);
+	agent.endObject(); // params
+
+	agent.add("auth", m_impl->authToken);
+	agent.add("id", 1);
+	agent.endObject();
+
+	return queryCommon(agent, queryRet);
+}
+
+void ZabbixAPI::getObjectStat(
+  ObjectStat &stat, const string &method, const string &idName,
+  const string &filterName)
+{
+	// The first request gets the number and the second one gets
+	// the largest ID.
+	for (int i = 0; i < 2; i++) {
+		const bool countOutput = (i == 0);
+		HatoholError queryRet;
+		SoupMessage *msg = queryObjectStat(method, idName, filterName,
+		                                   countOutput, queryRet);
+		if (!msg) {
+			if (queryRet == HTERR_INTERNAL_ERROR) {
+				THROW_HATOHOL_EXCEPTION_WITH_ERROR_CODE(
+				  HTERR_INTERNAL_ERROR,
+				  "Failed to query: %s", method.c_str());
+			} else {
+				THROW_HATOHOL_EXCEPTION_WITH_ERROR_CODE(
+				  HTERR_FAILED_CONNECT_ZABBIX,
+				  "%s", queryRet.getMessage().c_str());
+			}
+		}
+		JSONParser parser(msg->response_body->data);
+		g_object_unref(msg);
+		if (parser.hasError()) {
+			THROW_HATOHOL_EXCEPTION_WITH_ERROR_CODE(
+			  HTERR_FAILED_TO_PARSE_JSON_DATA,
+			  "Failed to parser: %s", parser.getErrorMessage());
+		}
+
+		string value;
+		if (countOutput) {
+			if (!parser.read("result", value)) {
+				THROW_HATOHOL_EXCEPTION_WITH_ERROR_CODE(
+				  HTERR_FAILED_TO_PARSE_JSON_DATA,
+				  "Failed to read: result\n");
+			}
+			stat.count = StringUtils::toUint64(value);
+			continue;
+		}
+
+		startObject(parser, "result");
+		stat.maxId = 0;
+		if (parser.countElements() == 0)
+			continue;
+		startElement(parser, 0);
+		if (!parser.read(idName, value)) {
+			THROW_HATOHOL_EXCEPTION_WITH_ERROR_CODE(
+			  HTERR_FAILED_TO_PARSE_JSON_DATA,
+			  "Failed to read: %s\n", idName.c_str());
+		}
+		stat.maxId = StringUtils::toUint64(value);
+	}
+	MLPL_DBG("%s: count: %" PRIu64 ", max ID: %" PRIu64 "\n",
+	         method.c_str(), stat.count, stat.maxId);
+}
+
 void ZabbixAPI::startObject(JSONParser &parser, const string &name)
 {
 	if (!parser.startObject(name)) {
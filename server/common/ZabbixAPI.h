@@ -48,6 +48,19 @@ public:
 
 	static const uint64_t EVENT_ID_NOT_FOUND;
 
+	/**
+	 * The number of objects such as hosts and the largest ID of them.
+	 * An addition or a removal of an object changes at least one of
+	 * them.
+	 */
+	struct ObjectStat {
+		uint64_t count;
+		uint64_t maxId;
+
+		ObjectStat(void);
+		bool operator==(const ObjectStat &rhs) const;
+	};
+
 	static ItemInfoValueType toItemValueType(
 	  const ZabbixAPI::ValueType &valueType);
 	static ZabbixAPI::ValueType fromItemValueType(
@@ -106,6 +119,26 @@ protected:
 	std::string getAuthToken(void);
 	void clearAuthToken(void);
 
+	/**
+	 * Start prefetching.
+	 *
+	 * The query*() methods called until endPrefetch() send their
+	 * requests on worker threads concurrently and return NULL without
+	 * waiting for the responses. A later call of the same query, such
+	 * as the get*() method that uses it, waits for and takes
+	 * the prefetched response instead of sending a new request.
+	 * The queries are matched with their request bodies including
+	 * the auth token.
+	 */
+	void beginPrefetch(void);
+	void endPrefetch(void);
+
+	/**
+	 * Wait for and drop the prefetched responses that haven't been
+	 * taken.
+	 */
+	void discardPrefetchedQueries(void);
+
 	/**
 	 * Get the triggers.
 	 *
@@ -145,17 +178,41 @@ protected:
 	 *
 	 * @param hostsGroupsTablePtr
 	 * A ItemTablePtr the obtained host groups are stored in.
+	 *
+	 * @param digest
+	 * If this is not NULL, a SHA256 of the response is stored in it.
 	 */
 	void getHosts(ItemTablePtr &hostsTablePtr,
-	              ItemTablePtr &hostsGroupsTablePtr);
+	              ItemTablePtr &hostsGroupsTablePtr,
+	              std::string *digest = NULL);
 
 	/**
 	 * Get the groups.
 	 *
 	 * @param groupsTablePtr
 	 * A ItemTablePtr the obtained groups are stored in.
+	 *
+	 * @param digest
+	 * If this is not NULL, a SHA256 of the response is stored in it.
+	 */
+	void getGroups(ItemTablePtr &groupsTablePtr,
+	               std::string *digest = NULL);
+
+	/**
+	 * Get the number and the largest ID of the monitored hosts.
+	 * Only two small requests are sent instead of getting all hosts.
+	 *
+	 * @param stat An ObjectStat the result is stored in.
+	 */
+	void getHostStat(ObjectStat &stat);
+
+	/**
+	 * Get the number and the largest ID of the groups.
+	 * Only two small requests are sent instead of getting all groups.
+	 *
+	 * @param stat An ObjectStat the result is stored in.
 	 */
-	void getGroups(ItemTablePtr &groupsTablePtr);
+	void getGroupStat(ObjectStat &stat);
 
 	/**
 	 * Get the applications
@@ -252,6 +309,30 @@ protected:
 	 */
 	SoupMessage *queryGroup(HatoholError &queryRet);
 
+	/**
+	 * Get the number of the hosts or the host with the largest ID.
+	 *
+	 * @param countOutput
+	 * true to get the number. false to get the largest ID.
+	 *
+	 * @return
+	 * A SoupMessage object with the raw Zabbix servers's response.
+	 */
+	SoupMessage *queryHostStat(const bool &countOutput,
+	                           HatoholError &queryRet);
+
+	/**
+	 * Get the number of the groups or the group with the largest ID.
+	 *
+	 * @param countOutput
+	 * true to get the number. false to get the largest ID.
+	 *
+	 * @return
+	 * A SoupMessage object with the raw Zabbix servers's response.
+	 */
+	SoupMessage *queryGroupStat(const bool &countOutput,
+	                            HatoholError &queryRet);
+
 	/**
 	 * Get the applications.
 	 *
@@ -293,6 +374,14 @@ protected:
 	ItemTablePtr getFunctions(void);
 
 	SoupMessage *queryCommon(JSONBuilder &agent, HatoholError &queryRet);
+	SoupMessage *queryObjectStat(const std::string &method,
+	                             const std::string &idName,
+	                             const std::string &filterName,
+	                             const bool &countOutput,
+	                             HatoholError &queryRet);
+	void getObjectStat(ObjectStat &stat, const std::string &method,
+	                   const std::string &idName,
+	                   const std::string &filterName);
 	SoupMessage *queryAPIVersion(HatoholError &queryRet);
 	std::string getInitialJSONRequest(void);
 	bool parseInitialResponse(SoupMessage *msg);
@@ -21,9 +21,11 @@
 #include <Mutex.h>
 #include <Reaper.h>
 #include <stack>
+#include <deque>
 #include <cstring>
 #include <libsoup/soup.h>
 #include "Utils.h"
+#include "HatoholThreadBase.h"
 #include "JSONBuilder.h"
 #include "JSONParser.h"
 #include "HapProcessCeilometer.h"
@@ -32,6 +34,12 @@ using namespace std;
 using namespace mlpl;
 
 static const char *MIME_JSON = "application/json";
+static const guint DEFAULT_TIMEOUT = 60;
+// The number of HTTP requests sent at the same time.
+static const size_t NUM_HTTP_REQUEST_WORKERS = 8;
+// The number of requests of a batch that are queued ahead of the one
+// being parsed. It bounds the number of responses kept in memory.
+static const size_t HTTP_REQUEST_WINDOW = 2 * NUM_HTTP_REQUEST_WORKERS;
 
 struct OpenStackEndPoint {
 	string publicURL;
@@ -52,13 +60,28 @@ struct AcquireContext
 	}
 };
 
-struct HapProcessCeilometer::HttpRequestArg
+struct HttpRequestJob {
+	SoupMessage     *msg;
+	guint            status;
+	SimpleSemaphore  completion;
+
+	HttpRequestJob(void)
+	: msg(NULL),
+	  status(SOUP_STATUS_NONE),
+	  completion(0)
+	{
+	}
+};
+
+struct HapProcessCeilometer::HttpRequestArg : public HttpRequestJob
 {
 	const char *method;
 	string      url;
 	string      body;
 	bool        useAuthToken;
 	mlpl::Reaper<SoupMessage> msgPtr;
+	// The alarm or the instance that the request is for.
+	string      targetId;
 
 	HttpRequestArg(const char *_method, const string &_url)
 	: method(_method),
@@ -68,6 +91,91 @@ struct HapProcessCeilometer::HttpRequestArg
 	}
 };
 
+class HttpRequestQueue {
+public:
+	HttpRequestQueue(void)
+	: m_jobSemaphore(0),
+	  m_canceled(false)
+	{
+	}
+
+	void push(HttpRequestJob *job)
+	{
+		AutoMutex autoLock(&m_lock);
+		m_queue.push_back(job);
+		m_jobSemaphore.post();
+	}
+
+	/**
+	 * Wait for a job.
+	 *
+	 * @return A job, or NULL after cancel() is called.
+	 */
+	HttpRequestJob *pop(void)
+	{
+		m_jobSemaphore.wait();
+		AutoMutex autoLock(&m_lock);
+		if (m_canceled || m_queue.empty())
+			return NULL;
+		HttpRequestJob *job = m_queue.front();
+		m_queue.pop_front();
+		return job;
+	}
+
+	void cancel(const size_t &numWorkers)
+	{
+		AutoMutex autoLock(&m_lock);
+		m_canceled = true;
+		for (auto job : m_queue) {
+			job->status = SOUP_STATUS_CANCELLED;
+			job->completion.post();
+		}
+		m_queue.clear();
+		for (size_t i = 0; i < numWorkers; i++)
+			m_jobSemaphore.post();
+	}
+
+private:
+	Mutex                   m_lock;
+	deque<HttpRequestJob *> m_queue;
+	SimpleSemaphore         m_jobSemaphore;
+	bool                    m_canceled;
+};
+
+/**
+ * A worker thread that sends requests with the shared synchronous
+ * session. SoupSessionSync can be used from multiple threads and keeps
+ * the connections alive.
+ */
+class HttpRequestWorker : public HatoholThreadBase {
+public:
+	HttpRequestWorker(SoupSession *session, HttpRequestQueue &queue)
+	: m_session(session),
+	  m_queue(queue)
+	{
+	}
+
+	virtual ~HttpRequestWorker()
+	{
+		exitSync();
+	}
+
+protected:
+	virtual gpointer mainThread(HatoholThreadArg *arg) override
+	{
+		while (HttpRequestJob *job = m_queue.pop()) {
+			job->status =
+			  soup_session_send_message(m_session, job->msg);
+			job->completion.post();
+		}
+		return NULL;
+	}
+
+private:
+	SoupSession      *m_session;
+	HttpRequestQueue &m_queue;
+};
+
 struct HapProcessCeilometer::Impl {
 	string osUsername;
 	string osPassword;
@@ -82,8 +190,16 @@ struct HapProcessCeilometer::Impl {
 	AcquireContext    acquireCtx;
 	vector<string>    instanceIds;
 	set<string>       targetItemNames;
+	// The time of the last event of each alarm that was sent.
+	// The server is asked only for a new alarm.
+	map<string, SmartTime> lastAlarmTimes;
+
+	SoupSession                           *session;
+	HttpRequestQueue                       requestQueue;
+	vector<unique_ptr<HttpRequestWorker> > requestWorkers;
 
 	Impl(void)
+	: session(NULL)
 	{
 		const char *targetItems[] = {
 			"cpu",
@@ -101,6 +217,14 @@ struct HapProcessCeilometer::Impl {
 			targetItemNames.insert(targetItems[i]);
 	}
 
+	virtual ~Impl()
+	{
+		requestQueue.cancel(requestWorkers.size());
+		requestWorkers.clear();
+		if (session)
+			g_object_unref(session);
+	}
+
 	void clear(void)
 	{
 		token.clear();
@@ -108,6 +232,99 @@ struct HapProcessCeilometer::Impl {
 		novaEP.clear();
 		tokenExpires = SmartTime();
 	}
+
+	void startHttpRequest(HttpRequestJob &job)
+	{
+		if (requestWorkers.empty()) {
+			for (size_t i = 0; i < NUM_HTTP_REQUEST_WORKERS; i++) {
+				HttpRequestWorker *worker =
+				  new HttpRequestWorker(session, requestQueue);
+				requestWorkers.push_back(
+				  unique_ptr<HttpRequestWorker>(worker));
+				worker->start();
+			}
+		}
+		requestQueue.push(&job);
+	}
+};
+
+/**
+ * Requests that are sent by the workers and parsed in the order of
+ * addition. The requests are started when they are added as long as
+ * the window allows. The others are started as the preceding ones are
+ * waited for.
+ */
+struct HapProcessCeilometer::HttpRequestBatch {
+	HapProcessCeilometer           &hap;
+	vector<unique_ptr<HttpRequestArg> > args;
+	vector<bool>                    started;
+	size_t                          numStarted;
+	size_t                          numWaited;
+
+	HttpRequestBatch(HapProcessCeilometer &_hap)
+	: hap(_hap),
+	  numStarted(0),
+	  numWaited(0)
+	{
+	}
+
+	~HttpRequestBatch()
+	{
+		// The workers may still refer to the requests.
+		for (size_t i = numWaited; i < numStarted; i++) {
+			if (started[i])
+				args[i]->completion.wait();
+		}
+	}
+
+	void add(HttpRequestArg *arg)
+	{
+		args.push_back(unique_ptr<HttpRequestArg>(arg));
+		started.push_back(false);
+		startRequests();
+	}
+
+	size_t size(void) const
+	{
+		return args.size();
+	}
+
+	/**
+	 * Wait for the next request.
+	 *
+	 * @return
+	 * The request. It is valid until this batch is destroyed.
+	 * @param err The result of the request is set.
+	 */
+	HttpRequestArg &waitNext(HatoholError &err)
+	{
+		HATOHOL_ASSERT(numWaited < args.size(),
+		               "No request: %zd", numWaited);
+		const size_t index = numWaited++;
+		HttpRequestArg &arg = *args[index];
+		if (started[index]) {
+			arg.completion.wait();
+			err = hap.checkHttpResponse(arg);
+		} else {
+			err = HTERR_INVALID_URL;
+		}
+		startRequests();
+		return arg;
+	}
+
+private:
+	void startRequests(void)
+	{
+		while (numStarted < args.size() &&
+		       numStarted < numWaited + HTTP_REQUEST_WINDOW) {
+			HttpRequestArg &arg = *args[numStarted];
+			if (hap.prepareHttpRequest(arg) == HTERR_OK) {
+				hap.m_impl->startHttpRequest(arg);
+				started[numStarted] = true;
+			}
+			numStarted++;
+		}
+	}
 };
 
 // ---------------------------------------------------------------------------
@@ -272,7 +489,20 @@ bool HapProcessCeilometer::parserEndpoints(JSONParser &parser,
 	return true;
 }
 
-HatoholError HapProcessCeilometer::sendHttpRequest(HttpRequestArg &arg)
+SoupSession *HapProcessCeilometer::getSession(void)
+{
+	// Connections are kept alive and reused by the following requests.
+	if (!m_impl->session) {
+		m_impl->session = soup_session_sync_new_with_options(
+		  SOUP_SESSION_TIMEOUT, DEFAULT_TIMEOUT,
+		  // The workers and this thread
+		  SOUP_SESSION_MAX_CONNS_PER_HOST, NUM_HTTP_REQUEST_WORKERS + 1,
+		  NULL);
+	}
+	return m_impl->session;
+}
+
+HatoholError HapProcessCeilometer::prepareHttpRequest(HttpRequestArg &arg)
 {
 	const string &url = arg.url;
 	HATOHOL_ASSERT(arg.method, "Method is not set.");
@@ -296,17 +526,32 @@ HatoholError HapProcessCeilometer::sendHttpRequest(HttpRequestArg &arg)
 		                         SOUP_MEMORY_TEMPORARY,
 		                         arg.body.c_str(), arg.body.size());
 	}
-	SoupSession *session = soup_session_sync_new();
-	guint ret = soup_session_send_message(session, msg);
-	g_object_unref(session);
-	if (ret != SOUP_STATUS_OK) {
+	arg.msg = msg;
+	// The workers use the session created in this thread.
+	getSession();
+	return HTERR_OK;
+}
+
+HatoholError HapProcessCeilometer::checkHttpResponse(HttpRequestArg &arg)
+{
+	if (arg.status != SOUP_STATUS_OK) {
 		MLPL_ERR("Failed to connect: (%d) %s, URL: %s\n",
-		         ret, soup_status_get_phrase(ret), url.c_str());
+		         arg.status, soup_status_get_phrase(arg.status),
+		         arg.url.c_str());
 		return HTERR_BAD_REST_RESPONSE;
 	}
 	return HTERR_OK;
 }
 
+HatoholError HapProcessCeilometer::sendHttpRequest(HttpRequestArg &arg)
+{
+	HatoholError err = prepareHttpRequest(arg);
+	if (err != HTERR_OK)
+		return err;
+	arg.status = soup_session_send_message(getSession(), arg.msg);
+	return checkHttpResponse(arg);
+}
+
 HatoholError HapProcessCeilometer::getInstanceList(void)
 {
 	m_impl->instanceIds.clear();
@@ -565,17 +810,77 @@ HatoholError HapProcessCeilometer::parseReplyGetAlarmList(
 
 HatoholError HapProcessCeilometer::getAlarmHistories(void)
 {
+	const StringVector &alarmIds = m_impl->acquireCtx.alarmIds;
+
+	// Forget the alarms that have been deleted.
+	map<string, SmartTime> lastAlarmTimes;
+	for (size_t i = 0; i < alarmIds.size(); i++) {
+		map<string, SmartTime>::iterator it =
+		  m_impl->lastAlarmTimes.find(alarmIds[i]);
+		if (it != m_impl->lastAlarmTimes.end())
+			lastAlarmTimes.insert(*it);
+	}
+	m_impl->lastAlarmTimes.swap(lastAlarmTimes);
+
+	vector<SmartTime> lastTimes;
+	getLastAlarmTimes(alarmIds, lastTimes);
+
+	// The requests are sent in parallel and parsed in order.
+	HttpRequestBatch batch(*this);
+	for (size_t i = 0; i < alarmIds.size(); i++) {
+		const string &alarmId = alarmIds[i];
+		const SmartTime &lastTime = lastTimes[i];
+		string url = StringUtils::sprintf(
+		               "%s/v2/alarms/%s/history%s",
+		               m_impl->ceilometerEP.publicURL.c_str(),
+		               alarmId.c_str(),
+		               getHistoryQueryOption(lastTime).c_str());
+		HttpRequestArg *arg = new HttpRequestArg(SOUP_METHOD_GET, url);
+		arg->targetId = alarmId;
+		batch.add(arg);
+	}
+
 	HatoholError err(HTERR_OK);
-	for (size_t i = 0; i < m_impl->acquireCtx.alarmIds.size(); i++) {
-		err = getAlarmHistory(i);
-		if (err != HTERR_OK) {
+	for (size_t i = 0; i < batch.size(); i++) {
+		HatoholError requestErr;
+		HttpRequestArg &arg = batch.waitNext(requestErr);
+		if (requestErr == HTERR_OK)
+			requestErr = parseAlarmHistory(arg, lastTimes[i]);
+		if (requestErr != HTERR_OK) {
 			MLPL_ERR("Failed to get alarm history: %s\n",
-			         m_impl->acquireCtx.alarmIds[i].c_str());
+			         arg.targetId.c_str());
+			err = requestErr;
 		}
 	}
 	return err;
 }
 
+void HapProcessCeilometer::getLastAlarmTimes(
+  const StringVector &alarmIds, vector<SmartTime> &lastTimes)
+{
+	// Only the times of the new alarms are asked to the server at once.
+	lastTimes.assign(alarmIds.size(), SmartTime());
+	vector<TriggerIdType> newAlarmIds;
+	vector<size_t> newAlarmIndexes;
+	for (size_t i = 0; i < alarmIds.size(); i++) {
+		map<string, SmartTime>::const_iterator it =
+		  m_impl->lastAlarmTimes.find(alarmIds[i]);
+		if (it != m_impl->lastAlarmTimes.end()) {
+			lastTimes[i] = it->second;
+			continue;
+		}
+		newAlarmIds.push_back(alarmIds[i]);
+		newAlarmIndexes.push_back(i);
+	}
+	if (newAlarmIds.empty())
+		return;
+
+	vector<SmartTime> newAlarmTimes;
+	getTimesOfLastEvents(newAlarmIds, newAlarmTimes);
+	for (size_t i = 0; i < newAlarmIndexes.size(); i++)
+		lastTimes[newAlarmIndexes[i]] = newAlarmTimes[i];
+}
+
 string HapProcessCeilometer::getHistoryTimeString(const timespec &ts)
 {
 	tm tm;
@@ -602,20 +907,11 @@ string  HapProcessCeilometer::getHistoryQueryOption(
 	return query;
 }
 
-HatoholError HapProcessCeilometer::getAlarmHistory(const unsigned int &index)
+HatoholError HapProcessCeilometer::parseAlarmHistory(
+  HttpRequestArg &arg, const SmartTime &lastTime)
 {
-	const char *alarmId = m_impl->acquireCtx.alarmIds[index].c_str();
-	const SmartTime lastTime = getTimeOfLastEvent(alarmId);
-	string url = StringUtils::sprintf(
-	               "%s/v2/alarms/%s/history%s",
-	               m_impl->ceilometerEP.publicURL.c_str(),
-	               alarmId, getHistoryQueryOption(lastTime).c_str());
-	HttpRequestArg arg(SOUP_METHOD_GET, url);
-	HatoholError err = sendHttpRequest(arg);
-	if (err != HTERR_OK)
-		return err;
 	SoupMessage *msg = arg.msgPtr.get();
-
+	HatoholError err(HTERR_OK);
 	AlarmTimeMap alarmTimeMap;
 	const timespec &ts = lastTime.getAsTimespec();
 	if (ts.tv_sec == 0 && ts.tv_nsec == 0 &&
@@ -631,10 +927,18 @@ HatoholError HapProcessCeilometer::getAlarmHistory(const unsigned int &index)
 	}
 
 	MLPL_DBG("The numebr of updated alarms: %zd url: %s\n",
-	         alarmTimeMap.size(), url.c_str());
-	if (alarmTimeMap.empty())
+	         alarmTimeMap.size(), arg.url.c_str());
+	if (alarmTimeMap.empty()) {
+		m_impl->lastAlarmTimes.insert(
+		  pair<string, SmartTime>(arg.targetId, lastTime));
 		return HTERR_OK;
+	}
+	return sendAlarmEvents(arg.targetId, alarmTimeMap);
+}
 
+HatoholError HapProcessCeilometer::sendAlarmEvents(
+  const string &alarmId, const AlarmTimeMap &alarmTimeMap)
+{
 	// Build the table
 	VariableItemTablePtr eventTablePtr;
 	AlarmTimeMapConstIterator it = alarmTimeMap.begin();
@@ -642,8 +946,16 @@ HatoholError HapProcessCeilometer::getAlarmHistory(const unsigned int &index)
 		const ItemGroupPtr &historyElement = it->second;
 		eventTablePtr->add(historyElement);
 	}
-	sendTable(HAPI_CMD_SEND_UPDATED_EVENTS,
-	          static_cast<ItemTablePtr>(eventTablePtr));
+	if (!sendTableSync(HAPI_CMD_SEND_UPDATED_EVENTS,
+	                   static_cast<ItemTablePtr>(eventTablePtr))) {
+		MLPL_ERR("Failed to send the events of alarm: %s\n",
+		         alarmId.c_str());
+		return HTERR_HAP_INTERNAL_ERROR;
+	}
+	// The next request asks only for the newer history. The cached
+	// time is kept when the server didn't store the events, so that
+	// they are requested again.
+	m_impl->lastAlarmTimes[alarmId] = alarmTimeMap.rbegin()->first;
 	return HTERR_OK;
 }
 
@@ -886,11 +1198,7 @@ HatoholError HapProcessCeilometer::fetchItem(const MessagingContext &msgCtx,
 {
 	MLPL_DBG("fetchItem\n");
 	VariableItemTablePtr tablePtr;
-	HatoholError err(HTERR_OK);
-	for (size_t i = 0; i < m_impl->instanceIds.size(); i++) {
-		const string &instanceId = m_impl->instanceIds[i];
-		err = fetchItemsOfInstance(tablePtr, instanceId);
-	}
+	HatoholError err = fetchItemsOfInstances(tablePtr);
 	SmartBuffer resBuf;
 	setupResponseBuffer<void>(resBuf, 0, HAPI_RES_ITEMS, &msgCtx);
 	appendItemTable(resBuf, static_cast<ItemTablePtr>(tablePtr));
@@ -916,22 +1224,51 @@ HatoholError HapProcessCeilometer::fetchTrigger(const MessagingContext &msgCtx,
 	return err;
 }
 
-HatoholError HapProcessCeilometer::fetchItemsOfInstance(
-  VariableItemTablePtr &tablePtr, const string &instanceId)
+HatoholError HapProcessCeilometer::fetchItemsOfInstances(
+  VariableItemTablePtr &tablePtr)
 {
 	HatoholError err = updateAuthTokenIfNeeded();
 	if (err != HTERR_OK)
 		return err;
 
-	string url = StringUtils::sprintf(
-	               "%s/v2/resources/%s",
-	               m_impl->ceilometerEP.publicURL.c_str(),
-	               instanceId.c_str());
-	HttpRequestArg arg(SOUP_METHOD_GET, url);
-	err = sendHttpRequest(arg);
-	if (err != HTERR_OK)
-		return err;
+	// The resources of the instances are requested in parallel. The meters
+	// in them are requested as soon as each resource is parsed.
+	HttpRequestBatch instanceBatch(*this);
+	for (size_t i = 0; i < m_impl->instanceIds.size(); i++) {
+		const string &instanceId = m_impl->instanceIds[i];
+		string url = StringUtils::sprintf(
+		               "%s/v2/resources/%s",
+		               m_impl->ceilometerEP.publicURL.c_str(),
+		               instanceId.c_str());
+		HttpRequestArg *arg = new HttpRequestArg(SOUP_METHOD_GET, url);
+		arg->targetId = instanceId;
+		instanceBatch.add(arg);
+	}
+
+	HttpRequestBatch resourceBatch(*this);
+	for (size_t i = 0; i < instanceBatch.size(); i++) {
+		HatoholError requestErr;
+		HttpRequestArg &arg = instanceBatch.waitNext(requestErr);
+		if (requestErr == HTERR_OK)
+			requestErr = parseResourceLinks(arg, resourceBatch);
+		if (requestErr != HTERR_OK)
+			err = requestErr;
+	}
+
+	for (size_t i = 0; i < resourceBatch.size(); i++) {
+		HatoholError requestErr;
+		HttpRequestArg &arg = resourceBatch.waitNext(requestErr);
+		if (requestErr == HTERR_OK)
+			requestErr = parseResource(tablePtr, arg);
+		if (requestErr != HTERR_OK)
+			err = requestErr;
+	}
+	return err;
+}
 
+HatoholError HapProcessCeilometer::parseResourceLinks(
+  HttpRequestArg &arg, HttpRequestBatch &resourceBatch)
+{
 	SoupMessage *msg = arg.msgPtr.get();
 	JSONParser parser(msg->response_body->data);
 	if (parser.hasError()) {
@@ -946,8 +1283,8 @@ HatoholError HapProcessCeilometer::fetchItemsOfInstance(
 
 	const unsigned int count = parser.countElements();
 	for (unsigned int idx = 0; idx < count; idx++) {
-		HatoholError err = parserResourceLink(parser, tablePtr, idx,
-		                                      instanceId);
+		HatoholError err = parserResourceLink(parser, resourceBatch,
+		                                      idx, arg.targetId);
 		if (err != HTERR_OK)
 			return err;
 	}
@@ -981,8 +1318,8 @@ HatoholError HapProcessCeilometer::fetchHistory(const MessagingContext &msgCtx,
 }
 
 HatoholError HapProcessCeilometer::parserResourceLink(
-  JSONParser &parser, VariableItemTablePtr &tablePtr, const unsigned int &index,
-  const string &instanceId)
+  JSONParser &parser, HttpRequestBatch &resourceBatch,
+  const unsigned int &index, const string &instanceId)
 {
 	JSONParser::PositionStack parserRewinder(parser);
 	if (! parserRewinder.pushElement(index)) {
@@ -997,17 +1334,18 @@ HatoholError HapProcessCeilometer::parserResourceLink(
 		return HTERR_OK;
 	if (!read(parser, "href", href))
 		return HTERR_FAILED_TO_PARSE_JSON_DATA;
-	return getResource(tablePtr, href, instanceId);
+	HttpRequestArg *arg =
+	  new HttpRequestArg(SOUP_METHOD_GET, href + "&limit=1");
+	arg->targetId = instanceId;
+	resourceBatch.add(arg);
+	return HTERR_OK;
 }
 
-HatoholError HapProcessCeilometer::getResource(
-  VariableItemTablePtr &tablePtr, const string &_url, const string &instanceId)
+HatoholError HapProcessCeilometer::parseResource(
+  VariableItemTablePtr &tablePtr, HttpRequestArg &arg)
 {
-	string url = _url + "&limit=1";
-	HttpRequestArg arg(SOUP_METHOD_GET, url);
-	HatoholError err = sendHttpRequest(arg);
-	if (err != HTERR_OK)
-		return err;
+	const string &url = arg.url;
+	const string &instanceId = arg.targetId;
 	SoupMessage *msg = arg.msgPtr.get();
 	JSONParser parser(msg->response_body->data);
 	if (parser.hasError()) {
@@ -22,6 +22,7 @@
 
 #include <string>
 #include <SmartTime.h>
+#include <StringUtils.h>
 #include <Reaper.h>
 #include <libsoup/soup.h>
 #include "JSONParser.h"
@@ -42,6 +43,10 @@ protected:
 	bool parseReplyToknes(SoupMessage *msg);
 
 	struct HttpRequestArg;
+	struct HttpRequestBatch;
+	SoupSession *getSession(void);
+	HatoholError prepareHttpRequest(HttpRequestArg &arg);
+	HatoholError checkHttpResponse(HttpRequestArg &arg);
 	HatoholError sendHttpRequest(HttpRequestArg &arg);
 
 	HatoholError getInstanceList(void);
@@ -62,7 +67,12 @@ protected:
 	mlpl::SmartTime parseStateTimestamp(const std::string &stateTimestamp);
 
 	HatoholError getAlarmHistories(void);
-	HatoholError getAlarmHistory(const unsigned int &index);
+	void getLastAlarmTimes(const mlpl::StringVector &alarmIds,
+	                       std::vector<mlpl::SmartTime> &lastTimes);
+	HatoholError parseAlarmHistory(HttpRequestArg &arg,
+	                               const mlpl::SmartTime &lastTime);
+	HatoholError sendAlarmEvents(const std::string &alarmId,
+	                             const AlarmTimeMap &alarmTimeMap);
 	std::string  getHistoryQueryOption(const mlpl::SmartTime &lastTime);
 	HatoholError parseReplyGetAlarmHistory(SoupMessage *msg,
 	                                       AlarmTimeMap &alarmTimeMap);
@@ -95,17 +105,17 @@ protected:
 	virtual HatoholError fetchTrigger(
 	                       const MessagingContext &msgCtx,
 			       const mlpl::SmartBuffer &cmdBuf) override;
-	HatoholError fetchItemsOfInstance(
-	  VariableItemTablePtr &tablePtr, const std::string &instanceId);
+	HatoholError fetchItemsOfInstances(VariableItemTablePtr &tablePtr);
 	virtual HatoholError fetchHistory(
 	  const MessagingContext &msgCtx,
 	  const mlpl::SmartBuffer &cmdBuf) override;
+	HatoholError parseResourceLinks(HttpRequestArg &arg,
+	                                HttpRequestBatch &resourceBatch);
 	HatoholError parserResourceLink(
-	  JSONParser &parser, VariableItemTablePtr &tablePtr,
+	  JSONParser &parser, HttpRequestBatch &resourceBatch,
 	  const unsigned int &index, const std::string &instanceId);
-	HatoholError getResource(
-	  VariableItemTablePtr &tablePtr, const std::string &url,
-	  const std::string &instanceId);
+	HatoholError parseResource(VariableItemTablePtr &tablePtr,
+	                           HttpRequestArg &arg);
 	std::string getHistoryTimeString(const timespec &timeSpec);
 	ItemTablePtr getHistory(
 	  const ItemIdType &itemId, const LocalHostIdType &hostId,
@@ -251,6 +251,14 @@ EventIdType HatoholArmPluginBase::getLastEventId(void)
 
 SmartTime HatoholArmPluginBase::getTimeOfLastEvent(
   const TriggerIdType &triggerId)
+{
+	vector<SmartTime> lastTimes;
+	getTimesOfLastEvents(vector<TriggerIdType>(1, triggerId), lastTimes);
+	return lastTimes[0];
+}
+
+void HatoholArmPluginBase::getTimesOfLastEvents(
+  const vector<TriggerIdType> &triggerIds, vector<SmartTime> &lastTimes)
 {
 	struct Callback : public SyncCommand {
 		SmartTime lastTime;
@@ -275,24 +283,42 @@ SmartTime HatoholArmPluginBase::getTimeOfLastEvent(
 			lastTime = SmartTime(ts);
 			setSucceeded();
 		}
-	} *cb = new Callback(this);
-	Reaper<UsedCountable> reaper(cb, UsedCountable::unref);
+	};
 
-	SmartBuffer cmdBuf;
-	HapiParamTimeOfLastEvent *param = 
-	  setupCommandHeader<HapiParamTimeOfLastEvent>(
-	    cmdBuf, HAPI_CMD_GET_TIME_OF_LAST_EVENT,
-	    sizeof(HapiParamTimeOfLastEvent) + triggerId.size() + 1);
-	char *buf = reinterpret_cast<char *>(param + 1);
-	buf = putString(buf, param, triggerId,
-	                &param->triggerIdOffset, &param->triggerIdLength);
-	send(cmdBuf, cb);
-	cb->wait();
-	if (!cb->getSucceeded()) {
+	// The replies come in the order of the commands. So all commands
+	// are sent first and then the replies are waited for.
+	vector<UsedCountablePtr<Callback> > callbacks;
+	callbacks.reserve(triggerIds.size());
+	for (size_t i = 0; i < triggerIds.size(); i++) {
+		const TriggerIdType &triggerId = triggerIds[i];
+		Callback *cb = new Callback(this);
+		callbacks.push_back(UsedCountablePtr<Callback>(cb, false));
+
+		SmartBuffer cmdBuf;
+		HapiParamTimeOfLastEvent *param = 
+		  setupCommandHeader<HapiParamTimeOfLastEvent>(
+		    cmdBuf, HAPI_CMD_GET_TIME_OF_LAST_EVENT,
+		    sizeof(HapiParamTimeOfLastEvent) + triggerId.size() + 1);
+		char *buf = reinterpret_cast<char *>(param + 1);
+		buf = putString(buf, param, triggerId,
+		                &param->triggerIdOffset,
+		                &param->triggerIdLength);
+		send(cmdBuf, cb);
+	}
+
+	bool succeeded = true;
+	lastTimes.clear();
+	lastTimes.reserve(callbacks.size());
+	for (size_t i = 0; i < callbacks.size(); i++) {
+		callbacks[i]->wait();
+		if (!callbacks[i]->getSucceeded())
+			succeeded = false;
+		lastTimes.push_back(callbacks[i]->lastTime);
+	}
+	if (!succeeded) {
 		THROW_HATOHOL_EXCEPTION(
 		  "Failed to call HAPI_CMD_GET_TIME_OF_LAST_EVENT\n");
 	}
-	return cb->lastTime;
 }
 
 bool HatoholArmPluginBase::wasHostsInServerDBChanged(void)
@@ -478,6 +504,33 @@ void HatoholArmPluginBase::sendTable(
 	send(cmdBuf);
 }
 
+bool HatoholArmPluginBase::sendTableSync(
+  const HapiCommandCode &code, const ItemTablePtr &tablePtr)
+{
+	struct Callback : public SyncCommand {
+		Callback(HatoholArmPluginBase *obj)
+		: SyncCommand(obj)
+		{
+		}
+
+		virtual void onGotReply(
+		  mlpl::SmartBuffer &replyBuf,
+		  const HapiCommandHeader &cmdHeader) override
+		{
+			SemaphorePoster poster(this);
+			setSucceeded();
+		}
+	} *cb = new Callback(this);
+	Reaper<UsedCountable> reaper(cb, UsedCountable::unref);
+
+	SmartBuffer cmdBuf;
+	setupCommandHeader<void>(cmdBuf, code);
+	appendItemTable(cmdBuf, tablePtr);
+	send(cmdBuf, cb);
+	cb->wait();
+	return cb->getSucceeded();
+}
+
 void HatoholArmPluginBase::sendArmInfo(const ArmInfo &armInfo,
 				       const HatoholArmPluginWatchType &type)
 {
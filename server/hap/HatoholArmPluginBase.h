@@ -20,6 +20,7 @@
 #ifndef HatoholArmPluginBase_h
 #define HatoholArmPluginBase_h
 
+#include <vector>
 #include <SmartTime.h>
 #include "ArmStatus.h"
 #include "ItemTablePtr.h"
@@ -64,6 +65,20 @@ public:
 	mlpl::SmartTime getTimeOfLastEvent(
 	  const TriggerIdType &triggerId = ALL_TRIGGERS);
 
+	/**
+	 * Get the times of the last events of the triggers. The requests
+	 * are sent at once and then the replies are waited for.
+	 *
+	 * @param triggerIds IDs of the target triggers.
+	 * @param lastTimes
+	 * The time of the last event of each trigger is stored in the order
+	 * of triggerIds. If no events found, hasValidTime() of the element
+	 * is false.
+	 */
+	virtual void getTimesOfLastEvents(
+	  const std::vector<TriggerIdType> &triggerIds,
+	  std::vector<mlpl::SmartTime> &lastTimes);
+
 	bool wasHostsInServerDBChanged(void);
 
 	bool shouldLoadOldEvent(void);
@@ -88,6 +103,15 @@ protected:
 
 	void sendTable(const HapiCommandCode &code,
 	               const ItemTablePtr &tablePtr);
+
+	/**
+	 * Send a table and wait for the reply from the server.
+	 *
+	 * @return true if the server accepted the table. Or false is returned.
+	 */
+	virtual bool sendTableSync(const HapiCommandCode &code,
+	                           const ItemTablePtr &tablePtr);
+
 	void sendArmInfo(const ArmInfo &armInfo,
 			 const HatoholArmPluginWatchType &type = COLLECT_OK);
 	void sendHapSelfTriggers(const int TriggerNum,
@@ -0,0 +1,579 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <map>
+#include <deque>
+#include <algorithm>
+#include <Mutex.h>
+#include <SimpleSemaphore.h>
+#include <SmartTime.h>
+#include "ActionLogWriter.h"
+#include "ConfigManager.h"
+#include "HatoholException.h"
+#include "HatoholThreadBase.h"
+#include "ThreadLocalDBCache.h"
+
+using namespace std;
+using namespace mlpl;
+
+const size_t ActionLogWriter::DEFAULT_FLUSH_INTERVAL_MSEC = 200;
+const size_t ActionLogWriter::DEFAULT_MAX_CHANGES_PER_COMMIT = 1024;
+const size_t ActionLogWriter::DEFAULT_MAX_QUEUED_CHANGES = 65536;
+
+// A margin for the clocks of the monitoring servers. The logs started
+// within this period before the allowed time of the action for old
+// events are also loaded into the index.
+static const time_t INDEX_MARGIN_SEC = 60 * 60;
+
+// The maximum number of events in the index when the actions for all
+// old events are allowed. The DB is queried on a miss in that case.
+static const size_t MAX_INDEXED_EVENTS = 65536;
+
+typedef DBTablesAction::ActionLogChange ActionLogChange;
+typedef DBTablesAction::ActionLogChangeVect ActionLogChangeVect;
+typedef pair<ServerIdType, EventIdType> LoggedEventKey;
+
+enum CommitResult {
+	COMMIT_OK,
+	// The DB isn't available. The changes should be written later.
+	COMMIT_DB_UNAVAILABLE,
+	// The changes can't be written. Retrying them is useless.
+	COMMIT_REJECTED,
+};
+
+// ---------------------------------------------------------------------------
+// ActionLogFlusher
+// ---------------------------------------------------------------------------
+class ActionLogFlusher : public HatoholThreadBase {
+public:
+	/**
+	 * A function that writes queued changes. It returns true if
+	 * there are still changes to be written immediately.
+	 */
+	typedef bool (*WriteFunc)(void *data);
+
+	ActionLogFlusher(WriteFunc writeFunc, void *data)
+	: m_writeFunc(writeFunc),
+	  m_data(data),
+	  m_wakeSemaphore(0)
+	{
+	}
+
+	virtual ~ActionLogFlusher()
+	{
+		exitSync();
+	}
+
+	virtual void waitExit(void) override
+	{
+		m_wakeSemaphore.post();
+		HatoholThreadBase::waitExit();
+	}
+
+	/**
+	 * Write the queued changes without waiting for the interval.
+	 */
+	void notify(void)
+	{
+		m_wakeSemaphore.post();
+	}
+
+protected:
+	virtual gpointer mainThread(HatoholThreadArg *arg) override
+	{
+		while (true) {
+			m_wakeSemaphore.timedWait(
+			  ActionLogWriter::DEFAULT_FLUSH_INTERVAL_MSEC);
+			if (isExitRequested())
+				break;
+			while ((*m_writeFunc)(m_data) && !isExitRequested())
+				;
+		}
+		// Write the rest before the exit.
+		(*m_writeFunc)(m_data);
+		return NULL;
+	}
+
+private:
+	WriteFunc        m_writeFunc;
+	void            *m_data;
+	SimpleSemaphore  m_wakeSemaphore;
+};
+
+// ---------------------------------------------------------------------------
+// ActionLogWriter
+// ---------------------------------------------------------------------------
+struct ActionLogWriter::Impl
+{
+	static ActionLogWriter instance;
+
+	Mutex                     startLock;
+	bool                      started;
+	unique_ptr<ActionLogFlusher> flusher;
+
+	// Serializes taking and writing the changes, so that the changes
+	// of a log are written in the order of the calls.
+	Mutex                     writeLock;
+
+	Mutex                     lock;
+	map<ActionLogIdType, ActionLogChange> queue;
+	Stat                      stat;
+
+	// The events of action logs and their start times.
+	map<LoggedEventKey, time_t>             loggedEvents;
+	deque<pair<time_t, LoggedEventKey> >    loggedEventOrder;
+	// The index has all logs of the events that happened after this
+	// time, if 'indexComplete' is true.
+	bool                      indexComplete;
+	time_t                    indexCompleteSince;
+
+	Impl(void)
+	: started(false),
+	  indexComplete(false),
+	  indexCompleteSince(0)
+	{
+	}
+
+	~Impl()
+	{
+		flusher.reset();
+	}
+
+	void prepare(void)
+	{
+		AutoMutex autoLock(&startLock);
+		if (started)
+			return;
+		loadIndex();
+		flusher.reset(new ActionLogFlusher(writeCb, this));
+		flusher->start();
+		started = true;
+	}
+
+	void stop(void)
+	{
+		AutoMutex autoLock(&startLock);
+		{
+			AutoMutex autoMutex(&lock);
+			if (!queue.empty()) {
+				MLPL_WARN("Drop %zd queued action log "
+				          "changes.\n", queue.size());
+			}
+			queue.clear();
+			loggedEvents.clear();
+			loggedEventOrder.clear();
+			indexComplete = false;
+			stat = Stat();
+		}
+		flusher.reset();
+		started = false;
+	}
+
+	static int getAllowedTime(void)
+	{
+		ConfigManager *configMgr = ConfigManager::getInstance();
+		return configMgr->getAllowedTimeOfActionForOldEvents();
+	}
+
+	static bool compareStartTime(
+	  const DBTablesAction::ActionLogEvent &lhs,
+	  const DBTablesAction::ActionLogEvent &rhs)
+	{
+		return lhs.startTime < rhs.startTime;
+	}
+
+	void loadIndex(void)
+	{
+		// Actions aren't run for the events older than the allowed
+		// time. So the logs started in the time are enough to check
+		// the other events.
+		const int allowedTime = getAllowedTime();
+		if (allowedTime ==
+		    ConfigManager::ALLOW_ACTION_FOR_ALL_OLD_EVENTS)
+			return;
+		const time_t now = time(NULL);
+		DBTablesAction::ActionLogEventVect logEvents;
+		try {
+			ThreadLocalDBCache cache;
+			cache.getAction().getActionLogEvents(
+			  logEvents, now - allowedTime - INDEX_MARGIN_SEC);
+		} catch (const exception &e) {
+			MLPL_ERR("Failed to load action log events: %s\n",
+			         e.what());
+			return;
+		}
+		sort(logEvents.begin(), logEvents.end(), compareStartTime);
+
+		AutoMutex autoMutex(&lock);
+		for (size_t i = 0; i < logEvents.size(); i++) {
+			const DBTablesAction::ActionLogEvent &logEvent =
+			  logEvents[i];
+			addLoggedEvent(logEvent.serverId, logEvent.eventId,
+			               logEvent.startTime);
+		}
+		indexComplete = true;
+		indexCompleteSince = now - allowedTime;
+		MLPL_INFO("Loaded %zd action log events.\n", logEvents.size());
+	}
+
+	void addLoggedEvent(const ServerIdType &serverId,
+	                    const EventIdType &eventId, const time_t &time)
+	{
+		// This function assumes that 'lock' is being locked.
+		const LoggedEventKey key(serverId, eventId);
+		loggedEvents[key] = time;
+		loggedEventOrder.push_back(make_pair(time, key));
+	}
+
+	void evictLoggedEvents(const time_t &now)
+	{
+		// This function assumes that 'lock' is being locked.
+		const int allowedTime = getAllowedTime();
+		while (!loggedEventOrder.empty()) {
+			const time_t &time = loggedEventOrder.front().first;
+			if (indexComplete) {
+				const time_t oldest =
+				  now - allowedTime - INDEX_MARGIN_SEC;
+				if (time >= oldest)
+					break;
+			} else if (loggedEvents.size() <= MAX_INDEXED_EVENTS) {
+				break;
+			}
+			// The event may be logged again later.
+			const LoggedEventKey &key =
+			  loggedEventOrder.front().second;
+			auto it = loggedEvents.find(key);
+			if (it != loggedEvents.end() && it->second == time)
+				loggedEvents.erase(it);
+			loggedEventOrder.pop_front();
+		}
+	}
+
+	bool isCoveredByIndex(const EventInfo &eventInfo, const time_t &now)
+	{
+		// This function assumes that 'lock' is being locked.
+		if (!indexComplete)
+			return false;
+		const time_t &eventTime = eventInfo.time.tv_sec;
+		return eventTime >= indexCompleteSince &&
+		       eventTime >= now - getAllowedTime();
+	}
+
+	void queueChange(const ActionLogChange &change)
+	{
+		prepare();
+		{
+			AutoMutex autoMutex(&lock);
+			stat.numChanges++;
+			if (addToQueue(change))
+				return;
+		}
+		// The queue is full, typically because the DB isn't
+		// available. The caller writes the change by itself
+		// instead of growing the queue.
+		writeDirectly(change);
+	}
+
+	/**
+	 * Merge a change into the queued one of the log or add it to the
+	 * queue. This function assumes that 'lock' is being locked.
+	 *
+	 * @return false if the queue is full. Otherwise true.
+	 */
+	bool addToQueue(const ActionLogChange &change)
+	{
+		auto it = queue.find(change.log.id);
+		if (it != queue.end()) {
+			it->second.merge(change);
+			stat.numMergedChanges++;
+			return true;
+		}
+		if (queue.size() >= DEFAULT_MAX_QUEUED_CHANGES)
+			return false;
+		queue.insert(make_pair(change.log.id, change));
+		if (queue.size() >= DEFAULT_MAX_CHANGES_PER_COMMIT)
+			flusher->notify();
+		return true;
+	}
+
+	void writeDirectly(const ActionLogChange &change)
+	{
+		// writeLock waits for the commit of the preceding changes
+		// of the log that are being written by the writer thread.
+		AutoMutex writeMutex(&writeLock);
+		{
+			AutoMutex autoMutex(&lock);
+			// They may have been requeued.
+			auto it = queue.find(change.log.id);
+			if (it != queue.end()) {
+				it->second.merge(change);
+				stat.numMergedChanges++;
+				return;
+			}
+		}
+		const CommitResult result =
+		  commit(ActionLogChangeVect(1, change));
+		if (result != COMMIT_OK)
+			dropChange(change);
+		AutoMutex autoMutex(&lock);
+		if (result == COMMIT_OK)
+			stat.numCommits++;
+		else
+			stat.numFailedCommits++;
+	}
+
+	void dropChange(const ActionLogChange &change)
+	{
+		MLPL_ERR("Drop an action log change: log ID: %"
+		         FMT_ACTION_LOG_ID "\n", change.log.id);
+		AutoMutex autoMutex(&lock);
+		stat.numDroppedChanges++;
+	}
+
+	void takeChanges(ActionLogChangeVect &changes)
+	{
+		AutoMutex autoMutex(&lock);
+		auto it = queue.begin();
+		while (it != queue.end() &&
+		       changes.size() < DEFAULT_MAX_CHANGES_PER_COMMIT) {
+			changes.push_back(it->second);
+			queue.erase(it++);
+		}
+	}
+
+	void requeueChanges(const ActionLogChangeVect &changes)
+	{
+		// The changes queued after the failed commit are newer.
+		AutoMutex autoMutex(&lock);
+		for (size_t i = 0; i < changes.size(); i++) {
+			ActionLogChange change = changes[i];
+			auto it = queue.find(change.log.id);
+			if (it != queue.end()) {
+				change.merge(it->second);
+				it->second = change;
+			} else {
+				queue.insert(make_pair(change.log.id, change));
+			}
+		}
+	}
+
+	CommitResult commit(const ActionLogChangeVect &changes)
+	{
+		try {
+			ThreadLocalDBCache cache;
+			cache.getAction().writeActionLogs(changes);
+			return COMMIT_OK;
+		} catch (const HatoholException &e) {
+			MLPL_ERR("Failed to write %zd action log changes: %s\n",
+			         changes.size(), e.getFancyMessage().c_str());
+			if (e.getErrCode() == HTERR_FAILED_CONNECT_MYSQL)
+				return COMMIT_DB_UNAVAILABLE;
+		} catch (const exception &e) {
+			MLPL_ERR("Failed to write %zd action log changes: %s\n",
+			         changes.size(), e.what());
+		}
+		return COMMIT_REJECTED;
+	}
+
+	/**
+	 * Write the changes one by one to find the ones that can't be
+	 * written. They are dropped.
+	 *
+	 * @param changes
+	 * The changes to be written. If the DB becomes unavailable, the
+	 * changes that haven't been written are left.
+	 */
+	CommitResult commitEach(ActionLogChangeVect &changes)
+	{
+		for (size_t i = 0; i < changes.size(); i++) {
+			const CommitResult result =
+			  commit(ActionLogChangeVect(1, changes[i]));
+			if (result == COMMIT_DB_UNAVAILABLE) {
+				changes.erase(changes.begin(),
+				              changes.begin() + i);
+				return result;
+			}
+			if (result == COMMIT_REJECTED)
+				dropChange(changes[i]);
+		}
+		changes.clear();
+		return COMMIT_OK;
+	}
+
+	/**
+	 * Write the queued changes in one transaction. If it fails for
+	 * a reason other than the DB connection, the changes are written
+	 * one by one and the bad ones are dropped.
+	 *
+	 * @return
+	 * true if the changes are written or there's no change.
+	 * false if the DB isn't available.
+	 */
+	bool write(void)
+	{
+		AutoMutex writeMutex(&writeLock);
+		ActionLogChangeVect changes;
+		takeChanges(changes);
+		if (changes.empty())
+			return true;
+
+		SmartTime startTime(SmartTime::INIT_CURR_TIME);
+		CommitResult result = commit(changes);
+		if (result == COMMIT_REJECTED)
+			result = commitEach(changes);
+		if (result == COMMIT_DB_UNAVAILABLE)
+			requeueChanges(changes);
+		SmartTime commitTime(SmartTime::INIT_CURR_TIME);
+		commitTime -= startTime;
+
+		const bool committed = (result != COMMIT_DB_UNAVAILABLE);
+		AutoMutex autoMutex(&lock);
+		stat.commitTimeMSec += commitTime.getAsMSec();
+		if (committed)
+			stat.numCommits++;
+		else
+			stat.numFailedCommits++;
+		return committed;
+	}
+
+	bool isQueueEmpty(void)
+	{
+		AutoMutex autoMutex(&lock);
+		return queue.empty();
+	}
+
+	static bool writeCb(void *data)
+	{
+		Impl *impl = static_cast<Impl *>(data);
+		// A failed commit is retried after the interval.
+		return impl->write() && !impl->isQueueEmpty();
+	}
+};
+
+ActionLogWriter ActionLogWriter::Impl::instance;
+
+ActionLogWriter::Stat::Stat(void)
+: numCommits(0),
+  numFailedCommits(0),
+  numChanges(0),
+  numMergedChanges(0),
+  numDroppedChanges(0),
+  queueDepth(0),
+  numIndexedEvents(0),
+  numDBLookups(0),
+  commitTimeMSec(0)
+{
+}
+
+// ---------------------------------------------------------------------------
+// Public methods
+// ---------------------------------------------------------------------------
+ActionLogWriter &ActionLogWriter::getInstance(void)
+{
+	return Impl::instance;
+}
+
+void ActionLogWriter::reset(void)
+{
+	Impl::instance.m_impl->stop();
+}
+
+ActionLogIdType ActionLogWriter::createActionLog(
+  const ActionDef &actionDef, const EventInfo &eventInfo,
+  ActionLogExecFailureCode failureCode, ActionLogStatus initialStatus)
+{
+	m_impl->prepare();
+	ThreadLocalDBCache cache;
+	ActionLogChange change;
+	change.setNew(cache.getAction().allocateActionLogId(),
+	              actionDef, eventInfo, failureCode, initialStatus);
+	{
+		AutoMutex autoMutex(&m_impl->lock);
+		m_impl->addLoggedEvent(change.serverId, change.eventId,
+		                       change.log.startTime);
+	}
+	m_impl->queueChange(change);
+	return change.log.id;
+}
+
+void ActionLogWriter::logEndExecAction(
+  const DBTablesAction::LogEndExecActionArg &logArg)
+{
+	ActionLogChange change;
+	change.log.id = logArg.logId;
+	change.setEnd(logArg);
+	m_impl->queueChange(change);
+}
+
+void ActionLogWriter::updateLogStatusToStart(const ActionLogIdType &logId)
+{
+	ActionLogChange change;
+	change.log.id = logId;
+	change.setStarted();
+	m_impl->queueChange(change);
+}
+
+bool ActionLogWriter::isLogged(const EventInfo &eventInfo,
+                               DBTablesAction &dbAction)
+{
+	m_impl->prepare();
+	{
+		const time_t now = time(NULL);
+		AutoMutex autoMutex(&m_impl->lock);
+		m_impl->evictLoggedEvents(now);
+		const LoggedEventKey key(eventInfo.serverId, eventInfo.id);
+		if (m_impl->loggedEvents.count(key))
+			return true;
+		if (m_impl->isCoveredByIndex(eventInfo, now))
+			return false;
+		m_impl->stat.numDBLookups++;
+	}
+	// Every queued new log is in the index. So we don't have to
+	// flush the queue here.
+	ActionLog actionLog;
+	return dbAction.getLog(actionLog, eventInfo.serverId, eventInfo.id);
+}
+
+void ActionLogWriter::flush(void)
+{
+	while (!m_impl->isQueueEmpty()) {
+		if (!m_impl->write())
+			return;
+	}
+}
+
+void ActionLogWriter::getStat(Stat &stat)
+{
+	AutoMutex autoMutex(&m_impl->lock);
+	stat = m_impl->stat;
+	stat.queueDepth = m_impl->queue.size();
+	stat.numIndexedEvents = m_impl->loggedEvents.size();
+}
+
+// ---------------------------------------------------------------------------
+// Protected methods
+// ---------------------------------------------------------------------------
+ActionLogWriter::ActionLogWriter(void)
+: m_impl(new Impl())
+{
+}
+
+ActionLogWriter::~ActionLogWriter()
+{
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ActionLogWriter_h
+#define ActionLogWriter_h
+
+#include <memory>
+#include "DBTablesAction.h"
+
+/**
+ * ActionLogWriter writes action logs asynchronously.
+ *
+ * The creations and the updates of action logs are queued and written
+ * by a writer thread in one transaction every DEFAULT_FLUSH_INTERVAL_MSEC.
+ * The changes of the same log in the queue are merged, so a short action
+ * is typically written with a single INSERT.
+ *
+ * A change that can't be written is dropped. The changes that fail
+ * because the DB isn't available are retried. When the queue has
+ * DEFAULT_MAX_QUEUED_CHANGES, a new change is written by the caller
+ * and dropped if it fails.
+ *
+ * The writer also keeps the events of recent action logs in memory.
+ * isLogged() answers from it without the DB for the events that are
+ * new enough to be run actions.
+ */
+class ActionLogWriter
+{
+public:
+	static const size_t DEFAULT_FLUSH_INTERVAL_MSEC;
+	static const size_t DEFAULT_MAX_CHANGES_PER_COMMIT;
+	static const size_t DEFAULT_MAX_QUEUED_CHANGES;
+
+	struct Stat {
+		uint64_t numCommits;
+		uint64_t numFailedCommits;
+		// The number of changes passed to the writer.
+		uint64_t numChanges;
+		// The number of changes merged into a queued one.
+		uint64_t numMergedChanges;
+		// The number of changes that couldn't be written.
+		uint64_t numDroppedChanges;
+		// The number of changes waiting for the commit.
+		size_t   queueDepth;
+		// The number of events in the index.
+		size_t   numIndexedEvents;
+		// The number of isLogged() calls that queried the DB.
+		uint64_t numDBLookups;
+		// Total time spent in the commits.
+		double   commitTimeMSec;
+
+		Stat(void);
+	};
+
+	static ActionLogWriter &getInstance(void);
+
+	/**
+	 * Stop the writer and drop the queued changes and the index.
+	 * This is mainly for the test.
+	 */
+	static void reset(void);
+
+	/**
+	 * Queue a new action log.
+	 * The parameters are the same as DBTablesAction::createActionLog().
+	 *
+	 * @return an ID of the log.
+	 */
+	ActionLogIdType createActionLog(
+	  const ActionDef &actionDef, const EventInfo &eventInfo,
+	  ActionLogExecFailureCode failureCode = ACTLOG_EXECFAIL_NONE,
+	  ActionLogStatus initialStatus = ACTLOG_STAT_STARTED);
+
+	/**
+	 * Queue the end of an action.
+	 * See also DBTablesAction::logEndExecAction().
+	 */
+	void logEndExecAction(
+	  const DBTablesAction::LogEndExecActionArg &logArg);
+
+	/**
+	 * Queue the start of an action.
+	 * See also DBTablesAction::updateLogStatusToStart().
+	 */
+	void updateLogStatusToStart(const ActionLogIdType &logId);
+
+	/**
+	 * Check if an action log for the event exists.
+	 *
+	 * @param eventInfo An event to be checked.
+	 * @param dbAction
+	 * A DBTablesAction used when the index can't answer.
+	 *
+	 * @return true if the log exists. Otherwise false.
+	 */
+	bool isLogged(const EventInfo &eventInfo, DBTablesAction &dbAction);
+
+	/**
+	 * Write the queued changes and wait for the commit.
+	 */
+	void flush(void);
+
+	void getStat(Stat &stat);
+
+protected:
+	ActionLogWriter(void);
+	virtual ~ActionLogWriter();
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> m_impl;
+};
+
+#endif // ActionLogWriter_h
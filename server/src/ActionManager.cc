@@ -21,6 +21,7 @@
 #include <deque>
 #include <errno.h>
 #include "ActionManager.h"
+#include "ActionLogWriter.h"
 #include "ActorCollector.h"
 #include "DBTablesAction.h"
 #include "DBTablesMonitoring.h"
@@ -102,6 +103,17 @@ struct ResidentInfo :
 	ResidentNotifyQueue notifyQueue; // should be used with queueLock.
 	ResidentStatus      status;      // should be used with queueLock.
 
+	// The first 'numInFlight' elements of notifyQueue have been sent to
+	// hatohol-resident-yard and are waiting for the acks.
+	// An ack is being pulled when this is not zero.
+	// This should be used with queueLock.
+	size_t              numInFlight;
+	const size_t        notifyWindow;
+
+	// This keeps the order of the notifications sent from different
+	// threads the same as notifyQueue.
+	Mutex               sendLock;
+
 	NamedPipe pipeRd, pipeWr;
 	string pipeName;
 	string modulePath;
@@ -113,6 +125,9 @@ struct ResidentInfo :
 	  pid(0),
 	  inRunningResidentMap(false),
 	  status(RESIDENT_STAT_INIT),
+	  numInFlight(0),
+	  notifyWindow(
+	    ConfigManager::getInstance()->getResidentNotifyWindow()),
 	  pipeRd(NamedPipe::END_TYPE_MASTER_READ),
 	  pipeWr(NamedPipe::END_TYPE_MASTER_WRITE)
 	{
@@ -188,16 +203,31 @@ struct ResidentInfo :
 		queueLock.unlock();
 	}
 
-	void deleteFrontNotifyInfo(void)
+	/**
+	 * Delete the acked notification at the front of notifyQueue.
+	 *
+	 * @return
+	 * The next notification waiting for an ack or NULL if there's none.
+	 * In the latter case, the status is changed to RESIDENT_STAT_IDLE.
+	 */
+	ActionManager::ResidentNotifyInfo *deleteFrontNotifyInfo(void)
 	{
+		ActionManager::ResidentNotifyInfo *nextInfo = NULL;
 		queueLock.lock();
 		HATOHOL_ASSERT(!notifyQueue.empty(), "Queue is empty.");
+		HATOHOL_ASSERT(numInFlight > 0, "No notification in flight.");
 		ActionManager::ResidentNotifyInfo *notifyInfo
 		   = notifyQueue.front();
 		notifyQueue.pop_front();
+		numInFlight--;
+		if (numInFlight > 0)
+			nextInfo = notifyQueue.front();
+		else
+			status = RESIDENT_STAT_IDLE;
 		queueLock.unlock();
 
 		delete notifyInfo;
+		return nextInfo;
 	}
 };
 
@@ -370,9 +400,9 @@ protected:
 		WaitingCommandActionInfo *waitCmdInfo =
 		  new WaitingCommandActionInfo();
 		waitCmdInfo->logId =
-		   dbAction.createActionLog(actionDef, eventInfo,
-		                            ACTLOG_EXECFAIL_NONE,
-		                            ACTLOG_STAT_QUEUING);
+		   ActionLogWriter::getInstance().createActionLog(
+		     actionDef, eventInfo,
+		     ACTLOG_EXECFAIL_NONE, ACTLOG_STAT_QUEUING);
 		waitCmdInfo->actionDef = actionDef;
 		waitCmdInfo->eventInfo = eventInfo;
 		waitCmdInfo->argVect   = argVect;
@@ -485,6 +515,7 @@ void ActionManager::reset(void)
 	ResidentInfo::runningResidentMap.clear();
 
 	CommandActionContext::reset();
+	ActionLogWriter::reset();
 }
 
 ActionManager::ActionManager(void)
@@ -583,11 +614,8 @@ bool ActionManager::shouldSkipByTime(const EventInfo &eventInfo)
 bool ActionManager::shouldSkipByLog(const EventInfo &eventInfo,
                                     DBTablesAction &dbAction)
 {
-	ActionLog actionLog;
-	bool found;
-	found = dbAction.getLog(actionLog, eventInfo.serverId, eventInfo.id);
 	// TODO: We shouldn't skip if status is ACTLOG_STAT_QUEUING.
-	return found;
+	return ActionLogWriter::getInstance().isLogged(eventInfo, dbAction);
 }
 
 static bool checkActionOwner(const ActionDef &actionDef)
@@ -660,16 +688,15 @@ struct ActionManager::ActorProfile : public ActorCollector::Profile {
 		  (actionDef.type == ACTION_COMMAND) ?
 		    ACTLOG_STAT_STARTED : ACTLOG_STAT_LAUNCHING_RESIDENT;
 
-		ThreadLocalDBCache cache;
-		DBTablesAction &dbAction = cache.getAction();
+		ActionLogWriter &logWriter = ActionLogWriter::getInstance();
 		if (waitCmdInfo) {
 			// A waiting command action has the log ID.
 			// So we simply update the status.
-			dbAction.updateLogStatusToStart(waitCmdInfo->logId);
+			logWriter.updateLogStatusToStart(waitCmdInfo->logId);
 			actorInfo->logId = waitCmdInfo->logId;
 		} else {
 			actorInfo->logId =
-			  dbAction.createActionLog(
+			  logWriter.createActionLog(
 			    actionDef, eventInfo,
 			    ACTLOG_EXECFAIL_NONE, initialStatus);
 		}
@@ -874,7 +901,7 @@ void ActionManager::execResidentAction(const ActionDef &actionDef,
 		   new ResidentNotifyInfo(residentInfo);
 		notifyInfo->eventInfo = eventInfo; // just copy
 		notifyInfo->logId =
-		   dbAction.createActionLog(
+		   ActionLogWriter::getInstance().createActionLog(
 		     actionDef, eventInfo, ACTLOG_EXECFAIL_NONE,
 		     ACTLOG_STAT_RESIDENT_QUEUING);
 
@@ -1072,14 +1099,18 @@ void ActionManager::gotNotifyEventAckCb(GIOStatus stat, SmartBuffer &sbuf,
 	logArg.status = ACTLOG_STAT_SUCCEEDED,
 	logArg.exitCode = resultCode;
 
-	ThreadLocalDBCache cache;
-	cache.getAction().logEndExecAction(logArg);
+	ActionLogWriter::getInstance().logEndExecAction(logArg);
 
-	// remove the notifyInfo 
-	residentInfo->deleteFrontNotifyInfo();
+	// remove the notifyInfo and wait for the ack of the next one
+	// if it has already been sent.
+	ResidentNotifyInfo *nextInfo = residentInfo->deleteFrontNotifyInfo();
+	if (nextInfo) {
+		residentInfo->setPullCallbackArg(nextInfo);
+		residentInfo->pullData(RESIDENT_PROTO_EVENT_ACK_PKT_LEN,
+		                       gotNotifyEventAckCb);
+	}
 
-	// send the next notificaiton if it exists
-	residentInfo->setStatus(RESIDENT_STAT_IDLE);
+	// send the next notificaitons if they exist
 	obj->tryNotifyEvent(residentInfo);
 }
 
@@ -1120,8 +1151,7 @@ gboolean ActionManager::commandActionTimeoutCb(gpointer data)
 	logArg.status = ACTLOG_STAT_FAILED;
 	logArg.failureCode = ACTLOG_EXECFAIL_KILLED_TIMEOUT;
 	logArg.exitCode = 0;
-	ThreadLocalDBCache cache;
-	cache.getAction().logEndExecAction(logArg);
+	ActionLogWriter::getInstance().logEndExecAction(logArg);
 	ActorCollector::setDontLog(actorInfo->pid);
 	kill(actorInfo->pid, SIGKILL);
 	actorInfo->timerTag = INVALID_EVENT_ID;
@@ -1256,48 +1286,81 @@ ResidentInfo *ActionManager::launchResidentActionYard
  */
 void ActionManager::tryNotifyEvent(ResidentInfo *residentInfo)
 {
+	vector<ResidentNotifyInfo *> notifyInfoVect;
+	AutoMutex autoSendLock(&residentInfo->sendLock);
 	residentInfo->queueLock.lock();
-	ResidentNotifyInfo *notifyInfo = NULL;
-	if (residentInfo->status != RESIDENT_STAT_IDLE) {
+	if (residentInfo->status != RESIDENT_STAT_IDLE &&
+	    residentInfo->status != RESIDENT_STAT_WAIT_NOTIFY_ACK) {
 		residentInfo->queueLock.unlock();
 		return;
 	}
-	if (!residentInfo->notifyQueue.empty()) {
-		notifyInfo = residentInfo->notifyQueue.front();
-		residentInfo->status = RESIDENT_STAT_WAIT_NOTIFY_ACK;
+	ResidentNotifyQueue &notifyQueue = residentInfo->notifyQueue;
+	const size_t &numInFlight = residentInfo->numInFlight;
+	for (size_t idx = numInFlight;
+	     idx < notifyQueue.size() &&
+	     notifyInfoVect.size() + numInFlight < residentInfo->notifyWindow;
+	     idx++) {
+		notifyInfoVect.push_back(notifyQueue[idx]);
+	}
+	if (notifyInfoVect.empty()) {
+		residentInfo->queueLock.unlock();
+		return;
 	}
+	const bool shouldPullAck = (numInFlight == 0);
+	residentInfo->numInFlight += notifyInfoVect.size();
+	residentInfo->status = RESIDENT_STAT_WAIT_NOTIFY_ACK;
 	residentInfo->queueLock.unlock();
-	if (notifyInfo)
-		notifyEvent(residentInfo, notifyInfo);
+
+	// No ack is being pulled when nothing is in flight. The ack of the
+	// first notification is pulled here. The following ones are pulled
+	// in gotNotifyEventAckCb().
+	if (shouldPullAck) {
+		residentInfo->setPullCallbackArg(notifyInfoVect[0]);
+		residentInfo->pullData(RESIDENT_PROTO_EVENT_ACK_PKT_LEN,
+		                       gotNotifyEventAckCb);
+	}
+	notifyEvents(residentInfo, notifyInfoVect);
 }
 
 /*
  * executed on the following thread(s)
  * - Threads that call checkEvents()
- *     [from notifyEvent()]
+ *     [from tryNotifyEvent()]
  * - The default GLIB event dispacther thread (main)
- *     [from notifyEvent()]
+ *     [from tryNotifyEvent()]
  */
-void ActionManager::notifyEvent(ResidentInfo *residentInfo,
-                                ResidentNotifyInfo *notifyInfo)
+void ActionManager::notifyEvents(
+  ResidentInfo *residentInfo,
+  const vector<ResidentNotifyInfo *> &notifyInfoVect)
 {
+	// The action logs are updated before sending the notifications.
+	// Otherwise the update might overwrite the result written in
+	// gotNotifyEventAckCb().
+	ActionLogWriter &logWriter = ActionLogWriter::getInstance();
+	for (size_t i = 0; i < notifyInfoVect.size(); i++) {
+		const ResidentNotifyInfo *notifyInfo = notifyInfoVect[i];
+		HATOHOL_ASSERT(notifyInfo->logId != INVALID_ACTION_LOG_ID,
+		               "An action log ID is not set.");
+		logWriter.updateLogStatusToStart(notifyInfo->logId);
+	}
+
+	const ActionIdType &actionId = residentInfo->actionDef.id;
 	ResidentCommunicator comm;
-	comm.setNotifyEventBody(residentInfo->actionDef.id,
-	                        notifyInfo->eventInfo,
-	                        notifyInfo->sessionId);
+	if (notifyInfoVect.size() == 1) {
+		const ResidentNotifyInfo *notifyInfo = notifyInfoVect[0];
+		comm.setNotifyEventBody(actionId, notifyInfo->eventInfo,
+		                        notifyInfo->sessionId);
+	} else {
+		comm.setNotifyEventBatchHeader();
+		for (size_t i = 0; i < notifyInfoVect.size(); i++) {
+			const ResidentNotifyInfo *notifyInfo =
+			  notifyInfoVect[i];
+			comm.addNotifyEventToBatch(actionId,
+			                           notifyInfo->eventInfo,
+			                           notifyInfo->sessionId);
+		}
+	}
 	comm.push(residentInfo->pipeWr);
-
-	// wait for result code
-	residentInfo->setPullCallbackArg(notifyInfo);
-	residentInfo->pullData(RESIDENT_PROTO_HEADER_LEN +
-	                       RESIDENT_PROTO_EVENT_ACK_CODE_LEN,
-	                       gotNotifyEventAckCb);
-
-	// create or update an action log
-	HATOHOL_ASSERT(notifyInfo->logId != INVALID_ACTION_LOG_ID,
-	               "An action log ID is not set.");
-	ThreadLocalDBCache cache;
-	cache.getAction().updateLogStatusToStart(notifyInfo->logId);
 }
 
 /*
@@ -1312,12 +1375,11 @@ static void onIncidentSenderJobStatusChanged(
 	  = static_cast<DBTablesAction::LogEndExecActionArg *>(userData);
 	bool completed = false;
 
-	ThreadLocalDBCache cache;
-	DBTablesAction &dbAction = cache.getAction();
+	ActionLogWriter &logWriter = ActionLogWriter::getInstance();
 	switch (status) {
 	case IncidentSender::JOB_STARTED:
 	{
-		dbAction.updateLogStatusToStart(logArg->logId);
+		logWriter.updateLogStatusToStart(logArg->logId);
 		break;
 	}
 	case IncidentSender::JOB_SUCCEEDED:
@@ -1335,7 +1397,7 @@ static void onIncidentSenderJobStatusChanged(
 	}
 
 	if (completed) {
-		dbAction.logEndExecAction(*logArg);
+		logWriter.logEndExecAction(*logArg);
 		delete logArg;
 	}
 }
@@ -1363,9 +1425,9 @@ void ActionManager::execIncidentSenderAction(const ActionDef &actionDef,
 	  = IncidentSenderManager::getInstance();
 	DBTablesAction::LogEndExecActionArg *logArg
 	  = new DBTablesAction::LogEndExecActionArg();
-	logArg->logId = dbAction.createActionLog(actionDef, eventInfo,
-						 ACTLOG_EXECFAIL_NONE,
-						 ACTLOG_STAT_QUEUING);
+	logArg->logId =
+	  ActionLogWriter::getInstance().createActionLog(
+	    actionDef, eventInfo, ACTLOG_EXECFAIL_NONE, ACTLOG_STAT_QUEUING);
 	senderManager.queue(trackerId, eventInfo,
 			    onIncidentSenderJobStatusChanged, logArg);
 }
@@ -1493,8 +1555,7 @@ void ActionManager::closeResident(ResidentNotifyInfo *notifyInfo,
 	logArg.status = ACTLOG_STAT_FAILED;
 	logArg.failureCode = failureCode;
 	logArg.exitCode = 0;
-	ThreadLocalDBCache cache;
-	cache.getAction().logEndExecAction(logArg);
+	ActionLogWriter::getInstance().logEndExecAction(logArg);
 
 	// remove this notifyInfo from the queue in the parent ResidentInfo
 	ResidentInfo *residentInfo = notifyInfo->residentInfo;
@@ -1522,9 +1583,10 @@ void ActionManager::postProcSpawnFailure(
 	ActionLogExecFailureCode failureCode =
 	  error->code == G_SPAWN_ERROR_NOENT ?
 	    ACTLOG_EXECFAIL_ENTRY_NOT_FOUND : ACTLOG_EXECFAIL_EXEC_FAILURE;
+	ActionLogWriter &logWriter = ActionLogWriter::getInstance();
 	if (!logUpdateFlag) {
 		actorInfo->logId =
-		  dbAction.createActionLog(actionDef, eventInfo, failureCode);
+		  logWriter.createActionLog(actionDef, eventInfo, failureCode);
 	} else {
 		actorInfo->logId = *logId;
 		DBTablesAction::LogEndExecActionArg logArg;
@@ -1532,7 +1594,7 @@ void ActionManager::postProcSpawnFailure(
 		logArg.status = ACTLOG_STAT_FAILED;
 		logArg.failureCode = failureCode;
 		logArg.nullFlags = ACTLOG_FLAG_EXIT_CODE;
-		dbAction.logEndExecAction(logArg);
+		logWriter.logEndExecAction(logArg);
 	}
 
 	// MLPL log
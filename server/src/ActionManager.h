@@ -21,6 +21,7 @@
 #define ActionManager_h
 
 #include <memory>
+#include <vector>
 #include "Params.h"
 #include "SmartBuffer.h"
 #include "DBTablesAction.h"
@@ -194,28 +195,30 @@ protected:
 	                                       DBTablesAction &dbAction,
 	                                       ActorInfo *actorInfoCopy);
 	/**
-	 * notify hatohol-resident-yard of an event only when it is idle and
-	 * there is at least one element in residentInfo->notifyQueue.
-	 * Othewise the request is processed later.
+	 * notify hatohol-resident-yard of the events in
+	 * residentInfo->notifyQueue that haven't been sent yet.
+	 * The number of events without an ack is limited by
+	 * ConfigManager::getResidentNotifyWindow(). The rest of the events
+	 * are sent when the acks are received.
 	 *
 	 * @param residentInfo A residentInfo instance.
 	 */
 	void tryNotifyEvent(ResidentInfo *residentInfo);
 
 	/**
-	 * notify hatohol-resident-yard of an event at the top of notifyQueue.
+	 * notify hatohol-resident-yard of events in a single packet.
 	 * NOTE: This function is assumed to be called only from
 	 * tryNotifyEvent().
 	 *
 	 * @param residentInfo A residentInfo instance.
 	 *
-	 * @param notifyInfo.
-	 * A ResidentNotifyInfo instance. If the member: logId is
-	 * INVALID_ACTION_LOG_ID, the new log record is created.
-	 * Otherwise the record with it will be updated.
+	 * @param notifyInfoVect
+	 * ResidentNotifyInfo instances in the order of notifyQueue.
+	 * The member: logId of them has to be set.
 	 */
-	void notifyEvent(ResidentInfo *residentInfo,
-	                 ResidentNotifyInfo *notifyInfo);
+	void notifyEvents(
+	  ResidentInfo *residentInfo,
+	  const std::vector<ResidentNotifyInfo *> &notifyInfoVect);
 
 	void execIncidentSenderAction(const ActionDef &actionDef,
 				      const EventInfo &eventInfo,
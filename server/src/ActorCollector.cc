@@ -30,7 +30,7 @@
 #include "SessionManager.h"
 #include "Reaper.h"
 #include "ChildProcessManager.h"
-#include "ThreadLocalDBCache.h"
+#include "ActionLogWriter.h"
 using namespace std;
 using namespace mlpl;
 
@@ -253,8 +253,7 @@ void ActorCollector::postCollectedProc(ActorContext &actorCtx)
 	// log the action result if needed
 	if (!actorInfo->dontLog) {
 		logArg.logId = actorInfo->logId;
-		ThreadLocalDBCache cache;
-		cache.getAction().logEndExecAction(logArg);
+		ActionLogWriter::getInstance().logEndExecAction(logArg);
 	}
 
 	// execute the callback function without the lock
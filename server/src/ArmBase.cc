@@ -23,8 +23,10 @@
 #include <queue>
 #include <Logger.h>
 #include <AtomicValue.h>
+#include <SmartTime.h>
 #include "ArmUtils.h"
 #include "ArmBase.h"
+#include "ArmPollingScheduler.h"
 #include "HatoholException.h"
 #include "DBTablesMonitoring.h"
 #include "UnifiedDataStore.h"
@@ -33,6 +35,10 @@
 using namespace std;
 using namespace mlpl;
 
+// A waiter for a polling slot is usually woken up by the scheduler.
+// This is a safeguard not to miss the wakeup forever.
+static const size_t SLOT_WAIT_TIMEOUT_MSEC = 1000;
+
 typedef enum {
 	UPDATE_POLLING,
 	UPDATE_ITEM_REQUEST,
@@ -124,7 +130,7 @@ struct ArmBase::Impl
 	string               name;
 	MonitoringServerInfo serverInfo; // we have the copy.
 	ArmUtils             utils;
-	timespec             lastPollingTime;
+	SmartTime            nextPollingTime;
 	sem_t                sleepSemaphore;
 	AtomicValue<bool>    exitRequest;
 	bool                 isCopyOnDemandEnabled;
@@ -148,8 +154,6 @@ struct ArmBase::Impl
 		static const int PSHARED = 1;
 		HATOHOL_ASSERT(sem_init(&sleepSemaphore, PSHARED, 0) == 0,
 		             "Failed to sem_init(): %d\n", errno);
-		lastPollingTime.tv_sec = 0;
-		lastPollingTime.tv_nsec = 0;
 	}
 
 	virtual ~Impl()
@@ -159,38 +163,40 @@ struct ArmBase::Impl
 			MLPL_ERR("Failed to call sem_destroy(): %d\n", errno);
 	}
 
-	void stampLastPollingTime(void)
+	void schedulePolling(const size_t &delayMSec)
 	{
-		int result = clock_gettime(CLOCK_REALTIME,
-					   &lastPollingTime);
-		if (result == 0) {
-			MLPL_DBG("lastPollingTime: %ld\n",
-				 lastPollingTime.tv_sec);
-		} else {
-			MLPL_ERR("Failed to call clock_gettime: %d\n",
-				 errno);
-			lastPollingTime.tv_sec = 0;
-			lastPollingTime.tv_nsec = 0;
-		}
+		const timespec delay = {
+		  static_cast<time_t>(delayMSec / 1000),
+		  static_cast<long>(delayMSec % 1000) * 1000 * 1000};
+		nextPollingTime = SmartTime::getCurrTime();
+		nextPollingTime += delay;
+		MLPL_DBG("nextPollingTime: %ld\n",
+		         nextPollingTime.getAsTimespec().tv_sec);
 	}
 
-	int getSecondsToNextPolling(void)
+	bool isPollingDue(void)
 	{
-		time_t interval = serverInfo.pollingIntervalSec;
-		timespec currentTime;
-
-		int result = clock_gettime(CLOCK_REALTIME, &currentTime);
-		if (result == 0 && lastPollingTime.tv_sec != 0) {
-			time_t elapsed
-			  = currentTime.tv_sec - lastPollingTime.tv_sec;
-			if (elapsed < interval)
-				interval -= elapsed;
-		}
-
-		if (interval <= 0 || interval > serverInfo.pollingIntervalSec)
-			interval = serverInfo.pollingIntervalSec;
+		return SmartTime::getCurrTime() >= nextPollingTime;
+	}
 
-		return interval;
+	/**
+	 * Wait for a post of sleepSemaphore until the specified time.
+	 *
+	 * @param until An absolute time in CLOCK_REALTIME.
+	 */
+	void waitUntil(const SmartTime &until)
+	{
+	retry:
+		int result = sem_timedwait(&sleepSemaphore,
+		                           &until.getAsTimespec());
+		if (result == -1) {
+			if (errno == ETIMEDOUT)
+				; // This is normal case
+			else if (errno == EINTR)
+				goto retry;
+			else
+				MLPL_ERR("sem_timedwait(): errno: %d\n", errno);
+		}
 	}
 
 	void pushJob(FetcherJob *job)
@@ -427,13 +433,45 @@ void ArmBase::setServerConnectStatus(const ArmPollingResult &type)
 	m_impl->utils.updateTriggerStatus(type, status);
 }
 
+struct PollingSlot {
+	const string &backend;
+
+	PollingSlot(const string &_backend)
+	: backend(_backend)
+	{
+	}
+
+	virtual ~PollingSlot()
+	{
+		ArmPollingScheduler::getInstance().release(backend);
+	}
+};
+
 gpointer ArmBase::mainThread(HatoholThreadArg *arg)
 {
+	ArmPollingScheduler &scheduler = ArmPollingScheduler::getInstance();
+	// Spread the first pollings of the arms over the polling interval.
+	m_impl->schedulePolling(
+	  scheduler.getInitialDelayMSec(getPollingInterval()));
+
 	ArmWorkingStatus previousArmWorkStatus = ARM_WORK_STAT_INIT;
 	while (!hasExitRequest()) {
 		FetcherJob *job = m_impl->popJob();
 		UpdateType updateType = job ? job->updateType : UPDATE_POLLING;
-		int sleepTime = m_impl->getSecondsToNextPolling();
+		if (!job && !m_impl->isPollingDue()) {
+			m_impl->waitUntil(m_impl->nextPollingTime);
+			continue;
+		}
+		if (!job && !scheduler.tryAcquire(getName(),
+		                                  &m_impl->sleepSemaphore)) {
+			SmartTime until = SmartTime::getCurrTime();
+			const timespec timeout = {
+			  SLOT_WAIT_TIMEOUT_MSEC / 1000,
+			  (SLOT_WAIT_TIMEOUT_MSEC % 1000) * 1000 * 1000};
+			until += timeout;
+			m_impl->waitUntil(until);
+			continue;
+		}
 
 		ArmPollingResult armPollingResult;
 		if (updateType == UPDATE_ITEM_REQUEST) {
@@ -455,6 +493,7 @@ gpointer ArmBase::mainThread(HatoholThreadArg *arg)
 			armPollingResult = mainThreadOneProcFetchTriggers();
 			job->run(updateType);
 		} else {
+			PollingSlot slot(getName());
 			armPollingResult = mainThreadOneProc();
 		}
 		delete job;
@@ -462,8 +501,19 @@ gpointer ArmBase::mainThread(HatoholThreadArg *arg)
 		if (armPollingResult == COLLECT_OK) {
 			m_impl->armStatus.logSuccess();
 			m_impl->lastFailureStatus = ARM_WORK_STAT_OK;
+			if (updateType == UPDATE_POLLING) {
+				m_impl->schedulePolling(
+				  getPollingInterval() * 1000);
+			}
 		} else {
-			sleepTime = getRetryInterval();
+			// The retries of the arms that failed at the same time
+			// (e.g. by a network trouble) are also spread. A failed
+			// on-demand job doesn't change the polling schedule.
+			if (updateType == UPDATE_POLLING) {
+				m_impl->schedulePolling(
+				  scheduler.getRetryDelayMSec(
+				    getRetryInterval()));
+			}
 			m_impl->armStatus.logFailure(m_impl->lastFailureComment,
 			                            m_impl->lastFailureStatus);
 			m_impl->lastFailureComment.clear();
@@ -479,14 +529,8 @@ gpointer ArmBase::mainThread(HatoholThreadArg *arg)
 				setServerConnectStatus(armPollingResult);
 		}
 		previousArmWorkStatus = m_impl->lastFailureStatus;
-
-		if (updateType == UPDATE_POLLING)
-			m_impl->stampLastPollingTime();
-
-		if (hasExitRequest())
-			break;
-		sleepInterruptible(sleepTime);
 	}
+	scheduler.cancelWait(&m_impl->sleepSemaphore);
 	return NULL;
 }
 
@@ -27,6 +27,7 @@
 #include "SQLUtils.h"
 #include "HatoholException.h"
 #include "ThreadLocalDBCache.h"
+#include "DBTablesLastInfo.h"
 using namespace std;
 using namespace mlpl;
 
@@ -38,6 +39,16 @@ static const char *TABLE_NAME_HOSTGROUPS    = "nagios_hostgroups";
 static const char *TABLE_NAME_HOSTGROUP_MEMBERS = "nagios_hostgroup_members";
 static const char *TABLE_NAME_OBJECTS       = "nagios_objects";
 
+// The maximum number of rows read by one query.
+static const size_t MAX_ROWS_PER_QUERY = 1000;
+
+// The maximum number of queries for the events in one polling.
+// The rest is read in the next polling.
+static const size_t MAX_EVENT_QUERIES_PER_POLLING = 10;
+
+// All triggers are read at this interval to invalidate removed services.
+static const time_t FULL_TRIGGER_SCAN_INTERVAL_SEC = 600;
+
 enum
 {
 	STATE_OK       = 0,
@@ -457,6 +468,14 @@ struct ArmNagiosNDOUtils::Impl
 	map<int, string>     hostMap;
 	map<int, string>     hostgroupMap;
 
+	// Cursors of the incremental polling. They are saved in
+	// DBTablesLastInfo so that only the rows changed after them are
+	// read even after a restart.
+	bool                 cursorsLoaded;
+	time_t               triggerCursor; // servicestatus.status_update_time
+	uint64_t             eventCursor;   // statehistory.statehistory_id
+	time_t               lastFullTriggerScanTime;
+
 	// methods
 	Impl(const MonitoringServerInfo &_serverInfo)
 	: dbAgent(NULL),
@@ -468,7 +487,11 @@ struct ArmNagiosNDOUtils::Impl
 	  selectHostgroupMembersArg(tableProfileHostgroupMembers),
 	  dataStore(NULL),
 	  serverInfo(_serverInfo),
-	  hostInfoCache(&_serverInfo.id)
+	  hostInfoCache(&_serverInfo.id),
+	  cursorsLoaded(false),
+	  triggerCursor(0),
+	  eventCursor(0),
+	  lastFullTriggerScanTime(0)
 	{
 		dataStore = UnifiedDataStore::getInstance();
 	}
@@ -499,6 +522,74 @@ struct ArmNagiosNDOUtils::Impl
 		  serverInfo.id, hostIdInServer.c_str());
 		return INVALID_HOST_ID;
 	}
+
+	void loadCursors(void)
+	{
+		if (cursorsLoaded)
+			return;
+
+		ThreadLocalDBCache cache;
+		LastInfoQueryOption option(USER_ID_SYSTEM);
+		option.setTargetServerId(serverInfo.id);
+		LastInfoDefList lastInfoList;
+		cache.getLastInfo().getLastInfoList(lastInfoList, option);
+		bool hasTriggerCursor = false;
+		bool hasEventCursor = false;
+		for (const auto &lastInfo : lastInfoList) {
+			if (lastInfo.dataType == LAST_INFO_TRIGGER) {
+				triggerCursor =
+				  StringUtils::toUint64(lastInfo.value);
+				hasTriggerCursor = true;
+			} else if (lastInfo.dataType == LAST_INFO_EVENT) {
+				eventCursor =
+				  StringUtils::toUint64(lastInfo.value);
+				hasEventCursor = true;
+			}
+		}
+
+		// Fall back to the stored data when the cursors have not
+		// been saved yet (e.g. the first run after an upgrade).
+		DBTablesMonitoring &dbMonitoring = cache.getMonitoring();
+		if (!hasTriggerCursor) {
+			triggerCursor =
+			  dbMonitoring.getLastChangeTimeOfTrigger(serverInfo.id);
+		}
+		if (!hasEventCursor) {
+			const EventIdType lastEventId =
+			  dbMonitoring.getMaxEventId(serverInfo.id);
+			if (lastEventId != EVENT_NOT_FOUND) {
+				if (!StringUtils::isNumber(lastEventId)) {
+					THROW_HATOHOL_EXCEPTION(
+					  "Unexpected event ID: %s\n",
+					  lastEventId.c_str());
+				}
+				eventCursor = StringUtils::toUint64(lastEventId);
+			}
+		}
+		cursorsLoaded = true;
+	}
+
+	void saveCursor(const LastInfoType &type, const uint64_t &value)
+	{
+		ThreadLocalDBCache cache;
+		OperationPrivilege privilege(USER_ID_SYSTEM);
+		LastInfoDef lastInfo;
+		lastInfo.id = AUTO_INCREMENT_VALUE;
+		lastInfo.dataType = type;
+		lastInfo.value = StringUtils::toString(value);
+		lastInfo.serverId = serverInfo.id;
+		cache.getLastInfo().upsertLastInfo(lastInfo, privilege);
+	}
+
+	bool shouldScanAllTriggers(const bool &hostsChanged)
+	{
+		// Services of new hosts may have an older update time than
+		// the cursor. So all triggers are read in that case.
+		if (hostsChanged || !lastFullTriggerScanTime)
+			return true;
+		return time(NULL) - lastFullTriggerScanTime >=
+		         FULL_TRIGGER_SCAN_INTERVAL_SEC;
+	}
 };
 
 // ---------------------------------------------------------------------------
@@ -550,6 +641,15 @@ void ArmNagiosNDOUtils::makeSelectTriggerBuilder(void)
 	m_impl->selectTriggerBaseCondition = StringUtils::sprintf(
 	  "%s>=",
 	  tableProfileServiceStatus.getFullColumnName(IDX_SERVICESTATUS_STATUS_UPDATE_TIME).c_str());
+
+	// The rows are read in the order of the index of status_update_time
+	// so that the last row of a page can be the key of the next page.
+	DBAgent::SelectExArg &arg = builder.getSelectExArg();
+	arg.orderBy = StringUtils::sprintf(
+	  "%s,%s",
+	  tableProfileServiceStatus.getFullColumnName(IDX_SERVICESTATUS_STATUS_UPDATE_TIME).c_str(),
+	  tableProfileServiceStatus.getFullColumnName(IDX_SERVICESTATUS_SERVICE_OBJECT_ID).c_str());
+	arg.limit = MAX_ROWS_PER_QUERY;
 }
 
 void ArmNagiosNDOUtils::makeSelectEventBuilder(void)
@@ -574,10 +674,15 @@ void ArmNagiosNDOUtils::makeSelectEventBuilder(void)
 
 	// contiditon
 	m_impl->selectEventBaseCondition = StringUtils::sprintf(
-	  "%s=%d and %s>=",
+	  "%s=%d and %s>",
 	  tableProfileStateHistory.getFullColumnName(IDX_STATEHISTORY_STATE_TYPE).c_str(),
 	  HARD_STATE,
 	  tableProfileStateHistory.getFullColumnName(IDX_STATEHISTORY_STATEHISTORY_ID).c_str());
+
+	DBAgent::SelectExArg &arg = builder.getSelectExArg();
+	arg.orderBy =
+	  tableProfileStateHistory.getFullColumnName(IDX_STATEHISTORY_STATEHISTORY_ID);
+	arg.limit = MAX_ROWS_PER_QUERY;
 }
 
 void ArmNagiosNDOUtils::makeSelectItemBuilder(void)
@@ -625,52 +730,35 @@ void ArmNagiosNDOUtils::makeSelectHostgroupMembersArg(void)
 	arg.add(IDX_HOSTGROUP_MEMBERS_HOSTGROUP_ID);
 }
 
-void ArmNagiosNDOUtils::addConditionForTriggerQuery(const bool &isUpdateTrigger)
+void ArmNagiosNDOUtils::addConditionForTriggerQuery(
+  const time_t &updateTime, const int &lastServiceObjectId)
 {
-	time_t lastUpdateTime;
-	struct tm tm;
-	if (isUpdateTrigger) {
-		ThreadLocalDBCache cache;
-		const MonitoringServerInfo &svInfo = getServerInfo();
-		lastUpdateTime =
-			cache.getMonitoring().getLastChangeTimeOfTrigger(svInfo.id);
-	} else {
-		lastUpdateTime = 0;
-	}
-	localtime_r(&lastUpdateTime, &tm);
-
+	const string timeStr = DBAgent::makeDatetimeString(updateTime);
 	DBAgent::SelectExArg &arg =
 	  m_impl->selectTriggerBuilder.getSelectExArg();
 	arg.condition = m_impl->selectTriggerBaseCondition;
-	arg.condition +=
-	   StringUtils::sprintf("'%04d-%02d-%02d %02d:%02d:%02d'",
-	                        1900+tm.tm_year, tm.tm_mon+1, tm.tm_mday,
-	                        tm.tm_hour, tm.tm_min, tm.tm_sec);
+	arg.condition += timeStr;
+	if (lastServiceObjectId < 0)
+		return;
+
+	// Rows after (updateTime, lastServiceObjectId) in the read order.
+	// The range condition above is kept so that the index is used.
+	arg.condition += StringUtils::sprintf(
+	  " and (%s>%s or %s>%d)",
+	  tableProfileServiceStatus.getFullColumnName(IDX_SERVICESTATUS_STATUS_UPDATE_TIME).c_str(),
+	  timeStr.c_str(),
+	  tableProfileServiceStatus.getFullColumnName(IDX_SERVICESTATUS_SERVICE_OBJECT_ID).c_str(),
+	  lastServiceObjectId);
 }
 
 void ArmNagiosNDOUtils::addConditionForEventQuery(void)
 {
-	ThreadLocalDBCache cache;
-	const MonitoringServerInfo &svInfo = getServerInfo();
-	const EventIdType lastEventId =
-	  cache.getMonitoring().getMaxEventId(svInfo.id);
-	string cond;
 	DBAgent::SelectExArg &arg = m_impl->selectEventBuilder.getSelectExArg();
 	arg.condition = m_impl->selectEventBaseCondition;
-	if (lastEventId == EVENT_NOT_FOUND) {
-		cond = "0";
-	} else {
-		if (!StringUtils::isNumber(lastEventId)) {
-			THROW_HATOHOL_EXCEPTION("Unexpected event ID: %s\n",
-			                        lastEventId.c_str());
-		}
-		const uint64_t eventId = Utils::sum(lastEventId, 1);
-		cond = StringUtils::toString(eventId);
-	}
-	arg.condition += cond;
+	arg.condition += StringUtils::toString(m_impl->eventCursor);
 }
 
-void ArmNagiosNDOUtils::getTriggerInfoTable(TriggerInfoList &triggerInfoList)
+size_t ArmNagiosNDOUtils::getTriggerInfoTable(TriggerInfoList &triggerInfoList)
 {
 	// TODO: should use transaction
 	DBAgent::SelectExArg &arg =
@@ -719,25 +807,56 @@ void ArmNagiosNDOUtils::getTriggerInfoTable(TriggerInfoList &triggerInfoList)
 		trigInfo.validity = TRIGGER_VALID;
 		triggerInfoList.push_back(trigInfo);
 	}
+	return numTriggers;
 }
 
 void ArmNagiosNDOUtils::getTrigger(const bool &isUpdateTrigger)
 {
+	m_impl->loadCursors();
+
+	// The rows updated in the same second as the cursor are read again,
+	// because they may have been written after the previous polling.
 	TriggerInfoList triggerInfoList;
-	addConditionForTriggerQuery(isUpdateTrigger);
-	getTriggerInfoTable(triggerInfoList);
+	time_t updateTime = isUpdateTrigger ? m_impl->triggerCursor : 0;
+	int lastServiceObjectId = -1;
+	while (true) {
+		addConditionForTriggerQuery(updateTime, lastServiceObjectId);
+		if (getTriggerInfoTable(triggerInfoList) < MAX_ROWS_PER_QUERY)
+			break;
+		const TriggerInfo &lastTrigger = triggerInfoList.back();
+		updateTime = lastTrigger.lastChangeTime.tv_sec;
+		lastServiceObjectId = atoi(lastTrigger.id.c_str());
+	}
 
+	ThreadLocalDBCache cache;
 	if (isUpdateTrigger) {
-		ThreadLocalDBCache cache;
 		cache.getMonitoring().addTriggerInfoList(triggerInfoList);
 	} else {
 		const MonitoringServerInfo &svInfo = getServerInfo();
-		ThreadLocalDBCache cache;
 		cache.getMonitoring().updateTrigger(triggerInfoList, svInfo.id);
+		m_impl->lastFullTriggerScanTime = time(NULL);
 	}
+
+	if (triggerInfoList.empty())
+		return;
+	const time_t lastUpdateTime =
+	  triggerInfoList.back().lastChangeTime.tv_sec;
+	if (lastUpdateTime <= m_impl->triggerCursor)
+		return;
+	m_impl->triggerCursor = lastUpdateTime;
+	m_impl->saveCursor(LAST_INFO_TRIGGER, lastUpdateTime);
 }
 
 void ArmNagiosNDOUtils::getEvent(void)
+{
+	m_impl->loadCursors();
+	for (size_t i = 0; i < MAX_EVENT_QUERIES_PER_POLLING; i++) {
+		if (getEventPage() < MAX_ROWS_PER_QUERY)
+			break;
+	}
+}
+
+size_t ArmNagiosNDOUtils::getEventPage(void)
 {
 	addConditionForEventQuery();
 
@@ -750,6 +869,7 @@ void ArmNagiosNDOUtils::getEvent(void)
 	// TODO: use addEventInfoList with the newly added data.
 	const MonitoringServerInfo &svInfo = getServerInfo();
 	EventInfoList eventInfoList;
+	int lastEventId = 0;
 	const ItemGroupList &grpList = arg.dataTable->getItemGroupList();
 	ItemGroupListConstIterator itemGrpItr = grpList.begin();
 	for (; itemGrpItr != grpList.end(); ++itemGrpItr) {
@@ -788,8 +908,16 @@ void ArmNagiosNDOUtils::getEvent(void)
 		  m_impl->getGlobalHostId(eventInfo.hostIdInServer);
 		itemGroupStream >> eventInfo.hostName;    // hosts.display_name
 		eventInfoList.push_back(eventInfo);
+		lastEventId = eventId;
 	}
+	if (eventInfoList.empty())
+		return numEvents;
 	m_impl->dataStore->addEventList(eventInfoList);
+
+	// The rows are sorted by statehistory_id.
+	m_impl->eventCursor = lastEventId;
+	m_impl->saveCursor(LAST_INFO_EVENT, m_impl->eventCursor);
+	return numEvents;
 }
 
 void ArmNagiosNDOUtils::getItem(void)
@@ -991,7 +1119,11 @@ ArmBase::ArmPollingResult ArmNagiosNDOUtils::mainThreadOneProc(void)
 		getHost();
 		getHostgroup();
 		getHostgroupMembers();
-		getTrigger(UnifiedDataStore::getInstance()->wasStoredHostsChanged());
+		// wasStoredHostsChanged() returns false when syncHosts()
+		// in getHost() has stored some changes.
+		const bool hostsChanged =
+		  !UnifiedDataStore::getInstance()->wasStoredHostsChanged();
+		getTrigger(!m_impl->shouldScanAllTriggers(hostsChanged));
 		getEvent();
 		if (!getCopyOnDemandEnabled())
 			getItem();
@@ -40,11 +40,21 @@ protected:
 	void makeSelectHostArg(void);
 	void makeSelectHostgroupArg(void);
 	void makeSelectHostgroupMembersArg(void);
-	void addConditionForTriggerQuery(const bool &isUpdateTrigger);
+	void addConditionForTriggerQuery(const time_t &updateTime,
+	                                 const int &lastServiceObjectId);
 	void addConditionForEventQuery(void);
+	size_t getTriggerInfoTable(TriggerInfoList &triggerInfoList);
+
+	/**
+	 * Read triggers whose status has been updated since the cursor.
+	 *
+	 * @param isUpdateTrigger
+	 * If this is false, all triggers are read and the ones that don't
+	 * exist in the monitoring server are invalidated.
+	 */
 	void getTrigger(const bool &isUpdateTrigger);
-	void getTriggerInfoTable(TriggerInfoList &triggerInfoList);
 	void getEvent(void);
+	size_t getEventPage(void);
 	void getItem(void);
 	void getHost(void);
 	void getHostgroup(void);
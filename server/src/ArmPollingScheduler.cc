@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <list>
+#include <map>
+#include <random>
+#include <Logger.h>
+#include <Mutex.h>
+#include "ArmPollingScheduler.h"
+#include "ConfigManager.h"
+#include "HatoholException.h"
+
+using namespace std;
+using namespace mlpl;
+
+const size_t ArmPollingScheduler::DEFAULT_MAX_RUNNING_POLLINGS = 16;
+const size_t ArmPollingScheduler::RETRY_JITTER_PERCENT = 25;
+
+struct Waiter {
+	string  backend;
+	sem_t  *wakeup;
+	// A slot is reserved for the waiter until it tries again.
+	bool    woken;
+};
+
+struct ArmPollingScheduler::Impl
+{
+	static ArmPollingScheduler instance;
+
+	Mutex                lock;
+	bool                 configLoaded;
+	size_t               maxRunning;
+	map<string, size_t>  maxRunningMap;
+	size_t               numRunning;
+	map<string, size_t>  numRunningMap;
+	// The slots reserved for the woken waiters.
+	size_t               numReserved;
+	map<string, size_t>  numReservedMap;
+	list<Waiter>         waiters;
+	mt19937              random;
+	Stat                 stat;
+
+	Impl(void)
+	: configLoaded(false),
+	  maxRunning(DEFAULT_MAX_RUNNING_POLLINGS),
+	  numRunning(0),
+	  numReserved(0),
+	  random(random_device()())
+	{
+	}
+
+	// Called with the lock.
+	void loadConfigIfNeeded(void)
+	{
+		if (configLoaded)
+			return;
+		configLoaded = true;
+		ConfigManager *configMgr = ConfigManager::getInstance();
+		const int num = configMgr->getArmPollingNumWorkers();
+		if (num > 0)
+			maxRunning = num;
+		MLPL_INFO("Max running pollings: %zd\n", maxRunning);
+	}
+
+	// Called with the lock.
+	size_t getBackendLimit(const string &backend)
+	{
+		map<string, size_t>::const_iterator it =
+		  maxRunningMap.find(backend);
+		if (it != maxRunningMap.end())
+			return it->second;
+		ConfigManager *configMgr = ConfigManager::getInstance();
+		const int num = configMgr->getArmPollingMaxRunning(backend);
+		const size_t limit = (num > 0) ? num : 0;
+		maxRunningMap[backend] = limit;
+		return limit;
+	}
+
+	// Called with the lock.
+	bool hasFreeSlot(const string &backend)
+	{
+		if (numRunning + numReserved >= maxRunning)
+			return false;
+		const size_t limit = getBackendLimit(backend);
+		return limit == 0 ||
+		       numRunningMap[backend] + numReservedMap[backend] < limit;
+	}
+
+	// Called with the lock.
+	void unreserve(Waiter &waiter)
+	{
+		if (!waiter.woken)
+			return;
+		waiter.woken = false;
+		numReserved--;
+		numReservedMap[waiter.backend]--;
+	}
+
+	// Called with the lock.
+	list<Waiter>::iterator findWaiter(sem_t *wakeup)
+	{
+		list<Waiter>::iterator it = waiters.begin();
+		for (; it != waiters.end(); ++it) {
+			if (it->wakeup == wakeup)
+				break;
+		}
+		return it;
+	}
+
+	// Called with the lock.
+	void removeWaiter(sem_t *wakeup)
+	{
+		list<Waiter>::iterator it = findWaiter(wakeup);
+		if (it == waiters.end())
+			return;
+		unreserve(*it);
+		waiters.erase(it);
+	}
+
+	// Called with the lock.
+	void wakeupWaiters(void)
+	{
+		// Wake up the waiters that can run in the order of the
+		// waiting. A slot is reserved for each woken waiter, so that
+		// an arm that comes later can't take it before the waiter
+		// tries again.
+		list<Waiter>::iterator it = waiters.begin();
+		for (; it != waiters.end(); ++it) {
+			if (numRunning + numReserved >= maxRunning)
+				break;
+			if (it->woken || !hasFreeSlot(it->backend))
+				continue;
+			if (sem_post(it->wakeup) == -1)
+				MLPL_ERR("Failed to call sem_post: %d\n", errno);
+			it->woken = true;
+			numReserved++;
+			numReservedMap[it->backend]++;
+		}
+	}
+};
+
+ArmPollingScheduler ArmPollingScheduler::Impl::instance;
+
+// ---------------------------------------------------------------------------
+// Stat
+// ---------------------------------------------------------------------------
+ArmPollingScheduler::Stat::Stat(void)
+: numPollings(0),
+  numDelayedPollings(0),
+  numRunning(0),
+  maxNumRunning(0)
+{
+}
+
+// ---------------------------------------------------------------------------
+// Public methods
+// ---------------------------------------------------------------------------
+ArmPollingScheduler &ArmPollingScheduler::getInstance(void)
+{
+	return Impl::instance;
+}
+
+void ArmPollingScheduler::reset(void)
+{
+	Impl *impl = Impl::instance.m_impl.get();
+	AutoMutex autoMutex(&impl->lock);
+	impl->configLoaded = false;
+	impl->maxRunning = DEFAULT_MAX_RUNNING_POLLINGS;
+	impl->maxRunningMap.clear();
+	impl->stat = Stat();
+	impl->stat.numRunning = impl->numRunning;
+}
+
+size_t ArmPollingScheduler::getInitialDelayMSec(const int &intervalSec)
+{
+	if (intervalSec <= 0)
+		return 0;
+	uniform_int_distribution<size_t> dist(0, intervalSec * 1000 - 1);
+	AutoMutex autoMutex(&m_impl->lock);
+	return dist(m_impl->random);
+}
+
+size_t ArmPollingScheduler::getRetryDelayMSec(const int &retryIntervalSec)
+{
+	if (retryIntervalSec <= 0)
+		return 0;
+	const size_t intervalMSec = retryIntervalSec * 1000;
+	uniform_int_distribution<size_t> dist(
+	  0, intervalMSec * RETRY_JITTER_PERCENT / 100);
+	AutoMutex autoMutex(&m_impl->lock);
+	return intervalMSec + dist(m_impl->random);
+}
+
+bool ArmPollingScheduler::tryAcquire(const string &backend, sem_t *wakeup)
+{
+	AutoMutex autoMutex(&m_impl->lock);
+	m_impl->loadConfigIfNeeded();
+	// The slot reserved for this waiter is used now.
+	list<Waiter>::iterator it = m_impl->findWaiter(wakeup);
+	if (it != m_impl->waiters.end())
+		m_impl->unreserve(*it);
+	if (!m_impl->hasFreeSlot(backend)) {
+		// The waiter keeps its place in the list. It happens when
+		// the limits are lowered or it's woken up by other than
+		// the scheduler.
+		if (it == m_impl->waiters.end()) {
+			Waiter waiter = {backend, wakeup, false};
+			m_impl->waiters.push_back(waiter);
+			m_impl->stat.numDelayedPollings++;
+		}
+		return false;
+	}
+	if (it != m_impl->waiters.end())
+		m_impl->waiters.erase(it);
+	m_impl->numRunning++;
+	m_impl->numRunningMap[backend]++;
+	m_impl->stat.numPollings++;
+	m_impl->stat.numRunning = m_impl->numRunning;
+	if (m_impl->numRunning > m_impl->stat.maxNumRunning)
+		m_impl->stat.maxNumRunning = m_impl->numRunning;
+	return true;
+}
+
+void ArmPollingScheduler::release(const string &backend)
+{
+	AutoMutex autoMutex(&m_impl->lock);
+	size_t &numRunningOfBackend = m_impl->numRunningMap[backend];
+	HATOHOL_ASSERT(m_impl->numRunning > 0 && numRunningOfBackend > 0,
+	               "No running polling: %s\n", backend.c_str());
+	m_impl->numRunning--;
+	numRunningOfBackend--;
+	m_impl->stat.numRunning = m_impl->numRunning;
+	m_impl->wakeupWaiters();
+}
+
+void ArmPollingScheduler::cancelWait(sem_t *wakeup)
+{
+	AutoMutex autoMutex(&m_impl->lock);
+	m_impl->removeWaiter(wakeup);
+	// The slot reserved for it may be given to another waiter.
+	m_impl->wakeupWaiters();
+}
+
+size_t ArmPollingScheduler::getMaxRunningPollings(void) const
+{
+	AutoMutex autoMutex(&m_impl->lock);
+	m_impl->loadConfigIfNeeded();
+	return m_impl->maxRunning;
+}
+
+void ArmPollingScheduler::setMaxRunningPollings(const size_t &num)
+{
+	HATOHOL_ASSERT(num > 0, "The number must not be zero.");
+	AutoMutex autoMutex(&m_impl->lock);
+	m_impl->configLoaded = true;
+	m_impl->maxRunning = num;
+	m_impl->wakeupWaiters();
+}
+
+size_t ArmPollingScheduler::getMaxRunningPollings(const string &backend) const
+{
+	AutoMutex autoMutex(&m_impl->lock);
+	return m_impl->getBackendLimit(backend);
+}
+
+void ArmPollingScheduler::setMaxRunningPollings(const string &backend,
+                                                const size_t &num)
+{
+	AutoMutex autoMutex(&m_impl->lock);
+	m_impl->maxRunningMap[backend] = num;
+	m_impl->wakeupWaiters();
+}
+
+void ArmPollingScheduler::getStat(Stat &stat)
+{
+	AutoMutex autoMutex(&m_impl->lock);
+	stat = m_impl->stat;
+}
+
+// ---------------------------------------------------------------------------
+// Protected methods
+// ---------------------------------------------------------------------------
+ArmPollingScheduler::ArmPollingScheduler(void)
+: m_impl(new Impl())
+{
+}
+
+ArmPollingScheduler::~ArmPollingScheduler()
+{
+}
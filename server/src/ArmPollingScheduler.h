@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ArmPollingScheduler_h
+#define ArmPollingScheduler_h
+
+#include <memory>
+#include <string>
+#include <semaphore.h>
+#include <stdint.h>
+
+/**
+ * ArmPollingScheduler spreads and bounds the pollings of the arms.
+ *
+ * Each arm polls at a random phase within its polling interval instead of
+ * all arms polling right after the start, and the retries after a failure
+ * are also jittered. At most getMaxRunningPollings() pollings run at the
+ * same time in total, and each backend (the name of an arm such as
+ * "ArmZabbixAPI") can have its own limit. An arm that can't get a slot
+ * waits on its own semaphore, which is posted when a slot is released.
+ * The slot is reserved for the woken arm until it calls tryAcquire() again.
+ *
+ * The on-demand fetches (fetchItems, fetchTriggers and fetchHistory)
+ * aren't limited by the scheduler.
+ */
+class ArmPollingScheduler
+{
+public:
+	static const size_t DEFAULT_MAX_RUNNING_POLLINGS;
+	static const size_t RETRY_JITTER_PERCENT;
+
+	struct Stat {
+		// The number of pollings that got a slot.
+		uint64_t numPollings;
+		// The number of pollings that had to wait for a slot.
+		uint64_t numDelayedPollings;
+		size_t   numRunning;
+		size_t   maxNumRunning;
+
+		Stat(void);
+	};
+
+	static ArmPollingScheduler &getInstance(void);
+
+	/**
+	 * Clear the statistics and reload the limits from ConfigManager.
+	 * This is mainly for the test.
+	 */
+	static void reset(void);
+
+	/**
+	 * Get a delay of the first polling of an arm.
+	 *
+	 * @param intervalSec A polling interval of the arm.
+	 *
+	 * @return A random delay in [0, intervalSec) in milliseconds.
+	 */
+	size_t getInitialDelayMSec(const int &intervalSec);
+
+	/**
+	 * Get a delay of the retry after a failed polling.
+	 *
+	 * @param retryIntervalSec A retry interval of the arm.
+	 *
+	 * @return
+	 * A random delay in milliseconds. It's longer than retryIntervalSec
+	 * by up to RETRY_JITTER_PERCENT.
+	 */
+	size_t getRetryDelayMSec(const int &retryIntervalSec);
+
+	/**
+	 * Try to get a slot to run a polling.
+	 *
+	 * @param backend A name of the arm.
+	 * @param wakeup
+	 * A semaphore posted when a slot is reserved for the caller. It's
+	 * registered only when this function returns false. The reserved
+	 * slot is kept until this function is called again with it or
+	 * cancelWait() is called.
+	 *
+	 * @return true if the slot is got. Otherwise false.
+	 */
+	bool tryAcquire(const std::string &backend, sem_t *wakeup);
+
+	/**
+	 * Release a slot got by tryAcquire().
+	 *
+	 * @param backend A name of the arm.
+	 */
+	void release(const std::string &backend);
+
+	/**
+	 * Unregister a semaphore passed to tryAcquire().
+	 * This must be called before the semaphore is destroyed.
+	 *
+	 * @param wakeup A semaphore passed to tryAcquire().
+	 */
+	void cancelWait(sem_t *wakeup);
+
+	size_t getMaxRunningPollings(void) const;
+	void setMaxRunningPollings(const size_t &num);
+
+	/**
+	 * Get the maximum number of running pollings of a backend.
+	 *
+	 * @param backend A name of the arm.
+	 *
+	 * @return A limit or 0 when the backend isn't limited.
+	 */
+	size_t getMaxRunningPollings(const std::string &backend) const;
+	void setMaxRunningPollings(const std::string &backend,
+	                           const size_t &num);
+
+	void getStat(Stat &stat);
+
+protected:
+	ArmPollingScheduler(void);
+	virtual ~ArmPollingScheduler();
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> m_impl;
+};
+
+#endif // ArmPollingScheduler_h
@@ -41,10 +41,52 @@ using namespace std;
 
 static const uint64_t NUMBER_OF_GET_EVENT_PER_ONCE  = 1000;
 
+// All hosts and groups are got at this interval even if their numbers
+// and largest IDs are unchanged, because a rename or a change of the
+// membership doesn't change them.
+static const time_t FULL_SYNC_INTERVAL_SEC = 300;
+
 struct ArmZabbixAPI::Impl
 {
+	// The state of the change detection of the hosts or the groups.
+	struct SyncState {
+		ZabbixAPI::ObjectStat objectStat;
+		string                digest;
+		time_t                lastFetchTime;
+
+		SyncState(void)
+		: lastFetchTime(0)
+		{
+		}
+
+		bool isFetchDue(void) const
+		{
+			if (!lastFetchTime)
+				return true;
+			return time(NULL) - lastFetchTime >=
+			         FULL_SYNC_INTERVAL_SEC;
+		}
+
+		bool needToFetch(const ZabbixAPI::ObjectStat &_objectStat) const
+		{
+			return isFetchDue() || !(_objectStat == objectStat);
+		}
+
+		void update(const ZabbixAPI::ObjectStat &_objectStat,
+		            const string &_digest)
+		{
+			objectStat = _objectStat;
+			digest = _digest;
+			lastFetchTime = time(NULL);
+		}
+	};
+
 	const ServerIdType zabbixServerId;
 	HostInfoCache      hostInfoCache;
+	SyncState          hostSyncState;
+	SyncState          groupSyncState;
+	Mutex              statLock;
+	Stat               stat;
 
 	// constructors
 	Impl(const MonitoringServerInfo &serverInfo)
@@ -52,10 +94,29 @@ struct ArmZabbixAPI::Impl
 	  hostInfoCache(&serverInfo.id)
 	{
 	}
+
+	int getTriggerRequestSince(void)
+	{
+		UnifiedDataStore *uds = UnifiedDataStore::getInstance();
+		SmartTime last = uds->getTimestampOfLastTrigger(zabbixServerId);
+		return last.getAsTimespec().tv_sec;
+	}
 };
 
 class connectionException : public HatoholException {};
 
+// ---------------------------------------------------------------------------
+// Stat
+// ---------------------------------------------------------------------------
+ArmZabbixAPI::Stat::Stat(void)
+: numHostFetches(0),
+  numHostStores(0),
+  numGroupFetches(0),
+  numGroupStores(0),
+  numAllTriggerFetches(0)
+{
+}
+
 // ---------------------------------------------------------------------------
 // Public methods
 // ---------------------------------------------------------------------------
@@ -76,23 +137,23 @@ void ArmZabbixAPI::onGotNewEvents(const ItemTablePtr &itemPtr)
 	// This function is used on a test class.
 }
 
+void ArmZabbixAPI::getStat(Stat &stat)
+{
+	AutoMutex autoMutex(&m_impl->statLock);
+	stat = m_impl->stat;
+}
+
 // ---------------------------------------------------------------------------
 // Protected methods
 // ---------------------------------------------------------------------------
 ItemTablePtr ArmZabbixAPI::updateTriggers(void)
 {
-	UnifiedDataStore *uds = UnifiedDataStore::getInstance();
-	SmartTime last = uds->getTimestampOfLastTrigger(m_impl->zabbixServerId);
-	const int requestSince = last.getAsTimespec().tv_sec;
-	return getTrigger(requestSince);
+	return getTrigger(m_impl->getTriggerRequestSince());
 }
 
 ItemTablePtr ArmZabbixAPI::updateTriggerExpandedDescriptions(void)
 {
-	UnifiedDataStore *uds = UnifiedDataStore::getInstance();
-	SmartTime last = uds->getTimestampOfLastTrigger(m_impl->zabbixServerId);
-	const int requestSince = last.getAsTimespec().tv_sec;
-	return getTriggerExpandedDescription(requestSince);
+	return getTriggerExpandedDescription(m_impl->getTriggerRequestSince());
 }
 
 void ArmZabbixAPI::updateItems(void)
@@ -112,6 +173,37 @@ void ArmZabbixAPI::updateHosts(void)
 	return;
 }
 
+bool ArmZabbixAPI::updateHostsIfChanged(void)
+{
+	ZabbixAPI::ObjectStat objectStat;
+	getHostStat(objectStat);
+	Impl::SyncState &syncState = m_impl->hostSyncState;
+	if (!syncState.needToFetch(objectStat))
+		return false;
+
+	ItemTablePtr hostTablePtr, hostsGroupsTablePtr;
+	string digest;
+	getHosts(hostTablePtr, hostsGroupsTablePtr, &digest);
+	m_impl->statLock.lock();
+	m_impl->stat.numHostFetches++;
+	m_impl->statLock.unlock();
+	if (digest == syncState.digest) {
+		syncState.update(objectStat, digest);
+		return false;
+	}
+
+	makeHatoholHosts(hostTablePtr);
+	makeHatoholMapHostsHostgroups(hostsGroupsTablePtr);
+	syncState.update(objectStat, digest);
+	m_impl->statLock.lock();
+	m_impl->stat.numHostStores++;
+	m_impl->statLock.unlock();
+
+	// wasStoredHostsChanged() returns false when syncHosts() in
+	// makeHatoholHosts() has stored some changes.
+	return !UnifiedDataStore::getInstance()->wasStoredHostsChanged();
+}
+
 void ArmZabbixAPI::updateEvents(void)
 {
 	const uint64_t serverLastEventId = getEndEventId(false);
@@ -136,6 +228,17 @@ void ArmZabbixAPI::updateEvents(void)
 	while (eventIdFrom <= serverLastEventId) {
 		const uint64_t eventIdTill =
 		  eventIdFrom + NUMBER_OF_GET_EVENT_PER_ONCE - 1;
+		// The next chunk is fetched while this one is parsed and
+		// stored.
+		const uint64_t nextEventIdFrom = eventIdTill + 1;
+		if (nextEventIdFrom <= serverLastEventId) {
+			HatoholError queryRet;
+			beginPrefetch();
+			queryEvent(nextEventIdFrom,
+			           nextEventIdFrom + NUMBER_OF_GET_EVENT_PER_ONCE - 1,
+			           queryRet);
+			endPrefetch();
+		}
 		ItemTablePtr eventsTablePtr =
 		  getEvents(eventIdFrom, eventIdTill);
 		makeHatoholEvents(eventsTablePtr);
@@ -159,6 +262,63 @@ void ArmZabbixAPI::updateGroups(void)
 	makeHatoholHostgroups(groupsTablePtr);
 }
 
+void ArmZabbixAPI::updateGroupsIfChanged(void)
+{
+	ZabbixAPI::ObjectStat objectStat;
+	getGroupStat(objectStat);
+	Impl::SyncState &syncState = m_impl->groupSyncState;
+	if (!syncState.needToFetch(objectStat))
+		return;
+
+	ItemTablePtr groupsTablePtr;
+	string digest;
+	getGroups(groupsTablePtr, &digest);
+	m_impl->statLock.lock();
+	m_impl->stat.numGroupFetches++;
+	m_impl->statLock.unlock();
+	if (digest == syncState.digest) {
+		syncState.update(objectStat, digest);
+		return;
+	}
+
+	makeHatoholHostgroups(groupsTablePtr);
+	syncState.update(objectStat, digest);
+	m_impl->statLock.lock();
+	m_impl->stat.numGroupStores++;
+	m_impl->statLock.unlock();
+}
+
+void ArmZabbixAPI::prefetchUpdates(void)
+{
+	HatoholError queryRet;
+	beginPrefetch();
+	queryHostStat(true, queryRet);
+	queryHostStat(false, queryRet);
+	if (m_impl->hostSyncState.isFetchDue())
+		queryHost(queryRet);
+	queryGroupStat(true, queryRet);
+	queryGroupStat(false, queryRet);
+	if (m_impl->groupSyncState.isFetchDue())
+		queryGroup(queryRet);
+	queryEndEventId(false, queryRet);
+	if (!getCopyOnDemandEnabled())
+		queryItem(queryRet);
+	endPrefetch();
+}
+
+void ArmZabbixAPI::prefetchTriggers(const bool &hostsChanged)
+{
+	// The same conditions as updateTriggers() and
+	// makeHatoholAllTriggers().
+	const int requestSince =
+	  hostsChanged ? 0 : m_impl->getTriggerRequestSince();
+	HatoholError queryRet;
+	beginPrefetch();
+	queryTrigger(queryRet, requestSince);
+	queryTriggerExpandedDescription(queryRet, requestSince);
+	endPrefetch();
+}
+
 //
 // virtual methods
 //
@@ -193,6 +353,9 @@ void ArmZabbixAPI::makeHatoholAllTriggers(void)
 
 	ThreadLocalDBCache cache;
 	cache.getMonitoring().updateTrigger(mergedTriggerInfoList, m_impl->zabbixServerId);
+	m_impl->statLock.lock();
+	m_impl->stat.numAllTriggerFetches++;
+	m_impl->statLock.unlock();
 }
 
 void ArmZabbixAPI::makeHatoholTriggers(ItemTablePtr triggers)
@@ -300,24 +463,32 @@ ArmBase::ArmPollingResult ArmZabbixAPI::mainThreadOneProc(void)
 	if (!updateAuthTokenIfNeeded())
 		return COLLECT_NG_DISCONNECT_ZABBIX;
 
+	// The queries that don't depend on each other are sent
+	// concurrently. Each stage below waits only for its own response.
+	// All hosts, groups and triggers are got only when the hosts or
+	// the groups have been changed.
+	ArmPollingResult result = COLLECT_OK;
 	try {
-		updateHosts();
-		updateGroups();
-		if (UnifiedDataStore::getInstance()->wasStoredHostsChanged()){
+		prefetchUpdates();
+		const bool hostsChanged = updateHostsIfChanged();
+		prefetchTriggers(hostsChanged);
+		updateGroupsIfChanged();
+		if (hostsChanged) {
+			makeHatoholAllTriggers();
+		} else {
 			ItemTablePtr triggers = updateTriggers();
 			makeHatoholTriggers(triggers);
-		} else {
-			makeHatoholAllTriggers();
 		}
 		updateEvents();
 
 		if (!getCopyOnDemandEnabled())
 			updateItems();
 	} catch (const HatoholException &he) {
-		return handleHatoholException(he);
+		result = handleHatoholException(he);
 	}
+	discardPrefetchedQueries();
 
-	return COLLECT_OK;
+	return result;
 }
 
 ArmBase::ArmPollingResult ArmZabbixAPI::mainThreadOneProcFetchItems(void)
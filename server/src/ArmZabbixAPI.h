@@ -38,11 +38,26 @@ public:
 	static const int POLLING_DISABLED = -1;
 	static const int DEFAULT_SERVER_PORT = 80;
 
+	struct Stat {
+		// The number of times all hosts were got.
+		uint64_t numHostFetches;
+		// The number of times the got hosts were stored.
+		uint64_t numHostStores;
+		uint64_t numGroupFetches;
+		uint64_t numGroupStores;
+		// The number of times all triggers were got.
+		uint64_t numAllTriggerFetches;
+
+		Stat(void);
+	};
+
 	ArmZabbixAPI(const MonitoringServerInfo &serverInfo);
 	virtual ~ArmZabbixAPI();
 
 	virtual void onGotNewEvents(const ItemTablePtr &itemPtr);
 
+	void getStat(Stat &stat);
+
 protected:
 	ItemTablePtr updateTriggers(void);
 	ItemTablePtr updateTriggerExpandedDescriptions(void);
@@ -53,6 +68,19 @@ protected:
 	 */
 	void updateHosts(void);
 
+	/**
+	 * Get all hosts and save them only if the hosts may have been
+	 * changed.
+	 *
+	 * The number and the largest ID of the hosts are compared with
+	 * the ones of the previous call. All hosts are got when either is
+	 * different or FULL_SYNC_INTERVAL_SEC has passed. They are saved
+	 * when the digest of the response is different from the previous one.
+	 *
+	 * @return true if the hosts in the Hatohol DB are changed.
+	 */
+	bool updateHostsIfChanged(void);
+
 	void updateEvents(void);
 
 	/**
@@ -63,6 +91,28 @@ protected:
 
 	void updateGroups(void);
 
+	/**
+	 * Get all groups and save them only if the groups may have been
+	 * changed. See also updateHostsIfChanged().
+	 */
+	void updateGroupsIfChanged(void);
+
+	/**
+	 * Start the queries of the numbers and the largest IDs of hosts
+	 * and groups, the last event ID and items without waiting for
+	 * the responses. The queries of all hosts and groups are also
+	 * started when they are going to be got regardless of the changes.
+	 */
+	void prefetchUpdates(void);
+
+	/**
+	 * Start the queries of triggers without waiting for the responses.
+	 *
+	 * @param hostsChanged
+	 * The result of updateHostsIfChanged().
+	 */
+	void prefetchTriggers(const bool &hostsChanged);
+
 	void makeHatoholTriggers(ItemTablePtr triggers);
 	void makeHatoholAllTriggers(void);
 	void makeHatoholEvents(ItemTablePtr events);
@@ -26,6 +26,7 @@
 #include "HatoholException.h"
 #include "Reaper.h"
 #include "EventSemaphore.h"
+#include "ProcessSpawner.h"
 
 using namespace std;
 using namespace mlpl;
@@ -73,6 +74,7 @@ typedef ChildMap::const_iterator ChildMapConstIterator;
 struct ChildProcessManager::Impl {
 	static ChildProcessManager *instance;
 	static ReadWriteLock        instanceLock;
+	static ProcessSpawner      *spawner;
 
 	AtomicValue<bool> resetRequest;
 	EventSemaphore    resetSem;
@@ -115,6 +117,82 @@ struct ChildProcessManager::Impl {
 		}
 	}
 
+	/**
+	 * childrenMapLock has to be locked before this method is called.
+	 *
+	 * @return true if the child is newly registered.
+	 */
+	bool registerChild(const pid_t &pid, EventCallback *eventCb)
+	{
+		ChildInfo *childInfo = new ChildInfo(pid, eventCb);
+		pair<ChildMapIterator, bool> result =
+		  childrenMap.insert(pair<pid_t, ChildInfo *>(pid, childInfo));
+		return result.second;
+	}
+
+	/**
+	 * Create a child with the spawner.
+	 *
+	 * @return
+	 * false if the spawner can't handle it. Otherwise true and the
+	 * result is set to 'err'.
+	 */
+	bool createBySpawner(CreateArg &arg, HatoholError &err)
+	{
+		struct Registrar : public ProcessSpawner::SpawnCallback {
+			Impl      &impl;
+			CreateArg &arg;
+			string     reason;
+
+			Registrar(Impl &_impl, CreateArg &_arg)
+			: impl(_impl),
+			  arg(_arg)
+			{
+			}
+
+			virtual void onSpawned(const pid_t &pid,
+			                       GError *gerror) override
+			{
+				Reaper<ReadWriteLock> unlocker(
+				  &impl.childrenMapLock, ReadWriteLock::unlock);
+				impl.childrenMapLock.writeLock();
+				arg.pid = pid;
+				if (arg.eventCb)
+					arg.eventCb->onExecuted(pid, gerror);
+				if (!pid) {
+					reason = gerror ? gerror->message :
+					                  "<Unknown reason>";
+					return;
+				}
+				if (!impl.registerChild(pid, arg.eventCb)) {
+					MLPL_BUG("The previous data might "
+					         "still remain: %d\n", pid);
+				}
+			}
+		} registrar(*this, arg);
+
+		if (!spawner || !spawner->spawn(arg.args, arg.envs,
+		                                arg.workingDirectory,
+		                                registrar)) {
+			return false;
+		}
+		if (!arg.pid) {
+			MLPL_ERR("Failed to create process: (%s), %s\n",
+			         arg.args[0].c_str(), registrar.reason.c_str());
+			err = HatoholError(HTERR_FAILED_TO_SPAWN,
+			                   registrar.reason);
+			return true;
+		}
+		err = HTERR_OK;
+		return true;
+	}
+
+	static void onSpawnedChildExited(const siginfo_t *siginfo, void *data)
+	{
+		const bool bySpawner = true;
+		getInstance()->collected(siginfo, bySpawner);
+	}
+
 	void resetOnCollectThread(void)
 	{
 		childrenMapLock.writeLock();
@@ -142,6 +220,7 @@ private:
 
 ChildProcessManager *ChildProcessManager::Impl::instance = NULL;
 ReadWriteLock        ChildProcessManager::Impl::instanceLock;
+ProcessSpawner      *ChildProcessManager::Impl::spawner = NULL;
 
 // ---------------------------------------------------------------------------
 // EventCallback
@@ -208,6 +287,19 @@ ChildProcessManager *ChildProcessManager::getInstance(void)
 	return Impl::instance;
 }
 
+bool ChildProcessManager::startSpawner(void)
+{
+	HATOHOL_ASSERT(!Impl::spawner, "The spawner has already started.");
+	ProcessSpawner *spawner = new ProcessSpawner();
+	if (!spawner->start(Impl::onSpawnedChildExited, NULL)) {
+		MLPL_INFO("Children are created by g_spawn_async().\n");
+		delete spawner;
+		return false;
+	}
+	Impl::spawner = spawner;
+	return true;
+}
+
 void ChildProcessManager::reset(void)
 {
 	struct ResetContext {
@@ -270,6 +362,12 @@ HatoholError ChildProcessManager::create(CreateArg &arg)
 	const size_t numArgs = arg.args.size();
 	if (numArgs == 0)
 		return HTERR_INVALID_ARGS;
+
+	HatoholError err;
+	if (arg.flags == G_SPAWN_DO_NOT_REAP_CHILD &&
+	    m_impl->createBySpawner(arg, err)) {
+		return err;
+	}
 	const gchar *argv[numArgs+1];
 	for (size_t i = 0; i < numArgs; i++)
 		argv[i] = arg.args[i].c_str();
@@ -301,13 +399,9 @@ HatoholError ChildProcessManager::create(CreateArg &arg)
 		return HatoholError(HTERR_FAILED_TO_SPAWN, reason);
 	}
 
-	ChildInfo *childInfo = new ChildInfo(arg.pid, arg.eventCb);
-
-	pair<ChildMapIterator, bool> result =
-	  m_impl->childrenMap.insert(pair<
-	    pid_t, ChildInfo *>(arg.pid, childInfo));
+	const bool registered = m_impl->registerChild(arg.pid, arg.eventCb);
 	m_impl->childrenMapLock.unlock();
-	if (!result.second) {
+	if (!registered) {
 		// TODO: Recovery
 		HATOHOL_ASSERT(true,
 		  "The previous data might still remain: %d\n", arg.pid);
@@ -367,7 +461,8 @@ bool ChildProcessManager::isDead(const siginfo_t *siginfo)
 	return false;
 }
 
-void ChildProcessManager::collected(const siginfo_t *siginfo)
+void ChildProcessManager::collected(const siginfo_t *siginfo,
+                                    const bool &bySpawner)
 {
 	ChildInfo *childInfo = NULL;
 
@@ -381,7 +476,8 @@ void ChildProcessManager::collected(const siginfo_t *siginfo)
 		childInfo = it->second;
 	if (!childInfo) {
 		unlocker.reap();
-		m_impl->postWaitChildSem();
+		if (!bySpawner)
+			m_impl->postWaitChildSem();
 		MLPL_INFO("Collected unwatched child: %d\n", siginfo->si_pid);
 		return;
 	}
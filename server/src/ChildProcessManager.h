@@ -100,10 +100,23 @@ public:
 	 */
 	static ChildProcessManager *getInstance(void);
 
+	/**
+	 * Start the helper process that launches children instead of
+	 * forking this process. See ProcessSpawner.
+	 * This should be called before other threads are started.
+	 * When the helper isn't available, children are created with
+	 * g_spawn_async() as before.
+	 *
+	 * @return true if the helper has started. Otherwise false.
+	 */
+	static bool startSpawner(void);
+
 	void reset(void);
 
 	/**
 	 * Create a child process.
+	 * If the spawner has been started and arg.flags has only
+	 * G_SPAWN_DO_NOT_REAP_CHILD, the child is launched by it.
 	 *
 	 * @param arg Information about the child to be created.
 	 * @return HatoholError instance.
@@ -117,7 +130,16 @@ protected:
 	virtual gpointer mainThread(HatoholThreadArg *arg) override;
 
 	bool isDead(const siginfo_t *siginfo);
-	void collected(const siginfo_t *siginfo);
+
+	/**
+	 * Handle an exit (or a stop) of a child.
+	 *
+	 * @param siginfo Information about the child.
+	 * @param bySpawner
+	 * true if the child has been launched by the spawner. The waiting
+	 * thread isn't woken up for such a child.
+	 */
+	void collected(const siginfo_t *siginfo, const bool &bySpawner = false);
 
 private:
 	struct Impl;
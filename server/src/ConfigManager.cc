@@ -48,6 +48,7 @@ static int DEFAULT_ALLOWED_TIME_OF_ACTION_FOR_OLD_EVENTS
 const char *ConfigManager::DEFAULT_PID_FILE_PATH = LOCALSTATEDIR "/run/hatohol.pid";
 
 static int DEFAULT_MAX_NUM_RUNNING_COMMAND_ACTION = 10;
+static const size_t DEFAULT_RESIDENT_NOTIFY_WINDOW = 32;
 
 static gboolean parseFaceRestPort(
   const gchar *option_name, const gchar *value,
@@ -122,7 +123,10 @@ CommandLineOptions::CommandLineOptions(void)
   disableCopyOnDemand(FALSE),
   loadOldEvents(FALSE),
   faceRestPort(-1),
-  faceRestNumWorkers(0)
+  faceRestNumWorkers(0),
+  ingestionSpoolDirectory(NULL),
+  historyStoreDirectory(NULL),
+  residentNotifyWindow(0)
 {
 }
 
@@ -146,6 +150,14 @@ struct ConfigManager::Impl {
 	string                pidFilePath;
 	bool                  loadOldEvents;
 	int                   faceRestNumWorkers;
+	map<string, int>      faceRestMaxRunningJobs;
+	map<string, int>      faceRestMaxQueuedJobs;
+	int                   faceRestCompressionThreshold;
+	int                   armPollingNumWorkers;
+	map<string, int>      armPollingMaxRunning;
+	string                ingestionSpoolDirectory;
+	string                historyStoreDirectory;
+	size_t                residentNotifyWindow;
 
 	// methods
 	Impl(void)
@@ -157,7 +169,10 @@ struct ConfigManager::Impl {
 	  faceRestPort(0),
 	  pidFilePath(DEFAULT_PID_FILE_PATH),
 	  loadOldEvents(false),
-	  faceRestNumWorkers(0)
+	  faceRestNumWorkers(0),
+	  faceRestCompressionThreshold(-1),
+	  armPollingNumWorkers(0),
+	  residentNotifyWindow(DEFAULT_RESIDENT_NOTIFY_WINDOW)
 	{
 	}
 
@@ -217,6 +232,7 @@ struct ConfigManager::Impl {
 
 		loadConfigFileMySQLGroup(keyFile);
 		loadConfigFileFaceRestGroup(keyFile);
+		loadConfigFileArmPollingGroup(keyFile);
 
 		return true;
 	}
@@ -246,6 +262,14 @@ struct ConfigManager::Impl {
 			loadOldEvents = cmdLineOpts.loadOldEvents;
 		if (cmdLineOpts.faceRestNumWorkers > 0)
 			faceRestNumWorkers = cmdLineOpts.faceRestNumWorkers;
+		if (cmdLineOpts.ingestionSpoolDirectory)
+			ingestionSpoolDirectory =
+			  cmdLineOpts.ingestionSpoolDirectory;
+		if (cmdLineOpts.historyStoreDirectory)
+			historyStoreDirectory =
+			  cmdLineOpts.historyStoreDirectory;
+		if (cmdLineOpts.residentNotifyWindow > 0)
+			residentNotifyWindow = cmdLineOpts.residentNotifyWindow;
 	}
 
 private:
@@ -283,6 +307,90 @@ private:
 		} else {
 			MLPL_WARN("ConfigFile: [FaceRest] workers=%d: Invalid value. Ignored.\n", num);
 		}
+
+		if (g_key_file_has_key(keyFile, group,
+		                       "compression_threshold", NULL)) {
+			gint threshold =
+			  g_key_file_get_integer(keyFile, group,
+			                         "compression_threshold", NULL);
+			if (threshold >= 0) {
+				faceRestCompressionThreshold = threshold;
+				MLPL_INFO("ConfigFile: [FaceRest] "
+				          "compression_threshold=%d\n", threshold);
+			} else {
+				MLPL_WARN("ConfigFile: [FaceRest] "
+				          "compression_threshold=%d: "
+				          "Invalid value. Ignored.\n", threshold);
+			}
+		}
+
+		// e.g. low_priority_workers=2, low_priority_queue_size=32
+		const char *priorityClassNames[] = {"high", "normal", "low"};
+		for (size_t i = 0; i < ARRAY_SIZE(priorityClassNames); i++) {
+			const string name = priorityClassNames[i];
+			loadConfigFileFaceRestPriority(
+			  keyFile, group, name, "workers",
+			  faceRestMaxRunningJobs);
+			loadConfigFileFaceRestPriority(
+			  keyFile, group, name, "queue_size",
+			  faceRestMaxQueuedJobs);
+		}
+	}
+
+	void loadConfigFileFaceRestPriority(
+	  GKeyFile *keyFile, const gchar *group, const string &className,
+	  const string &suffix, map<string, int> &valueMap)
+	{
+		const string key =
+		  StringUtils::sprintf("%s_priority_%s",
+		                       className.c_str(), suffix.c_str());
+		if (!g_key_file_has_key(keyFile, group, key.c_str(), NULL))
+			return;
+		gint num = g_key_file_get_integer(keyFile, group,
+						  key.c_str(), NULL);
+		if (num <= 0) {
+			MLPL_WARN("ConfigFile: [FaceRest] %s=%d: "
+			          "Invalid value. Ignored.\n", key.c_str(), num);
+			return;
+		}
+		valueMap[className] = num;
+		MLPL_INFO("ConfigFile: [FaceRest] %s=%d\n", key.c_str(), num);
+	}
+
+	void loadConfigFileArmPollingGroup(GKeyFile *keyFile)
+	{
+		const gchar *group = "ArmPolling";
+
+		if (!g_key_file_has_group(keyFile, group))
+			return;
+
+		// e.g. workers=16, ArmZabbixAPI_workers=8
+		static const string suffix = "_workers";
+		gchar **keys = g_key_file_get_keys(keyFile, group, NULL, NULL);
+		Reaper<gchar *> keysReaper(keys, g_strfreev);
+		for (gchar **key = keys; key && *key; key++) {
+			const string keyStr = *key;
+			const bool isTotal = (keyStr == "workers");
+			if (!isTotal &&
+			    !StringUtils::hasSuffix(keyStr, suffix))
+				continue;
+			gint num = g_key_file_get_integer(keyFile, group,
+							  *key, NULL);
+			if (num <= 0) {
+				MLPL_WARN("ConfigFile: [ArmPolling] %s=%d: "
+				          "Invalid value. Ignored.\n",
+				          *key, num);
+				continue;
+			}
+			if (isTotal) {
+				armPollingNumWorkers = num;
+			} else {
+				const string backend(
+				  keyStr, 0, keyStr.size() - suffix.size());
+				armPollingMaxRunning[backend] = num;
+			}
+			MLPL_INFO("ConfigFile: [ArmPolling] %s=%d\n", *key, num);
+		}
 	}
 };
 
@@ -345,6 +453,21 @@ bool ConfigManager::parseCommandLine(gint *argc, gchar ***argv,
 		{"face-rest-workers",
 		 'T', 0, G_OPTION_ARG_CALLBACK, (gpointer)parseFaceRestNumWorkers,
 		 "Number of FaceRest worker threads", NULL},
+		{"ingestion-spool-dir",
+		 0, 0, G_OPTION_ARG_STRING,
+		 &cmdLineOpts->ingestionSpoolDirectory,
+		 "Directory to spool events and items before storing them",
+		 NULL},
+		{"history-store-dir",
+		 0, 0, G_OPTION_ARG_STRING,
+		 &cmdLineOpts->historyStoreDirectory,
+		 "Directory to keep item history fetched from servers",
+		 NULL},
+		{"resident-notify-window",
+		 0, 0, G_OPTION_ARG_INT,
+		 &cmdLineOpts->residentNotifyWindow,
+		 "Max number of events sent to a resident action "
+		 "without an ack", NULL},
 		{ NULL }
 	};
 
@@ -522,6 +645,94 @@ void ConfigManager::setFaceRestNumWorkers(const int &num)
 	m_impl->faceRestNumWorkers = num;
 }
 
+string ConfigManager::getIngestionSpoolDirectory(void) const
+{
+	return m_impl->ingestionSpoolDirectory;
+}
+
+string ConfigManager::getHistoryStoreDirectory(void) const
+{
+	return m_impl->historyStoreDirectory;
+}
+
+size_t ConfigManager::getResidentNotifyWindow(void) const
+{
+	return m_impl->residentNotifyWindow;
+}
+
+void ConfigManager::setResidentNotifyWindow(const size_t &window)
+{
+	HATOHOL_ASSERT(window > 0, "The window must not be zero.");
+	m_impl->residentNotifyWindow = window;
+}
+
+int ConfigManager::getFaceRestMaxRunningJobs(
+  const string &priorityClassName) const
+{
+	AutoMutex autoLock(&m_impl->mutex);
+	map<string, int>::const_iterator it =
+	  m_impl->faceRestMaxRunningJobs.find(priorityClassName);
+	return (it == m_impl->faceRestMaxRunningJobs.end()) ? 0 : it->second;
+}
+
+void ConfigManager::setFaceRestMaxRunningJobs(
+  const string &priorityClassName, const int &num)
+{
+	AutoMutex autoLock(&m_impl->mutex);
+	m_impl->faceRestMaxRunningJobs[priorityClassName] = num;
+}
+
+int ConfigManager::getFaceRestMaxQueuedJobs(
+  const string &priorityClassName) const
+{
+	AutoMutex autoLock(&m_impl->mutex);
+	map<string, int>::const_iterator it =
+	  m_impl->faceRestMaxQueuedJobs.find(priorityClassName);
+	return (it == m_impl->faceRestMaxQueuedJobs.end()) ? 0 : it->second;
+}
+
+void ConfigManager::setFaceRestMaxQueuedJobs(
+  const string &priorityClassName, const int &num)
+{
+	AutoMutex autoLock(&m_impl->mutex);
+	m_impl->faceRestMaxQueuedJobs[priorityClassName] = num;
+}
+
+int ConfigManager::getFaceRestCompressionThreshold(void) const
+{
+	return m_impl->faceRestCompressionThreshold;
+}
+
+void ConfigManager::setFaceRestCompressionThreshold(const int &threshold)
+{
+	m_impl->faceRestCompressionThreshold = threshold;
+}
+
+int ConfigManager::getArmPollingNumWorkers(void) const
+{
+	return m_impl->armPollingNumWorkers;
+}
+
+void ConfigManager::setArmPollingNumWorkers(const int &num)
+{
+	m_impl->armPollingNumWorkers = num;
+}
+
+int ConfigManager::getArmPollingMaxRunning(const string &backend) const
+{
+	AutoMutex autoLock(&m_impl->mutex);
+	map<string, int>::const_iterator it =
+	  m_impl->armPollingMaxRunning.find(backend);
+	return (it == m_impl->armPollingMaxRunning.end()) ? 0 : it->second;
+}
+
+void ConfigManager::setArmPollingMaxRunning(const string &backend,
+                                            const int &num)
+{
+	AutoMutex autoLock(&m_impl->mutex);
+	m_impl->armPollingMaxRunning[backend] = num;
+}
+
 // ---------------------------------------------------------------------------
 // Protected methods
 // ---------------------------------------------------------------------------
@@ -38,6 +38,9 @@ struct CommandLineOptions {
 	gboolean  loadOldEvents;
 	gint      faceRestPort;
 	gint      faceRestNumWorkers;
+	gchar    *ingestionSpoolDirectory;
+	gchar    *historyStoreDirectory;
+	gint      residentNotifyWindow;
 
 	CommandLineOptions(void);
 };
@@ -131,8 +134,94 @@ public:
 
 	int getFaceRestNumWorkers(void) const;
 
+	/**
+	 * Get the directory of the ingestion spool.
+	 *
+	 * @return The path, or an empty string if the spool is disabled.
+	 */
+	std::string getIngestionSpoolDirectory(void) const;
+
+	/**
+	 * Get the directory of the local history store.
+	 *
+	 * @return The path, or an empty string if the store is disabled.
+	 */
+	std::string getHistoryStoreDirectory(void) const;
+
+	/**
+	 * Get the maximum number of events that are sent to a resident
+	 * action without an ack. 1 means that an event is sent after the
+	 * ack of the previous one is received.
+	 *
+	 * @return The window size. It is never zero.
+	 */
+	size_t getResidentNotifyWindow(void) const;
+
+	void setResidentNotifyWindow(const size_t &window);
+
 	void setFaceRestNumWorkers(const int &num);
 
+	/**
+	 * Get the maximum number of concurrently running jobs of a FaceRest
+	 * priority class.
+	 *
+	 * @param priorityClassName A name such as "high", "normal" or "low".
+	 *
+	 * @retrun
+	 * A configured value or 0 when it isn't configured.
+	 */
+	int getFaceRestMaxRunningJobs(const std::string &priorityClassName) const;
+
+	void setFaceRestMaxRunningJobs(const std::string &priorityClassName,
+				       const int &num);
+
+	/**
+	 * Get the maximum number of queued jobs of a FaceRest priority class.
+	 *
+	 * @param priorityClassName A name such as "high", "normal" or "low".
+	 *
+	 * @retrun
+	 * A configured value or 0 when it isn't configured.
+	 */
+	int getFaceRestMaxQueuedJobs(const std::string &priorityClassName) const;
+
+	void setFaceRestMaxQueuedJobs(const std::string &priorityClassName,
+				      const int &num);
+
+	/**
+	 * Get the minimum size of a FaceRest response to be compressed.
+	 *
+	 * @retrun
+	 * A configured value in bytes or -1 when it isn't configured.
+	 */
+	int getFaceRestCompressionThreshold(void) const;
+
+	void setFaceRestCompressionThreshold(const int &threshold);
+
+	/**
+	 * Get the maximum number of concurrently running pollings of arms.
+	 *
+	 * @retrun
+	 * A configured value or 0 when it isn't configured.
+	 */
+	int getArmPollingNumWorkers(void) const;
+
+	void setArmPollingNumWorkers(const int &num);
+
+	/**
+	 * Get the maximum number of concurrently running pollings of a
+	 * backend.
+	 *
+	 * @param backend A name of the arm such as "ArmZabbixAPI".
+	 *
+	 * @retrun
+	 * A configured value or 0 when it isn't configured.
+	 */
+	int getArmPollingMaxRunning(const std::string &backend) const;
+
+	void setArmPollingMaxRunning(const std::string &backend,
+				     const int &num);
+
 protected:
 	void loadConfFile(void);
 	static gboolean parseLogLevel(
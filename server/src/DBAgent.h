@@ -351,6 +351,16 @@ public:
 
 	static bool isAutoIncrementValue(const ItemData *item);
 
+	/**
+	 * Make a quoted DATETIME literal in the local time.
+	 *
+	 * @param datetime
+	 * A time in seconds since the epoch or CURR_DATETIME.
+	 *
+	 * @return A string such as '2015-01-23 04:56:07'.
+	 */
+	static std::string makeDatetimeString(int datetime);
+
 protected:
 	static std::string makeSelectStatement(const SelectArg &selectArg);
 	static std::string makeSelectStatement(const SelectExArg &selectExArg);
@@ -358,7 +368,6 @@ protected:
 	static std::string makeRenameTableStatement(
 	  const std::string &srcName,
 	  const std::string &destName);
-	static std::string makeDatetimeString(int datetime);
 	std::string makeUpdateStatement(const UpdateArg &updateArg);
 
 	virtual std::string getColumnValueString(const ColumnDef *columnDef,
@@ -350,6 +350,12 @@ static bool updateDB(
 
 struct DBTablesAction::Impl
 {
+	// The last allocated action log ID in this process. It's loaded
+	// from the DB at the first allocation.
+	static Mutex           actionLogIdLock;
+	static bool            actionLogIdLoaded;
+	static ActionLogIdType lastActionLogId;
+
 	Impl(void)
 	{
 	}
@@ -359,6 +365,10 @@ struct DBTablesAction::Impl
 	}
 };
 
+Mutex           DBTablesAction::Impl::actionLogIdLock;
+bool            DBTablesAction::Impl::actionLogIdLoaded = false;
+ActionLogIdType DBTablesAction::Impl::lastActionLogId = 0;
+
 struct deleteInvalidActionsContext {
 	guint timerId;
 	guint idleEventId;
@@ -377,6 +387,124 @@ DBTablesAction::LogEndExecActionArg::LogEndExecActionArg(void)
 {
 }
 
+// ---------------------------------------------------------------------------
+// ActionLogChange
+// ---------------------------------------------------------------------------
+DBTablesAction::ActionLogChange::ActionLogChange(void)
+: serverId(INVALID_SERVER_ID),
+  isNew(false),
+  updatedColumns(0)
+{
+	log.id          = INVALID_ACTION_LOG_ID;
+	log.actionId    = 0;
+	log.status      = ACTLOG_STAT_INVALID;
+	log.starterId   = 0;
+	log.queuingTime = 0;
+	log.startTime   = 0;
+	log.endTime     = 0;
+	log.failureCode = ACTLOG_EXECFAIL_NONE;
+	log.exitCode    = 0;
+	log.nullFlags   = 0;
+}
+
+void DBTablesAction::ActionLogChange::setNew(
+  const ActionLogIdType &logId,
+  const ActionDef &actionDef, const EventInfo &eventInfo,
+  ActionLogExecFailureCode failureCode, ActionLogStatus initialStatus)
+{
+	const int now = time(NULL);
+	isNew = true;
+	updatedColumns = 0;
+	serverId = eventInfo.serverId;
+	eventId  = eventInfo.id;
+
+	log.id       = logId;
+	log.actionId = actionDef.id;
+	if (failureCode == ACTLOG_EXECFAIL_NONE)
+		log.status = initialStatus;
+	else
+		log.status = ACTLOG_STAT_FAILED;
+
+	// TODO: set the appropriate the following starter ID.
+	log.starterId = 0;
+
+	log.nullFlags = ACTLOG_FLAG_EXIT_CODE;
+	if (initialStatus == ACTLOG_STAT_QUEUING)
+		log.queuingTime = now;
+	else
+		log.nullFlags |= ACTLOG_FLAG_QUEUING_TIME;
+	log.startTime = now;
+	if (failureCode == ACTLOG_EXECFAIL_NONE)
+		log.nullFlags |= ACTLOG_FLAG_END_TIME;
+	else
+		log.endTime = now;
+
+	log.failureCode = failureCode;
+	log.exitCode = 0;
+}
+
+void DBTablesAction::ActionLogChange::setStarted(void)
+{
+	log.status = ACTLOG_STAT_STARTED;
+	log.startTime = time(NULL);
+	log.nullFlags &= ~ACTLOG_FLAG_START_TIME;
+	updatedColumns |= (1 << IDX_ACTION_LOGS_STATUS);
+	updatedColumns |= (1 << IDX_ACTION_LOGS_START_TIME);
+}
+
+void DBTablesAction::ActionLogChange::setEnd(
+  const LogEndExecActionArg &logArg)
+{
+	log.status = logArg.status;
+	updatedColumns |= (1 << IDX_ACTION_LOGS_STATUS);
+	if (!(logArg.nullFlags & ACTLOG_FLAG_END_TIME)) {
+		log.endTime = time(NULL);
+		log.nullFlags &= ~ACTLOG_FLAG_END_TIME;
+		updatedColumns |= (1 << IDX_ACTION_LOGS_END_TIME);
+	}
+	log.failureCode = logArg.failureCode;
+	updatedColumns |= (1 << IDX_ACTION_LOGS_EXEC_FAILURE_CODE);
+	if (!(logArg.nullFlags & ACTLOG_FLAG_EXIT_CODE)) {
+		log.exitCode = logArg.exitCode;
+		log.nullFlags &= ~ACTLOG_FLAG_EXIT_CODE;
+		updatedColumns |= (1 << IDX_ACTION_LOGS_EXIT_CODE);
+	}
+}
+
+void DBTablesAction::ActionLogChange::merge(const ActionLogChange &change)
+{
+	HATOHOL_ASSERT(change.log.id == log.id,
+	               "Different log IDs: %" FMT_ACTION_LOG_ID
+	               ", %" FMT_ACTION_LOG_ID, log.id, change.log.id);
+	if (change.isNew) {
+		*this = change;
+		return;
+	}
+
+	struct {
+		int      ActionLog::*member;
+		uint32_t            nullFlag;
+		size_t              columnIndex;
+	} const columns[] = {
+		{&ActionLog::status,      0, IDX_ACTION_LOGS_STATUS},
+		{&ActionLog::startTime,   ACTLOG_FLAG_START_TIME,
+		 IDX_ACTION_LOGS_START_TIME},
+		{&ActionLog::endTime,     ACTLOG_FLAG_END_TIME,
+		 IDX_ACTION_LOGS_END_TIME},
+		{&ActionLog::failureCode, 0, IDX_ACTION_LOGS_EXEC_FAILURE_CODE},
+		{&ActionLog::exitCode,    ACTLOG_FLAG_EXIT_CODE,
+		 IDX_ACTION_LOGS_EXIT_CODE},
+	};
+	for (size_t i = 0; i < ARRAY_SIZE(columns); i++) {
+		if (!(change.updatedColumns & (1 << columns[i].columnIndex)))
+			continue;
+		log.*columns[i].member = change.log.*columns[i].member;
+		log.nullFlags &= ~columns[i].nullFlag;
+		log.nullFlags |= (change.log.nullFlags & columns[i].nullFlag);
+	}
+	updatedColumns |= change.updatedColumns;
+}
+
 // ---------------------------------------------------------------------------
 // Public methods
 // ---------------------------------------------------------------------------
@@ -392,6 +520,10 @@ void DBTablesAction::init(void)
 void DBTablesAction::reset(void)
 {
 	getSetupInfo().initialized = false;
+
+	AutoMutex autoMutex(&Impl::actionLogIdLock);
+	Impl::actionLogIdLoaded = false;
+	Impl::lastActionLogId = 0;
 }
 
 const DBTables::SetupInfo &DBTablesAction::getConstSetupInfo(void)
@@ -743,84 +875,159 @@ uint64_t DBTablesAction::createActionLog(
   const ActionDef &actionDef, const EventInfo &eventInfo,
   ActionLogExecFailureCode failureCode, ActionLogStatus initialStatus)
 {
-	DBAgent::InsertArg arg(tableProfileActionLogs);
-	arg.row->addNewItem(AUTO_INCREMENT_VALUE_U64);
-	arg.row->addNewItem(actionDef.id);
-
-	// status
-	ActionLogStatus status;
-	if (failureCode == ACTLOG_EXECFAIL_NONE)
-		status = initialStatus;
-	else
-		status = ACTLOG_STAT_FAILED;
-	arg.row->addNewItem(status);
-
-	// TODO: set the appropriate the following starter ID.
-	int starterId = 0;
-	arg.row->addNewItem(starterId);
-
-	// queuing_time
-	const int dummyTime = 0;
-	if (initialStatus == ACTLOG_STAT_QUEUING)
-		arg.row->addNewItem(CURR_DATETIME);
-	else
-		arg.row->addNewItem(dummyTime, ITEM_DATA_NULL);
-	arg.row->addNewItem(CURR_DATETIME);     // start_time
-
-	// end_time
-	if (failureCode == ACTLOG_EXECFAIL_NONE)
-		arg.row->addNewItem(dummyTime, ITEM_DATA_NULL);
-	else
-		arg.row->addNewItem(CURR_DATETIME);
+	ActionLogChangeVect changes(1);
+	const ActionLogIdType logId = allocateActionLogId();
+	changes[0].setNew(logId, actionDef, eventInfo,
+	                  failureCode, initialStatus);
+	writeActionLogs(changes);
+	return logId;
+}
 
-	arg.row->addNewItem(failureCode);
-	arg.row->addNewItem(dummyTime, ITEM_DATA_NULL); // exit_code
+void DBTablesAction::logEndExecAction(const LogEndExecActionArg &logArg)
+{
+	ActionLogChangeVect changes(1);
+	changes[0].log.id = logArg.logId;
+	changes[0].setEnd(logArg);
+	writeActionLogs(changes);
+}
 
-	// server ID and event ID
-	arg.row->addNewItem(eventInfo.serverId);
-	arg.row->addNewItem(eventInfo.id);
+void DBTablesAction::updateLogStatusToStart(const ActionLogIdType &logId)
+{
+	ActionLogChangeVect changes(1);
+	changes[0].log.id = logId;
+	changes[0].setStarted();
+	writeActionLogs(changes);
+}
 
-	ActionLogIdType logId;
-	getDBAgent().runTransaction(arg, &logId);
-	return logId;
+ActionLogIdType DBTablesAction::allocateActionLogId(void)
+{
+	AutoMutex autoMutex(&Impl::actionLogIdLock);
+	if (!Impl::actionLogIdLoaded) {
+		DBAgent::SelectExArg arg(tableProfileActionLogs);
+		const ColumnDef &idColumnDef =
+		  COLUMN_DEF_ACTION_LOGS[IDX_ACTION_LOGS_ACTION_LOG_ID];
+		arg.add(StringUtils::sprintf("coalesce(max(%s), 0)",
+		                             idColumnDef.columnName),
+		        idColumnDef.type);
+		getDBAgent().runTransaction(arg);
+
+		const ItemGroupList &grpList =
+		  arg.dataTable->getItemGroupList();
+		ItemGroupStream itemGroupStream(*grpList.begin());
+		Impl::lastActionLogId = itemGroupStream.read<uint64_t>();
+		Impl::actionLogIdLoaded = true;
+	}
+	return ++Impl::lastActionLogId;
 }
 
-void DBTablesAction::logEndExecAction(const LogEndExecActionArg &logArg)
+void DBTablesAction::writeActionLogs(const ActionLogChangeVect &changes)
 {
-	DBAgent::UpdateArg arg(tableProfileActionLogs);
+	struct TrxProc : public DBAgent::TransactionProc {
+		const ActionLogChangeVect &changes;
+
+		TrxProc(const ActionLogChangeVect &_changes)
+		: changes(_changes)
+		{
+		}
 
-	const char *actionLogIdColumnName =
-	  COLUMN_DEF_ACTION_LOGS[IDX_ACTION_LOGS_ACTION_LOG_ID].columnName;
-	arg.condition = StringUtils::sprintf("%s=%" FMT_ACTION_LOG_ID,
-	                                     actionLogIdColumnName,
-	                                     logArg.logId);
-	// status
-	arg.add(IDX_ACTION_LOGS_STATUS, logArg.status);
-	if (!(logArg.nullFlags & ACTLOG_FLAG_END_TIME))
-		arg.add(IDX_ACTION_LOGS_END_TIME, CURR_DATETIME);
+		static ItemDataNullFlagType nullFlag(const ActionLog &log,
+		                                     const uint32_t &flag)
+		{
+			return (log.nullFlags & flag) ?
+			       ITEM_DATA_NULL : ITEM_DATA_NOT_NULL;
+		}
 
-	// exec_failure_code
-	arg.add(IDX_ACTION_LOGS_EXEC_FAILURE_CODE, logArg.failureCode);
+		void insert(DBAgent &dbAgent, const ActionLogChange &change)
+		{
+			const ActionLog &log = change.log;
+			DBAgent::InsertArg arg(tableProfileActionLogs);
+			arg.row->addNewItem(log.id);
+			arg.row->addNewItem(log.actionId);
+			arg.row->addNewItem(log.status);
+			arg.row->addNewItem(log.starterId);
+			arg.row->addNewItem(
+			  log.queuingTime,
+			  nullFlag(log, ACTLOG_FLAG_QUEUING_TIME));
+			arg.row->addNewItem(
+			  log.startTime, nullFlag(log, ACTLOG_FLAG_START_TIME));
+			arg.row->addNewItem(
+			  log.endTime, nullFlag(log, ACTLOG_FLAG_END_TIME));
+			arg.row->addNewItem(log.failureCode);
+			arg.row->addNewItem(
+			  log.exitCode, nullFlag(log, ACTLOG_FLAG_EXIT_CODE));
+			arg.row->addNewItem(change.serverId);
+			arg.row->addNewItem(change.eventId);
+			dbAgent.insert(arg);
+		}
 
-	// exit_code
-	if (!(logArg.nullFlags & ACTLOG_FLAG_EXIT_CODE))
-		arg.add(IDX_ACTION_LOGS_EXIT_CODE, logArg.exitCode);
+		void update(DBAgent &dbAgent, const ActionLogChange &change)
+		{
+			const ActionLog &log = change.log;
+			const uint32_t &columns = change.updatedColumns;
+			if (!columns)
+				return;
+			DBAgent::UpdateArg arg(tableProfileActionLogs);
+			const char *actionLogIdColumnName =
+			  COLUMN_DEF_ACTION_LOGS[
+			    IDX_ACTION_LOGS_ACTION_LOG_ID].columnName;
+			arg.condition = StringUtils::sprintf(
+			  "%s=%" FMT_ACTION_LOG_ID,
+			  actionLogIdColumnName, log.id);
+			if (columns & (1 << IDX_ACTION_LOGS_STATUS))
+				arg.add(IDX_ACTION_LOGS_STATUS, log.status);
+			if (columns & (1 << IDX_ACTION_LOGS_START_TIME)) {
+				arg.add(IDX_ACTION_LOGS_START_TIME,
+				        log.startTime);
+			}
+			if (columns & (1 << IDX_ACTION_LOGS_END_TIME))
+				arg.add(IDX_ACTION_LOGS_END_TIME, log.endTime);
+			if (columns & (1 << IDX_ACTION_LOGS_EXEC_FAILURE_CODE)) {
+				arg.add(IDX_ACTION_LOGS_EXEC_FAILURE_CODE,
+				        log.failureCode);
+			}
+			if (columns & (1 << IDX_ACTION_LOGS_EXIT_CODE))
+				arg.add(IDX_ACTION_LOGS_EXIT_CODE, log.exitCode);
+			dbAgent.update(arg);
+		}
 
-	getDBAgent().runTransaction(arg);
+		void operator ()(DBAgent &dbAgent) override
+		{
+			for (size_t i = 0; i < changes.size(); i++) {
+				if (changes[i].isNew)
+					insert(dbAgent, changes[i]);
+				else
+					update(dbAgent, changes[i]);
+			}
+		}
+	} trx(changes);
+	getDBAgent().runTransaction(trx);
 }
 
-void DBTablesAction::updateLogStatusToStart(const ActionLogIdType &logId)
+void DBTablesAction::getActionLogEvents(ActionLogEventVect &logEvents,
+                                        const time_t &since)
 {
-	DBAgent::UpdateArg arg(tableProfileActionLogs);
-
-	const char *actionLogIdColumnName =
-	  COLUMN_DEF_ACTION_LOGS[IDX_ACTION_LOGS_ACTION_LOG_ID].columnName;
-	arg.condition = StringUtils::sprintf("%s=%" FMT_ACTION_LOG_ID,
-	                                     actionLogIdColumnName, logId);
-	arg.add(IDX_ACTION_LOGS_STATUS, ACTLOG_STAT_STARTED);
-	arg.add(IDX_ACTION_LOGS_START_TIME, CURR_DATETIME);
-
+	DBAgent::SelectExArg arg(tableProfileActionLogs);
+	arg.add(IDX_ACTION_LOGS_SERVER_ID);
+	arg.add(IDX_ACTION_LOGS_EVENT_ID);
+	arg.add(IDX_ACTION_LOGS_START_TIME);
+	arg.condition = StringUtils::sprintf(
+	  "%s>=%s",
+	  COLUMN_DEF_ACTION_LOGS[IDX_ACTION_LOGS_START_TIME].columnName,
+	  DBAgent::makeDatetimeString(since).c_str());
 	getDBAgent().runTransaction(arg);
+
+	const ItemGroupList &grpList = arg.dataTable->getItemGroupList();
+	ItemGroupListConstIterator it = grpList.begin();
+	for (; it != grpList.end(); ++it) {
+		ItemGroupStream itemGroupStream(*it);
+		ActionLogEvent logEvent;
+		int startTime;
+		itemGroupStream >> logEvent.serverId;
+		itemGroupStream >> logEvent.eventId;
+		itemGroupStream >> startTime;
+		logEvent.startTime = startTime;
+		logEvents.push_back(logEvent);
+	}
 }
 
 bool DBTablesAction::getLog(ActionLog &actionLog, const ActionLogIdType &logId)
@@ -21,6 +21,7 @@
 #define DBTablesAction_h
 
 #include <string>
+#include <vector>
 #include "DBTablesMonitoring.h"
 #include "DBTables.h"
 #include "Params.h"
@@ -277,6 +278,56 @@ public:
 		LogEndExecActionArg(void);
 	};
 
+	/**
+	 * A change of an action log. It's either a new log or an update
+	 * of the columns in updatedColumns of an existing log.
+	 */
+	struct ActionLogChange {
+		ActionLog    log;
+		ServerIdType serverId;
+		EventIdType  eventId;
+		bool         isNew;
+		// Bits of (1 << IDX_ACTION_LOGS_*) to be updated.
+		uint32_t     updatedColumns;
+
+		ActionLogChange(void);
+
+		/**
+		 * Make this a new log. The parameters are the same as
+		 * those of createActionLog().
+		 */
+		void setNew(const ActionLogIdType &logId,
+		            const ActionDef &actionDef,
+		            const EventInfo &eventInfo,
+		            ActionLogExecFailureCode failureCode,
+		            ActionLogStatus initialStatus);
+
+		/**
+		 * Add the change made by updateLogStatusToStart().
+		 */
+		void setStarted(void);
+
+		/**
+		 * Add the change made by logEndExecAction().
+		 */
+		void setEnd(const LogEndExecActionArg &logArg);
+
+		/**
+		 * Apply a later change of the same log.
+		 *
+		 * @param change A change made after this one.
+		 */
+		void merge(const ActionLogChange &change);
+	};
+	typedef std::vector<ActionLogChange> ActionLogChangeVect;
+
+	struct ActionLogEvent {
+		ServerIdType serverId;
+		EventIdType  eventId;
+		time_t       startTime;
+	};
+	typedef std::vector<ActionLogEvent> ActionLogEventVect;
+
 	static const int ACTION_DB_VERSION;
 
 	static void init(void);
@@ -342,6 +393,32 @@ public:
 	 */
 	void updateLogStatusToStart(const ActionLogIdType &logId);
 
+	/**
+	 * Reserve an ID of a new action log. The IDs are given in the
+	 * ascending order in this process, so that a log can be written
+	 * later with writeActionLogs().
+	 *
+	 * @return A reserved action log ID.
+	 */
+	ActionLogIdType allocateActionLogId(void);
+
+	/**
+	 * Write changes of action logs in one transaction.
+	 *
+	 * @param changes
+	 * Changes to be written. They are applied in the order of the vector.
+	 */
+	void writeActionLogs(const ActionLogChangeVect &changes);
+
+	/**
+	 * Get the events of the action logs started after the given time.
+	 *
+	 * @param logEvents The obtained events are added to this vector.
+	 * @param since     A time in seconds since the epoch.
+	 */
+	void getActionLogEvents(ActionLogEventVect &logEvents,
+	                        const time_t &since);
+
 	/**
 	 * Get the action log.
 	 * @param actionLog
@@ -24,6 +24,7 @@
 #include "ThreadLocalDBCache.h"
 #include "DBClientJoinBuilder.h"
 #include "DBTermCStringProvider.h"
+#include "FingerprintTable.h"
 using namespace std;
 using namespace mlpl;
 
@@ -744,6 +745,8 @@ HostIdType DBTablesHost::upsertHost(
 		getDBAgent().runTransaction(proc);
 	else
 		proc(getDBAgent());
+	FingerprintTable::invalidate(FingerprintTable::KIND_HOSTS,
+	                             serverHostDef.serverId);
 
 	return proc.hostId;
 }
@@ -786,6 +789,8 @@ void DBTablesHost::upsertHosts(
 		}
 	} proc(*this, serverHostDefs, hostHostIdMapPtr);
 	getDBAgent().runTransaction(proc);
+	FingerprintTable::invalidate(FingerprintTable::KIND_HOSTS,
+	                             serverHostDefs);
 }
 
 GenericIdType DBTablesHost::upsertServerHostDef(
@@ -801,6 +806,8 @@ GenericIdType DBTablesHost::upsertServerHostDef(
 	arg.add(serverHostDef.status);
 	arg.upsertOnDuplicate = true;
 	getDBAgent().runTransaction(arg, &id);
+	FingerprintTable::invalidate(FingerprintTable::KIND_HOSTS,
+	                             serverHostDef.serverId);
 	return id;
 }
 
@@ -847,6 +854,8 @@ GenericIdType DBTablesHost::upsertHostgroup(const Hostgroup &hostgroup,
 		dbAgent.insert(arg);
 		id = dbAgent.getLastInsertId();
 	}
+	FingerprintTable::invalidate(FingerprintTable::KIND_HOSTGROUPS,
+	                             hostgroup.serverId);
 
 	return id;
 }
@@ -872,6 +881,8 @@ void DBTablesHost::upsertHostgroups(const HostgroupVect &hostgroups)
 		}
 	} proc(*this, hostgroups);
 	getDBAgent().runTransaction(proc);
+	FingerprintTable::invalidate(FingerprintTable::KIND_HOSTGROUPS,
+	                             hostgroups);
 }
 
 HatoholError DBTablesHost::getHostgroups(HostgroupVect &hostgroups,
@@ -949,6 +960,9 @@ HatoholError DBTablesHost::deleteHostgroupList(const GenericIdList &idList)
 	} trx;
 	trx.arg.condition = makeConditionForDelete(idList);
 	getDBAgent().runTransaction(trx);
+	// The IDs don't tell the servers.
+	FingerprintTable::invalidate(FingerprintTable::KIND_HOSTGROUPS,
+	                             ALL_SERVERS);
 
 	// Check the result
 	if (trx.numAffectedRows != idList.size()) {
@@ -30,6 +30,7 @@
 #include "ItemGroupStream.h"
 #include "DBClientJoinBuilder.h"
 #include "DBTermCStringProvider.h"
+#include "FingerprintTable.h"
 
 // TODO: rmeove the followin two include files!
 // This class should not be aware of it.
@@ -390,9 +391,23 @@ static const int columnIndexesEventsTimeSequence[] = {
   IDX_EVENTS_UNIFIED_ID, DBAgent::IndexDef::END,
 };
 
+// for the keyset pagination narrowed by a server
+static const int columnIndexesEventsServerTimeSequence[] = {
+  IDX_EVENTS_SERVER_ID, IDX_EVENTS_TIME_SEC, IDX_EVENTS_TIME_NS,
+  IDX_EVENTS_UNIFIED_ID, DBAgent::IndexDef::END,
+};
+
+static const int columnIndexesEventsServerUnifiedId[] = {
+  IDX_EVENTS_SERVER_ID, IDX_EVENTS_UNIFIED_ID, DBAgent::IndexDef::END,
+};
+
 static const DBAgent::IndexDef indexDefsEvents[] = {
   {"EventsId", (const int *)columnIndexesEventsUniqId, false},
   {"EventsTimeSequence", (const int *)columnIndexesEventsTimeSequence, false},
+  {"EventsServerTimeSequence",
+   (const int *)columnIndexesEventsServerTimeSequence, false},
+  {"EventsServerUnifiedId",
+   (const int *)columnIndexesEventsServerUnifiedId, false},
   {NULL}
 };
 
@@ -832,6 +847,8 @@ struct EventsQueryOption::Impl {
 	TriggerIdType triggerId;
 	timespec beginTime;
 	timespec endTime;
+	timespec cursorTime;
+	uint64_t cursorUnifiedId;
 
 	Impl()
 	: limitOfUnifiedId(NO_LIMIT),
@@ -842,7 +859,9 @@ struct EventsQueryOption::Impl {
 	  triggerStatus(TRIGGER_STATUS_ALL),
 	  triggerId(ALL_TRIGGERS),
 	  beginTime({0, 0}),
-	  endTime({0, 0})
+	  endTime({0, 0}),
+	  cursorTime({0, 0}),
+	  cursorUnifiedId(0)
 	{
 	}
 };
@@ -952,9 +971,47 @@ string EventsQueryOption::getCondition(void) const
 			m_impl->endTime.tv_nsec);
 	}
 
+	if (hasCursor()) {
+		if (!condition.empty())
+			condition += " AND ";
+		condition += makeCursorCondition();
+	}
+
 	return condition;
 }
 
+string EventsQueryOption::makeCursorCondition(void) const
+{
+	HATOHOL_ASSERT(m_impl->sortDirection != SORT_DONT_CARE,
+	               "A cursor needs a sort direction.");
+	const bool descending =
+	  (m_impl->sortDirection == SORT_DESCENDING);
+	const char *op = descending ? "<" : ">";
+	const char *opOrEqual = descending ? "<=" : ">=";
+	const string unifiedIdColumn = getColumnName(IDX_EVENTS_UNIFIED_ID);
+
+	if (m_impl->sortType == SORT_UNIFIED_ID) {
+		return StringUtils::sprintf(
+		  "%s%s%" PRIu64,
+		  unifiedIdColumn.c_str(), op, m_impl->cursorUnifiedId);
+	}
+
+	// The leading bound on time_sec lets the DB server use a range scan
+	// of the (time_sec, time_ns, unified_id) index.
+	const string timeSecColumn = getColumnName(IDX_EVENTS_TIME_SEC);
+	const string timeNsColumn = getColumnName(IDX_EVENTS_TIME_NS);
+	const timespec &time = m_impl->cursorTime;
+	return StringUtils::sprintf(
+	  "(%s%s%ld AND (%s%s%ld OR (%s=%ld AND "
+	  "(%s%s%ld OR (%s=%ld AND %s%s%" PRIu64 ")))))",
+	  timeSecColumn.c_str(), opOrEqual, time.tv_sec,
+	  timeSecColumn.c_str(), op, time.tv_sec,
+	  timeSecColumn.c_str(), time.tv_sec,
+	  timeNsColumn.c_str(), op, time.tv_nsec,
+	  timeNsColumn.c_str(), time.tv_nsec,
+	  unifiedIdColumn.c_str(), op, m_impl->cursorUnifiedId);
+}
+
 void EventsQueryOption::setLimitOfUnifiedId(const uint64_t &unifiedId)
 {
 	m_impl->limitOfUnifiedId = unifiedId;
@@ -965,6 +1022,18 @@ uint64_t EventsQueryOption::getLimitOfUnifiedId(void) const
 	return m_impl->limitOfUnifiedId;
 }
 
+void EventsQueryOption::setCursor(const timespec &time,
+				  const uint64_t &unifiedId)
+{
+	m_impl->cursorTime = time;
+	m_impl->cursorUnifiedId = unifiedId;
+}
+
+bool EventsQueryOption::hasCursor(void) const
+{
+	return m_impl->cursorUnifiedId != 0;
+}
+
 void EventsQueryOption::setSortType(
   const SortType &type, const SortDirection &direction)
 {
@@ -1425,6 +1494,8 @@ void DBTablesMonitoring::addTriggerInfo(const TriggerInfo *triggerInfo)
 		}
 	} trx(triggerInfo);
 	getDBAgent().runTransaction(trx);
+	FingerprintTable::invalidate(FingerprintTable::KIND_TRIGGERS,
+	                             triggerInfo->serverId);
 }
 
 void DBTablesMonitoring::addTriggerInfoList(const TriggerInfoList &triggerInfoList)
@@ -1446,6 +1517,8 @@ void DBTablesMonitoring::addTriggerInfoList(const TriggerInfoList &triggerInfoLi
 		}
 	} trx(triggerInfoList);
 	getDBAgent().runTransaction(trx);
+	FingerprintTable::invalidate(FingerprintTable::KIND_TRIGGERS,
+	                             triggerInfoList);
 }
 
 bool DBTablesMonitoring::getTriggerInfo(TriggerInfo &triggerInfo,
@@ -1569,6 +1642,8 @@ void DBTablesMonitoring::setTriggerInfoList(
 		}
 	} trx(triggerInfoList, serverId);
 	getDBAgent().runTransaction(trx);
+	FingerprintTable::invalidate(FingerprintTable::KIND_TRIGGERS,
+	                             serverId);
 }
 
 int DBTablesMonitoring::getLastChangeTimeOfTrigger(const ServerIdType &serverId)
@@ -1697,6 +1772,8 @@ HatoholError DBTablesMonitoring::deleteTriggerInfo(const TriggerIdList &idList,
 	} trx;
 	trx.arg.condition = makeConditionForDelete(idList, serverId);
 	getDBAgent().runTransaction(trx);
+	FingerprintTable::invalidate(FingerprintTable::KIND_TRIGGERS,
+	                             serverId);
 
 	// Check the result
 	if (trx.numAffectedRows != idList.size()) {
@@ -2076,6 +2153,38 @@ void DBTablesMonitoring::addItemInfoList(const ItemInfoList &itemInfoList)
 	getDBAgent().runTransaction(trx);
 }
 
+void DBTablesMonitoring::addEventAndItemInfoLists(
+  const vector<EventInfoList *> &eventInfoLists,
+  const vector<const ItemInfoList *> &itemInfoLists)
+{
+	struct TrxProc : public DBAgent::TransactionProc {
+		const vector<EventInfoList *> &eventInfoLists;
+		const vector<const ItemInfoList *> &itemInfoLists;
+
+		TrxProc(const vector<EventInfoList *> &_eventInfoLists,
+			const vector<const ItemInfoList *> &_itemInfoLists)
+		: eventInfoLists(_eventInfoLists),
+		  itemInfoLists(_itemInfoLists)
+		{
+		}
+
+		void operator ()(DBAgent &dbAgent) override
+		{
+			for (auto eventInfoList : eventInfoLists) {
+				for (auto &eventInfo : *eventInfoList)
+					addEventInfoWithoutTransaction(
+					  dbAgent, eventInfo);
+			}
+			for (auto itemInfoList : itemInfoLists) {
+				for (auto &itemInfo : *itemInfoList)
+					addItemInfoWithoutTransaction(
+					  dbAgent, itemInfo);
+			}
+		}
+	} trx(eventInfoLists, itemInfoLists);
+	getDBAgent().runTransaction(trx);
+}
+
 void DBTablesMonitoring::getItemInfoList(ItemInfoList &itemInfoList,
 				      const ItemsQueryOption &option)
 {
@@ -48,6 +48,22 @@ public:
 	void setLimitOfUnifiedId(const uint64_t &unifiedId);
 	uint64_t getLimitOfUnifiedId(void) const;
 
+	/**
+	 * Set a keyset cursor for pagination.
+	 *
+	 * Only events that come after the specified position in the current
+	 * sort order are returned. Unlike an offset, the preceding rows are
+	 * not scanned, so that the cost is constant however deep the page is.
+	 * setSortType() has to be called with SORT_ASCENDING or
+	 * SORT_DESCENDING. Otherwise getCondition() throws an exception.
+	 *
+	 * @param time The time of the last event in the previous page.
+	 * @param unifiedId The unified ID of the last event in the previous
+	 *                  page. 0 means that no cursor is set.
+	 */
+	void setCursor(const timespec &time, const uint64_t &unifiedId);
+	bool hasCursor(void) const;
+
 	void setSortType(const SortType &type, const SortDirection &direction);
 	SortType getSortType(void) const;
 	SortDirection getSortDirection(void) const;
@@ -67,6 +83,9 @@ public:
 	void setEndTime(const timespec &endTime);
 	const timespec &getEndTime(void);
 
+protected:
+	std::string makeCursorCondition(void) const;
+
 private:
 	struct Impl;
 	std::unique_ptr<Impl> m_impl;
@@ -208,6 +227,18 @@ public:
 
 	void addItemInfo(const ItemInfo *itemInfo);
 	void addItemInfoList(const ItemInfoList &itemInfoList);
+
+	/**
+	 * Add events and items of many requests in one transaction.
+	 * The lists are stored in the given order.
+	 *
+	 * @param eventInfoLists Lists of events. The unified IDs are set
+	 *                       to the elements.
+	 * @param itemInfoLists Lists of items.
+	 */
+	void addEventAndItemInfoLists(
+	  const std::vector<EventInfoList *> &eventInfoLists,
+	  const std::vector<const ItemInfoList *> &itemInfoLists);
 	void getItemInfoList(ItemInfoList &itemInfoList,
 			     const ItemsQueryOption &option);
 	void getApplicationInfoVect(ApplicationInfoVect &applicationInfoVect,
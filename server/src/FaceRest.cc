@@ -32,6 +32,8 @@
 #include <semaphore.h>
 #include "FaceRest.h"
 #include "FaceRestPrivate.h"
+#include "FaceRestJobQueue.h"
+#include "ResponseCompressor.h"
 #include "JSONBuilder.h"
 #include "HatoholException.h"
 #include "UnifiedDataStore.h"
@@ -56,6 +58,19 @@ using namespace mlpl;
 int FaceRest::API_VERSION = 4;
 const char *FaceRest::SESSION_ID_HEADER_NAME = "X-Hatohol-Session";
 const int FaceRest::DEFAULT_NUM_WORKERS = 4;
+const char *FaceRest::PRIORITY_CLASS_NAMES[NUM_PRIORITY_CLASSES] = {
+  "high", "normal", "low",
+};
+
+// The maximum number of jobs waiting for a worker in each priority class.
+// A request that exceeds it is rejected immediately with 503.
+static const size_t DEFAULT_MAX_QUEUED_JOBS[FaceRest::NUM_PRIORITY_CLASSES] = {
+  256, 128, 32,
+};
+
+// Responses smaller than this are sent without compression because
+// the saved bytes don't pay for the CPU time and the headers.
+const size_t FaceRest::DEFAULT_COMPRESSION_THRESHOLD = 1024;
 
 static const guint DEFAULT_PORT = 33194;
 
@@ -93,7 +108,38 @@ int scanParam(const char *value, const char *scanFmt, std::string &dest)
 	return !dest.empty();
 }
 
+static double getThreadCPUTimeInMSec(void)
+{
+	timespec ts;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == -1) {
+		MLPL_ERR("Failed to call clock_gettime: %d\n", errno);
+		return 0;
+	}
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
 // FaceRest ==================================================================
+FaceRest::PriorityClassStat::PriorityClassStat(void)
+: maxRunning(1),
+  maxQueued(0),
+  running(0),
+  queued(0),
+  numHandled(0),
+  numRejected(0),
+  totalQueueWaitMSec(0),
+  totalHandlerMSec(0)
+{
+}
+
+FaceRest::CompressionStat::CompressionStat(void)
+: numCompressed(0),
+  numSkipped(0),
+  totalInputBytes(0),
+  totalOutputBytes(0),
+  totalCPUMSec(0)
+{
+}
+
 struct FaceRest::Impl {
 	struct MainThreadCleaner;
 	static Mutex        lock;
@@ -108,10 +154,19 @@ struct FaceRest::Impl {
 	bool             asyncMode;
 	size_t           numPreLoadWorkers;
 	set<Worker *>    workers;
-	queue<ResourceHandler *> restJobQueue;
-	Mutex            restJobLock;
+	FaceRestJobQueue<ResourceHandler> jobQueue;
 	sem_t            waitJobSemaphore;
 
+	// for compressed responses
+	size_t           compressionThreshold;
+	CompressionStat  compressionStat;
+	Mutex            compressionStatLock;
+
+	// for single-flight coalescing
+	map<string, vector<ResourceHandler *> > inFlightMap;
+	uint64_t         numCoalescedRequests;
+	Mutex            inFlightLock;
+
 	Impl(FaceRestParam *_param)
 	: port(DEFAULT_PORT),
 	  soupServer(NULL),
@@ -119,7 +174,9 @@ struct FaceRest::Impl {
 	  param(_param),
 	  quitRequest(false),
 	  asyncMode(true),
-	  numPreLoadWorkers(DEFAULT_NUM_WORKERS)
+	  numPreLoadWorkers(DEFAULT_NUM_WORKERS),
+	  compressionThreshold(DEFAULT_COMPRESSION_THRESHOLD),
+	  numCoalescedRequests(0)
 	{
 		gMainCtx = g_main_context_new();
 		sem_init(&waitJobSemaphore, 0, 0);
@@ -131,14 +188,56 @@ struct FaceRest::Impl {
 		sem_destroy(&waitJobSemaphore);
 	}
 
-	void pushJob(ResourceHandler *job)
+	size_t getNumWorkers(void) const
+	{
+		// With only one worker, one more worker is started for
+		// the high class so that the lower classes can't take all.
+		return numPreLoadWorkers == 1 ? 2 : numPreLoadWorkers;
+	}
+
+	void setupPriorityClasses(void)
 	{
-		restJobLock.lock();
-		restJobQueue.push(job);
+		ConfigManager *confMgr = ConfigManager::getInstance();
+		const size_t numWorkers = getNumWorkers();
+		// Requests of the lower classes can't occupy all workers
+		// so that cheap requests are always served soon.
+		const size_t maxLowerRunning =
+		  numWorkers > 1 ? numWorkers - 1 : 1;
+		const size_t defaultMaxRunning[NUM_PRIORITY_CLASSES] = {
+		  numWorkers,
+		  maxLowerRunning,
+		  numWorkers > 1 ? numWorkers / 2 : 1,
+		};
+
+		jobQueue.setMaxLowerRunning(maxLowerRunning);
+		for (int i = 0; i < NUM_PRIORITY_CLASSES; i++) {
+			const PriorityClass priorityClass =
+			  static_cast<PriorityClass>(i);
+			const char *name = PRIORITY_CLASS_NAMES[i];
+			int maxRunning =
+			  confMgr->getFaceRestMaxRunningJobs(name);
+			if (maxRunning <= 0)
+				maxRunning = defaultMaxRunning[i];
+			int maxQueued = confMgr->getFaceRestMaxQueuedJobs(name);
+			if (maxQueued <= 0)
+				maxQueued = DEFAULT_MAX_QUEUED_JOBS[i];
+			jobQueue.setLimits(priorityClass, maxRunning, maxQueued);
+			MLPL_INFO("face-rest priority class: %s, "
+			          "max running: %d, max queued: %d\n",
+			          name, maxRunning, maxQueued);
+		}
+		MLPL_INFO("face-rest max running of normal and low: %zd\n",
+		          maxLowerRunning);
+	}
+
+	bool pushJob(ResourceHandler *job)
+	{
+		if (!jobQueue.push(job, job->m_priorityClass))
+			return false;
 		if (sem_post(&waitJobSemaphore) == -1)
 			MLPL_ERR("Failed to call sem_post: %d\n",
 				 errno);
-		restJobLock.unlock();
+		return true;
 	}
 
 	bool waitJob(void)
@@ -148,20 +247,170 @@ struct FaceRest::Impl {
 		return !quitRequest.get();
 	}
 
+	/**
+	 * Pop a job from the highest priority class whose number of
+	 * running jobs doesn't reach the limit.
+	 *
+	 * @return
+	 * A job to be handled or NULL if there's no runnable job.
+	 */
 	ResourceHandler *popJob(void)
 	{
-		ResourceHandler *job = NULL;
-		restJobLock.lock();
-		if (!restJobQueue.empty()) {
-			job = restJobQueue.front();
-			restJobQueue.pop();
+		PriorityClass priorityClass;
+		ResourceHandler *job = jobQueue.pop(priorityClass);
+		if (job) {
+			MLPL_DBG("face-rest job: %s, class: %s\n",
+			         job->m_path.c_str(),
+			         PRIORITY_CLASS_NAMES[priorityClass]);
 		}
-		restJobLock.unlock();
 		return job;
 	}
 
-	void addHandler(const char *path, ResourceHandlerFactory *factory)
+	void finishJob(ResourceHandler *job, const double &handlerMSec)
+	{
+		MLPL_DBG("face-rest job: %s, class: %s, handler: %.3f ms\n",
+		         job->m_path.c_str(),
+		         PRIORITY_CLASS_NAMES[job->m_priorityClass],
+		         handlerMSec);
+		// A job may have been deferred by the limits.
+		if (jobQueue.finish(job->m_priorityClass, handlerMSec)) {
+			if (sem_post(&waitJobSemaphore) == -1)
+				MLPL_ERR("Failed to call sem_post: %d\n",
+					 errno);
+		}
+	}
+
+	void addCompressionResult(const size_t &inputBytes,
+				  const size_t &outputBytes,
+				  const double &cpuMSec)
+	{
+		AutoMutex autoLock(&compressionStatLock);
+		compressionStat.numCompressed++;
+		compressionStat.totalInputBytes += inputBytes;
+		compressionStat.totalOutputBytes += outputBytes;
+		compressionStat.totalCPUMSec += cpuMSec;
+	}
+
+	void countSkippedCompression(void)
+	{
+		AutoMutex autoLock(&compressionStatLock);
+		compressionStat.numSkipped++;
+	}
+
+	/**
+	 * Attach a job to an identical job that is being handled.
+	 *
+	 * If there's no such job, the job is registered as the leader and
+	 * it has to be handled and passed to leaveSingleFlight().
+	 * Otherwise the job is referenced and replied with the response of
+	 * the leader. The caller must not touch the response in that case.
+	 *
+	 * @param job A job to be handled.
+	 * @return true if the job is attached to another one.
+	 */
+	bool joinSingleFlight(ResourceHandler *job)
+	{
+		if (!job->m_singleFlight || !job->httpMethodIs("GET"))
+			return false;
+		const string key = job->makeSingleFlightKey();
+
+		AutoMutex autoLock(&inFlightLock);
+		auto it = inFlightMap.find(key);
+		if (it == inFlightMap.end()) {
+			inFlightMap[key];
+			job->m_singleFlightKey = key;
+			return false;
+		}
+		job->ref();
+		it->second.push_back(job);
+		numCoalescedRequests++;
+		MLPL_DBG("coalesced a request: %s (waiting: %zd)\n",
+		         job->m_path.c_str(), it->second.size());
+		return true;
+	}
+
+	/**
+	 * Detach the jobs attached to a leader. This is done only once for
+	 * a leader.
+	 *
+	 * @param leader A job registered by joinSingleFlight().
+	 * @param followers The attached jobs are stored.
+	 * @return true if the jobs are detached now. Otherwise false.
+	 */
+	bool takeFollowers(ResourceHandler *leader,
+	                   vector<ResourceHandler *> &followers)
+	{
+		AutoMutex autoLock(&inFlightLock);
+		if (leader->m_singleFlightKey.empty())
+			return false;
+		auto it = inFlightMap.find(leader->m_singleFlightKey);
+		HATOHOL_ASSERT(it != inFlightMap.end(),
+		               "Not found in-flight request: %s",
+		               leader->m_singleFlightKey.c_str());
+		followers.swap(it->second);
+		inFlightMap.erase(it);
+		leader->m_singleFlightKey.clear();
+		return true;
+	}
+
+	/**
+	 * Reply to the jobs attached to a leader with its response. This is
+	 * called when the response is prepared, which can be on another
+	 * thread than the worker of the leader.
+	 */
+	void replyFollowers(ResourceHandler *leader, const string &body,
+	                    const char *mimeType, const guint &statusCode)
+	{
+		vector<ResourceHandler *> followers;
+		if (!takeFollowers(leader, followers))
+			return;
+		for (auto job : followers) {
+			job->replySharedResponse(body, mimeType, statusCode);
+			job->unpauseResponse();
+			job->unref();
+		}
+	}
+
+	/**
+	 * Finish the single flight of a leader whose handler has returned.
+	 * If the leader hasn't replied yet, for example because its handler
+	 * replies asynchronously, the attached jobs are queued again and
+	 * each of them is handled under the limits of its class.
+	 */
+	void leaveSingleFlight(ResourceHandler *leader)
+	{
+		vector<ResourceHandler *> followers;
+		if (!takeFollowers(leader, followers))
+			return;
+		{
+			AutoMutex autoLock(&inFlightLock);
+			numCoalescedRequests -= followers.size();
+		}
+		for (auto job : followers) {
+			// The reference taken by joinSingleFlight() is passed
+			// to the queue.
+			if (!pushJob(job))
+				rejectJob(job);
+		}
+	}
+
+	void rejectJob(ResourceHandler *job)
+	{
+		MLPL_WARN("Rejected a request: %s (class: %s)\n",
+		          job->m_path.c_str(),
+		          PRIORITY_CLASS_NAMES[job->m_priorityClass]);
+		job->replyError(HTERR_SERVER_BUSY, "",
+		                SOUP_STATUS_SERVICE_UNAVAILABLE);
+		soup_message_headers_replace(job->m_message->response_headers,
+		                             "Retry-After", "1");
+		job->unpauseResponse();
+		job->unref();
+	}
+
+	void addHandler(const char *path, ResourceHandlerFactory *factory,
+			const PriorityClass &priorityClass = PRIORITY_NORMAL)
 	{
+		factory->m_priorityClass = priorityClass;
 		soup_server_add_handler(soupServer, path,
 					queueRestJob, factory,
 					ResourceHandlerFactory::destroy);
@@ -213,12 +462,26 @@ protected:
 	virtual gpointer mainThread(HatoholThreadArg *arg)
 	{
 		ResourceHandler *job;
+		ResponseCompressor compressor;
+		ResponseCompressor::setThreadInstance(&compressor);
 		MLPL_INFO("start face-rest worker\n");
+		FaceRest::Impl *impl = m_faceRest->m_impl.get();
 		while ((job = waitNextJob())) {
-			job->handleInTryBlock();
-			job->unpauseResponse();
+			SmartTime startTime(SmartTime::INIT_CURR_TIME);
+			const bool coalesced = impl->joinSingleFlight(job);
+			if (!coalesced) {
+				job->handleInTryBlock();
+				impl->leaveSingleFlight(job);
+			}
+			SmartTime handlerTime(SmartTime::INIT_CURR_TIME);
+			handlerTime -= startTime;
+			impl->finishJob(job, handlerTime.getAsMSec());
+			// The leader replies to the coalesced job.
+			if (!coalesced)
+				job->unpauseResponse();
 			job->unref();
 		}
+		ResponseCompressor::setThreadInstance(NULL);
 		MLPL_INFO("exited face-rest worker\n");
 		return NULL;
 	}
@@ -269,6 +532,11 @@ FaceRest::FaceRest(FaceRestParam *param)
 		setNumberOfPreLoadWorkers(num);
 	}
 
+	int threshold =
+	  ConfigManager::getInstance()->getFaceRestCompressionThreshold();
+	if (threshold >= 0)
+		m_impl->compressionThreshold = threshold;
+
 	MLPL_INFO("started face-rest, port: %d, workers: %zu\n",
 		  m_impl->port, m_impl->numPreLoadWorkers);
 }
@@ -310,9 +578,30 @@ void FaceRest::setNumberOfPreLoadWorkers(size_t num)
 }
 
 void FaceRest::addResourceHandlerFactory(const char *path,
-					 ResourceHandlerFactory *factory)
+					 ResourceHandlerFactory *factory,
+					 const PriorityClass &priorityClass)
+{
+	m_impl->addHandler(path, factory, priorityClass);
+}
+
+void FaceRest::getPriorityClassStat(const PriorityClass &priorityClass,
+				    PriorityClassStat &stat)
+{
+	HATOHOL_ASSERT(priorityClass < NUM_PRIORITY_CLASSES,
+	               "Invalid priority class: %d", priorityClass);
+	m_impl->jobQueue.getStat(priorityClass, stat);
+}
+
+void FaceRest::getCompressionStat(CompressionStat &stat)
+{
+	AutoMutex autoLock(&m_impl->compressionStatLock);
+	stat = m_impl->compressionStat;
+}
+
+uint64_t FaceRest::getNumCoalescedRequests(void)
 {
-	m_impl->addHandler(path, factory);
+	AutoMutex autoLock(&m_impl->inFlightLock);
+	return m_impl->numCoalescedRequests;
 }
 
 // ---------------------------------------------------------------------------
@@ -347,7 +636,9 @@ bool FaceRest::isAsyncMode(void)
 
 void FaceRest::startWorkers(void)
 {
-	for (size_t i = 0; i < m_impl->numPreLoadWorkers; i++) {
+	m_impl->setupPriorityClasses();
+	const size_t numWorkers = m_impl->getNumWorkers();
+	for (size_t i = 0; i < numWorkers; i++) {
 		Worker *worker = new Worker(this);
 		worker->start();
 		m_impl->workers.insert(worker);
@@ -387,13 +678,16 @@ gpointer FaceRest::mainThread(HatoholThreadArg *arg)
 	soup_server_add_handler(m_impl->soupServer, NULL,
 	                        handlerDefault, this, NULL);
 	m_impl->addHandler("/hello.html",
-			  new ResourceHandlerFactory(this, &handlerHelloPage));
+			  new ResourceHandlerFactory(this, &handlerHelloPage),
+			  PRIORITY_HIGH);
 	m_impl->addHandler(pathForTest,
 			  new ResourceHandlerFactory(this, handlerTest));
 	m_impl->addHandler(pathForLogin,
-			  new ResourceHandlerFactory(this, handlerLogin));
+			  new ResourceHandlerFactory(this, handlerLogin),
+			  PRIORITY_HIGH);
 	m_impl->addHandler(pathForLogout,
-			  new ResourceHandlerFactory(this, handlerLogout));
+			  new ResourceHandlerFactory(this, handlerLogout),
+			  PRIORITY_HIGH);
 	RestResourceUser::registerFactories(this);
 	RestResourceServer::registerFactories(this);
 	RestResourceHost::registerFactories(this);
@@ -471,6 +765,8 @@ void FaceRest::Impl::queueRestJob
 	  = static_cast<ResourceHandlerFactory *>(user_data);
 	FaceRest *face = factory->m_faceRest;
 	ResourceHandler *job = factory->createHandler();
+	job->m_priorityClass = factory->m_priorityClass;
+	job->m_singleFlight = factory->m_singleFlight;
 	bool succeeded = job->setRequest(msg, path, query, client);
 	if (!succeeded) {
 		job->unref();
@@ -480,7 +776,9 @@ void FaceRest::Impl::queueRestJob
 	job->pauseResponse();
 
 	if (face->isAsyncMode()) {
-		face->m_impl->pushJob(job);
+		if (face->m_impl->pushJob(job))
+			return;
+		face->m_impl->rejectJob(job);
 	} else {
 		job->handleInTryBlock();
 		job->unpauseResponse();
@@ -619,7 +917,9 @@ FaceRest::ResourceHandler::ResourceHandler(FaceRest *faceRest,
 					   RestHandlerFunc handler)
 : m_faceRest(faceRest), m_staticHandlerFunc(handler), m_message(NULL),
   m_path(), m_query(NULL), m_client(NULL), m_mimeType(NULL),
-  m_userId(INVALID_USER_ID), m_replyIsPrepared(false)
+  m_userId(INVALID_USER_ID), m_replyIsPrepared(false),
+  m_priorityClass(PRIORITY_NORMAL),
+  m_singleFlight(false)
 {
 }
 
@@ -894,6 +1194,7 @@ void FaceRest::ResourceHandler::replyError(const HatoholError &hatoholError,
 	soup_message_body_append(m_message->response_body, SOUP_MEMORY_COPY,
 	                         response.c_str(), response.size());
 	soup_message_set_status(m_message, statusCode);
+	shareResponse(response, MIME_JSON, statusCode);
 
 	m_replyIsPrepared = true;
 }
@@ -912,13 +1213,159 @@ void FaceRest::ResourceHandler::replyJSONData(JSONBuilder &agent,
 		response = wrapForJSONP(response, m_jsonpCallbackName);
 	soup_message_headers_set_content_type(m_message->response_headers,
 	                                      m_mimeType, NULL);
-	soup_message_body_append(m_message->response_body, SOUP_MEMORY_COPY,
-	                         response.c_str(), response.size());
+	appendResponseBody(response);
+	soup_message_set_status(m_message, statusCode);
+	shareResponse(response, m_mimeType, statusCode);
+
+	m_replyIsPrepared = true;
+}
+
+void FaceRest::ResourceHandler::shareResponse(const string &body,
+					      const char *mimeType,
+					      const guint &statusCode)
+{
+	// m_singleFlight isn't changed after the job is queued.
+	if (!m_singleFlight || !m_faceRest)
+		return;
+	m_faceRest->m_impl->replyFollowers(this, body, mimeType, statusCode);
+}
+
+void FaceRest::ResourceHandler::replySharedResponse(const string &body,
+						    const char *mimeType,
+						    const guint &statusCode)
+{
+	soup_message_headers_set_content_type(m_message->response_headers,
+	                                      mimeType, NULL);
+	// Compressed for each request since Accept-Encoding can differ.
+	appendResponseBody(body);
 	soup_message_set_status(m_message, statusCode);
 
 	m_replyIsPrepared = true;
 }
 
+string FaceRest::ResourceHandler::normalizeQuery(GHashTable *query)
+{
+	if (!query)
+		return "";
+
+	map<string, string> sortedParams;
+	GHashTableIter iter;
+	gpointer key, value;
+	g_hash_table_iter_init(&iter, query);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		const char *name = static_cast<const char *>(key);
+		if (strcmp(name, "_") == 0)
+			continue;
+		const char *val = static_cast<const char *>(value);
+		sortedParams[name] = val ? val : "";
+	}
+
+	string normalized;
+	for (auto &param : sortedParams) {
+		gchar *name = g_uri_escape_string(param.first.c_str(),
+		                                  NULL, FALSE);
+		gchar *val = g_uri_escape_string(param.second.c_str(),
+		                                 NULL, FALSE);
+		if (!normalized.empty())
+			normalized += "&";
+		normalized += name;
+		normalized += "=";
+		normalized += val;
+		g_free(name);
+		g_free(val);
+	}
+	return normalized;
+}
+
+string FaceRest::ResourceHandler::makeSingleFlightKey(void)
+{
+	// Users who see the same set of servers and host groups get
+	// the same response. So the key has the set instead of the user ID.
+	DataQueryContext &dataQueryContext = *m_dataQueryContextPtr;
+	const OperationPrivilege &privilege =
+	  dataQueryContext.getOperationPrivilege();
+	string visibility = StringUtils::sprintf(
+	  "%" FMT_OPPRVLG, privilege.getFlags());
+	if (privilege.has(OPPRVLG_GET_ALL_SERVER)) {
+		visibility += ":all";
+	} else {
+		const ServerHostGrpSetMap &srvHostGrpSetMap =
+		  dataQueryContext.getServerHostGrpSetMap();
+		for (auto &srvHostGrps : srvHostGrpSetMap) {
+			visibility += StringUtils::sprintf(
+			  ":%" FMT_SERVER_ID, srvHostGrps.first);
+			for (auto &hostgroupId : srvHostGrps.second) {
+				visibility += ",";
+				visibility += hostgroupId;
+			}
+		}
+	}
+
+	string key = m_path;
+	key += "?";
+	key += normalizeQuery(m_query);
+	key += "#";
+	key += visibility;
+	return key;
+}
+
+void FaceRest::ResourceHandler::appendResponseBody(const string &body)
+{
+	ResponseCompressor::Encoding encoding =
+	  ResponseCompressor::chooseEncoding(m_message);
+	soup_message_headers_append(m_message->response_headers,
+	                            "Vary", "Accept-Encoding");
+	if (encoding == ResponseCompressor::ENCODING_IDENTITY || !m_faceRest) {
+		soup_message_body_append(m_message->response_body,
+		                         SOUP_MEMORY_COPY,
+		                         body.c_str(), body.size());
+		return;
+	}
+
+	Impl *impl = m_faceRest->m_impl.get();
+	if (body.size() < impl->compressionThreshold) {
+		impl->countSkippedCompression();
+		soup_message_body_append(m_message->response_body,
+		                         SOUP_MEMORY_COPY,
+		                         body.c_str(), body.size());
+		return;
+	}
+
+	// Replies made on other threads than workers, such as callbacks
+	// of on-demand fetch, use a temporary compressor.
+	unique_ptr<ResponseCompressor> localCompressor;
+	ResponseCompressor *compressor =
+	  ResponseCompressor::getThreadInstance();
+	if (!compressor) {
+		localCompressor.reset(new ResponseCompressor());
+		compressor = localCompressor.get();
+	}
+
+	gchar *compressed = NULL;
+	gsize compressedSize = 0;
+	const double cpuTimeStart = getThreadCPUTimeInMSec();
+	if (!compressor->compress(encoding, body,
+	                          compressed, compressedSize)) {
+		soup_message_body_append(m_message->response_body,
+		                         SOUP_MEMORY_COPY,
+		                         body.c_str(), body.size());
+		return;
+	}
+	const double cpuMSec = getThreadCPUTimeInMSec() - cpuTimeStart;
+
+	soup_message_headers_replace(
+	  m_message->response_headers, "Content-Encoding",
+	  ResponseCompressor::ENCODING_NAMES[encoding]);
+	soup_message_body_append(m_message->response_body, SOUP_MEMORY_TAKE,
+	                         compressed, compressedSize);
+	impl->addCompressionResult(body.size(), compressedSize, cpuMSec);
+	MLPL_DBG("compressed response: %s, %s, %zd -> %zd bytes (%.1f%%), "
+	         "CPU: %.3f ms\n",
+	         m_path.c_str(), ResponseCompressor::ENCODING_NAMES[encoding],
+	         body.size(), (size_t)compressedSize,
+	         100.0 * compressedSize / body.size(), cpuMSec);
+}
+
 void FaceRest::ResourceHandler::addHatoholError(JSONBuilder &agent,
 						const HatoholError &err)
 {
@@ -1093,7 +1540,9 @@ void FaceRest::ResourceHandler::addServersMap(
 
 FaceRest::ResourceHandlerFactory::ResourceHandlerFactory(
   FaceRest *faceRest, RestHandlerFunc handler)
-: m_faceRest(faceRest), m_staticHandlerFunc(handler)
+: m_faceRest(faceRest), m_staticHandlerFunc(handler),
+  m_priorityClass(PRIORITY_NORMAL),
+  m_singleFlight(false)
 {
 }
 
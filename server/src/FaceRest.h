@@ -44,9 +44,41 @@ public:
 	struct ResourceHandlerFactory;
 	struct ResourceHandler;
 
+	enum PriorityClass {
+		PRIORITY_HIGH,
+		PRIORITY_NORMAL,
+		PRIORITY_LOW,
+		NUM_PRIORITY_CLASSES,
+	};
+
+	struct PriorityClassStat {
+		size_t   maxRunning;
+		size_t   maxQueued;
+		size_t   running;
+		size_t   queued;
+		uint64_t numHandled;
+		uint64_t numRejected;
+		double   totalQueueWaitMSec; // from queueing to a worker pick-up
+		double   totalHandlerMSec;   // time spent in handle() on a worker
+
+		PriorityClassStat(void);
+	};
+
+	struct CompressionStat {
+		uint64_t numCompressed;
+		uint64_t numSkipped;   // smaller than the threshold
+		uint64_t totalInputBytes;
+		uint64_t totalOutputBytes;
+		double   totalCPUMSec; // CPU time of the compressing threads
+
+		CompressionStat(void);
+	};
+
 	static int API_VERSION;
 	static const char *SESSION_ID_HEADER_NAME;
 	static const int DEFAULT_NUM_WORKERS;
+	static const char *PRIORITY_CLASS_NAMES[NUM_PRIORITY_CLASSES];
+	static const size_t DEFAULT_COMPRESSION_THRESHOLD;
 
 	static void init(void);
 
@@ -55,8 +87,33 @@ public:
 	virtual void waitExit(void) override;
 	virtual void setNumberOfPreLoadWorkers(size_t num);
 
-	void addResourceHandlerFactory(const char *path,
-				       ResourceHandlerFactory *factory);
+	void addResourceHandlerFactory(
+	  const char *path, ResourceHandlerFactory *factory,
+	  const PriorityClass &priorityClass = PRIORITY_NORMAL);
+
+	/**
+	 * Get the scheduling statistics of the specified priority class.
+	 *
+	 * @param priorityClass A target priority class.
+	 * @param stat The statistics are stored in this instance.
+	 */
+	void getPriorityClassStat(const PriorityClass &priorityClass,
+				  PriorityClassStat &stat);
+
+	/**
+	 * Get the statistics of the compressed responses.
+	 *
+	 * @param stat The statistics are stored in this instance.
+	 */
+	void getCompressionStat(CompressionStat &stat);
+
+	/**
+	 * Get the number of requests that were answered with the response
+	 * of an identical request running at the same time.
+	 *
+	 * @return The number of coalesced requests.
+	 */
+	uint64_t getNumCoalescedRequests(void);
 
 protected:
 	class Worker;
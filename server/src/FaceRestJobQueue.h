@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FaceRestJobQueue_h
+#define FaceRestJobQueue_h
+
+#include <queue>
+#include <Mutex.h>
+#include <SmartTime.h>
+#include "FaceRest.h"
+
+/**
+ * FaceRestJobQueue holds the queued jobs of the priority classes of
+ * FaceRest and decides which job a free worker runs next.
+ *
+ * A job is popped from the highest class whose running count doesn't
+ * reach the limit of the class. In addition, the running jobs of the
+ * classes other than PRIORITY_HIGH are limited in total by
+ * setMaxLowerRunning(). When the limit is less than the number of the
+ * workers, a worker is always left for the high class.
+ */
+template<class Job>
+class FaceRestJobQueue {
+public:
+	typedef FaceRest::PriorityClass     PriorityClass;
+	typedef FaceRest::PriorityClassStat PriorityClassStat;
+
+	FaceRestJobQueue(void)
+	: m_maxLowerRunning(1),
+	  m_lowerRunning(0)
+	{
+	}
+
+	void setLimits(const PriorityClass &priorityClass,
+	               const size_t &maxRunning, const size_t &maxQueued)
+	{
+		mlpl::AutoMutex autoLock(&m_lock);
+		PriorityClassStat &stat = m_classes[priorityClass].stat;
+		stat.maxRunning = maxRunning;
+		stat.maxQueued = maxQueued;
+	}
+
+	/**
+	 * Set the maximum number of running jobs of the lower classes
+	 * (i.e. other than PRIORITY_HIGH) in total.
+	 *
+	 * @param num The maximum number. It must not be zero.
+	 */
+	void setMaxLowerRunning(const size_t &num)
+	{
+		mlpl::AutoMutex autoLock(&m_lock);
+		m_maxLowerRunning = num;
+	}
+
+	size_t getMaxLowerRunning(void)
+	{
+		mlpl::AutoMutex autoLock(&m_lock);
+		return m_maxLowerRunning;
+	}
+
+	/**
+	 * Queue a job.
+	 *
+	 * @param job A job to be queued.
+	 * @param priorityClass A class of the job.
+	 *
+	 * @return false if the queue of the class is full. Otherwise true.
+	 */
+	bool push(Job *job, const PriorityClass &priorityClass)
+	{
+		mlpl::AutoMutex autoLock(&m_lock);
+		JobClass &jobClass = m_classes[priorityClass];
+		if (jobClass.jobs.size() >= jobClass.stat.maxQueued) {
+			jobClass.stat.numRejected++;
+			return false;
+		}
+		QueuedJob queuedJob = {
+		  job, mlpl::SmartTime(mlpl::SmartTime::INIT_CURR_TIME)};
+		jobClass.jobs.push(queuedJob);
+		return true;
+	}
+
+	/**
+	 * Pop a runnable job.
+	 *
+	 * @param priorityClass The class of the popped job is stored.
+	 *
+	 * @return
+	 * A job to be run or NULL if there's no runnable job.
+	 */
+	Job *pop(PriorityClass &priorityClass)
+	{
+		mlpl::AutoMutex autoLock(&m_lock);
+		for (int i = 0; i < FaceRest::NUM_PRIORITY_CLASSES; i++) {
+			JobClass &jobClass = m_classes[i];
+			if (jobClass.jobs.empty())
+				continue;
+			if (jobClass.stat.running >= jobClass.stat.maxRunning)
+				continue;
+			const bool isLower = (i != FaceRest::PRIORITY_HIGH);
+			if (isLower && m_lowerRunning >= m_maxLowerRunning)
+				continue;
+			QueuedJob queuedJob = jobClass.jobs.front();
+			jobClass.jobs.pop();
+			jobClass.stat.running++;
+			if (isLower)
+				m_lowerRunning++;
+			mlpl::SmartTime waitTime(
+			  mlpl::SmartTime::INIT_CURR_TIME);
+			waitTime -= queuedJob.queuedTime;
+			jobClass.stat.totalQueueWaitMSec +=
+			  waitTime.getAsMSec();
+			priorityClass = static_cast<PriorityClass>(i);
+			return queuedJob.job;
+		}
+		return NULL;
+	}
+
+	/**
+	 * Notify the end of a job popped by pop().
+	 *
+	 * @param priorityClass A class of the job.
+	 * @param handlerMSec Time spent to run the job.
+	 *
+	 * @return true if a queued job may become runnable. Otherwise false.
+	 */
+	bool finish(const PriorityClass &priorityClass,
+	            const double &handlerMSec)
+	{
+		mlpl::AutoMutex autoLock(&m_lock);
+		PriorityClassStat &stat = m_classes[priorityClass].stat;
+		stat.running--;
+		stat.numHandled++;
+		stat.totalHandlerMSec += handlerMSec;
+		if (priorityClass != FaceRest::PRIORITY_HIGH)
+			m_lowerRunning--;
+		// The limits depend on each other. So a job of any class
+		// may have been deferred.
+		for (int i = 0; i < FaceRest::NUM_PRIORITY_CLASSES; i++) {
+			if (!m_classes[i].jobs.empty())
+				return true;
+		}
+		return false;
+	}
+
+	void getStat(const PriorityClass &priorityClass,
+	             PriorityClassStat &stat)
+	{
+		mlpl::AutoMutex autoLock(&m_lock);
+		const JobClass &jobClass = m_classes[priorityClass];
+		stat = jobClass.stat;
+		stat.queued = jobClass.jobs.size();
+	}
+
+private:
+	struct QueuedJob {
+		Job             *job;
+		mlpl::SmartTime  queuedTime;
+	};
+
+	struct JobClass {
+		std::queue<QueuedJob> jobs;
+		PriorityClassStat     stat;
+	};
+
+	mlpl::Mutex m_lock;
+	JobClass    m_classes[FaceRest::NUM_PRIORITY_CLASSES];
+	size_t      m_maxLowerRunning;
+	size_t      m_lowerRunning;
+};
+
+#endif // FaceRestJobQueue_h
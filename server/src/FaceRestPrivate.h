@@ -67,6 +67,7 @@ public:
 			const guint &statusCode = SOUP_STATUS_OK);
 	void replyHttpStatus(const guint &statusCode);
 	void replyJSONData(JSONBuilder &agent, const guint &statusCode = SOUP_STATUS_OK);
+	void appendResponseBody(const std::string &body);
 	void addServersMap(JSONBuilder &agent,
 			   TriggerBriefMaps *triggerMaps = NULL,
 			   bool lookupTriggerBrief = false);
@@ -77,6 +78,21 @@ public:
 	static void addHatoholError(JSONBuilder &agent,
 	                            const HatoholError &err);
 
+	/**
+	 * Make a canonical string of query parameters. The parameters are
+	 * sorted by the name and the cache buster of jQuery ('_') is
+	 * ignored, so that equivalent requests result in the same string.
+	 *
+	 * @param query Query parameters. It can be NULL.
+	 * @return A normalized query string.
+	 */
+	static std::string normalizeQuery(GHashTable *query);
+
+	std::string makeSingleFlightKey(void);
+	void replySharedResponse(const std::string &body,
+				 const char *mimeType,
+				 const guint &statusCode);
+
 public:
 	FaceRest          *m_faceRest;
 	RestHandlerFunc    m_staticHandlerFunc;
@@ -98,8 +114,19 @@ public:
 	bool        m_replyIsPrepared;
 	DataQueryContextPtr m_dataQueryContextPtr;
 
+	// scheduling
+	FaceRest::PriorityClass m_priorityClass;
+
+	// single-flight coalescing
+	bool        m_singleFlight;
+	// Set while the job leads a single flight. It's guarded by
+	// the lock of the in-flight jobs.
+	std::string m_singleFlightKey;
+
 protected:
 	bool parseRequest(void);
+	void shareResponse(const std::string &body, const char *mimeType,
+			   const guint &statusCode);
 	std::string getJSONPCallbackName(void);
 	bool parseFormatType(void);
 };
@@ -113,6 +140,11 @@ struct FaceRest::ResourceHandlerFactory
 
 	FaceRest        *m_faceRest;
 	RestHandlerFunc  m_staticHandlerFunc;
+	FaceRest::PriorityClass m_priorityClass;
+
+	// Identical GET requests running at the same time share
+	// the response of the first one if this is true.
+	bool             m_singleFlight;
 };
 
 #define REPLY_ERROR(JOB, ERR_CODE, ERR_MSG_FMT, ...) \
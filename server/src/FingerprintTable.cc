@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <set>
+#include "FingerprintTable.h"
+
+using namespace std;
+using namespace mlpl;
+
+static const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+static const uint64_t FNV_PRIME        = 1099511628211ULL;
+
+// ---------------------------------------------------------------------------
+// Fingerprint
+// ---------------------------------------------------------------------------
+Fingerprint::Fingerprint(void)
+: m_value(FNV_OFFSET_BASIS)
+{
+}
+
+Fingerprint &Fingerprint::add(const string &value)
+{
+	// The length is added so that ("ab", "c") differs from ("a", "bc").
+	add(static_cast<int64_t>(value.size()));
+	addBytes(value.data(), value.size());
+	return *this;
+}
+
+Fingerprint &Fingerprint::add(const int64_t &value)
+{
+	addBytes(&value, sizeof(value));
+	return *this;
+}
+
+uint64_t Fingerprint::get(void) const
+{
+	return m_value;
+}
+
+void Fingerprint::addBytes(const void *data, const size_t &size)
+{
+	const uint8_t *bytes = static_cast<const uint8_t *>(data);
+	for (size_t i = 0; i < size; i++) {
+		m_value ^= bytes[i];
+		m_value *= FNV_PRIME;
+	}
+}
+
+// ---------------------------------------------------------------------------
+// FingerprintTable
+// ---------------------------------------------------------------------------
+typedef pair<FingerprintTable::Kind, ServerIdType> GenerationKey;
+
+static Mutex                          generationLock;
+static map<GenerationKey, uint64_t>   generationMap;
+// The table that the current thread is writing.
+static __thread FingerprintTable     *tls_currentWriter = NULL;
+
+FingerprintTable::WriterScope::WriterScope(FingerprintTable &table)
+: m_prevWriter(tls_currentWriter)
+{
+	const uint64_t generation =
+	  getGeneration(table.m_kind, table.m_serverId);
+	{
+		AutoMutex autoLock(&table.m_lock);
+		table.m_writerGeneration = generation;
+	}
+	tls_currentWriter = &table;
+}
+
+FingerprintTable::WriterScope::~WriterScope()
+{
+	tls_currentWriter = m_prevWriter;
+}
+
+void FingerprintTable::invalidate(const Kind &kind,
+				  const ServerIdType &serverId)
+{
+	if (tls_currentWriter && tls_currentWriter->m_kind == kind &&
+	    tls_currentWriter->m_serverId == serverId) {
+		return;
+	}
+	AutoMutex autoLock(&generationLock);
+	generationMap[GenerationKey(kind, serverId)]++;
+}
+
+uint64_t FingerprintTable::getGeneration(const Kind &kind,
+					 const ServerIdType &serverId)
+{
+	if (kind == KIND_NONE)
+		return 0;
+	AutoMutex autoLock(&generationLock);
+	// A write for ALL_SERVERS affects the tables of every server.
+	return generationMap[GenerationKey(kind, serverId)] +
+	       generationMap[GenerationKey(kind, ALL_SERVERS)];
+}
+
+FingerprintTable::FingerprintTable(const Kind &kind,
+				   const ServerIdType &serverId)
+: m_kind(kind),
+  m_serverId(serverId),
+  m_seeded(false),
+  m_generation(0),
+  m_writerGeneration(0)
+{
+}
+
+bool FingerprintTable::isSeeded(void)
+{
+	AutoMutex autoLock(&m_lock);
+	return isSeededWithoutLock();
+}
+
+void FingerprintTable::getDelta(const EntryVect &entries,
+				vector<size_t> &changedIndexes,
+				vector<string> &removedKeys)
+{
+	AutoMutex autoLock(&m_lock);
+	set<string> currentKeys;
+	for (size_t i = 0; i < entries.size(); i++) {
+		const Entry &entry = entries[i];
+		currentKeys.insert(entry.first);
+		auto it = m_fingerprintMap.find(entry.first);
+		if (it == m_fingerprintMap.end() || it->second != entry.second)
+			changedIndexes.push_back(i);
+	}
+	for (auto &pair : m_fingerprintMap) {
+		if (currentKeys.find(pair.first) == currentKeys.end())
+			removedKeys.push_back(pair.first);
+	}
+}
+
+void FingerprintTable::replace(const EntryVect &entries)
+{
+	const uint64_t generation = getGeneration(m_kind, m_serverId);
+	AutoMutex autoLock(&m_lock);
+	m_fingerprintMap.clear();
+	m_seeded = false;
+	// Someone else wrote the rows while we did. The entries may not
+	// be what the DB has.
+	if (tls_currentWriter == this && generation != m_writerGeneration)
+		return;
+	for (auto &entry : entries)
+		m_fingerprintMap[entry.first] = entry.second;
+	m_seeded = true;
+	m_generation = generation;
+}
+
+void FingerprintTable::update(const EntryVect &entries)
+{
+	AutoMutex autoLock(&m_lock);
+	if (!isSeededWithoutLock())
+		return;
+	for (auto &entry : entries)
+		m_fingerprintMap[entry.first] = entry.second;
+}
+
+void FingerprintTable::clear(void)
+{
+	AutoMutex autoLock(&m_lock);
+	m_fingerprintMap.clear();
+	m_seeded = false;
+}
+
+size_t FingerprintTable::size(void)
+{
+	AutoMutex autoLock(&m_lock);
+	return m_fingerprintMap.size();
+}
+
+// ---------------------------------------------------------------------------
+// Private methods
+// ---------------------------------------------------------------------------
+bool FingerprintTable::isSeededWithoutLock(void)
+{
+	if (!m_seeded)
+		return false;
+	if (m_generation != getGeneration(m_kind, m_serverId)) {
+		m_fingerprintMap.clear();
+		m_seeded = false;
+	}
+	return m_seeded;
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FingerprintTable_h
+#define FingerprintTable_h
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <stdint.h>
+#include <Mutex.h>
+#include "Params.h"
+
+/**
+ * Fingerprint is a 64-bit content hash (FNV-1a) of some values.
+ */
+class Fingerprint {
+public:
+	Fingerprint(void);
+	Fingerprint &add(const std::string &value);
+	Fingerprint &add(const int64_t &value);
+	uint64_t get(void) const;
+
+private:
+	void addBytes(const void *data, const size_t &size);
+
+	uint64_t m_value;
+};
+
+/**
+ * FingerprintTable remembers a fingerprint for each element of a list
+ * that has been stored in the DB.
+ *
+ * It is used to find the elements that differ from the stored ones
+ * without reading the DB. The table isn't seeded until the first
+ * replace().
+ *
+ * A table can be bound to the rows of a kind of a server. The code that
+ * writes such rows calls invalidate() and the bound tables are no longer
+ * seeded then. The writes done in a WriterScope of the table don't
+ * invalidate it, but replace() in the scope doesn't seed the table if
+ * another thread wrote the rows meanwhile. All methods are thread safe.
+ */
+class FingerprintTable {
+public:
+	typedef std::pair<std::string, uint64_t> Entry;
+	typedef std::vector<Entry>               EntryVect;
+
+	enum Kind {
+		KIND_NONE,
+		KIND_TRIGGERS,
+		KIND_HOSTS,
+		KIND_HOSTGROUPS,
+	};
+
+	/**
+	 * Mark the current thread as the writer of a table while
+	 * the instance exists.
+	 */
+	class WriterScope {
+	public:
+		WriterScope(FingerprintTable &table);
+		virtual ~WriterScope();
+	private:
+		FingerprintTable *m_prevWriter;
+	};
+
+	/**
+	 * Tell that rows of a server have been written.
+	 *
+	 * @param kind A kind of the rows.
+	 * @param serverId
+	 * A server ID of the rows. ALL_SERVERS invalidates the tables of
+	 * all servers.
+	 */
+	static void invalidate(const Kind &kind, const ServerIdType &serverId);
+
+	/**
+	 * Tell that rows of the servers of elements have been written.
+	 *
+	 * @param kind A kind of the rows.
+	 * @param list Elements that have serverId.
+	 */
+	template<class List>
+	static void invalidate(const Kind &kind, const List &list)
+	{
+		std::set<ServerIdType> serverIds;
+		for (auto &element : list)
+			serverIds.insert(element.serverId);
+		for (auto serverId : serverIds)
+			invalidate(kind, serverId);
+	}
+
+	FingerprintTable(const Kind &kind = KIND_NONE,
+	                 const ServerIdType &serverId = ALL_SERVERS);
+
+	bool isSeeded(void);
+
+	/**
+	 * Compare entries with the stored ones.
+	 *
+	 * @param entries Entries of the current list.
+	 * @param changedIndexes
+	 * Indexes of the entries that are new or have another fingerprint
+	 * are added to this vector.
+	 * @param removedKeys
+	 * Keys that are stored but aren't in the entries are added to
+	 * this vector.
+	 */
+	void getDelta(const EntryVect &entries,
+		      std::vector<size_t> &changedIndexes,
+		      std::vector<std::string> &removedKeys);
+
+	/**
+	 * Replace all stored entries and mark the table as seeded.
+	 */
+	void replace(const EntryVect &entries);
+
+	/**
+	 * Overwrite or add entries if the table is seeded.
+	 */
+	void update(const EntryVect &entries);
+
+	/**
+	 * Forget all entries. The next delta has to be made with the DB.
+	 */
+	void clear(void);
+
+	size_t size(void);
+
+private:
+	static uint64_t getGeneration(const Kind &kind,
+	                              const ServerIdType &serverId);
+	// Should be called with m_lock.
+	bool isSeededWithoutLock(void);
+
+	const Kind                      m_kind;
+	const ServerIdType              m_serverId;
+	mlpl::Mutex                     m_lock;
+	bool                            m_seeded;
+	// The generation of the rows when the table is seeded.
+	uint64_t                        m_generation;
+	// The generation of the rows when a WriterScope begins.
+	uint64_t                        m_writerGeneration;
+	std::map<std::string, uint64_t> m_fingerprintMap;
+};
+
+#endif // FingerprintTable_h
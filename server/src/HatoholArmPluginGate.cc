@@ -39,6 +39,7 @@
 #include "StringUtils.h"
 #include "HostInfoCache.h"
 #include "HatoholDBUtils.h"
+#include "HapiItemTableView.h"
 #include "UnifiedDataStore.h"
 #include "ConfigManager.h"
 
@@ -303,11 +304,11 @@ bool HatoholArmPluginGate::startOnDemandFetchItems(
 			serverStatus.serverId = serverId;
 
 			replyBuf.setIndex(sizeof(HapiResponseHeader));
-			ItemTablePtr itemTablePtr = createItemTable(replyBuf);
-			ItemTablePtr appTablePtr  = createItemTable(replyBuf);
+			const HapiItemTableView itemTable(replyBuf);
+			const HapiItemTableView appTable(replyBuf);
 			ItemInfoList itemList;
 			HatoholDBUtils::transformItemsToHatoholFormat(
-			  itemList, serverStatus, itemTablePtr, appTablePtr,
+			  itemList, serverStatus, itemTable, appTable,
 			  serverId, hostInfoCache);
 			UnifiedDataStore *dataStore = UnifiedDataStore::getInstance();
 			dataStore->addItemList(itemList);
@@ -416,10 +417,10 @@ bool HatoholArmPluginGate::startOnDemandFetchTriggers(
 		                          override
 		{
 			replyBuf.setIndex(sizeof(HapiResponseHeader));
-			ItemTablePtr tablePtr = createItemTable(replyBuf);
+			const HapiItemTableView table(replyBuf);
 			TriggerInfoList trigInfoList;
 			HatoholDBUtils::transformTriggersToHatoholFormat(
-			  trigInfoList, tablePtr, serverId, *hostInfoCache);
+			  trigInfoList, table, serverId, *hostInfoCache);
 
 			ThreadLocalDBCache cache;
 			cache.getMonitoring().updateTrigger(trigInfoList, serverId);
@@ -1034,10 +1035,10 @@ void HatoholArmPluginGate::parseCmdHandlerTriggerList(TriggerInfoList &trigInfoL
 	HATOHOL_ASSERT(cmdBuf, "Current buffer: NULL");
 
 	cmdBuf->setIndex(sizeof(HapiCommandHeader));
-	ItemTablePtr tablePtr = createItemTable(*cmdBuf);
+	const HapiItemTableView table(*cmdBuf);
 
 	HatoholDBUtils::transformTriggersToHatoholFormat(
-	  trigInfoList, tablePtr, m_impl->serverInfo.id, m_impl->hostInfoCache);
+	  trigInfoList, table, m_impl->serverInfo.id, m_impl->hostInfoCache);
 
 	return;
 }
@@ -23,6 +23,9 @@
 #include "HatoholArmPluginGateHAPI2.h"
 #include "ThreadLocalDBCache.h"
 #include "UnifiedDataStore.h"
+#include "IngestionPipeline.h"
+#include "HistoryStore.h"
+#include "FingerprintTable.h"
 #include "ArmFake.h"
 #include "ChildProcessManager.h"
 #include <libsoup/soup.h>
@@ -32,6 +35,65 @@
 using namespace std;
 using namespace mlpl;
 
+static void makeFingerprints(const TriggerInfoList &triggerInfoList,
+			     FingerprintTable::EntryVect &entries)
+{
+	for (auto &trigger : triggerInfoList) {
+		Fingerprint fingerprint;
+		fingerprint.add(trigger.status)
+		           .add(trigger.severity)
+		           .add(trigger.lastChangeTime.tv_sec)
+		           .add(trigger.lastChangeTime.tv_nsec)
+		           .add(trigger.globalHostId)
+		           .add(trigger.hostIdInServer)
+		           .add(trigger.hostName)
+		           .add(trigger.brief)
+		           .add(trigger.extendedInfo)
+		           .add(trigger.validity);
+		entries.push_back(make_pair(trigger.id, fingerprint.get()));
+	}
+}
+
+static void makeFingerprints(const ServerHostDefVect &svHostDefs,
+			     FingerprintTable::EntryVect &entries)
+{
+	for (auto &svHostDef : svHostDefs) {
+		Fingerprint fingerprint;
+		fingerprint.add(svHostDef.name).add(svHostDef.status);
+		entries.push_back(
+		  make_pair(svHostDef.hostIdInServer, fingerprint.get()));
+	}
+}
+
+static void makeFingerprints(const HostgroupVect &hostgroups,
+			     FingerprintTable::EntryVect &entries)
+{
+	for (auto &hostgroup : hostgroups) {
+		Fingerprint fingerprint;
+		fingerprint.add(hostgroup.name);
+		entries.push_back(
+		  make_pair(hostgroup.idInServer, fingerprint.get()));
+	}
+}
+
+template<typename ListType>
+static void pickElements(const ListType &src,
+			 const vector<size_t> &indexes, ListType &dest)
+{
+	// indexes is sorted in ascending order.
+	auto indexItr = indexes.begin();
+	size_t i = 0;
+	for (auto &element : src) {
+		if (indexItr == indexes.end())
+			break;
+		if (*indexItr == i) {
+			dest.push_back(element);
+			++indexItr;
+		}
+		i++;
+	}
+}
+
 struct JSONRPCError {
 	StringList errors;
 	void addError(const char *format,
@@ -106,6 +168,14 @@ struct HatoholArmPluginGateHAPI2::Impl
 	string m_pluginProcessName;
 	string m_pluginControlScriptPath;
 	set<string> m_supportedProcedureNameSet;
+	string m_negotiatedEncoding;
+	// Fingerprints of the elements stored by the last "ALL" update.
+	// They are used to skip reading the whole list from the DB, and
+	// are invalidated when the rows of the server are written by
+	// other code.
+	FingerprintTable m_triggerFingerprints;
+	FingerprintTable m_hostFingerprints;
+	FingerprintTable m_hostgroupFingerprints;
 	HostInfoCache hostInfoCache;
 	map<string, Closure0 *> m_fetchClosureMap;
 	map<string, Closure1<HistoryInfoVect> *> m_fetchHistoryClosureMap;
@@ -120,6 +190,12 @@ struct HatoholArmPluginGateHAPI2::Impl
 	  m_armFake(m_serverInfo),
 	  m_armStatus(),
 	  m_createdSelfTriggers(false),
+	  m_negotiatedEncoding(HAPI2_ENCODING_JSON),
+	  m_triggerFingerprints(FingerprintTable::KIND_TRIGGERS,
+	                        _serverInfo.id),
+	  m_hostFingerprints(FingerprintTable::KIND_HOSTS, _serverInfo.id),
+	  m_hostgroupFingerprints(FingerprintTable::KIND_HOSTGROUPS,
+	                          _serverInfo.id),
 	  hostInfoCache(&_serverInfo.id)
 	{
 		ArmPluginInfo::initialize(m_pluginInfo);
@@ -181,6 +257,8 @@ struct HatoholArmPluginGateHAPI2::Impl
 		}
 		parser.endObject(); // procedures
 
+		parseEncodings(parser);
+
 		PARSE_AS_MANDATORY("name", m_pluginProcessName, errObj);
 		MLPL_INFO("HAP Process connecting done. "
 			  "Connected HAP process name: \"%s\"\n",
@@ -188,6 +266,33 @@ struct HatoholArmPluginGateHAPI2::Impl
 		return true;
 	}
 
+	void parseEncodings(JSONParser &parser)
+	{
+		// "encodings" is optional. Old plugins only send JSON.
+		m_negotiatedEncoding = HAPI2_ENCODING_JSON;
+		if (!parser.isMember("encodings"))
+			return;
+		parser.startObject("encodings");
+		size_t num = parser.countElements();
+		for (size_t i = 0; i < num; i++) {
+			string encoding;
+			parser.read(i, encoding);
+			if (encoding == HAPI2_ENCODING_MESSAGE_PACK)
+				m_negotiatedEncoding = encoding;
+		}
+		parser.endObject(); // encodings
+		MLPL_INFO("Negotiated encoding: %s\n",
+			  m_negotiatedEncoding.c_str());
+	}
+
+	static void addEncodings(JSONBuilder &builder)
+	{
+		builder.startArray("encodings");
+		builder.add(HAPI2_ENCODING_JSON);
+		builder.add(HAPI2_ENCODING_MESSAGE_PACK);
+		builder.endArray();
+	}
+
 	struct ExchangeProfileCallback : public ProcedureCallback {
 		Impl &m_impl;
 		ExchangeProfileCallback(Impl &impl)
@@ -269,6 +374,7 @@ struct HatoholArmPluginGateHAPI2::Impl
 			builder.add(procedureDef.name);
 		}
 		builder.endArray(); // procedures
+		addEncodings(builder);
 		builder.endObject(); // params
 		std::mt19937 random = m_hapi2.getRandomEngine();
 		int64_t id = random();
@@ -312,6 +418,169 @@ struct HatoholArmPluginGateHAPI2::Impl
 		}
 	}
 
+	void syncTriggers(const TriggerInfoList &triggerInfoList)
+	{
+		FingerprintTable &table = m_triggerFingerprints;
+		FingerprintTable::WriterScope writerScope(table);
+		FingerprintTable::EntryVect entries;
+		makeFingerprints(triggerInfoList, entries);
+
+		ThreadLocalDBCache cache;
+		DBTablesMonitoring &dbMonitoring = cache.getMonitoring();
+		if (!table.isSeeded()) {
+			HatoholError err =
+			  dbMonitoring.syncTriggers(triggerInfoList,
+						    m_serverInfo.id);
+			if (err == HTERR_OK)
+				table.replace(entries);
+			return;
+		}
+
+		vector<size_t> changedIndexes;
+		vector<string> removedKeys;
+		table.getDelta(entries, changedIndexes, removedKeys);
+		if (changedIndexes.empty() && removedKeys.empty())
+			return;
+
+		// Forget the fingerprints until the delta is stored, so that
+		// the next update reads the DB if something fails.
+		table.clear();
+		HatoholError err(HTERR_OK);
+		if (!removedKeys.empty()) {
+			TriggerIdList idList(removedKeys.begin(),
+					     removedKeys.end());
+			err = dbMonitoring.deleteTriggerInfo(idList,
+							     m_serverInfo.id);
+		}
+		if (!changedIndexes.empty()) {
+			TriggerInfoList changedTriggers;
+			pickElements(triggerInfoList, changedIndexes,
+				     changedTriggers);
+			dbMonitoring.addTriggerInfoList(changedTriggers);
+		}
+		if (err == HTERR_OK)
+			table.replace(entries);
+		MLPL_DBG("Trigger delta: changed: %zd, removed: %zd\n",
+			 changedIndexes.size(), removedKeys.size());
+	}
+
+	void upsertTriggers(const TriggerInfoList &triggerInfoList)
+	{
+		FingerprintTable::WriterScope writerScope(
+		  m_triggerFingerprints);
+		ThreadLocalDBCache cache;
+		cache.getMonitoring().addTriggerInfoList(triggerInfoList);
+		FingerprintTable::EntryVect entries;
+		makeFingerprints(triggerInfoList, entries);
+		m_triggerFingerprints.update(entries);
+	}
+
+	void syncHostsWithDB(const ServerHostDefVect &svHostDefs,
+			     const FingerprintTable::EntryVect &entries)
+	{
+		UnifiedDataStore *dataStore = UnifiedDataStore::getInstance();
+		HatoholError err =
+		  dataStore->syncHosts(svHostDefs, m_serverInfo.id,
+				       hostInfoCache);
+		if (err == HTERR_OK)
+			m_hostFingerprints.replace(entries);
+	}
+
+	void syncHosts(const ServerHostDefVect &svHostDefs)
+	{
+		FingerprintTable &table = m_hostFingerprints;
+		FingerprintTable::WriterScope writerScope(table);
+		FingerprintTable::EntryVect entries;
+		makeFingerprints(svHostDefs, entries);
+		if (!table.isSeeded()) {
+			syncHostsWithDB(svHostDefs, entries);
+			return;
+		}
+
+		vector<size_t> changedIndexes;
+		vector<string> removedKeys;
+		table.getDelta(entries, changedIndexes, removedKeys);
+		if (changedIndexes.empty() && removedKeys.empty())
+			return;
+
+		table.clear();
+		if (!removedKeys.empty()) {
+			// Removed hosts are marked with their stored records,
+			// which only the DB has.
+			syncHostsWithDB(svHostDefs, entries);
+			return;
+		}
+		ServerHostDefVect changedHosts;
+		pickElements(svHostDefs, changedIndexes, changedHosts);
+		upsertHosts(changedHosts);
+		table.replace(entries);
+		MLPL_DBG("Host delta: changed: %zd\n", changedIndexes.size());
+	}
+
+	void upsertHosts(const ServerHostDefVect &svHostDefs)
+	{
+		FingerprintTable::WriterScope writerScope(m_hostFingerprints);
+		UnifiedDataStore *dataStore = UnifiedDataStore::getInstance();
+		HostHostIdMap hostsMap;
+		dataStore->upsertHosts(svHostDefs, &hostsMap);
+		hostInfoCache.update(svHostDefs, &hostsMap);
+		FingerprintTable::EntryVect entries;
+		makeFingerprints(svHostDefs, entries);
+		m_hostFingerprints.update(entries);
+	}
+
+	void syncHostgroupsWithDB(const HostgroupVect &hostgroups,
+				  const FingerprintTable::EntryVect &entries)
+	{
+		UnifiedDataStore *dataStore = UnifiedDataStore::getInstance();
+		HatoholError err =
+		  dataStore->syncHostgroups(hostgroups, m_serverInfo.id);
+		if (err == HTERR_OK)
+			m_hostgroupFingerprints.replace(entries);
+	}
+
+	void syncHostgroups(const HostgroupVect &hostgroups)
+	{
+		FingerprintTable &table = m_hostgroupFingerprints;
+		FingerprintTable::WriterScope writerScope(table);
+		FingerprintTable::EntryVect entries;
+		makeFingerprints(hostgroups, entries);
+		if (!table.isSeeded()) {
+			syncHostgroupsWithDB(hostgroups, entries);
+			return;
+		}
+
+		vector<size_t> changedIndexes;
+		vector<string> removedKeys;
+		table.getDelta(entries, changedIndexes, removedKeys);
+		if (changedIndexes.empty() && removedKeys.empty())
+			return;
+
+		table.clear();
+		if (!removedKeys.empty()) {
+			// Deleting needs the IDs of the records in the DB.
+			syncHostgroupsWithDB(hostgroups, entries);
+			return;
+		}
+		HostgroupVect changedHostgroups;
+		pickElements(hostgroups, changedIndexes, changedHostgroups);
+		upsertHostgroups(changedHostgroups);
+		table.replace(entries);
+		MLPL_DBG("Hostgroup delta: changed: %zd\n",
+			 changedIndexes.size());
+	}
+
+	void upsertHostgroups(const HostgroupVect &hostgroups)
+	{
+		FingerprintTable::WriterScope writerScope(
+		  m_hostgroupFingerprints);
+		UnifiedDataStore *dataStore = UnifiedDataStore::getInstance();
+		dataStore->upsertHostgroups(hostgroups);
+		FingerprintTable::EntryVect entries;
+		makeFingerprints(hostgroups, entries);
+		m_hostgroupFingerprints.update(entries);
+	}
+
 	void queueFetchCallback(const string &fetchId, Closure0 *closure)
 	{
 		if (fetchId.empty())
@@ -729,6 +998,11 @@ bool HatoholArmPluginGateHAPI2::isEstablished(void)
 	return m_impl->isEstablished();
 }
 
+string HatoholArmPluginGateHAPI2::getNegotiatedEncoding(void)
+{
+	return m_impl->m_negotiatedEncoding;
+}
+
 bool HatoholArmPluginGateHAPI2::parseTimeStamp(
   const string &timeStampString, timespec &timeStamp, const bool allowEmpty)
 {
@@ -979,6 +1253,7 @@ string HatoholArmPluginGateHAPI2::procedureHandlerExchangeProfile(
 		builder.add(procedureDef.name);
 	}
 	builder.endArray(); // procedures
+	Impl::addEncodings(builder);
 	builder.endObject(); // result
 	setResponseId(parser, builder);
 	builder.endObject();
@@ -1127,7 +1402,6 @@ static bool parseItemParams(JSONParser &parser, ItemInfoList &itemInfoList,
 
 string HatoholArmPluginGateHAPI2::procedureHandlerPutItems(JSONParser &parser)
 {
-	UnifiedDataStore *dataStore = UnifiedDataStore::getInstance();
 	ItemInfoList itemList;
 	JSONRPCError errObj;
 	string fetchId;
@@ -1154,7 +1428,14 @@ string HatoholArmPluginGateHAPI2::procedureHandlerPutItems(JSONParser &parser)
 		  &errObj.getErrors(), &parser);
 	}
 
-	dataStore->addItemList(itemList);
+	// The waiter of a fetch reads the DB as soon as it's notified.
+	const bool waitForCommit = !fetchId.empty();
+	if (!IngestionPipeline::getInstance().addItemList(itemList,
+	                                                  waitForCommit)) {
+		return HatoholArmPluginInterfaceHAPI2::buildErrorResponse(
+		  JSON_RPC_INTERNAL_ERROR, "Failed to store items.",
+		  NULL, &parser);
+	}
 
 	if (!fetchId.empty()) {
 		m_impl->runFetchCallback(fetchId);
@@ -1233,6 +1514,10 @@ string HatoholArmPluginGateHAPI2::procedureHandlerPutHistory(
 
 	if (!fetchId.empty()) {
 		m_impl->runFetchHistoryCallback(fetchId, historyInfoVect);
+	} else {
+		// The samples pushed by the plugin. The results of a fetch
+		// are stored by HistoryStore::fetch() with the coverage.
+		HistoryStore::getInstance()->add(historyInfoVect);
 	}
 
 	// TODO: add error clause
@@ -1293,7 +1578,6 @@ static bool parseUpdateType(JSONParser &parser, string &updateType,
 string HatoholArmPluginGateHAPI2::procedureHandlerPutHosts(
   JSONParser &parser)
 {
-	UnifiedDataStore *dataStore = UnifiedDataStore::getInstance();
 	ServerHostDefVect hostInfoVect;
 	JSONRPCError errObj;
 	string lastInfo;
@@ -1326,14 +1610,10 @@ string HatoholArmPluginGateHAPI2::procedureHandlerPutHosts(
 	}
 
 	// TODO: reflect error in response
-	if (checkInvalidHosts) {
-		dataStore->syncHosts(hostInfoVect, serverInfo.id,
-				     m_impl->hostInfoCache);
-	} else {
-		HostHostIdMap hostsMap;
-		dataStore->upsertHosts(hostInfoVect, &hostsMap);
-		m_impl->hostInfoCache.update(hostInfoVect, &hostsMap);
-	}
+	if (checkInvalidHosts)
+		m_impl->syncHosts(hostInfoVect);
+	else
+		m_impl->upsertHosts(hostInfoVect);
 
 	// TODO: add error clause
 	string result = "SUCCESS";
@@ -1378,7 +1658,6 @@ static bool parseHostGroupsParams(JSONParser &parser,
 string HatoholArmPluginGateHAPI2::procedureHandlerPutHostGroups(
   JSONParser &parser)
 {
-	UnifiedDataStore *dataStore = UnifiedDataStore::getInstance();
 	HostgroupVect hostgroupVect;
 	JSONRPCError errObj;
 	string lastInfo;
@@ -1410,11 +1689,10 @@ string HatoholArmPluginGateHAPI2::procedureHandlerPutHostGroups(
 	}
 
 	// TODO: reflect error in response
-	if (checkInvalidHostGroups) {
-		dataStore->syncHostgroups(hostgroupVect, serverInfo.id);
-	} else {
-		dataStore->upsertHostgroups(hostgroupVect);
-	}
+	if (checkInvalidHostGroups)
+		m_impl->syncHostgroups(hostgroupVect);
+	else
+		m_impl->upsertHostgroups(hostgroupVect);
 
 	// TODO: Add failure clause
 	string result = "SUCCESS";
@@ -1651,8 +1929,6 @@ static bool parseTriggersParams(JSONParser &parser, TriggerInfoList &triggerInfo
 string HatoholArmPluginGateHAPI2::procedureHandlerPutTriggers(
   JSONParser &parser)
 {
-	ThreadLocalDBCache cache;
-	DBTablesMonitoring &dbMonitoring = cache.getMonitoring();
 	TriggerInfoList triggerInfoList;
 	JSONRPCError errObj;
 	string lastInfo;
@@ -1690,11 +1966,10 @@ string HatoholArmPluginGateHAPI2::procedureHandlerPutTriggers(
 	}
 
 	// TODO: reflect error in response
-	if (checkInvalidTriggers) {
-		dbMonitoring.syncTriggers(triggerInfoList, serverInfo.id);
-	} else {
-		dbMonitoring.addTriggerInfoList(triggerInfoList);
-	}
+	if (checkInvalidTriggers)
+		m_impl->syncTriggers(triggerInfoList);
+	else
+		m_impl->upsertTriggers(triggerInfoList);
 
 	if (!fetchId.empty()) {
 		m_impl->runFetchCallback(fetchId);
@@ -1795,7 +2070,6 @@ static bool parseEventsParams(JSONParser &parser, EventInfoList &eventInfoList,
 string HatoholArmPluginGateHAPI2::procedureHandlerPutEvents(
   JSONParser &parser)
 {
-	UnifiedDataStore *dataStore = UnifiedDataStore::getInstance();
 	EventInfoList eventInfoList;
 	JSONRPCError errObj;
 	string fetchId, lastInfo;
@@ -1835,7 +2109,17 @@ string HatoholArmPluginGateHAPI2::procedureHandlerPutEvents(
 		upsertLastInfo(lastInfo, LAST_INFO_EVENT);
 	}
 
-	dataStore->addEventList(eventInfoList);
+	// The reply is sent after the events are committed or spooled.
+	// Actions for them are checked on another stage. The events of a
+	// fetch aren't spooled since the waiter reads the DB as soon as
+	// it's notified.
+	const bool waitForCommit = !fetchId.empty();
+	if (!IngestionPipeline::getInstance().addEventList(eventInfoList,
+	                                                   waitForCommit)) {
+		return HatoholArmPluginInterfaceHAPI2::buildErrorResponse(
+		  JSON_RPC_INTERNAL_ERROR, "Failed to store events.",
+		  NULL, &parser);
+	}
 
 	if (!mayMoreFlag)
 		m_impl->runFetchCallback(fetchId);
@@ -40,6 +40,14 @@ public:
 	virtual void stop(void) override;
 	bool isEstablished(void);
 
+	/**
+	 * Get the encoding that the plugin may use for its messages.
+	 *
+	 * @return HAPI2_ENCODING_MESSAGE_PACK if both sides support it.
+	 * Otherwise HAPI2_ENCODING_JSON.
+	 */
+	std::string getNegotiatedEncoding(void);
+
 	virtual bool isFetchItemsSupported(void);
 	virtual bool startOnDemandFetchItems(
 	  const LocalHostIdVector &hostIds = {},
@@ -17,10 +17,17 @@
  * <http://www.gnu.org/licenses/>.
  */
 
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif // HAVE_CONFIG_H
+
 #include <ZabbixAPI.h>
 #include "HatoholDBUtils.h"
 #include "DBTablesMonitoring.h"
 #include "ThreadLocalDBCache.h"
+#ifdef WITH_QPID
+#include "HapiItemTableView.h"
+#endif
 
 using namespace std;
 using namespace mlpl;
@@ -59,6 +66,60 @@ static bool findHostCache(
 	return false;
 }
 
+static bool completeTriggerInfo(
+  TriggerInfo &trigInfo, const string &expandedDescription,
+  const ServerIdType &serverId, const HostInfoCache &hostInfoCache)
+{
+	if (!expandedDescription.empty()) {
+		JSONBuilder agent;
+		agent.startObject();
+		agent.add("expandedDescription", expandedDescription);
+		agent.endObject();
+		trigInfo.extendedInfo = agent.generate();
+	}
+
+	HostInfoCache::Element cacheElem;
+	const bool found =
+	  findHostCache(serverId, trigInfo.hostIdInServer,
+	                hostInfoCache,  cacheElem);
+	if (!found)
+		return false;
+	trigInfo.globalHostId = cacheElem.hostId;
+	trigInfo.hostName     = cacheElem.name;
+	return true;
+}
+
+static void computeNvps(MonitoringServerStatus &serverStatus,
+                        const ItemInfoList &itemInfoList)
+{
+	ItemInfoListConstIterator item_it = itemInfoList.begin();
+	serverStatus.nvps = 0.0;
+	for (; item_it != itemInfoList.end(); ++item_it) {
+		if ((*item_it).delay != 0)
+			serverStatus.nvps += 1.0/(*item_it).delay;
+	}
+}
+
+static bool setItemGroupName(
+  ItemInfo &itemInfo, const ItemCategoryIdType &itemCategoryId,
+  const ItemCategoryNameMap &itemCategoryNameMap)
+{
+	if (itemCategoryId == NO_ITEM_CATEGORY_ID) {
+		itemInfo.itemGroupName = "N/A";
+	} else {
+		ItemCategoryNameMapConstIterator it =
+		  itemCategoryNameMap.find(itemCategoryId);
+		if (it == itemCategoryNameMap.end()) {
+			MLPL_ERR("Failed to get item category name: "
+			         "%" FMT_ITEM_CATEGORY_ID "\n",
+			         itemCategoryId.c_str());
+			return false;
+		}
+		itemInfo.itemGroupName = it->second;
+	}
+	return true;
+}
+
 // ----------------------------------------------------------------------------
 // Public methods
 // ----------------------------------------------------------------------------
@@ -99,25 +160,57 @@ void HatoholDBUtils::transformTriggersToHatoholFormat(
 		trigGroupStream.seek(ITEM_ID_ZBX_TRIGGERS_EXPANDED_DESCRIPTION);
 		trigGroupStream >> expandedDescription;
 
-		if (!expandedDescription.empty()) {
-			JSONBuilder agent;
-			agent.startObject();
-			agent.add("expandedDescription", expandedDescription);
-			agent.endObject();
-			trigInfo.extendedInfo = agent.generate();
-		}
+		if (!completeTriggerInfo(trigInfo, expandedDescription,
+		                         serverId, hostInfoCache))
+			continue;
+		trigInfoList.push_back(trigInfo);
+	}
+}
+
+#ifdef WITH_QPID
+void HatoholDBUtils::transformTriggersToHatoholFormat(
+  TriggerInfoList &trigInfoList, const HapiItemTableView &triggers,
+  const ServerIdType &serverId, const HostInfoCache &hostInfoCache)
+{
+	const size_t numGroups = triggers.getNumberOfGroups();
+	for (size_t idx = 0; idx < numGroups; idx++) {
+		const HapiItemGroupView trigGroup = triggers.getGroupAt(idx);
+		TriggerInfo trigInfo;
+		std::string expandedDescription;
+
+		trigInfo.serverId = serverId;
+
+		trigInfo.validity = TRIGGER_VALID;
 
-		HostInfoCache::Element cacheElem;
-		const bool found =
-		  findHostCache(serverId, trigInfo.hostIdInServer,
-		                hostInfoCache,  cacheElem);
-		if (!found)
+		trigGroup.getItem(ITEM_ID_ZBX_TRIGGERS_TRIGGERID)
+		  >> trigInfo.id;
+
+		trigInfo.status = static_cast<TriggerStatusType>(
+		  trigGroup.getItem(ITEM_ID_ZBX_TRIGGERS_VALUE).getInt());
+
+		trigInfo.severity = static_cast<TriggerSeverityType>(
+		  trigGroup.getItem(ITEM_ID_ZBX_TRIGGERS_PRIORITY).getInt());
+
+		trigGroup.getItem(ITEM_ID_ZBX_TRIGGERS_LASTCHANGE)
+		  >> trigInfo.lastChangeTime.tv_sec;
+		trigInfo.lastChangeTime.tv_nsec = 0;
+
+		trigGroup.getItem(ITEM_ID_ZBX_TRIGGERS_DESCRIPTION)
+		  >> trigInfo.brief;
+
+		trigGroup.getItem(ITEM_ID_ZBX_TRIGGERS_HOSTID)
+		  >> trigInfo.hostIdInServer;
+
+		trigGroup.getItem(ITEM_ID_ZBX_TRIGGERS_EXPANDED_DESCRIPTION)
+		  >> expandedDescription;
+
+		if (!completeTriggerInfo(trigInfo, expandedDescription,
+		                         serverId, hostInfoCache))
 			continue;
-		trigInfo.globalHostId = cacheElem.hostId;
-		trigInfo.hostName     = cacheElem.name;
 		trigInfoList.push_back(trigInfo);
 	}
 }
+#endif // WITH_QPID
 
 void HatoholDBUtils::transformEventsToHatoholFormat(
   EventInfoList &eventInfoList, const ItemTablePtr events,
@@ -228,13 +321,44 @@ void HatoholDBUtils::transformItemsToHatoholFormat(
 		itemInfoList.push_back(itemInfo);
 	}
 
-	ItemInfoListConstIterator item_it = itemInfoList.begin();
-	serverStatus.nvps = 0.0;
-	for (; item_it != itemInfoList.end(); ++item_it) {
-		if ((*item_it).delay != 0)
-			serverStatus.nvps += 1.0/(*item_it).delay;
+	computeNvps(serverStatus, itemInfoList);
+}
+
+#ifdef WITH_QPID
+void HatoholDBUtils::transformItemsToHatoholFormat(
+  ItemInfoList &itemInfoList, MonitoringServerStatus &serverStatus,
+  const HapiItemTableView &items, const HapiItemTableView &applications,
+  const ServerIdType &serverId, const HostInfoCache &hostInfoCache)
+{
+	// Make application map
+	ItemCategoryNameMap itemCategoryNameMap;
+	const size_t numApps = applications.getNumberOfGroups();
+	for (size_t idx = 0; idx < numApps; idx++) {
+		const HapiItemGroupView appGroup = applications.getGroupAt(idx);
+		ItemCategoryIdType appId;
+		appGroup.getItem(ITEM_ID_ZBX_APPLICATIONS_APPLICATIONID)
+		  >> appId;
+		appGroup.getItem(ITEM_ID_ZBX_APPLICATIONS_NAME)
+		  >> itemCategoryNameMap[appId];
 	}
+
+	// Make ItemInfoList
+	const size_t numItems = items.getNumberOfGroups();
+	for (size_t idx = 0; idx < numItems; idx++) {
+		ItemInfo itemInfo;
+		itemInfo.serverId = serverStatus.serverId;
+		const bool succeeded = transformItemItemGroupToItemInfo(
+		                         itemInfo, items.getGroupAt(idx),
+		                         itemCategoryNameMap,
+		                         serverId, hostInfoCache);
+		if (!succeeded)
+			continue;
+		itemInfoList.push_back(itemInfo);
+	}
+
+	computeNvps(serverStatus, itemInfoList);
 }
+#endif // WITH_QPID
 
 void HatoholDBUtils::transformHistoryToHatoholFormat(
   HistoryInfoVect &historyInfoVect,  const ItemTablePtr items,
@@ -286,6 +410,16 @@ string HatoholDBUtils::makeItemBrief(const ItemGroup *itemItemGroup)
 	itemGroupStream.seek(ITEM_ID_ZBX_ITEMS_NAME);
 	itemGroupStream >> name;
 
+	// get items.key_
+	string itemKey;
+	itemGroupStream.seek(ITEM_ID_ZBX_ITEMS_KEY_);
+	itemGroupStream >> itemKey;
+
+	return makeItemBrief(name, itemKey);
+}
+
+string HatoholDBUtils::makeItemBrief(const string &name, const string &itemKey)
+{
 	// summarize word and variables ($1 - $9)
 	vector<BriefElem> briefElemVect;
 	size_t i, tail = 0;
@@ -313,10 +447,6 @@ string HatoholDBUtils::makeItemBrief(const ItemGroup *itemItemGroup)
 	}
 
 	// extract words to be replace
-	string itemKey;
-	itemGroupStream.seek(ITEM_ID_ZBX_ITEMS_KEY_);
-	itemGroupStream >> itemKey;
-
 	StringVector params;
 	extractItemKeys(params, itemKey);
 
@@ -481,22 +611,61 @@ bool HatoholDBUtils::transformItemItemGroupToItemInfo(
 	itemGroupStream.seek(ITEM_ID_ZBX_ITEMS_APPLICATIONID);
 	itemGroupStream >> itemCategoryId;
 
-	if (itemCategoryId == NO_ITEM_CATEGORY_ID) {
-		itemInfo.itemGroupName = "N/A";
-	} else {
-		ItemCategoryNameMapConstIterator it =
-		  itemCategoryNameMap.find(itemCategoryId);
-		if (it == itemCategoryNameMap.end()) {
-			MLPL_ERR("Failed to get item category name: "
-			         "%" FMT_ITEM_CATEGORY_ID "\n",
-			         itemCategoryId.c_str());
-			return false;
-		}
-		itemInfo.itemGroupName = it->second;
+	return setItemGroupName(itemInfo, itemCategoryId, itemCategoryNameMap);
+}
+
+#ifdef WITH_QPID
+bool HatoholDBUtils::transformItemItemGroupToItemInfo(
+  ItemInfo &itemInfo, const HapiItemGroupView &itemItemGroup,
+  const ItemCategoryNameMap &itemCategoryNameMap,
+  const ServerIdType &serverId, const HostInfoCache &hostInfoCache)
+{
+	itemInfo.lastValueTime.tv_nsec = 0;
+
+	string name, itemKey;
+	itemItemGroup.getItem(ITEM_ID_ZBX_ITEMS_NAME) >> name;
+	itemItemGroup.getItem(ITEM_ID_ZBX_ITEMS_KEY_) >> itemKey;
+	itemInfo.brief = makeItemBrief(name, itemKey);
+
+	itemItemGroup.getItem(ITEM_ID_ZBX_ITEMS_ITEMID) >> itemInfo.id;
+	itemItemGroup.getItem(ITEM_ID_ZBX_ITEMS_HOSTID)
+	  >> itemInfo.hostIdInServer;
+
+	HostInfoCache::Element cacheElem;
+	const bool found = findHostCache(serverId, itemInfo.hostIdInServer,
+	                                 hostInfoCache, cacheElem);
+	if (!found)
+		return false;
+	itemInfo.globalHostId = cacheElem.hostId;
+
+	itemItemGroup.getItem(ITEM_ID_ZBX_ITEMS_LASTCLOCK)
+	  >> itemInfo.lastValueTime.tv_sec;
+	if (itemInfo.lastValueTime.tv_sec == 0) {
+		// We assume that the item in this case is a kind of
+		// template such as 'Incoming network traffic on {#IFNAME}'.
+		return false;
 	}
 
-	return true;
+	itemItemGroup.getItem(ITEM_ID_ZBX_ITEMS_LASTVALUE)
+	  >> itemInfo.lastValue;
+	itemItemGroup.getItem(ITEM_ID_ZBX_ITEMS_PREVVALUE)
+	  >> itemInfo.prevValue;
+	itemItemGroup.getItem(ITEM_ID_ZBX_ITEMS_DELAY) >> itemInfo.delay;
+	itemItemGroup.getItem(ITEM_ID_ZBX_ITEMS_UNITS) >> itemInfo.unit;
+
+	const int valueType =
+	  itemItemGroup.getItem(ITEM_ID_ZBX_ITEMS_VALUE_TYPE).getInt();
+	itemInfo.valueType
+	  = ZabbixAPI::toItemValueType(
+	      static_cast<ZabbixAPI::ValueType>(valueType));
+
+	ItemCategoryIdType itemCategoryId;
+	itemItemGroup.getItem(ITEM_ID_ZBX_ITEMS_APPLICATIONID)
+	  >> itemCategoryId;
+
+	return setItemGroupName(itemInfo, itemCategoryId, itemCategoryNameMap);
 }
+#endif // WITH_QPID
 
 void HatoholDBUtils::transformHistoryItemGroupToHistoryInfo(
   HistoryInfo &historyInfo, const ItemGroup *item)
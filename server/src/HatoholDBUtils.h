@@ -23,12 +23,24 @@
 #include "DBTablesMonitoring.h"
 #include "HostInfoCache.h"
 
+class HapiItemTableView;
+class HapiItemGroupView;
+
 class HatoholDBUtils {
 public:
 	static void transformTriggersToHatoholFormat(
 	  TriggerInfoList &trigInfoList, const ItemTablePtr triggers,
 	  const ServerIdType &serverId, const HostInfoCache &hostInfoCache);
 
+	/**
+	 * Transform triggers in a HAPI buffer without creating an ItemTable.
+	 *
+	 * This is available only when Hatohol is built with qpid.
+	 */
+	static void transformTriggersToHatoholFormat(
+	  TriggerInfoList &trigInfoList, const HapiItemTableView &triggers,
+	  const ServerIdType &serverId, const HostInfoCache &hostInfoCache);
+
 	static void transformEventsToHatoholFormat(
 	  EventInfoList &eventInfoList, const ItemTablePtr events,
 	  const ServerIdType &serverId);
@@ -51,6 +63,17 @@ public:
 	  const ItemTablePtr items, const ItemTablePtr applications,
 	  const ServerIdType &serverId, const HostInfoCache &hostInfoCache);
 
+	/**
+	 * Transform items in a HAPI buffer without creating an ItemTable.
+	 *
+	 * This is available only when Hatohol is built with qpid.
+	 */
+	static void transformItemsToHatoholFormat(
+	  ItemInfoList &itemInfoList, MonitoringServerStatus &serverStatus,
+	  const HapiItemTableView &items,
+	  const HapiItemTableView &applications,
+	  const ServerIdType &serverId, const HostInfoCache &hostInfoCache);
+
 	static void transformHistoryToHatoholFormat(
 	  HistoryInfoVect &historyInfoVect, const ItemTablePtr items,
 	  const ServerIdType &serverId);
@@ -70,6 +93,8 @@ protected:
 	                            const std::string &key);
 
 	static std::string makeItemBrief(const ItemGroup *itemItemGroup);
+	static std::string makeItemBrief(const std::string &name,
+	                                 const std::string &itemKey);
 
 	static bool transformEventItemGroupToEventInfo(
 	  EventInfo &eventInfo, const ItemGroup *event);
@@ -86,6 +111,11 @@ protected:
 	  const ItemCategoryNameMap &itemCategoryNameMap,
 	  const ServerIdType &serverId, const HostInfoCache &hostInfoCache);
 
+	static bool transformItemItemGroupToItemInfo(
+	  ItemInfo &itemInfo, const HapiItemGroupView &item,
+	  const ItemCategoryNameMap &itemCategoryNameMap,
+	  const ServerIdType &serverId, const HostInfoCache &hostInfoCache);
+
 	static void transformHistoryItemGroupToHistoryInfo(
 	  HistoryInfo &historyInfo, const ItemGroup *item);
 };
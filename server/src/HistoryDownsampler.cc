@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <HatoholException.h>
+#include "HistoryDownsampler.h"
+
+using namespace std;
+
+struct FunctionName {
+	HistoryDownsampler::Function function;
+	const char                  *name;
+};
+
+static const FunctionName FUNCTION_NAMES[] = {
+	{HistoryDownsampler::FUNC_AVG,     "avg"},
+	{HistoryDownsampler::FUNC_MIN,     "min"},
+	{HistoryDownsampler::FUNC_MAX,     "max"},
+	{HistoryDownsampler::FUNC_LAST,    "last"},
+	{HistoryDownsampler::FUNC_MIN_MAX, "minmax"},
+};
+static const size_t NUM_FUNCTION_NAMES =
+  sizeof(FUNCTION_NAMES) / sizeof(FUNCTION_NAMES[0]);
+
+struct TimedValue {
+	time_t sec;
+	long   nsec;
+	double value;
+
+	bool operator<(const TimedValue &rhs) const
+	{
+		if (sec != rhs.sec)
+			return sec < rhs.sec;
+		return nsec < rhs.nsec;
+	}
+};
+
+static bool parseNumber(const string &str, double &value)
+{
+	if (str.empty())
+		return false;
+	char *end;
+	value = strtod(str.c_str(), &end);
+	return *end == '\0' && isfinite(value);
+}
+
+// ---------------------------------------------------------------------------
+// Public methods
+// ---------------------------------------------------------------------------
+bool HistoryDownsampler::parseFunction(const string &name, Function &func)
+{
+	for (size_t i = 0; i < NUM_FUNCTION_NAMES; i++) {
+		if (name == FUNCTION_NAMES[i].name) {
+			func = FUNCTION_NAMES[i].function;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char *HistoryDownsampler::getFunctionName(const Function &func)
+{
+	for (size_t i = 0; i < NUM_FUNCTION_NAMES; i++) {
+		if (FUNCTION_NAMES[i].function == func)
+			return FUNCTION_NAMES[i].name;
+	}
+	HATOHOL_ASSERT(false, "Unknown function: %d", func);
+	return NULL;
+}
+
+time_t HistoryDownsampler::calcBucketWidth(
+  const time_t &beginTime, const time_t &endTime, const size_t &numPoints)
+{
+	HATOHOL_ASSERT(numPoints > 0, "numPoints must not be zero.");
+	if (endTime < beginTime)
+		return 1;
+	const time_t duration = endTime - beginTime + 1;
+	const time_t width = (duration + numPoints - 1) / numPoints;
+	return max(width, static_cast<time_t>(1));
+}
+
+HistoryDownsampler::HistoryDownsampler(
+  const Function &func, const time_t &bucketWidth, const time_t &origin)
+: m_function(func),
+  m_bucketWidth(bucketWidth),
+  m_origin(origin)
+{
+	HATOHOL_ASSERT(bucketWidth > 0, "Invalid bucket width: %ld",
+	               bucketWidth);
+}
+
+const HistoryDownsampler::Function &HistoryDownsampler::getFunction(
+  void) const
+{
+	return m_function;
+}
+
+const time_t &HistoryDownsampler::getBucketWidth(void) const
+{
+	return m_bucketWidth;
+}
+
+bool HistoryDownsampler::run(const HistoryInfoVect &historyInfoVect,
+                             vector<Point> &points) const
+{
+	// Parse all values at first so that the aggregation below is
+	// a simple loop over a flat array.
+	vector<TimedValue> values(historyInfoVect.size());
+	for (size_t i = 0; i < historyInfoVect.size(); i++) {
+		const HistoryInfo &historyInfo = historyInfoVect[i];
+		TimedValue &timedValue = values[i];
+		if (!parseNumber(historyInfo.value, timedValue.value))
+			return false;
+		timedValue.sec  = historyInfo.clock.tv_sec;
+		timedValue.nsec = historyInfo.clock.tv_nsec;
+	}
+	// Data stores usually return sorted samples.
+	if (!is_sorted(values.begin(), values.end()))
+		stable_sort(values.begin(), values.end());
+
+	double sum = 0;
+	Point point;
+	point.numSamples = 0;
+	for (size_t i = 0; i < values.size(); i++) {
+		const TimedValue &timedValue = values[i];
+		const time_t offset = timedValue.sec - m_origin;
+		time_t bucketIndex = offset / m_bucketWidth;
+		if (offset % m_bucketWidth < 0)
+			bucketIndex--;
+		const time_t bucketTime =
+		  m_origin + bucketIndex * m_bucketWidth;
+
+		if (point.numSamples > 0 && point.time != bucketTime) {
+			finishPoint(point, sum, points);
+			point.numSamples = 0;
+		}
+		const double &value = timedValue.value;
+		if (point.numSamples == 0) {
+			point.time = bucketTime;
+			point.min  = value;
+			point.max  = value;
+			sum = 0;
+		}
+		point.numSamples++;
+		sum += value;
+		point.min = min(point.min, value);
+		point.max = max(point.max, value);
+		switch (m_function) {
+		case FUNC_MIN:
+			point.value = point.min;
+			break;
+		case FUNC_MAX:
+			point.value = point.max;
+			break;
+		case FUNC_LAST:
+			point.value = value;
+			break;
+		default:
+			break;
+		}
+	}
+	if (point.numSamples > 0)
+		finishPoint(point, sum, points);
+	return true;
+}
+
+// ---------------------------------------------------------------------------
+// Private methods
+// ---------------------------------------------------------------------------
+void HistoryDownsampler::finishPoint(Point &point, const double &sum,
+                                     vector<Point> &points) const
+{
+	if (m_function == FUNC_AVG || m_function == FUNC_MIN_MAX)
+		point.value = sum / point.numSamples;
+	points.push_back(point);
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HistoryDownsampler_h
+#define HistoryDownsampler_h
+
+#include <string>
+#include <vector>
+#include "Monitoring.h"
+
+/**
+ * HistoryDownsampler reduces history samples to one point per time
+ * bucket.
+ *
+ * Buckets are aligned to the origin given to the constructor. A bucket
+ * without samples produces no point.
+ */
+class HistoryDownsampler {
+public:
+	enum Function {
+		FUNC_AVG,
+		FUNC_MIN,
+		FUNC_MAX,
+		FUNC_LAST,
+		// Both the minimum and the maximum (and the average as
+		// the value) to draw an envelope.
+		FUNC_MIN_MAX,
+	};
+
+	struct Point {
+		// The begin of the bucket.
+		time_t   time;
+		double   value;
+		double   min;
+		double   max;
+		size_t   numSamples;
+	};
+
+	/**
+	 * Get a function from its name: "avg", "min", "max", "last" or
+	 * "minmax".
+	 *
+	 * @return true if the name is valid. Otherwise false.
+	 */
+	static bool parseFunction(const std::string &name, Function &func);
+	static const char *getFunctionName(const Function &func);
+
+	/**
+	 * Calculate the smallest bucket width (in seconds) with which
+	 * a range is divided into at most the given number of buckets.
+	 *
+	 * @param beginTime The begin of the range (inclusive).
+	 * @param endTime The end of the range (inclusive).
+	 * @param numPoints The maximum number of buckets. It must be > 0.
+	 * @return The bucket width (>= 1).
+	 */
+	static time_t calcBucketWidth(const time_t &beginTime,
+	                              const time_t &endTime,
+	                              const size_t &numPoints);
+
+	HistoryDownsampler(const Function &func, const time_t &bucketWidth,
+	                   const time_t &origin);
+
+	const Function &getFunction(void) const;
+	const time_t &getBucketWidth(void) const;
+
+	/**
+	 * Downsample history.
+	 *
+	 * @param historyInfoVect
+	 * Samples of an item. They don't have to be sorted.
+	 * @param points The points are added in the order of the time.
+	 * @return
+	 * false if there's a value that isn't a number. 'points' isn't
+	 * changed in that case.
+	 */
+	bool run(const HistoryInfoVect &historyInfoVect,
+	         std::vector<Point> &points) const;
+
+private:
+	void finishPoint(Point &point, const double &sum,
+	                 std::vector<Point> &points) const;
+
+	Function m_function;
+	time_t   m_bucketWidth;
+	time_t   m_origin;
+};
+
+#endif // HistoryDownsampler_h
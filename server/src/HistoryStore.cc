@@ -0,0 +1,1093 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <inttypes.h>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <glib.h>
+#include <Logger.h>
+#include <Mutex.h>
+#include <StringUtils.h>
+#include "HistoryStore.h"
+#include "ConfigManager.h"
+#include "FingerprintTable.h"
+
+using namespace std;
+using namespace mlpl;
+
+const size_t HistoryStore::MAX_SAMPLES_PER_BLOCK = 1024;
+const time_t HistoryStore::SETTLE_TIME_SEC = 60;
+
+// A history file of an item is a sequence of blocks. A block consists of
+// a BlockHeader and a payload:
+//   timestamps: the first time, the first delta and delta-of-deltas
+//               in nanoseconds as zigzag varints.
+//   values:     BLOCK_DECIMAL: XOR-compressed doubles in a bit stream.
+//               BLOCK_STRING:  varint length and bytes of each string.
+// The coverage of an item is saved in a text file with an atomic rename.
+static const uint32_t BLOCK_MAGIC = 0x42485448; // "HTHB"
+static const char    *HISTORY_FILE_SUFFIX = ".hist";
+static const char    *COVERAGE_FILE_SUFFIX = ".cov";
+// "%.*f" reproduces a decimal string up to this number of digits.
+static const int      MAX_DECIMAL_PRECISION = 15;
+static const int64_t  NSEC_PER_SEC = 1000000000;
+
+enum BlockType {
+	BLOCK_DECIMAL = 1,
+	BLOCK_STRING  = 2,
+};
+
+struct BlockHeader {
+	uint32_t magic;
+	uint8_t  type;
+	// The number of fractional digits of BLOCK_DECIMAL.
+	uint8_t  precision;
+	uint16_t reserved;
+	uint32_t numSamples;
+	uint32_t payloadLength;
+	int64_t  firstTime;
+	int64_t  lastTime;
+	uint64_t checksum;
+} __attribute__((__packed__));
+
+struct Sample {
+	int64_t time; // nanoseconds
+	string  value;
+
+	bool operator<(const Sample &rhs) const
+	{
+		return time < rhs.time;
+	}
+};
+
+typedef vector<Sample> SampleVect;
+
+// ---------------------------------------------------------------------------
+// Encoding
+// ---------------------------------------------------------------------------
+static uint64_t zigzag(const int64_t &value)
+{
+	return (static_cast<uint64_t>(value) << 1) ^
+	       static_cast<uint64_t>(value >> 63);
+}
+
+static int64_t unzigzag(const uint64_t &value)
+{
+	return static_cast<int64_t>(value >> 1) ^
+	       -static_cast<int64_t>(value & 1);
+}
+
+static void putVarint(string &buf, uint64_t value)
+{
+	while (value >= 0x80) {
+		buf += static_cast<char>((value & 0x7f) | 0x80);
+		value >>= 7;
+	}
+	buf += static_cast<char>(value);
+}
+
+static bool getVarint(const string &buf, size_t &pos, uint64_t &value)
+{
+	value = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		if (pos >= buf.size())
+			return false;
+		const uint8_t byte = buf[pos++];
+		value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+	return false;
+}
+
+class BitWriter {
+public:
+	BitWriter(string &buf)
+	: m_buf(buf),
+	  m_numFreeBits(0)
+	{
+	}
+
+	void write(const uint64_t &value, const int &numBits)
+	{
+		for (int i = numBits - 1; i >= 0; i--) {
+			if (m_numFreeBits == 0) {
+				m_buf += '\0';
+				m_numFreeBits = 8;
+			}
+			m_numFreeBits--;
+			if ((value >> i) & 1)
+				m_buf[m_buf.size() - 1] |= (1 << m_numFreeBits);
+		}
+	}
+
+private:
+	string &m_buf;
+	int     m_numFreeBits;
+};
+
+class BitReader {
+public:
+	BitReader(const string &buf, const size_t &bytePos)
+	: m_buf(buf),
+	  m_bitPos(bytePos * 8)
+	{
+	}
+
+	bool read(uint64_t &value, const int &numBits)
+	{
+		if (m_bitPos + numBits > m_buf.size() * 8)
+			return false;
+		value = 0;
+		for (int i = 0; i < numBits; i++, m_bitPos++) {
+			const uint8_t byte = m_buf[m_bitPos / 8];
+			const int shift = 7 - m_bitPos % 8;
+			value = (value << 1) | ((byte >> shift) & 1);
+		}
+		return true;
+	}
+
+private:
+	const string &m_buf;
+	size_t        m_bitPos;
+};
+
+static uint64_t toBits(const double &value)
+{
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+static double fromBits(const uint64_t &bits)
+{
+	double value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+/**
+ * Parse a decimal string such as "-12" or "0.0500".
+ *
+ * @return true if "%.*f" with the precision reproduces the string.
+ */
+static bool parseDecimal(const string &str, double &value, int &precision)
+{
+	size_t pos = 0;
+	if (pos < str.size() && str[pos] == '-')
+		pos++;
+	const size_t intTop = pos;
+	while (pos < str.size() && isdigit(str[pos]))
+		pos++;
+	if (pos == intTop)
+		return false;
+	precision = 0;
+	if (pos < str.size() && str[pos] == '.') {
+		pos++;
+		const size_t fracTop = pos;
+		while (pos < str.size() && isdigit(str[pos]))
+			pos++;
+		precision = pos - fracTop;
+		if (precision == 0)
+			return false;
+	}
+	if (pos != str.size() || precision > MAX_DECIMAL_PRECISION)
+		return false;
+	value = strtod(str.c_str(), NULL);
+	return StringUtils::sprintf("%.*f", precision, value) == str;
+}
+
+static void encodeTimestamps(string &payload, const SampleVect &samples,
+                             const size_t &top, const size_t &num)
+{
+	int64_t prevTime = 0;
+	int64_t prevDelta = 0;
+	for (size_t i = 0; i < num; i++) {
+		const int64_t time = samples[top + i].time;
+		if (i == 0) {
+			putVarint(payload, zigzag(time));
+		} else {
+			const int64_t delta = time - prevTime;
+			putVarint(payload, zigzag(delta - prevDelta));
+			prevDelta = delta;
+		}
+		prevTime = time;
+	}
+}
+
+static void encodeDecimals(string &payload, const vector<double> &values)
+{
+	BitWriter writer(payload);
+	uint64_t prevBits = toBits(values[0]);
+	writer.write(prevBits, 64);
+	int prevLeading = -1;
+	int prevTrailing = 0;
+	for (size_t i = 1; i < values.size(); i++) {
+		const uint64_t bits = toBits(values[i]);
+		const uint64_t xorBits = bits ^ prevBits;
+		prevBits = bits;
+		if (xorBits == 0) {
+			writer.write(0, 1);
+			continue;
+		}
+		writer.write(1, 1);
+		int leading = __builtin_clzll(xorBits);
+		const int trailing = __builtin_ctzll(xorBits);
+		if (leading > 31)
+			leading = 31;
+		if (prevLeading >= 0 &&
+		    leading >= prevLeading && trailing >= prevTrailing) {
+			// The meaningful bits fit in the previous window.
+			writer.write(0, 1);
+			writer.write(xorBits >> prevTrailing,
+			             64 - prevLeading - prevTrailing);
+			continue;
+		}
+		const int numMeaningfulBits = 64 - leading - trailing;
+		writer.write(1, 1);
+		writer.write(leading, 5);
+		// 64 is written as 0.
+		writer.write(numMeaningfulBits & 0x3f, 6);
+		writer.write(xorBits >> trailing, numMeaningfulBits);
+		prevLeading = leading;
+		prevTrailing = trailing;
+	}
+}
+
+static bool decodeDecimals(const string &payload, const size_t &pos,
+                           const size_t &numSamples, const int &precision,
+                           vector<string> &values)
+{
+	BitReader reader(payload, pos);
+	uint64_t bits;
+	if (!reader.read(bits, 64))
+		return false;
+	values.push_back(
+	  StringUtils::sprintf("%.*f", precision, fromBits(bits)));
+	int leading = 0;
+	int trailing = 0;
+	for (size_t i = 1; i < numSamples; i++) {
+		uint64_t flag;
+		if (!reader.read(flag, 1))
+			return false;
+		if (flag) {
+			uint64_t newWindow;
+			if (!reader.read(newWindow, 1))
+				return false;
+			if (newWindow) {
+				uint64_t val;
+				if (!reader.read(val, 5))
+					return false;
+				leading = val;
+				if (!reader.read(val, 6))
+					return false;
+				const int numMeaningfulBits = val ? val : 64;
+				trailing = 64 - leading - numMeaningfulBits;
+				if (trailing < 0)
+					return false;
+			}
+			uint64_t meaningfulBits;
+			if (!reader.read(meaningfulBits,
+			                 64 - leading - trailing))
+				return false;
+			bits ^= meaningfulBits << trailing;
+		}
+		values.push_back(
+		  StringUtils::sprintf("%.*f", precision, fromBits(bits)));
+	}
+	return true;
+}
+
+/**
+ * Encode samples from 'top' as a block. The samples that have the same
+ * type and precision as the first one are taken.
+ *
+ * @return The number of the encoded samples.
+ */
+static size_t encodeBlock(string &block, const SampleVect &samples,
+                          const size_t &top)
+{
+	BlockHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = BLOCK_MAGIC;
+
+	vector<double> decimals;
+	double decimal;
+	int precision;
+	const bool isDecimal =
+	  parseDecimal(samples[top].value, decimal, precision);
+	header.type = isDecimal ? BLOCK_DECIMAL : BLOCK_STRING;
+	header.precision = isDecimal ? precision : 0;
+	size_t num = 0;
+	while (top + num < samples.size() &&
+	       num < HistoryStore::MAX_SAMPLES_PER_BLOCK) {
+		const string &value = samples[top + num].value;
+		int samplePrecision;
+		const bool sampleIsDecimal =
+		  parseDecimal(value, decimal, samplePrecision);
+		if (sampleIsDecimal != isDecimal)
+			break;
+		if (isDecimal) {
+			if (samplePrecision != precision)
+				break;
+			decimals.push_back(decimal);
+		}
+		num++;
+	}
+
+	string payload;
+	encodeTimestamps(payload, samples, top, num);
+	if (isDecimal) {
+		encodeDecimals(payload, decimals);
+	} else {
+		for (size_t i = 0; i < num; i++) {
+			const string &value = samples[top + i].value;
+			putVarint(payload, value.size());
+			payload += value;
+		}
+	}
+
+	header.numSamples    = num;
+	header.payloadLength = payload.size();
+	header.firstTime     = samples[top].time;
+	header.lastTime      = samples[top + num - 1].time;
+	header.checksum      = Fingerprint().add(payload).get();
+	block.append(reinterpret_cast<const char *>(&header), sizeof(header));
+	block += payload;
+	return num;
+}
+
+static bool decodeBlock(const BlockHeader &header, const string &payload,
+                        SampleVect &samples)
+{
+	size_t pos = 0;
+	vector<int64_t> times;
+	int64_t prevTime = 0;
+	int64_t prevDelta = 0;
+	for (size_t i = 0; i < header.numSamples; i++) {
+		uint64_t encoded;
+		if (!getVarint(payload, pos, encoded))
+			return false;
+		int64_t time;
+		if (i == 0) {
+			time = unzigzag(encoded);
+		} else {
+			const int64_t delta = prevDelta + unzigzag(encoded);
+			time = prevTime + delta;
+			prevDelta = delta;
+		}
+		times.push_back(time);
+		prevTime = time;
+	}
+
+	vector<string> values;
+	if (header.type == BLOCK_DECIMAL) {
+		if (!decodeDecimals(payload, pos, header.numSamples,
+		                    header.precision, values))
+			return false;
+	} else if (header.type == BLOCK_STRING) {
+		for (size_t i = 0; i < header.numSamples; i++) {
+			uint64_t length;
+			if (!getVarint(payload, pos, length))
+				return false;
+			if (length > payload.size() - pos)
+				return false;
+			values.push_back(payload.substr(pos, length));
+			pos += length;
+		}
+	} else {
+		return false;
+	}
+
+	for (size_t i = 0; i < header.numSamples; i++) {
+		Sample sample;
+		sample.time = times[i];
+		sample.value.swap(values[i]);
+		samples.push_back(sample);
+	}
+	return true;
+}
+
+static int64_t toNanoseconds(const timespec &clock)
+{
+	return clock.tv_sec * NSEC_PER_SEC + clock.tv_nsec;
+}
+
+static int64_t toNanoseconds(const time_t &sec)
+{
+	return sec * NSEC_PER_SEC;
+}
+
+/**
+ * Sort samples by the time and remove the earlier added one of those
+ * with the same time.
+ */
+static void sortAndUnique(SampleVect &samples)
+{
+	stable_sort(samples.begin(), samples.end());
+	size_t numUnique = 0;
+	for (size_t i = 0; i < samples.size(); i++) {
+		if (i + 1 < samples.size() &&
+		    samples[i + 1].time == samples[i].time)
+			continue;
+		if (numUnique != i)
+			swap(samples[numUnique], samples[i]);
+		numUnique++;
+	}
+	samples.resize(numUnique);
+}
+
+// ---------------------------------------------------------------------------
+// Series
+// ---------------------------------------------------------------------------
+struct BlockRef {
+	uint64_t offset;
+	int64_t  firstTime;
+	int64_t  lastTime;
+};
+
+typedef pair<time_t, time_t> TimeRange;
+
+struct Series {
+	Mutex             lock;
+	string            path;
+	bool              loaded;
+	uint64_t          fileSize;
+	vector<BlockRef>  blocks;
+	// Sorted and merged ranges (inclusive).
+	vector<TimeRange> coverage;
+
+	Series(const string &_path)
+	: path(_path),
+	  loaded(false),
+	  fileSize(0)
+	{
+	}
+
+	string getHistoryPath(void) const
+	{
+		return path + HISTORY_FILE_SUFFIX;
+	}
+
+	string getCoveragePath(void) const
+	{
+		return path + COVERAGE_FILE_SUFFIX;
+	}
+
+	void load(void)
+	{
+		if (loaded)
+			return;
+		loaded = true;
+		loadBlocks();
+		loadCoverage();
+	}
+
+	void loadBlocks(void)
+	{
+		const string histPath = getHistoryPath();
+		const int fd = open(histPath.c_str(), O_RDWR);
+		if (fd < 0) {
+			if (errno != ENOENT) {
+				MLPL_ERR("Failed to open %s: %s\n",
+				         histPath.c_str(), g_strerror(errno));
+			}
+			return;
+		}
+		struct stat st;
+		if (fstat(fd, &st) == -1) {
+			MLPL_ERR("Failed to stat %s: %s\n",
+			         histPath.c_str(), g_strerror(errno));
+			close(fd);
+			return;
+		}
+
+		uint64_t offset = 0;
+		const uint64_t size = st.st_size;
+		while (offset < size) {
+			BlockHeader header;
+			string payload;
+			if (!readBlock(fd, offset, size, header, payload))
+				break;
+			BlockRef ref;
+			ref.offset    = offset;
+			ref.firstTime = header.firstTime;
+			ref.lastTime  = header.lastTime;
+			blocks.push_back(ref);
+			offset += sizeof(header) + header.payloadLength;
+		}
+		if (offset < size) {
+			// A block written by a crashed process is discarded.
+			MLPL_WARN("Discard a broken tail of %s: %" PRIu64
+			          " bytes\n", histPath.c_str(), size - offset);
+			if (ftruncate(fd, offset) == -1) {
+				MLPL_ERR("Failed to truncate %s: %s\n",
+				         histPath.c_str(), g_strerror(errno));
+			}
+		}
+		fileSize = offset;
+		close(fd);
+	}
+
+	void loadCoverage(void)
+	{
+		FILE *fp = fopen(getCoveragePath().c_str(), "r");
+		if (!fp)
+			return;
+		int64_t begin, end;
+		while (fscanf(fp, "%" SCNd64 " %" SCNd64, &begin, &end) == 2)
+			coverage.push_back(TimeRange(begin, end));
+		fclose(fp);
+	}
+
+	static bool readBlock(const int &fd, const uint64_t &offset,
+	                      const uint64_t &size,
+	                      BlockHeader &header, string &payload)
+	{
+		if (size - offset < sizeof(header))
+			return false;
+		if (pread(fd, &header, sizeof(header), offset) !=
+		    static_cast<ssize_t>(sizeof(header)))
+			return false;
+		if (header.magic != BLOCK_MAGIC)
+			return false;
+		if (size - offset - sizeof(header) < header.payloadLength)
+			return false;
+		payload.resize(header.payloadLength);
+		if (header.payloadLength > 0 &&
+		    pread(fd, &payload[0], header.payloadLength,
+		          offset + sizeof(header)) !=
+		    static_cast<ssize_t>(header.payloadLength))
+			return false;
+		return Fingerprint().add(payload).get() == header.checksum;
+	}
+
+	bool append(const SampleVect &samples, const bool &sync,
+	            HistoryStore::Stat &stat)
+	{
+		string data;
+		vector<BlockRef> newBlocks;
+		for (size_t top = 0; top < samples.size();) {
+			BlockRef ref;
+			ref.offset = fileSize + data.size();
+			const size_t num = encodeBlock(data, samples, top);
+			ref.firstTime = samples[top].time;
+			ref.lastTime  = samples[top + num - 1].time;
+			newBlocks.push_back(ref);
+			top += num;
+		}
+
+		const string histPath = getHistoryPath();
+		const int fd = open(histPath.c_str(), O_WRONLY|O_CREAT, 0644);
+		if (fd < 0) {
+			MLPL_ERR("Failed to open %s: %s\n",
+			         histPath.c_str(), g_strerror(errno));
+			return false;
+		}
+		const ssize_t written =
+		  pwrite(fd, data.data(), data.size(), fileSize);
+		bool succeeded = (written == static_cast<ssize_t>(data.size()));
+		if (!succeeded) {
+			MLPL_ERR("Failed to write %s: %s\n",
+			         histPath.c_str(), g_strerror(errno));
+			// Remove a partially written block.
+			if (ftruncate(fd, fileSize) == -1) {
+				MLPL_ERR("Failed to truncate %s: %s\n",
+				         histPath.c_str(), g_strerror(errno));
+			}
+		} else if (sync && fdatasync(fd) == -1) {
+			MLPL_ERR("Failed to sync %s: %s\n",
+			         histPath.c_str(), g_strerror(errno));
+			succeeded = false;
+		}
+		close(fd);
+		if (written > 0 &&
+		    written == static_cast<ssize_t>(data.size())) {
+			fileSize += data.size();
+			blocks.insert(blocks.end(),
+			              newBlocks.begin(), newBlocks.end());
+			stat.numStoredSamples += samples.size();
+			stat.numStoredBlocks  += newBlocks.size();
+			stat.storedBytes      += data.size();
+		}
+		return succeeded;
+	}
+
+	void read(SampleVect &samples, const int64_t &beginTime,
+	          const int64_t &endTime)
+	{
+		if (blocks.empty())
+			return;
+		const string histPath = getHistoryPath();
+		const int fd = open(histPath.c_str(), O_RDONLY);
+		if (fd < 0) {
+			MLPL_ERR("Failed to open %s: %s\n",
+			         histPath.c_str(), g_strerror(errno));
+			return;
+		}
+		for (size_t i = 0; i < blocks.size(); i++) {
+			const BlockRef &ref = blocks[i];
+			if (ref.lastTime < beginTime || ref.firstTime > endTime)
+				continue;
+			BlockHeader header;
+			string payload;
+			SampleVect blockSamples;
+			if (!readBlock(fd, ref.offset, fileSize,
+			               header, payload) ||
+			    !decodeBlock(header, payload, blockSamples)) {
+				MLPL_ERR("Broken block: %s, offset: %" PRIu64
+				         "\n", histPath.c_str(), ref.offset);
+				continue;
+			}
+			for (size_t j = 0; j < blockSamples.size(); j++) {
+				Sample &sample = blockSamples[j];
+				if (sample.time < beginTime ||
+				    sample.time > endTime)
+					continue;
+				samples.push_back(Sample());
+				samples.back().time = sample.time;
+				samples.back().value.swap(sample.value);
+			}
+		}
+		close(fd);
+	}
+
+	void addCoverage(const time_t &beginTime, const time_t &endTime)
+	{
+		coverage.push_back(TimeRange(beginTime, endTime));
+		sort(coverage.begin(), coverage.end());
+		vector<TimeRange> merged;
+		for (size_t i = 0; i < coverage.size(); i++) {
+			const TimeRange &range = coverage[i];
+			if (!merged.empty() &&
+			    range.first <= merged.back().second + 1) {
+				merged.back().second =
+				  max(merged.back().second, range.second);
+			} else {
+				merged.push_back(range);
+			}
+		}
+		coverage.swap(merged);
+	}
+
+	bool saveCoverage(void)
+	{
+		const string covPath = getCoveragePath();
+		const string tmpPath = covPath + ".tmp";
+		FILE *fp = fopen(tmpPath.c_str(), "w");
+		if (!fp) {
+			MLPL_ERR("Failed to open %s: %s\n",
+			         tmpPath.c_str(), g_strerror(errno));
+			return false;
+		}
+		for (size_t i = 0; i < coverage.size(); i++) {
+			fprintf(fp, "%" PRId64 " %" PRId64 "\n",
+			        static_cast<int64_t>(coverage[i].first),
+			        static_cast<int64_t>(coverage[i].second));
+		}
+		const bool written =
+		  (fflush(fp) == 0 && fsync(fileno(fp)) == 0);
+		fclose(fp);
+		if (!written ||
+		    rename(tmpPath.c_str(), covPath.c_str()) == -1) {
+			MLPL_ERR("Failed to save %s: %s\n",
+			         covPath.c_str(), g_strerror(errno));
+			unlink(tmpPath.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	bool findGap(const time_t &beginTime, const time_t &endTime,
+	             time_t &gapBegin, time_t &gapEnd) const
+	{
+		time_t first = beginTime;
+		for (size_t i = 0; i < coverage.size(); i++) {
+			const TimeRange &range = coverage[i];
+			if (range.first <= first && first <= range.second)
+				first = range.second + 1;
+		}
+		if (first > endTime)
+			return false;
+		time_t last = endTime;
+		for (size_t i = coverage.size(); i > 0; i--) {
+			const TimeRange &range = coverage[i - 1];
+			if (range.first <= last && last <= range.second)
+				last = range.first - 1;
+		}
+		gapBegin = first;
+		gapEnd = last;
+		return true;
+	}
+};
+
+// ---------------------------------------------------------------------------
+// FetchedClosure
+// ---------------------------------------------------------------------------
+struct FetchedClosure : public Closure1<HistoryInfoVect> {
+	HistoryStore              &m_store;
+	ServerIdType               m_serverId;
+	ItemIdType                 m_itemId;
+	time_t                     m_beginTime;
+	time_t                     m_endTime;
+	time_t                     m_gapBegin;
+	time_t                     m_gapEnd;
+	time_t                     m_requestTime;
+	Closure1<HistoryInfoVect> *m_closure;
+
+	FetchedClosure(HistoryStore &store, const ItemInfo &itemInfo,
+	               const time_t &beginTime, const time_t &endTime,
+	               const time_t &gapBegin, const time_t &gapEnd,
+	               Closure1<HistoryInfoVect> *closure)
+	: m_store(store),
+	  m_serverId(itemInfo.serverId),
+	  m_itemId(itemInfo.id),
+	  m_beginTime(beginTime),
+	  m_endTime(endTime),
+	  m_gapBegin(gapBegin),
+	  m_gapEnd(gapEnd),
+	  m_requestTime(time(NULL)),
+	  m_closure(closure)
+	{
+	}
+
+	virtual ~FetchedClosure()
+	{
+		delete m_closure;
+	}
+
+	virtual void operator()(const HistoryInfoVect &fetched) override
+	{
+		// An empty result may be an error of the data store.
+		// So the coverage is added only when we got samples.
+		bool stored = false;
+		if (!fetched.empty()) {
+			const time_t coveredEnd =
+			  min(m_gapEnd,
+			      m_requestTime - HistoryStore::SETTLE_TIME_SEC);
+			if (coveredEnd >= m_gapBegin) {
+				stored = m_store.addFetched(
+				  m_serverId, m_itemId, m_gapBegin, coveredEnd,
+				  fetched);
+			} else {
+				stored = m_store.add(fetched);
+			}
+		}
+
+		HistoryInfoVect historyInfoVect;
+		m_store.get(historyInfoVect, m_serverId, m_itemId,
+		            m_beginTime, m_endTime);
+		if (!stored && !fetched.empty()) {
+			historyInfoVect.insert(historyInfoVect.end(),
+			                       fetched.begin(), fetched.end());
+			stable_sort(historyInfoVect.begin(),
+			            historyInfoVect.end(), compareClock);
+		}
+		(*m_closure)(historyInfoVect);
+		delete m_closure;
+		m_closure = NULL;
+	}
+
+	static bool compareClock(const HistoryInfo &lhs, const HistoryInfo &rhs)
+	{
+		return toNanoseconds(lhs.clock) < toNanoseconds(rhs.clock);
+	}
+};
+
+// ---------------------------------------------------------------------------
+// Impl
+// ---------------------------------------------------------------------------
+typedef pair<ServerIdType, ItemIdType> SeriesKey;
+
+struct HistoryStore::Impl {
+	static Mutex         instanceLock;
+	static HistoryStore *instance;
+
+	string                            directory;
+	Mutex                             lock;
+	map<SeriesKey, unique_ptr<Series>> seriesMap;
+	Stat                              stat;
+
+	Impl(const string &_directory)
+	: directory(_directory)
+	{
+	}
+
+	static string escape(const string &name)
+	{
+		string escaped;
+		for (size_t i = 0; i < name.size(); i++) {
+			const unsigned char c = name[i];
+			if (isalnum(c) || c == '_' || c == '-')
+				escaped += c;
+			else
+				escaped += StringUtils::sprintf("%%%02X", c);
+		}
+		return escaped;
+	}
+
+	/**
+	 * Get the series of an item. The returned series is locked.
+	 */
+	Series *lockSeries(const ServerIdType &serverId,
+	                   const ItemIdType &itemId)
+	{
+		Series *series;
+		{
+			AutoMutex autoLock(&lock);
+			unique_ptr<Series> &entry =
+			  seriesMap[SeriesKey(serverId, itemId)];
+			if (!entry) {
+				const string serverDir = StringUtils::sprintf(
+				  "%s/%" FMT_SERVER_ID,
+				  directory.c_str(), serverId);
+				entry.reset(new Series(serverDir + "/" +
+				                       escape(itemId)));
+			}
+			series = entry.get();
+		}
+		series->lock.lock();
+		series->load();
+		return series;
+	}
+
+	bool makeServerDirectory(const ServerIdType &serverId)
+	{
+		const string serverDir = StringUtils::sprintf(
+		  "%s/%" FMT_SERVER_ID, directory.c_str(), serverId);
+		if (g_mkdir_with_parents(serverDir.c_str(), 0755) == -1) {
+			MLPL_ERR("Failed to make a directory: %s: %s\n",
+			         serverDir.c_str(), g_strerror(errno));
+			return false;
+		}
+		return true;
+	}
+
+	bool store(const ServerIdType &serverId, const ItemIdType &itemId,
+	           SampleVect &samples, const TimeRange *coveredRange)
+	{
+		if (!makeServerDirectory(serverId))
+			return false;
+		sort(samples.begin(), samples.end());
+		Series *series = lockSeries(serverId, itemId);
+		bool succeeded = true;
+		Stat appendStat;
+		if (!samples.empty()) {
+			// The samples have to be synced before the coverage
+			// that refers to them is saved.
+			const bool sync = coveredRange;
+			succeeded = series->append(samples, sync, appendStat);
+		}
+		if (succeeded && coveredRange) {
+			series->addCoverage(coveredRange->first,
+			                    coveredRange->second);
+			succeeded = series->saveCoverage();
+		}
+		series->lock.unlock();
+
+		AutoMutex autoLock(&lock);
+		stat.numStoredSamples += appendStat.numStoredSamples;
+		stat.numStoredBlocks  += appendStat.numStoredBlocks;
+		stat.storedBytes      += appendStat.storedBytes;
+		return succeeded;
+	}
+};
+
+Mutex         HistoryStore::Impl::instanceLock;
+HistoryStore *HistoryStore::Impl::instance = NULL;
+
+// ---------------------------------------------------------------------------
+// Public methods
+// ---------------------------------------------------------------------------
+HistoryStore::Stat::Stat(void)
+: numStoredSamples(0),
+  numStoredBlocks(0),
+  storedBytes(0),
+  numLocalReplies(0),
+  numBackendFetches(0)
+{
+}
+
+HistoryStore *HistoryStore::getInstance(void)
+{
+	AutoMutex autoLock(&Impl::instanceLock);
+	if (!Impl::instance) {
+		const string directory =
+		  ConfigManager::getInstance()->getHistoryStoreDirectory();
+		Impl::instance = new HistoryStore(directory);
+	}
+	return Impl::instance;
+}
+
+HistoryStore::HistoryStore(const string &directory)
+: m_impl(new Impl(directory))
+{
+}
+
+HistoryStore::~HistoryStore()
+{
+}
+
+bool HistoryStore::isEnabled(void) const
+{
+	return !m_impl->directory.empty();
+}
+
+bool HistoryStore::add(const HistoryInfoVect &historyInfoVect)
+{
+	if (!isEnabled())
+		return false;
+
+	map<SeriesKey, SampleVect> samplesMap;
+	HistoryInfoVectConstIterator it = historyInfoVect.begin();
+	for (; it != historyInfoVect.end(); ++it) {
+		const HistoryInfo &historyInfo = *it;
+		SampleVect &samples =
+		  samplesMap[SeriesKey(historyInfo.serverId,
+		                       historyInfo.itemId)];
+		samples.push_back(Sample());
+		samples.back().time  = toNanoseconds(historyInfo.clock);
+		samples.back().value = historyInfo.value;
+	}
+
+	bool succeeded = true;
+	map<SeriesKey, SampleVect>::iterator samplesIt = samplesMap.begin();
+	for (; samplesIt != samplesMap.end(); ++samplesIt) {
+		const SeriesKey &key = samplesIt->first;
+		if (!m_impl->store(key.first, key.second, samplesIt->second,
+		                   NULL))
+			succeeded = false;
+	}
+	return succeeded;
+}
+
+bool HistoryStore::addFetched(
+  const ServerIdType &serverId, const ItemIdType &itemId,
+  const time_t &beginTime, const time_t &endTime,
+  const HistoryInfoVect &historyInfoVect)
+{
+	if (!isEnabled())
+		return false;
+
+	SampleVect samples;
+	samples.reserve(historyInfoVect.size());
+	HistoryInfoVectConstIterator it = historyInfoVect.begin();
+	for (; it != historyInfoVect.end(); ++it) {
+		samples.push_back(Sample());
+		samples.back().time  = toNanoseconds(it->clock);
+		samples.back().value = it->value;
+	}
+	const TimeRange coveredRange(beginTime, endTime);
+	return m_impl->store(serverId, itemId, samples, &coveredRange);
+}
+
+void HistoryStore::get(
+  HistoryInfoVect &historyInfoVect,
+  const ServerIdType &serverId, const ItemIdType &itemId,
+  const time_t &beginTime, const time_t &endTime)
+{
+	if (!isEnabled())
+		return;
+
+	SampleVect samples;
+	Series *series = m_impl->lockSeries(serverId, itemId);
+	series->read(samples, toNanoseconds(beginTime),
+	             toNanoseconds(endTime + 1) - 1);
+	series->lock.unlock();
+	sortAndUnique(samples);
+
+	historyInfoVect.reserve(historyInfoVect.size() + samples.size());
+	for (size_t i = 0; i < samples.size(); i++) {
+		HistoryInfo historyInfo;
+		historyInfo.serverId      = serverId;
+		historyInfo.itemId        = itemId;
+		historyInfo.clock.tv_sec  = samples[i].time / NSEC_PER_SEC;
+		historyInfo.clock.tv_nsec = samples[i].time % NSEC_PER_SEC;
+		historyInfo.value.swap(samples[i].value);
+		historyInfoVect.push_back(historyInfo);
+	}
+}
+
+bool HistoryStore::findGap(
+  const ServerIdType &serverId, const ItemIdType &itemId,
+  const time_t &beginTime, const time_t &endTime,
+  time_t &gapBegin, time_t &gapEnd)
+{
+	if (!isEnabled()) {
+		gapBegin = beginTime;
+		gapEnd = endTime;
+		return true;
+	}
+	Series *series = m_impl->lockSeries(serverId, itemId);
+	const bool found =
+	  series->findGap(beginTime, endTime, gapBegin, gapEnd);
+	series->lock.unlock();
+	return found;
+}
+
+void HistoryStore::fetch(
+  DataStorePtr dataStorePtr, const ItemInfo &itemInfo,
+  const time_t &beginTime, const time_t &endTime,
+  Closure1<HistoryInfoVect> *closure)
+{
+	if (!isEnabled()) {
+		dataStorePtr->startOnDemandFetchHistory(itemInfo, beginTime,
+		                                        endTime, closure);
+		return;
+	}
+
+	time_t gapBegin, gapEnd;
+	if (!findGap(itemInfo.serverId, itemInfo.id, beginTime, endTime,
+	             gapBegin, gapEnd)) {
+		HistoryInfoVect historyInfoVect;
+		get(historyInfoVect, itemInfo.serverId, itemInfo.id,
+		    beginTime, endTime);
+		{
+			AutoMutex autoLock(&m_impl->lock);
+			m_impl->stat.numLocalReplies++;
+		}
+		(*closure)(historyInfoVect);
+		delete closure;
+		return;
+	}
+
+	{
+		AutoMutex autoLock(&m_impl->lock);
+		m_impl->stat.numBackendFetches++;
+	}
+	FetchedClosure *fetchedClosure =
+	  new FetchedClosure(*this, itemInfo, beginTime, endTime,
+	                     gapBegin, gapEnd, closure);
+	dataStorePtr->startOnDemandFetchHistory(itemInfo, gapBegin, gapEnd,
+	                                        fetchedClosure);
+}
+
+void HistoryStore::getStat(Stat &stat)
+{
+	AutoMutex autoLock(&m_impl->lock);
+	stat = m_impl->stat;
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HistoryStore_h
+#define HistoryStore_h
+
+#include <memory>
+#include <string>
+#include "Monitoring.h"
+#include "DataStore.h"
+#include "Closure.h"
+
+/**
+ * HistoryStore keeps item history on the local disk.
+ *
+ * The samples of an item are appended to a file of the item in
+ * compressed blocks. Timestamps are encoded as delta-of-delta varints.
+ * Decimal values are encoded as XOR-compressed doubles with the number
+ * of fractional digits, so that the same string is reproduced.
+ * Other values are stored as strings.
+ *
+ * The store also remembers the time ranges that were fetched from
+ * the monitoring server (the coverage). A history request is replied
+ * locally when the coverage includes the range. Otherwise only the gap
+ * is fetched from the data store.
+ *
+ * The store is disabled when the directory is empty. fetch() then
+ * passes the request to the data store as it is.
+ *
+ * All methods are thread safe.
+ */
+class HistoryStore {
+public:
+	static const size_t MAX_SAMPLES_PER_BLOCK;
+
+	/**
+	 * The latest samples of this duration aren't regarded as covered
+	 * by a fetch, because the monitoring server may not have them yet.
+	 */
+	static const time_t SETTLE_TIME_SEC;
+
+	struct Stat {
+		uint64_t numStoredSamples;
+		uint64_t numStoredBlocks;
+		// The size of the stored blocks including their headers.
+		uint64_t storedBytes;
+		// The number of requests replied only with the local samples.
+		uint64_t numLocalReplies;
+		// The number of requests passed to the data store.
+		uint64_t numBackendFetches;
+
+		Stat(void);
+	};
+
+	/**
+	 * Get the store in the directory given by ConfigManager.
+	 */
+	static HistoryStore *getInstance(void);
+
+	HistoryStore(const std::string &directory);
+	virtual ~HistoryStore();
+
+	bool isEnabled(void) const;
+
+	/**
+	 * Store samples that aren't a result of a fetch.
+	 *
+	 * The coverage isn't changed.
+	 *
+	 * @param historyInfoVect Samples of any servers and items.
+	 * @return true on success. Otherwise false.
+	 */
+	bool add(const HistoryInfoVect &historyInfoVect);
+
+	/**
+	 * Store samples fetched from a monitoring server.
+	 *
+	 * @param serverId A server ID.
+	 * @param itemId An item ID.
+	 * @param beginTime The begin of the fetched range.
+	 * @param endTime
+	 * The end of the fetched range (inclusive). The range is added to
+	 * the coverage.
+	 * @param historyInfoVect The fetched samples of the item.
+	 * @return true on success. Otherwise false.
+	 */
+	bool addFetched(const ServerIdType &serverId, const ItemIdType &itemId,
+	                const time_t &beginTime, const time_t &endTime,
+	                const HistoryInfoVect &historyInfoVect);
+
+	/**
+	 * Get the stored samples in a range.
+	 *
+	 * @param historyInfoVect
+	 * The samples are added in the order of the time. A sample with the
+	 * same time as a later stored one is omitted.
+	 * @param serverId A server ID.
+	 * @param itemId An item ID.
+	 * @param beginTime The begin of the range (inclusive).
+	 * @param endTime The end of the range (inclusive).
+	 */
+	void get(HistoryInfoVect &historyInfoVect,
+	         const ServerIdType &serverId, const ItemIdType &itemId,
+	         const time_t &beginTime, const time_t &endTime);
+
+	/**
+	 * Find the part of a range that isn't covered.
+	 *
+	 * @param gapBegin The first uncovered second is set.
+	 * @param gapEnd The last uncovered second is set.
+	 * @return true if there's a gap. false if the range is covered.
+	 */
+	bool findGap(const ServerIdType &serverId, const ItemIdType &itemId,
+	             const time_t &beginTime, const time_t &endTime,
+	             time_t &gapBegin, time_t &gapEnd);
+
+	/**
+	 * Reply the history of an item.
+	 *
+	 * The closure is called with the local samples when the range is
+	 * covered. Otherwise, DataStore::startOnDemandFetchHistory() is
+	 * called for the gap and the closure is called with the merged
+	 * samples after it's done.
+	 *
+	 * @param dataStorePtr The data store of the server.
+	 * @param itemInfo The target item.
+	 * @param beginTime The begin of the range (inclusive).
+	 * @param endTime The end of the range (inclusive).
+	 * @param closure
+	 * A closure to be called with the samples. This method takes the
+	 * ownership.
+	 */
+	void fetch(DataStorePtr dataStorePtr, const ItemInfo &itemInfo,
+	           const time_t &beginTime, const time_t &endTime,
+	           Closure1<HistoryInfoVect> *closure);
+
+	void getStat(Stat &stat);
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> m_impl;
+};
+
+#endif // HistoryStore_h
@@ -24,17 +24,21 @@
 #include "UnifiedDataStore.h"
 #include <Mutex.h>
 #include "SimpleSemaphore.h"
+#include "SmartTime.h"
 #include "Reaper.h"
 #include "AtomicValue.h"
 #include <unistd.h>
 #include <time.h>
-#include <queue>
+#include <list>
+#include <map>
+#include <vector>
 
 using namespace std;
 using namespace mlpl;
 
 static const size_t DEFAULT_RETRY_LIMIT = 3;
 static const unsigned int DEFAULT_RETRY_INTERVAL_MSEC = 5000;
+const size_t IncidentSender::DEFAULT_MAX_CONCURRENT_JOBS = 4;
 
 struct IncidentSender::Job
 {
@@ -45,13 +49,29 @@ struct IncidentSender::Job
 	UpdateIncidentCallback updateCallback;
 	void *userData;
 
+	// Jobs with the same key are sent one by one in the queued order.
+	// It's empty when there's no such restriction.
+	string key;
+	// Jobs completed with the result of this job.
+	vector<Job *> followers;
+	bool started;
+	size_t retryCount;
+	SmartTime retryTime;
+
 	Job(const EventInfo &_eventInfo,
 	    CreateIncidentCallback _callback = NULL,
 	    void *_userData = NULL)
 	: eventInfo(new EventInfo(_eventInfo)), incidentInfo(NULL),
 	  createCallback(_callback), updateCallback(NULL),
-	  userData(_userData)
+	  userData(_userData),
+	  started(false),
+	  retryCount(0)
 	{
+		if (!eventInfo->triggerId.empty()) {
+			key = StringUtils::sprintf(
+			  "trigger:%" FMT_SERVER_ID ":%s",
+			  eventInfo->serverId, eventInfo->triggerId.c_str());
+		}
 	}
 
 	Job(const IncidentInfo &_incidentInfo,
@@ -61,16 +81,40 @@ struct IncidentSender::Job
 	: eventInfo(NULL), incidentInfo(new IncidentInfo(_incidentInfo)),
 	  comment(_comment),
 	  createCallback(NULL), updateCallback(_callback),
-	  userData(_userData)
+	  userData(_userData),
+	  started(false),
+	  retryCount(0)
 	{
+		key = StringUtils::sprintf(
+		  "incident:%" FMT_INCIDENT_TRACKER_ID ":%s",
+		  incidentInfo->trackerId, incidentInfo->identifier.c_str());
 	}
 
 	virtual ~Job()
 	{
+		for (size_t i = 0; i < followers.size(); i++)
+			delete followers[i];
 		delete eventInfo;
 		delete incidentInfo;
 	}
 
+	/**
+	 * Check if 'job' can be completed with the result of this job
+	 * instead of being sent. Events are never merged, because an
+	 * incident (a row of the incidents table) belongs to one event.
+	 */
+	bool canMerge(const Job &job) const
+	{
+		if (key.empty() || key != job.key)
+			return false;
+		if (incidentInfo && job.incidentInfo) {
+			return incidentInfo->statusCode ==
+			         job.incidentInfo->statusCode &&
+			       comment == job.comment;
+		}
+		return false;
+	}
+
 	void notifyStatus(const JobStatus &status) const
 	{
 		if (eventInfo && createCallback)
@@ -79,6 +123,13 @@ struct IncidentSender::Job
 			updateCallback(*incidentInfo, status, userData);
 	}
 
+	void notifyStatusWithFollowers(const JobStatus &status) const
+	{
+		notifyStatus(status);
+		for (size_t i = 0; i < followers.size(); i++)
+			followers[i]->notifyStatus(status);
+	}
+
 	HatoholError send(IncidentSender &sender) const
 	{
 		if (eventInfo)
@@ -89,23 +140,47 @@ struct IncidentSender::Job
 	}
 };
 
+IncidentSender::Stat::Stat(void)
+: queueDepth(0),
+  numRunningJobs(0),
+  numSucceededJobs(0),
+  numFailedJobs(0),
+  numMergedJobs(0),
+  numRetries(0),
+  numSends(0),
+  sendTimeMSec(0),
+  maxSendTimeMSec(0)
+{
+}
+
 struct IncidentSender::Impl
 {
 	IncidentSender &sender;
 	IncidentTrackerInfo incidentTrackerInfo;
 	Mutex            queueLock;
-	std::queue<Job*> queue;
-	AtomicValue<Job*> runningJob;
+	// Jobs waiting for a worker. (used with queueLock)
+	list<Job *>      queue;
+	// Jobs waiting for a retry. (used with queueLock)
+	list<Job *>      retryList;
+	// Jobs with a key taken by a worker until they are completed.
+	// (used with queueLock)
+	map<string, Job *> runningJobMap;
+	// The number of jobs taken by a worker including the ones in
+	// retryList. (used with queueLock)
+	size_t           numRunningJobs;
+	Stat             stat; // used with queueLock
 	SimpleSemaphore jobSemaphore;
 	size_t retryLimit;
 	unsigned int retryIntervalMSec;
+	size_t maxConcurrentJobs;
 	AtomicValue<bool> trackerChanged;
 	Mutex trackerLock;
 
 	Impl(IncidentSender &_sender)
-	: sender(_sender), runningJob(NULL), jobSemaphore(0),
+	: sender(_sender), numRunningJobs(0), jobSemaphore(0),
 	  retryLimit(DEFAULT_RETRY_LIMIT),
-	  retryIntervalMSec(DEFAULT_RETRY_INTERVAL_MSEC)
+	  retryIntervalMSec(DEFAULT_RETRY_INTERVAL_MSEC),
+	  maxConcurrentJobs(DEFAULT_MAX_CONCURRENT_JOBS)
 	{
 	}
 
@@ -114,71 +189,233 @@ struct IncidentSender::Impl
 		queueLock.lock();
 		while (!queue.empty()) {
 			Job *job = queue.front();
-			queue.pop();
+			queue.pop_front();
 			delete job;
 		}
 		queueLock.unlock();
 	}
 
+	/**
+	 * Find a job that 'job' can be merged into. Only the last job with
+	 * the same key is checked so that the order of the jobs is kept.
+	 * This should be called with queueLock.
+	 */
+	Job *findLeader(const Job &job)
+	{
+		if (job.key.empty())
+			return NULL;
+		list<Job *>::reverse_iterator it = queue.rbegin();
+		for (; it != queue.rend(); ++it) {
+			if ((*it)->key == job.key)
+				return (*it)->canMerge(job) ? *it : NULL;
+		}
+		map<string, Job *>::iterator jobIt =
+		  runningJobMap.find(job.key);
+		if (jobIt == runningJobMap.end())
+			return NULL;
+		return jobIt->second->canMerge(job) ? jobIt->second : NULL;
+	}
+
 	void pushJob(Job *job)
 	{
 		queueLock.lock();
-		queue.push(job);
 		job->notifyStatus(JOB_QUEUED);
-		jobSemaphore.post();
+		Job *leader = findLeader(*job);
+		if (leader) {
+			leader->followers.push_back(job);
+			if (leader->started)
+				job->notifyStatus(JOB_STARTED);
+			stat.numMergedJobs++;
+		} else {
+			queue.push_back(job);
+			jobSemaphore.post();
+		}
 		queueLock.unlock();
 	}
 
-	Job *popJob(void)
+	/**
+	 * Take a job to be sent next. A job whose retry time has come is
+	 * taken first. This should be called with queueLock.
+	 *
+	 * @param waitMSec
+	 * If no job is taken, the time until the next retry is set.
+	 * Otherwise -1 is set.
+	 *
+	 * @return A job or NULL.
+	 */
+	Job *popJob(int &waitMSec)
+	{
+		waitMSec = -1;
+		SmartTime now(SmartTime::INIT_CURR_TIME);
+		list<Job *>::iterator it = retryList.begin();
+		for (; it != retryList.end(); ++it) {
+			Job *job = *it;
+			if (job->retryTime <= now) {
+				retryList.erase(it);
+				job->notifyStatusWithFollowers(JOB_RETRYING);
+				return job;
+			}
+			SmartTime remaining(job->retryTime);
+			remaining -= now;
+			const int msec = remaining.getAsMSec() + 1;
+			if (waitMSec < 0 || msec < waitMSec)
+				waitMSec = msec;
+		}
+
+		for (it = queue.begin(); it != queue.end(); ++it) {
+			Job *job = *it;
+			if (!job->key.empty()) {
+				if (runningJobMap.find(job->key) !=
+				    runningJobMap.end())
+					continue;
+				runningJobMap[job->key] = job;
+			}
+			queue.erase(it);
+			numRunningJobs++;
+			job->started = true;
+			job->notifyStatusWithFollowers(JOB_STARTED);
+			waitMSec = -1;
+			return job;
+		}
+		return NULL;
+	}
+
+	Job *waitNextJob(void)
+	{
+		while (true) {
+			queueLock.lock();
+			if (sender.isExitRequested()) {
+				queueLock.unlock();
+				return NULL;
+			}
+			int waitMSec;
+			Job *job = popJob(waitMSec);
+			queueLock.unlock();
+			if (job)
+				return job;
+			if (waitMSec < 0)
+				jobSemaphore.wait();
+			else
+				jobSemaphore.timedWait(waitMSec);
+		}
+	}
+
+	/**
+	 * Send a job once. If it fails and can be retried, it's put in
+	 * retryList instead of sleeping on the worker.
+	 */
+	void trySend(Job *job)
 	{
-		Job *job = NULL;
+		SmartTime startTime(SmartTime::INIT_CURR_TIME);
+		HatoholError result = job->send(sender);
+		SmartTime sendTime(SmartTime::INIT_CURR_TIME);
+		sendTime -= startTime;
+
+		const bool shouldRetry = (result != HTERR_OK) &&
+		                         (job->retryCount < retryLimit) &&
+		                         !sender.isExitRequested();
 		queueLock.lock();
-		if (!queue.empty()) {
-			job = queue.front();
-			queue.pop();
+		stat.numSends++;
+		stat.sendTimeMSec += sendTime.getAsMSec();
+		if (sendTime.getAsMSec() > stat.maxSendTimeMSec)
+			stat.maxSendTimeMSec = sendTime.getAsMSec();
+		if (shouldRetry) {
+			job->retryCount++;
+			stat.numRetries++;
+			job->notifyStatusWithFollowers(JOB_WAITING_RETRY);
+			job->retryTime.setCurrTime();
+			const timespec interval = {
+			  static_cast<time_t>(retryIntervalMSec / 1000),
+			  static_cast<long>(retryIntervalMSec % 1000) * 1000000
+			};
+			job->retryTime += interval;
+			retryList.push_back(job);
 		}
-		runningJob = job;
-		if (job)
-			job->notifyStatus(JOB_STARTED);
 		queueLock.unlock();
-		return job;
+
+		if (shouldRetry) {
+			// Wake up a worker to wait for the retry time.
+			jobSemaphore.post();
+			return;
+		}
+		finishJob(job, result);
 	}
 
-	Job *waitNextJob(void)
+	void finishJob(Job *job, const HatoholError &result)
 	{
-		jobSemaphore.wait();
-		if (sender.isExitRequested())
-			return NULL;
+		vector<Job *> followers;
+		queueLock.lock();
+		followers.swap(job->followers);
+		if (!job->key.empty())
+			runningJobMap.erase(job->key);
+		numRunningJobs--;
+		if (result == HTERR_OK)
+			stat.numSucceededJobs++;
 		else
-			return popJob();
-	}
+			stat.numFailedJobs++;
+		queueLock.unlock();
+
+		// A job with the same key may be waiting.
+		if (!job->key.empty())
+			jobSemaphore.post();
 
-	HatoholError trySend(const Job &job) {
-		HatoholError result;
-		for (size_t i = 0; i <= retryLimit; i++) {
-			result = job.send(sender);
-			if (result == HTERR_OK)
-				break;
-			if (i == retryLimit)
-				break;
-			if (sender.isExitRequested())
-				break;
-
-			job.notifyStatus(JOB_WAITING_RETRY);
-			usleep(retryIntervalMSec * 1000);
-
-			if (sender.isExitRequested())
-				break;
-			job.notifyStatus(JOB_RETRYING);
+		const JobStatus status =
+		  (result == HTERR_OK) ? JOB_SUCCEEDED : JOB_FAILED;
+		job->notifyStatus(status);
+		for (size_t i = 0; i < followers.size(); i++) {
+			followers[i]->notifyStatus(status);
+			delete followers[i];
 		}
+		queueLock.lock();
 		if (result == HTERR_OK)
-			job.notifyStatus(JOB_SUCCEEDED);
+			stat.numSucceededJobs += followers.size();
 		else
-			job.notifyStatus(JOB_FAILED);
-		return result;
+			stat.numFailedJobs += followers.size();
+		queueLock.unlock();
+		delete job;
+	}
+
+	/**
+	 * Fail the jobs waiting for a retry on exit.
+	 */
+	void failRetryingJobs(void)
+	{
+		queueLock.lock();
+		list<Job *> jobs;
+		jobs.swap(retryList);
+		queueLock.unlock();
+		while (!jobs.empty()) {
+			finishJob(jobs.front(), HTERR_FAILED_TO_SEND_INCIDENT);
+			jobs.pop_front();
+		}
+	}
+
+	void runJobs(void)
+	{
+		Job *job;
+		while ((job = waitNextJob()))
+			trySend(job);
 	}
 };
 
+class IncidentSender::Worker : public HatoholThreadBase {
+public:
+	Worker(IncidentSender::Impl &impl)
+	: m_impl(impl)
+	{
+	}
+
+protected:
+	virtual gpointer mainThread(HatoholThreadArg *arg) override
+	{
+		m_impl.runJobs();
+		return NULL;
+	}
+
+private:
+	IncidentSender::Impl &m_impl;
+};
+
 IncidentSender::IncidentSender(const IncidentTrackerInfo &tracker)
 : m_impl(new Impl(*this))
 {
@@ -221,12 +458,32 @@ void IncidentSender::setRetryInterval(const unsigned int &msec)
 	m_impl->retryIntervalMSec = msec;
 }
 
+void IncidentSender::setMaxConcurrentJobs(const size_t &num)
+{
+	HATOHOL_ASSERT(num > 0, "The number of jobs must not be zero.");
+	HATOHOL_ASSERT(!isStarted(), "The thread has already started.");
+	m_impl->maxConcurrentJobs = num;
+}
+
+size_t IncidentSender::getMaxConcurrentJobs(void) const
+{
+	return m_impl->maxConcurrentJobs;
+}
+
 bool IncidentSender::isIdling(void)
 {
 	AutoMutex autoMutex(&m_impl->queueLock);
 	if (!m_impl->queue.empty())
 		return false;
-	return !m_impl->runningJob;
+	return m_impl->numRunningJobs == 0;
+}
+
+void IncidentSender::getStat(Stat &stat)
+{
+	AutoMutex autoMutex(&m_impl->queueLock);
+	stat = m_impl->stat;
+	stat.queueDepth = m_impl->queue.size();
+	stat.numRunningJobs = m_impl->numRunningJobs;
 }
 
 const IncidentTrackerInfo IncidentSender::getIncidentTrackerInfo(void)
@@ -340,15 +597,25 @@ string IncidentSender::buildDescription(const EventInfo &event,
 gpointer IncidentSender::mainThread(HatoholThreadArg *arg)
 {
 	const IncidentTrackerInfo &tracker = m_impl->incidentTrackerInfo;
-	Job *job;
 	MLPL_INFO("Start IncidentSender thread for %" FMT_INCIDENT_TRACKER_ID ":%s\n",
 		  tracker.id, tracker.nickname.c_str());
-	while ((job = m_impl->waitNextJob())) {
-		if (!isExitRequested())
-			m_impl->trySend(*job);
-		m_impl->runningJob = NULL;
-		delete job;
+
+	// This thread is one of the workers.
+	vector<Worker *> workers;
+	for (size_t i = 1; i < m_impl->maxConcurrentJobs; i++) {
+		Worker *worker = new Worker(*m_impl);
+		worker->start();
+		workers.push_back(worker);
 	}
+	m_impl->runJobs();
+	for (size_t i = 0; i < workers.size(); i++)
+		m_impl->jobSemaphore.post();
+	for (size_t i = 0; i < workers.size(); i++) {
+		workers[i]->exitSync();
+		delete workers[i];
+	}
+	m_impl->failRetryingJobs();
+
 	MLPL_INFO("Exited IncidentSender thread for %" FMT_INCIDENT_TRACKER_ID ":%s\n",
 		  tracker.id, tracker.nickname.c_str());
 	return NULL;
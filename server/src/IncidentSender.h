@@ -28,6 +28,8 @@
 class IncidentSender : public HatoholThreadBase
 {
 public:
+	static const size_t DEFAULT_MAX_CONCURRENT_JOBS;
+
 	typedef enum {
 		JOB_QUEUED,
 		JOB_STARTED,
@@ -44,6 +46,26 @@ public:
 					       const JobStatus &status,
 					       void *userData);
 
+	struct Stat {
+		// The number of jobs waiting for a worker.
+		size_t   queueDepth;
+		// The number of jobs being sent or waiting for a retry.
+		size_t   numRunningJobs;
+		uint64_t numSucceededJobs;
+		uint64_t numFailedJobs;
+		// The number of updates completed with an identical update
+		// of the same incident instead of being sent.
+		uint64_t numMergedJobs;
+		uint64_t numRetries;
+		// The number of requests to the incident tracking system and
+		// the time spent in them.
+		uint64_t numSends;
+		double   sendTimeMSec;
+		double   maxSendTimeMSec;
+
+		Stat(void);
+	};
+
 	IncidentSender(const IncidentTrackerInfo &tracker);
 	virtual ~IncidentSender();
 
@@ -85,6 +107,10 @@ public:
 	 * start the thread by calling start() before or after calling this
 	 * function.
 	 *
+	 * Up to getMaxConcurrentJobs() jobs are sent concurrently. However,
+	 * the jobs for the same trigger are sent one by one in the queued
+	 * order.
+	 *
 	 * @param event
 	 * An EventInfo to send as an incident.
 	 *
@@ -107,6 +133,10 @@ public:
 	 * You must start the thread by calling start() before or after calling
 	 * this function.
 	 *
+	 * The updates of the same incident are sent one by one in the queued
+	 * order. An update identical to the last one of the incident that
+	 * hasn't been completed isn't sent again.
+	 *
 	 * @param incident
 	 * An IncidentInfo to update.
 	 *
@@ -145,6 +175,17 @@ public:
 	 */
 	void setRetryInterval(const unsigned int &msec);
 
+	/**
+	 * Set the max number of jobs sent concurrently. A job waiting for a
+	 * retry doesn't occupy a worker. This has to be called before
+	 * start().
+	 *
+	 * @param num The max number of jobs. It must not be zero.
+	 */
+	virtual void setMaxConcurrentJobs(const size_t &num);
+
+	size_t getMaxConcurrentJobs(void) const;
+
 	/**
 	 * Check whether all queued sending jobs are finished or not.
 	 *
@@ -153,6 +194,8 @@ public:
 	 */
 	bool isIdling(void);
 
+	void getStat(Stat &stat);
+
 	const IncidentTrackerInfo getIncidentTrackerInfo(void);
 	void setOnChangedIncidentTracker(void);
 
@@ -171,6 +214,7 @@ protected:
 private:
 	struct Job;
 	struct Impl;
+	class Worker;
 	std::unique_ptr<Impl> m_impl;
 };
 
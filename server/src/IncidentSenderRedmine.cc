@@ -38,8 +38,14 @@ struct IncidentSenderRedmine::Impl
 	Impl(IncidentSenderRedmine &sender)
 	: m_sender(sender), m_session(NULL)
 	{
+		// The workers of IncidentSender share this session.
+		// Connections are kept alive and reused by them.
+		const int maxConns = sender.getMaxConcurrentJobs();
 		m_session = soup_session_sync_new_with_options(
-			SOUP_SESSION_TIMEOUT, DEFAULT_TIMEOUT_SECONDS, NULL);
+			SOUP_SESSION_TIMEOUT, DEFAULT_TIMEOUT_SECONDS,
+			SOUP_SESSION_MAX_CONNS, maxConns,
+			SOUP_SESSION_MAX_CONNS_PER_HOST, maxConns,
+			NULL);
 		connectSessionSignals();
 	}
 	virtual ~Impl()
@@ -389,6 +395,16 @@ HatoholError IncidentSenderRedmine::Impl::send(const string &method, const strin
 	return HTERR_OK;
 }
 
+void IncidentSenderRedmine::setMaxConcurrentJobs(const size_t &num)
+{
+	IncidentSender::setMaxConcurrentJobs(num);
+	const int maxConns = num;
+	g_object_set(m_impl->m_session,
+		     SOUP_SESSION_MAX_CONNS, maxConns,
+		     SOUP_SESSION_MAX_CONNS_PER_HOST, maxConns,
+		     NULL);
+}
+
 HatoholError IncidentSenderRedmine::send(const EventInfo &event)
 {
 	string url = getIssuesJSONURL();
@@ -33,6 +33,8 @@ public:
 	virtual HatoholError send(const IncidentInfo &incident,
 				  const std::string &comment) override;
 
+	virtual void setMaxConcurrentJobs(const size_t &num) override;
+
 protected:
 	std::string buildJSON(const EventInfo &event);
 	std::string buildJSON(const IncidentInfo &incident,
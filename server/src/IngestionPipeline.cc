@@ -0,0 +1,892 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <deque>
+#include <Mutex.h>
+#include <SimpleSemaphore.h>
+#include <SmartTime.h>
+#include "IngestionPipeline.h"
+#include "IngestionSpool.h"
+#include "ConfigManager.h"
+#include "HatoholThreadBase.h"
+#include "HatoholException.h"
+#include "ThreadLocalDBCache.h"
+#include "ActionManager.h"
+
+using namespace std;
+using namespace mlpl;
+
+// The number of batches merged into one transaction at most.
+const size_t IngestionPipeline::DEFAULT_MAX_BATCHES_PER_COMMIT = 128;
+
+// The number of writer threads. Each server is assigned to one of them.
+const size_t IngestionPipeline::DEFAULT_NUM_WRITERS = 4;
+
+// The number of spooled records submitted to the writers at once.
+static const size_t MAX_SPOOL_RECORDS_PER_DRAIN = 128;
+// The interval to retry a spooled record after a failed commit.
+static const size_t SPOOL_RETRY_INTERVAL_MSEC = 5000;
+// A spooled record that fails this number of times by itself is moved
+// to the quarantine. Failures while the DB can't be reached aren't
+// counted.
+static const size_t MAX_SPOOL_RECORD_ATTEMPTS = 3;
+// A sub directory of the spool for the records that can't be stored.
+static const char *QUARANTINE_DIRECTORY_NAME = "quarantine";
+// The interval to wait for new records and to flush the spool.
+static const size_t SPOOL_SYNC_INTERVAL_MSEC = 1000;
+
+struct IngestionBatch {
+	EventInfoList      *eventList;
+	const ItemInfoList *itemList;
+	bool                committed;
+	// Set when the commit failed because the DB couldn't be reached.
+	bool                dbUnavailable;
+	// false if the caller checks actions for the events by itself.
+	bool                checkActions;
+	SimpleSemaphore     completion;
+	// An asynchronous batch isn't waited for and is freed when it's
+	// completed.
+	bool                               async;
+	IngestionPipeline::CommitCallback *callback;
+	unique_ptr<EventInfoList>          ownedEventList;
+	unique_ptr<ItemInfoList>           ownedItemList;
+
+	IngestionBatch(void)
+	: eventList(NULL),
+	  itemList(NULL),
+	  committed(false),
+	  dbUnavailable(false),
+	  checkActions(true),
+	  completion(0),
+	  async(false),
+	  callback(NULL)
+	{
+	}
+
+	ServerIdType getServerId(void) const
+	{
+		if (eventList && !eventList->empty())
+			return eventList->front().serverId;
+		if (itemList && !itemList->empty())
+			return itemList->front().serverId;
+		return 0;
+	}
+
+	void complete(const bool &_committed)
+	{
+		committed = _committed;
+		if (!async) {
+			completion.post();
+			return;
+		}
+		if (callback) {
+			try {
+				(*callback)(committed);
+			} catch (const exception &e) {
+				MLPL_ERR("Failed to run a commit callback: "
+				         "%s\n", e.what());
+			}
+			delete callback;
+		}
+		delete this;
+	}
+};
+
+// ---------------------------------------------------------------------------
+// ActionEvaluator
+// ---------------------------------------------------------------------------
+class ActionEvaluator : public HatoholThreadBase {
+public:
+	ActionEvaluator(void)
+	: m_jobSemaphore(0)
+	{
+	}
+
+	virtual ~ActionEvaluator()
+	{
+		exitSync();
+	}
+
+	virtual void waitExit(void) override
+	{
+		m_jobSemaphore.post();
+		HatoholThreadBase::waitExit();
+	}
+
+	void push(EventInfoList *eventList)
+	{
+		AutoMutex autoLock(&m_lock);
+		m_queue.push_back(eventList);
+		m_jobSemaphore.post();
+	}
+
+protected:
+	virtual gpointer mainThread(HatoholThreadArg *arg) override
+	{
+		while (true) {
+			m_jobSemaphore.wait();
+			if (isExitRequested())
+				break;
+			unique_ptr<EventInfoList> eventList(pop());
+			if (!eventList)
+				continue;
+			try {
+				ActionManager actionManager;
+				actionManager.checkEvents(*eventList);
+			} catch (const exception &e) {
+				MLPL_ERR("Failed to check actions: %s\n",
+				         e.what());
+			}
+		}
+		AutoMutex autoLock(&m_lock);
+		for (auto eventList : m_queue)
+			delete eventList;
+		m_queue.clear();
+		return NULL;
+	}
+
+	EventInfoList *pop(void)
+	{
+		AutoMutex autoLock(&m_lock);
+		if (m_queue.empty())
+			return NULL;
+		EventInfoList *eventList = m_queue.front();
+		m_queue.pop_front();
+		return eventList;
+	}
+
+private:
+	Mutex                   m_lock;
+	deque<EventInfoList *>  m_queue;
+	SimpleSemaphore         m_jobSemaphore;
+};
+
+// ---------------------------------------------------------------------------
+// GroupCommitWriter
+// ---------------------------------------------------------------------------
+class GroupCommitWriter : public HatoholThreadBase {
+public:
+	GroupCommitWriter(IngestionPipeline &pipeline,
+			  ActionEvaluator &evaluator,
+			  IngestionPipeline::Stat &stat, Mutex &statLock)
+	: m_pipeline(pipeline),
+	  m_evaluator(evaluator),
+	  m_stat(stat),
+	  m_statLock(statLock),
+	  m_jobSemaphore(0)
+	{
+	}
+
+	virtual ~GroupCommitWriter()
+	{
+		exitSync();
+	}
+
+	virtual void waitExit(void) override
+	{
+		m_jobSemaphore.post();
+		HatoholThreadBase::waitExit();
+	}
+
+	/**
+	 * Queue a batch and wait for its commit.
+	 *
+	 * @param batch A batch to be stored.
+	 * @return true if the batch is committed. Otherwise false.
+	 */
+	bool commit(IngestionBatch &batch)
+	{
+		if (!queue(&batch))
+			return false;
+		batch.completion.wait();
+		return batch.committed;
+	}
+
+	/**
+	 * Queue a batch.
+	 *
+	 * @param batch A batch to be stored.
+	 * @return
+	 * true if the batch is queued. Otherwise false. An asynchronous batch
+	 * is completed as a failure in that case.
+	 */
+	bool queue(IngestionBatch *batch)
+	{
+		{
+			AutoMutex autoLock(&m_lock);
+			if (!isExitRequested()) {
+				m_queue.push_back(batch);
+				m_jobSemaphore.post();
+				return true;
+			}
+		}
+		if (batch->async)
+			batch->complete(false);
+		return false;
+	}
+
+protected:
+	virtual gpointer mainThread(HatoholThreadArg *arg) override
+	{
+		vector<IngestionBatch *> batches;
+		while (true) {
+			m_jobSemaphore.wait();
+			if (isExitRequested())
+				break;
+			// The batches that arrived while the previous commit
+			// ran are merged into one transaction.
+			takeBatches(batches);
+			if (batches.empty())
+				continue;
+			writeBatches(batches);
+			batches.clear();
+		}
+
+		AutoMutex autoLock(&m_lock);
+		for (auto batch : m_queue)
+			batch->complete(false);
+		m_queue.clear();
+		return NULL;
+	}
+
+	void takeBatches(vector<IngestionBatch *> &batches)
+	{
+		AutoMutex autoLock(&m_lock);
+		const size_t maxBatches =
+		  IngestionPipeline::DEFAULT_MAX_BATCHES_PER_COMMIT;
+		while (!m_queue.empty() && batches.size() < maxBatches) {
+			batches.push_back(m_queue.front());
+			m_queue.pop_front();
+			// Each batch has posted the semaphore once.
+			if (batches.size() > 1)
+				m_jobSemaphore.tryWait();
+		}
+	}
+
+	void writeBatches(vector<IngestionBatch *> &batches)
+	{
+		vector<bool> results(batches.size(), false);
+		bool dbUnavailable = false;
+		if (commitBatches(batches, dbUnavailable)) {
+			results.assign(batches.size(), true);
+		} else if (batches.size() > 1 && !dbUnavailable) {
+			// One bad batch fails the whole transaction. Each
+			// batch is committed by itself again so that only
+			// the bad ones are rejected.
+			for (size_t i = 0; i < batches.size(); i++) {
+				vector<IngestionBatch *> batch(1, batches[i]);
+				results[i] = commitBatches(batch, dbUnavailable);
+				batches[i]->dbUnavailable = dbUnavailable;
+			}
+		} else {
+			for (auto batch : batches)
+				batch->dbUnavailable = dbUnavailable;
+		}
+
+		EventInfoList *committedEvents = NULL;
+		for (size_t i = 0; i < batches.size(); i++) {
+			EventInfoList *eventList = batches[i]->eventList;
+			if (!results[i] || !eventList ||
+			    !batches[i]->checkActions)
+				continue;
+			if (!committedEvents)
+				committedEvents = new EventInfoList();
+			committedEvents->insert(committedEvents->end(),
+			                        eventList->begin(),
+			                        eventList->end());
+		}
+		if (committedEvents)
+			m_evaluator.push(committedEvents);
+
+		{
+			AutoMutex autoLock(&m_statLock);
+			m_stat.numBatches += batches.size();
+		}
+		for (size_t i = 0; i < batches.size(); i++)
+			batches[i]->complete(results[i]);
+	}
+
+	/**
+	 * Store batches in one transaction.
+	 *
+	 * @param batches Batches to be stored.
+	 * @param dbUnavailable
+	 * Set to true if the DB couldn't be reached. Otherwise false.
+	 * @return true if the transaction is committed. Otherwise false.
+	 */
+	bool commitBatches(const vector<IngestionBatch *> &batches,
+			   bool &dbUnavailable)
+	{
+		vector<EventInfoList *> eventLists;
+		vector<const ItemInfoList *> itemLists;
+		for (auto batch : batches) {
+			if (batch->eventList)
+				eventLists.push_back(batch->eventList);
+			if (batch->itemList)
+				itemLists.push_back(batch->itemList);
+		}
+
+		bool committed = false;
+		dbUnavailable = false;
+		SmartTime startTime(SmartTime::INIT_CURR_TIME);
+		try {
+			m_pipeline.commitLists(eventLists, itemLists);
+			committed = true;
+		} catch (const HatoholException &e) {
+			MLPL_ERR("Failed to commit %zd batches: %s\n",
+			         batches.size(), e.getFancyMessage().c_str());
+			dbUnavailable =
+			  (e.getErrCode() == HTERR_FAILED_CONNECT_MYSQL);
+		} catch (const exception &e) {
+			MLPL_ERR("Failed to commit %zd batches: %s\n",
+			         batches.size(), e.what());
+		}
+		SmartTime commitTime(SmartTime::INIT_CURR_TIME);
+		commitTime -= startTime;
+
+		{
+			AutoMutex autoLock(&m_statLock);
+			m_stat.commitTimeMSec += commitTime.getAsMSec();
+			if (committed)
+				m_stat.numCommits++;
+			else
+				m_stat.numFailedCommits++;
+		}
+
+		MLPL_DBG("group commit: batches: %zd, event lists: %zd, "
+		         "item lists: %zd\n",
+		         batches.size(), eventLists.size(), itemLists.size());
+		return committed;
+	}
+
+private:
+	IngestionPipeline        &m_pipeline;
+	ActionEvaluator          &m_evaluator;
+	IngestionPipeline::Stat  &m_stat;
+	Mutex                    &m_statLock;
+	Mutex                     m_lock;
+	deque<IngestionBatch *>   m_queue;
+	SimpleSemaphore           m_jobSemaphore;
+};
+
+// ---------------------------------------------------------------------------
+// SpoolDrainer
+// ---------------------------------------------------------------------------
+class SpoolDrainer : public HatoholThreadBase {
+public:
+	typedef vector<unique_ptr<GroupCommitWriter> > WriterVect;
+
+	SpoolDrainer(IngestionSpool &spool, IngestionSpool *quarantine,
+		     WriterVect &writers, const size_t &retryIntervalMSec,
+		     IngestionPipeline::Stat &stat, Mutex &statLock)
+	: m_spool(spool),
+	  m_quarantine(quarantine),
+	  m_writers(writers),
+	  m_retryIntervalMSec(retryIntervalMSec),
+	  m_stat(stat),
+	  m_statLock(statLock),
+	  m_wakeSemaphore(0)
+	{
+	}
+
+	virtual ~SpoolDrainer()
+	{
+		exitSync();
+	}
+
+	virtual void waitExit(void) override
+	{
+		m_wakeSemaphore.post();
+		HatoholThreadBase::waitExit();
+	}
+
+	/**
+	 * Append a list to the spool, or commit it after all spooled
+	 * records when the spool is full. In the latter case, this method
+	 * waits for the commit. No list is appended until then, so that
+	 * a list of a server never overtakes an older one.
+	 *
+	 * @param list A list to be stored.
+	 * @param batch A batch of the list used when it isn't spooled.
+	 * @param waitForCommit
+	 * If true, the list isn't spooled and is always committed in the
+	 * same way as when the spool is full.
+	 * @return true if the list is spooled or committed.
+	 */
+	template<typename T>
+	bool add(const T &list, IngestionBatch &batch,
+	         const bool &waitForCommit)
+	{
+		{
+			AutoMutex autoLock(&m_overflowLock);
+			if (!waitForCommit && m_overflow.empty() &&
+			    m_spool.append(list)) {
+				m_wakeSemaphore.post();
+				return true;
+			}
+			if (isExitRequested())
+				return false;
+			m_overflow.push_back(&batch);
+		}
+		m_wakeSemaphore.post();
+		batch.completion.wait();
+		return batch.committed;
+	}
+
+protected:
+	virtual gpointer mainThread(HatoholThreadArg *arg) override
+	{
+		SmartTime lastSyncTime(SmartTime::INIT_CURR_TIME);
+		while (!isExitRequested()) {
+			const bool drained = drain() || submitOverflow();
+			SmartTime elapsed(SmartTime::INIT_CURR_TIME);
+			elapsed -= lastSyncTime;
+			if (elapsed.getAsMSec() >= SPOOL_SYNC_INTERVAL_MSEC) {
+				m_spool.sync();
+				lastSyncTime = SmartTime(SmartTime::INIT_CURR_TIME);
+			}
+			if (drained)
+				continue;
+			m_wakeSemaphore.timedWait(SPOOL_SYNC_INTERVAL_MSEC);
+			// Wake-ups by the appenders are counted. They are
+			// consumed at once since drain() takes all records.
+			while (m_wakeSemaphore.tryWait() == 0)
+				;
+		}
+		m_spool.sync();
+
+		AutoMutex autoLock(&m_overflowLock);
+		for (auto batch : m_overflow)
+			batch->complete(false);
+		m_overflow.clear();
+		return NULL;
+	}
+
+	/**
+	 * Submit spooled records to the writers and checkpoint them.
+	 *
+	 * @return true if any records are stored. Otherwise false.
+	 */
+	bool drain(void)
+	{
+		vector<unique_ptr<IngestionBatch> > batches;
+		IngestionSpool::Record record;
+		IngestionSpool::Position next;
+		timespec oldestTime = {0, 0};
+		while (batches.size() < MAX_SPOOL_RECORDS_PER_DRAIN &&
+		       m_spool.read(record)) {
+			if (batches.empty())
+				oldestTime = record.appendedTime;
+			next = record.next;
+			batches.push_back(unique_ptr<IngestionBatch>(
+			  createBatch(record)));
+		}
+		if (batches.empty())
+			return false;
+		for (auto &batch : batches)
+			submit(*batch);
+		size_t numFailed = 0;
+		for (auto &batch : batches) {
+			batch->completion.wait();
+			if (!batch->committed)
+				numFailed++;
+		}
+
+		if (numFailed > 0) {
+			// A later record of a server may have been stored
+			// before a failed one. The records are stored again
+			// one by one in the order of the spool, so that the
+			// latest values win.
+			MLPL_ERR("Failed to store %zd of %zd spooled records. "
+				 "Retry them one by one.\n",
+				 numFailed, batches.size());
+			m_spool.rewind();
+			if (!drainOneByOne(batches.size()))
+				return false;
+		} else {
+			m_spool.checkpoint(next);
+		}
+
+		SmartTime lag(SmartTime::INIT_CURR_TIME);
+		lag -= SmartTime(oldestTime);
+		AutoMutex autoLock(&m_statLock);
+		m_stat.spoolLagMSec = lag.getAsMSec();
+		return true;
+	}
+
+	/**
+	 * Store spooled records one at a time.
+	 *
+	 * @param numRecords The number of records to be stored.
+	 * @return false if the exit is requested. Otherwise true.
+	 */
+	bool drainOneByOne(const size_t &numRecords)
+	{
+		IngestionSpool::Record record;
+		for (size_t i = 0; i < numRecords && m_spool.read(record); i++) {
+			unique_ptr<IngestionBatch> batch(createBatch(record));
+			if (!storeRecord(*batch))
+				return false;
+			m_spool.checkpoint(record.next);
+		}
+		return true;
+	}
+
+	/**
+	 * Commit a batch of a spooled record until it succeeds, or move it
+	 * to the quarantine after MAX_SPOOL_RECORD_ATTEMPTS failures.
+	 *
+	 * @param batch A batch to be stored.
+	 * @return false if the exit is requested. Otherwise true.
+	 */
+	bool storeRecord(IngestionBatch &batch)
+	{
+		size_t numAttempts = 0;
+		while (!isExitRequested()) {
+			// The same lists can be committed again because the
+			// events and the items are upserted.
+			batch.committed = false;
+			batch.dbUnavailable = false;
+			submit(batch);
+			batch.completion.wait();
+			if (batch.committed)
+				return true;
+			// The record may be fine. It's kept until the DB is
+			// back.
+			if (!batch.dbUnavailable)
+				numAttempts++;
+			if (numAttempts >= MAX_SPOOL_RECORD_ATTEMPTS) {
+				quarantine(batch);
+				return true;
+			}
+			m_wakeSemaphore.timedWait(m_retryIntervalMSec);
+		}
+		return false;
+	}
+
+	void quarantine(const IngestionBatch &batch)
+	{
+		const size_t numElements = batch.eventList ?
+		  batch.eventList->size() : batch.itemList->size();
+		bool saved = false;
+		if (m_quarantine) {
+			saved = batch.eventList ?
+			  m_quarantine->append(*batch.eventList) :
+			  m_quarantine->append(*batch.itemList);
+		}
+		MLPL_ERR("Gave up storing a spooled record of %zd %s of "
+			 "server %" FMT_SERVER_ID ". %s\n",
+			 numElements, batch.eventList ? "events" : "items",
+			 batch.getServerId(),
+			 saved ? "It's moved to the quarantine." :
+			         "It's dropped.");
+		AutoMutex autoLock(&m_statLock);
+		m_stat.numQuarantined++;
+	}
+
+	/**
+	 * Submit the batches that couldn't be spooled. All spooled records
+	 * before them have been stored.
+	 *
+	 * @return true if any batches are submitted. Otherwise false.
+	 */
+	bool submitOverflow(void)
+	{
+		deque<IngestionBatch *> batches;
+		{
+			AutoMutex autoLock(&m_overflowLock);
+			batches.swap(m_overflow);
+		}
+		// Records appended after this are submitted later, so the
+		// writers still get them in order.
+		for (auto batch : batches)
+			submit(*batch);
+		return !batches.empty();
+	}
+
+	IngestionBatch *createBatch(IngestionSpool::Record &record)
+	{
+		IngestionBatch *batch = new IngestionBatch();
+		if (record.type == IngestionSpool::RECORD_EVENTS) {
+			batch->ownedEventList.reset(new EventInfoList());
+			batch->ownedEventList->swap(record.eventList);
+			batch->eventList = batch->ownedEventList.get();
+		} else {
+			batch->ownedItemList.reset(new ItemInfoList());
+			batch->ownedItemList->swap(record.itemList);
+			batch->itemList = batch->ownedItemList.get();
+		}
+		return batch;
+	}
+
+	void submit(IngestionBatch &batch)
+	{
+		// Only synchronous batches are submitted here.
+		const size_t index = static_cast<size_t>(batch.getServerId()) %
+		                     m_writers.size();
+		if (!m_writers[index]->queue(&batch))
+			batch.complete(false);
+	}
+
+private:
+	IngestionSpool           &m_spool;
+	IngestionSpool           *m_quarantine;
+	WriterVect               &m_writers;
+	const size_t              m_retryIntervalMSec;
+	IngestionPipeline::Stat  &m_stat;
+	Mutex                    &m_statLock;
+	SimpleSemaphore           m_wakeSemaphore;
+	// Batches waiting for the spool to be drained.
+	Mutex                     m_overflowLock;
+	deque<IngestionBatch *>   m_overflow;
+};
+
+// ---------------------------------------------------------------------------
+// IngestionPipeline
+// ---------------------------------------------------------------------------
+struct IngestionPipeline::Impl
+{
+	static IngestionPipeline instance;
+
+	IngestionPipeline           &pipeline;
+	Mutex                        startLock;
+	bool                         started;
+	Stat                         stat;
+	Mutex                        statLock;
+	unique_ptr<ActionEvaluator>  evaluator;
+	vector<unique_ptr<GroupCommitWriter> > writers;
+	// A spool given by the constructor for the test. When it's NULL,
+	// the configured directory is used.
+	unique_ptr<IngestionSpool>   spool;
+	unique_ptr<IngestionSpool>   quarantine;
+	unique_ptr<SpoolDrainer>     drainer;
+	size_t                       spoolRetryIntervalMSec;
+
+	Impl(IngestionPipeline &_pipeline)
+	: pipeline(_pipeline),
+	  started(false),
+	  spoolRetryIntervalMSec(SPOOL_RETRY_INTERVAL_MSEC)
+	{
+	}
+
+	~Impl()
+	{
+		stop();
+	}
+
+	void stop(void)
+	{
+		// The drainer feeds the writers and the writers feed the
+		// evaluator. They are stopped in that order.
+		drainer.reset();
+		writers.clear();
+		evaluator.reset();
+		spool.reset();
+		quarantine.reset();
+	}
+
+	void prepare(void)
+	{
+		AutoMutex autoLock(&startLock);
+		if (started)
+			return;
+		evaluator.reset(new ActionEvaluator());
+		evaluator->start();
+		for (size_t i = 0; i < DEFAULT_NUM_WRITERS; i++) {
+			GroupCommitWriter *writer =
+			  new GroupCommitWriter(pipeline, *evaluator, stat,
+			                        statLock);
+			writers.push_back(unique_ptr<GroupCommitWriter>(writer));
+			writer->start();
+		}
+		startSpool();
+		started = true;
+	}
+
+	void startSpool(void)
+	{
+		unique_ptr<IngestionSpool> newSpool(move(spool));
+		if (!newSpool) {
+			const string directory = ConfigManager::getInstance()->
+			  getIngestionSpoolDirectory();
+			if (directory.empty())
+				return;
+			newSpool.reset(new IngestionSpool(directory));
+		}
+		const string &directory = newSpool->getDirectory();
+		if (!newSpool->open()) {
+			MLPL_ERR("The ingestion spool is disabled: %s\n",
+			         directory.c_str());
+			return;
+		}
+		spool = move(newSpool);
+
+		// The records are kept for an investigation. The drainer
+		// drops them when this can't be opened.
+		quarantine.reset(new IngestionSpool(
+		  directory + "/" + QUARANTINE_DIRECTORY_NAME));
+		if (!quarantine->open())
+			quarantine.reset();
+
+		drainer.reset(new SpoolDrainer(*spool, quarantine.get(),
+		                               writers, spoolRetryIntervalMSec,
+		                               stat, statLock));
+		drainer->start();
+	}
+
+	GroupCommitWriter &getWriter(const ServerIdType &serverId)
+	{
+		prepare();
+		// All batches of a server go to the same writer, which
+		// commits them in the order of arrival.
+		const size_t index = static_cast<size_t>(serverId) %
+		                     writers.size();
+		return *writers[index];
+	}
+
+	template<typename T>
+	bool add(IngestionBatch &batch, const T &list,
+	         const bool &waitForCommit)
+	{
+		GroupCommitWriter &writer = getWriter(batch.getServerId());
+		// When the spool is full or the caller waits for the commit,
+		// the list is committed after the spooled ones. Otherwise
+		// older spooled data could overwrite it.
+		if (drainer)
+			return drainer->add(list, batch, waitForCommit);
+		return writer.commit(batch);
+	}
+};
+
+IngestionPipeline IngestionPipeline::Impl::instance;
+
+IngestionPipeline::Stat::Stat(void)
+: numCommits(0),
+  numBatches(0),
+  numFailedCommits(0),
+  commitTimeMSec(0),
+  numSpooled(0),
+  spoolDepthBytes(0),
+  spoolLagMSec(0),
+  numQuarantined(0)
+{
+}
+
+IngestionPipeline &IngestionPipeline::getInstance(void)
+{
+	return Impl::instance;
+}
+
+bool IngestionPipeline::addEventList(EventInfoList &eventList,
+                                     const bool &waitForCommit)
+{
+	if (eventList.empty())
+		return true;
+	IngestionBatch batch;
+	batch.eventList = &eventList;
+	return m_impl->add(batch, eventList, waitForCommit);
+}
+
+bool IngestionPipeline::commitEventList(EventInfoList &eventList)
+{
+	if (eventList.empty())
+		return true;
+	IngestionBatch batch;
+	batch.eventList = &eventList;
+	batch.checkActions = false;
+	return m_impl->add(batch, eventList, true);
+}
+
+void IngestionPipeline::addEventList(EventInfoList *eventList,
+                                     CommitCallback *callback)
+{
+	IngestionBatch *batch = new IngestionBatch();
+	batch->ownedEventList.reset(eventList);
+	batch->eventList = eventList;
+	batch->async = true;
+	batch->callback = callback;
+	if (eventList->empty()) {
+		batch->complete(true);
+		return;
+	}
+	m_impl->getWriter(eventList->front().serverId).queue(batch);
+}
+
+bool IngestionPipeline::addItemList(const ItemInfoList &itemList,
+                                    const bool &waitForCommit)
+{
+	if (itemList.empty())
+		return true;
+	IngestionBatch batch;
+	batch.itemList = &itemList;
+	return m_impl->add(batch, itemList, waitForCommit);
+}
+
+void IngestionPipeline::getStat(Stat &stat)
+{
+	{
+		AutoMutex autoLock(&m_impl->statLock);
+		stat = m_impl->stat;
+	}
+	IngestionSpool *spool = NULL;
+	{
+		AutoMutex autoLock(&m_impl->startLock);
+		spool = m_impl->spool.get();
+	}
+	// The spool is never replaced after it's opened.
+	if (!spool)
+		return;
+	IngestionSpool::Stat spoolStat;
+	spool->getStat(spoolStat);
+	stat.numSpooled = spoolStat.numAppended;
+	stat.spoolDepthBytes = spoolStat.depthBytes;
+}
+
+// ---------------------------------------------------------------------------
+// Protected methods
+// ---------------------------------------------------------------------------
+IngestionPipeline::IngestionPipeline(void)
+: m_impl(new Impl(*this))
+{
+}
+
+IngestionPipeline::IngestionPipeline(IngestionSpool *spool,
+                                     const size_t &retryIntervalMSec)
+: m_impl(new Impl(*this))
+{
+	m_impl->spool.reset(spool);
+	m_impl->spoolRetryIntervalMSec = retryIntervalMSec;
+}
+
+IngestionPipeline::~IngestionPipeline()
+{
+}
+
+void IngestionPipeline::commitLists(
+  const vector<EventInfoList *> &eventLists,
+  const vector<const ItemInfoList *> &itemLists)
+{
+	ThreadLocalDBCache cache;
+	cache.getMonitoring().addEventAndItemInfoLists(eventLists, itemLists);
+}
+
+void IngestionPipeline::stop(void)
+{
+	m_impl->stop();
+}
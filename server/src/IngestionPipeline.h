@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IngestionPipeline_h
+#define IngestionPipeline_h
+
+#include <memory>
+#include "DBTablesMonitoring.h"
+#include "Closure.h"
+
+class IngestionSpool;
+
+/**
+ * IngestionPipeline stores monitoring data sent by plugins.
+ *
+ * The data are handled in three stages: the caller's thread that parses
+ * a message, writers that commit batches of many callers in one
+ * transaction (group commit), and an evaluator that checks actions of
+ * the committed events. A caller returns after its data is committed,
+ * so that a reply can be sent safely.
+ *
+ * Servers are spread over DEFAULT_NUM_WRITERS writers by the server ID.
+ * The batches of a server always go to the same writer and are committed
+ * in the order of arrival, which keeps the order of each server.
+ *
+ * When a spool directory is configured, the data of synchronous additions
+ * are appended to an IngestionSpool and a caller returns without waiting
+ * for the DB. A drainer thread passes the spooled data to the writers and
+ * checkpoints them after the commits, so that a stall of the DB doesn't
+ * block the plugins. When the spool is full, a caller waits until its
+ * data is committed after all spooled ones. A spooled record that keeps
+ * failing by itself is moved to the "quarantine" sub directory.
+ *
+ * A reply to a fetch request isn't spooled because the waiter reads the
+ * DB as soon as it's notified. It's committed after all spooled ones in
+ * the same way as when the spool is full.
+ */
+class IngestionPipeline
+{
+public:
+	static const size_t DEFAULT_MAX_BATCHES_PER_COMMIT;
+	static const size_t DEFAULT_NUM_WRITERS;
+
+	/**
+	 * A callback of an asynchronous addition. The argument is true if
+	 * the data is committed. It's called on a writer thread.
+	 */
+	typedef Closure1<bool> CommitCallback;
+
+	struct Stat {
+		uint64_t numCommits;
+		uint64_t numBatches;
+		uint64_t numFailedCommits;
+		// Total time spent in the commits.
+		double   commitTimeMSec;
+		// The number of the records appended to the spool.
+		uint64_t numSpooled;
+		// The bytes in the spool that haven't been stored.
+		uint64_t spoolDepthBytes;
+		// How long the last drained records stayed in the spool.
+		double   spoolLagMSec;
+		// The number of the spooled records given up.
+		uint64_t numQuarantined;
+
+		Stat(void);
+	};
+
+	static IngestionPipeline &getInstance(void);
+
+	/**
+	 * Store events and then evaluate actions for them asynchronously.
+	 *
+	 * @param eventList
+	 * Events to be stored. The unified IDs are set unless the events are
+	 * spooled.
+	 * @param waitForCommit
+	 * If true, the events aren't spooled and this method returns after
+	 * they are committed.
+	 * @return
+	 * true if the events are committed or spooled. Otherwise false.
+	 */
+	bool addEventList(EventInfoList &eventList,
+	                  const bool &waitForCommit = false);
+
+	/**
+	 * Store events and return after they are committed. They are never
+	 * spooled, and actions for them aren't evaluated by the pipeline so
+	 * that the caller can check them on its own thread.
+	 * All events in the list have to belong to the same server.
+	 *
+	 * @param eventList
+	 * Events to be stored. The unified IDs are set.
+	 * @return true if the events are committed. Otherwise false.
+	 */
+	bool commitEventList(EventInfoList &eventList);
+
+	/**
+	 * Store events without waiting for the commit.
+	 * All events in the list have to belong to the same server.
+	 *
+	 * @param eventList
+	 * Events to be stored. The pipeline takes the ownership.
+	 * @param callback
+	 * A callback called after the commit, or NULL. The pipeline takes
+	 * the ownership.
+	 */
+	void addEventList(EventInfoList *eventList,
+	                  CommitCallback *callback = NULL);
+
+	/**
+	 * Store items.
+	 *
+	 * @param itemList Items to be stored.
+	 * @param waitForCommit
+	 * If true, the items aren't spooled and this method returns after
+	 * they are committed.
+	 * @return true if the items are committed or spooled. Otherwise false.
+	 */
+	bool addItemList(const ItemInfoList &itemList,
+	                 const bool &waitForCommit = false);
+
+	void getStat(Stat &stat);
+
+protected:
+	IngestionPipeline(void);
+
+	/**
+	 * Create a pipeline with a given spool. This is mainly for the test.
+	 *
+	 * @param spool
+	 * A spool that hasn't been opened. The pipeline takes the ownership.
+	 * @param retryIntervalMSec
+	 * The interval to retry a spooled record after a failed commit.
+	 */
+	IngestionPipeline(IngestionSpool *spool,
+	                  const size_t &retryIntervalMSec);
+	virtual ~IngestionPipeline();
+
+	/**
+	 * Store lists in one transaction. This is called on writer threads.
+	 *
+	 * @param eventLists Lists of events.
+	 * @param itemLists Lists of items.
+	 */
+	virtual void commitLists(
+	  const std::vector<EventInfoList *> &eventLists,
+	  const std::vector<const ItemInfoList *> &itemLists);
+
+	/**
+	 * Stop the threads. A subclass that overrides commitLists() has to
+	 * call this in its destructor.
+	 */
+	void stop(void);
+
+private:
+	friend class GroupCommitWriter;
+	struct Impl;
+	std::unique_ptr<Impl> m_impl;
+};
+
+#endif // IngestionPipeline_h
@@ -0,0 +1,788 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <inttypes.h>
+#include <cstdio>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <glib.h>
+#include <Logger.h>
+#include <Mutex.h>
+#include <SmartTime.h>
+#include <StringUtils.h>
+#include "IngestionSpool.h"
+
+using namespace std;
+using namespace mlpl;
+
+const size_t IngestionSpool::DEFAULT_SEGMENT_SIZE = 16 * 1024 * 1024;
+// 1 GiB with the default segment size.
+const size_t IngestionSpool::DEFAULT_MAX_NUM_SEGMENTS = 64;
+
+// A segment file consists of a header and records:
+//   header: magic (8 bytes), sequence number (8 bytes)
+//   record: length (4 bytes), checksum (4 bytes), payload (padded to 8)
+// The length is written after the payload. A zero length is the end of
+// the written data. ROTATE_MARK means that the next record is in the
+// next segment.
+static const char     SEGMENT_MAGIC[8] = {'H', 'T', 'S', 'P', 'O', 'O', 'L', '1'};
+static const size_t   SEGMENT_HEADER_SIZE = 16;
+static const size_t   RECORD_HEADER_SIZE = 8;
+static const uint32_t ROTATE_MARK = 0xffffffff;
+static const char    *SEGMENT_NAME_FORMAT = "segment-%016" PRIx64 ".spool";
+static const char    *CHECKPOINT_FILE_NAME = "checkpoint";
+
+static size_t alignRecordSize(const size_t &payloadSize)
+{
+	return RECORD_HEADER_SIZE + ((payloadSize + 7) & ~static_cast<size_t>(7));
+}
+
+static uint32_t calcChecksum(const uint8_t *data, const size_t &size)
+{
+	// FNV-1a
+	uint32_t hash = 2166136261U;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+// ---------------------------------------------------------------------------
+// Payload encoding
+// ---------------------------------------------------------------------------
+struct PayloadWriter {
+	string buf;
+
+	template<typename T> void addValue(const T &value)
+	{
+		buf.append(reinterpret_cast<const char *>(&value), sizeof(T));
+	}
+
+	void add(const string &value)
+	{
+		addValue<uint32_t>(value.size());
+		buf.append(value);
+	}
+
+	void add(const timespec &value)
+	{
+		addValue<int64_t>(value.tv_sec);
+		addValue<int64_t>(value.tv_nsec);
+	}
+
+	void add(const EventInfo &event)
+	{
+		addValue<int32_t>(event.serverId);
+		add(event.id);
+		add(event.time);
+		addValue<int32_t>(event.type);
+		add(event.triggerId);
+		addValue<int32_t>(event.status);
+		addValue<int32_t>(event.severity);
+		addValue<uint64_t>(event.globalHostId);
+		add(event.hostIdInServer);
+		add(event.hostName);
+		add(event.brief);
+		add(event.extendedInfo);
+	}
+
+	void add(const ItemInfo &item)
+	{
+		addValue<int32_t>(item.serverId);
+		add(item.id);
+		addValue<uint64_t>(item.globalHostId);
+		add(item.hostIdInServer);
+		add(item.brief);
+		add(item.lastValueTime);
+		add(item.lastValue);
+		add(item.prevValue);
+		add(item.itemGroupName);
+		addValue<int32_t>(item.delay);
+		addValue<int32_t>(item.valueType);
+		add(item.unit);
+	}
+};
+
+struct PayloadReader {
+	const uint8_t *data;
+	size_t         size;
+	size_t         pos;
+	bool           broken;
+
+	PayloadReader(const uint8_t *_data, const size_t &_size)
+	: data(_data),
+	  size(_size),
+	  pos(0),
+	  broken(false)
+	{
+	}
+
+	template<typename T> T getValue(void)
+	{
+		T value = 0;
+		if (broken || size - pos < sizeof(T)) {
+			broken = true;
+			return value;
+		}
+		memcpy(&value, data + pos, sizeof(T));
+		pos += sizeof(T);
+		return value;
+	}
+
+	void get(string &value)
+	{
+		const uint32_t length = getValue<uint32_t>();
+		if (broken || size - pos < length) {
+			broken = true;
+			return;
+		}
+		value.assign(reinterpret_cast<const char *>(data + pos), length);
+		pos += length;
+	}
+
+	void get(timespec &value)
+	{
+		value.tv_sec = getValue<int64_t>();
+		value.tv_nsec = getValue<int64_t>();
+	}
+
+	void get(EventInfo &event)
+	{
+		initEventInfo(event);
+		event.serverId = getValue<int32_t>();
+		get(event.id);
+		get(event.time);
+		event.type = static_cast<EventType>(getValue<int32_t>());
+		get(event.triggerId);
+		event.status =
+		  static_cast<TriggerStatusType>(getValue<int32_t>());
+		event.severity =
+		  static_cast<TriggerSeverityType>(getValue<int32_t>());
+		event.globalHostId = getValue<uint64_t>();
+		get(event.hostIdInServer);
+		get(event.hostName);
+		get(event.brief);
+		get(event.extendedInfo);
+	}
+
+	void get(ItemInfo &item)
+	{
+		item.serverId = getValue<int32_t>();
+		get(item.id);
+		item.globalHostId = getValue<uint64_t>();
+		get(item.hostIdInServer);
+		get(item.brief);
+		get(item.lastValueTime);
+		get(item.lastValue);
+		get(item.prevValue);
+		get(item.itemGroupName);
+		item.delay = getValue<int32_t>();
+		item.valueType =
+		  static_cast<ItemInfoValueType>(getValue<int32_t>());
+		get(item.unit);
+	}
+};
+
+// ---------------------------------------------------------------------------
+// Segment
+// ---------------------------------------------------------------------------
+struct SpoolSegment {
+	uint64_t  seq;
+	string    path;
+	int       fd;
+	uint8_t  *data;
+	size_t    size;
+
+	SpoolSegment(void)
+	: seq(0),
+	  fd(-1),
+	  data(NULL),
+	  size(0)
+	{
+	}
+
+	~SpoolSegment()
+	{
+		if (data)
+			munmap(data, size);
+		if (fd >= 0)
+			close(fd);
+	}
+
+	bool map(const bool &create, const size_t &segmentSize)
+	{
+		const int flags = O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0);
+		fd = ::open(path.c_str(), flags, 0600);
+		if (fd < 0) {
+			MLPL_ERR("Failed to open %s: %s\n",
+				 path.c_str(), strerror(errno));
+			return false;
+		}
+		if (create) {
+			size = segmentSize;
+			if (!allocate()) {
+				unlink(path.c_str());
+				return false;
+			}
+		} else {
+			struct stat st;
+			if (fstat(fd, &st) < 0 ||
+			    static_cast<size_t>(st.st_size) <
+			      SEGMENT_HEADER_SIZE + RECORD_HEADER_SIZE) {
+				MLPL_ERR("Invalid segment: %s\n", path.c_str());
+				return false;
+			}
+			size = st.st_size;
+		}
+		void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+				  MAP_SHARED, fd, 0);
+		if (addr == MAP_FAILED) {
+			MLPL_ERR("Failed to map %s: %s\n",
+				 path.c_str(), strerror(errno));
+			return false;
+		}
+		data = static_cast<uint8_t *>(addr);
+
+		if (create) {
+			memcpy(data, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+			memcpy(data + sizeof(SEGMENT_MAGIC), &seq, sizeof(seq));
+		} else if (memcmp(data, SEGMENT_MAGIC,
+				  sizeof(SEGMENT_MAGIC)) != 0) {
+			MLPL_ERR("Invalid segment magic: %s\n", path.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	 * Allocate the blocks of the whole segment. A write through the
+	 * mapping to a hole of a sparse file raises SIGBUS when the disk is
+	 * full, so a segment is written only after this succeeds.
+	 *
+	 * @return true on success. Otherwise false.
+	 */
+	bool allocate(void)
+	{
+		const int err = posix_fallocate(fd, 0, size);
+		if (err != 0) {
+			MLPL_ERR("Failed to allocate %s: %s\n",
+				 path.c_str(), strerror(err));
+			return false;
+		}
+		return true;
+	}
+
+	uint32_t getLength(const size_t &offset) const
+	{
+		uint32_t length;
+		memcpy(&length, data + offset, sizeof(length));
+		return length;
+	}
+
+	void setLength(const size_t &offset, const uint32_t &length)
+	{
+		memcpy(data + offset, &length, sizeof(length));
+	}
+
+	/**
+	 * Check the record at offset.
+	 *
+	 * @return The size of the payload, or -1 if it's invalid.
+	 */
+	ssize_t validate(const size_t &offset) const
+	{
+		if (offset + RECORD_HEADER_SIZE > size)
+			return -1;
+		const uint32_t length = getLength(offset);
+		if (length == 0 || length == ROTATE_MARK)
+			return -1;
+		if (offset + alignRecordSize(length) > size)
+			return -1;
+		uint32_t checksum;
+		memcpy(&checksum, data + offset + 4, sizeof(checksum));
+		const uint8_t *payload = data + offset + RECORD_HEADER_SIZE;
+		if (calcChecksum(payload, length) != checksum)
+			return -1;
+		return length;
+	}
+};
+
+// ---------------------------------------------------------------------------
+// Impl
+// ---------------------------------------------------------------------------
+struct IngestionSpool::Impl {
+	const string                   directory;
+	const size_t                   segmentSize;
+	const size_t                   maxNumSegments;
+	Mutex                          lock;
+	map<uint64_t, SpoolSegment *>  segments;
+	Position                       writePos;
+	Position                       readPos;
+	Position                       checkpointPos;
+	Stat                           stat;
+	bool                           opened;
+	// false if the blocks of the last segment found on open() couldn't
+	// be allocated. Nothing is appended then.
+	bool                           writable;
+
+	Impl(const string &_directory, const size_t &_segmentSize,
+	     const size_t &_maxNumSegments)
+	: directory(_directory),
+	  segmentSize(_segmentSize),
+	  maxNumSegments(_maxNumSegments),
+	  opened(false),
+	  writable(false)
+	{
+	}
+
+	~Impl()
+	{
+		for (auto &pair : segments)
+			delete pair.second;
+	}
+
+	string getSegmentPath(const uint64_t &seq)
+	{
+		return directory + "/" +
+		       StringUtils::sprintf(SEGMENT_NAME_FORMAT, seq);
+	}
+
+	string getCheckpointPath(void)
+	{
+		return directory + "/" + CHECKPOINT_FILE_NAME;
+	}
+
+	SpoolSegment *openSegment(const uint64_t &seq, const bool &create)
+	{
+		SpoolSegment *segment = new SpoolSegment();
+		segment->seq = seq;
+		segment->path = getSegmentPath(seq);
+		if (!segment->map(create, segmentSize)) {
+			delete segment;
+			return NULL;
+		}
+		segments[seq] = segment;
+		return segment;
+	}
+
+	SpoolSegment *getSegment(const uint64_t &seq)
+	{
+		auto it = segments.find(seq);
+		return (it == segments.end()) ? NULL : it->second;
+	}
+
+	bool loadCheckpoint(void)
+	{
+		gchar *contents = NULL;
+		if (!g_file_get_contents(getCheckpointPath().c_str(),
+					 &contents, NULL, NULL)) {
+			return false;
+		}
+		uint64_t segment, offset;
+		const int numFields =
+		  sscanf(contents, "%" SCNu64 " %" SCNu64, &segment, &offset);
+		g_free(contents);
+		if (numFields != 2) {
+			MLPL_ERR("Broken spool checkpoint\n");
+			return false;
+		}
+		checkpointPos.segment = segment;
+		checkpointPos.offset = offset;
+		return true;
+	}
+
+	bool saveCheckpoint(const Position &position)
+	{
+		const string path = getCheckpointPath();
+		const string tmpPath = path + ".tmp";
+		const string contents =
+		  StringUtils::sprintf("%" PRIu64 " %" PRIu64 "\n",
+				       position.segment, position.offset);
+		const int fd = ::open(tmpPath.c_str(),
+				      O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+				      0600);
+		if (fd < 0) {
+			MLPL_ERR("Failed to open %s: %s\n",
+				 tmpPath.c_str(), strerror(errno));
+			return false;
+		}
+		const bool written =
+		  (write(fd, contents.c_str(), contents.size()) ==
+		   static_cast<ssize_t>(contents.size())) &&
+		  (fdatasync(fd) == 0);
+		close(fd);
+		if (!written || rename(tmpPath.c_str(), path.c_str()) < 0) {
+			MLPL_ERR("Failed to save %s: %s\n",
+				 path.c_str(), strerror(errno));
+			return false;
+		}
+		return true;
+	}
+
+	void listSegments(vector<uint64_t> &seqs)
+	{
+		GDir *dir = g_dir_open(directory.c_str(), 0, NULL);
+		if (!dir)
+			return;
+		const gchar *name;
+		while ((name = g_dir_read_name(dir))) {
+			uint64_t seq;
+			if (sscanf(name, "segment-%" SCNx64 ".spool", &seq) == 1)
+				seqs.push_back(seq);
+		}
+		g_dir_close(dir);
+		sort(seqs.begin(), seqs.end());
+	}
+
+	/**
+	 * Find the end of the valid records in the last segment and clear
+	 * the rest, which may have a torn record.
+	 */
+	void recoverWritePosition(SpoolSegment &segment, size_t offset)
+	{
+		while (true) {
+			const ssize_t length = segment.validate(offset);
+			if (length < 0)
+				break;
+			offset += alignRecordSize(length);
+		}
+		if (offset < segment.size &&
+		    segment.getLength(offset) == ROTATE_MARK) {
+			// The next segment was lost before it's created.
+			offset += RECORD_HEADER_SIZE;
+		}
+		if (writable && offset < segment.size)
+			memset(segment.data + offset, 0, segment.size - offset);
+		writePos.segment = segment.seq;
+		writePos.offset = offset;
+	}
+
+	void updateDepth(void)
+	{
+		// lock has to be held by the caller.
+		uint64_t depth = 0;
+		for (auto &pair : segments) {
+			const uint64_t seq = pair.first;
+			if (seq < checkpointPos.segment || seq > writePos.segment)
+				continue;
+			const uint64_t begin = (seq == checkpointPos.segment) ?
+			  checkpointPos.offset : SEGMENT_HEADER_SIZE;
+			const uint64_t end = (seq == writePos.segment) ?
+			  writePos.offset : pair.second->size;
+			if (end > begin)
+				depth += end - begin;
+		}
+		stat.depthBytes = depth;
+		stat.numSegments = segments.size();
+	}
+
+	bool rotate(void)
+	{
+		// lock has to be held by the caller.
+		if (segments.size() >= maxNumSegments)
+			return false;
+		SpoolSegment *current = getSegment(writePos.segment);
+		SpoolSegment *next = openSegment(writePos.segment + 1, true);
+		if (!next)
+			return false;
+		if (current)
+			current->setLength(writePos.offset, ROTATE_MARK);
+		writePos.segment = next->seq;
+		writePos.offset = SEGMENT_HEADER_SIZE;
+		return true;
+	}
+
+	bool append(const string &payload)
+	{
+		const size_t recordSize = alignRecordSize(payload.size());
+		// The last RECORD_HEADER_SIZE bytes of a segment are kept
+		// for ROTATE_MARK.
+		const size_t capacity =
+		  segmentSize - SEGMENT_HEADER_SIZE - RECORD_HEADER_SIZE;
+		AutoMutex autoLock(&lock);
+		if (!opened || !writable || recordSize > capacity ||
+		    payload.size() >= ROTATE_MARK) {
+			stat.numRejected++;
+			return false;
+		}
+		SpoolSegment *segment = getSegment(writePos.segment);
+		if (writePos.offset + recordSize >
+		    segment->size - RECORD_HEADER_SIZE) {
+			if (!rotate()) {
+				stat.numRejected++;
+				return false;
+			}
+			segment = getSegment(writePos.segment);
+		}
+
+		uint8_t *dest = segment->data + writePos.offset;
+		const uint32_t checksum =
+		  calcChecksum(reinterpret_cast<const uint8_t *>(
+		                 payload.data()), payload.size());
+		memcpy(dest + 4, &checksum, sizeof(checksum));
+		memcpy(dest + RECORD_HEADER_SIZE, payload.data(),
+		       payload.size());
+		// The length makes the record visible. It's written last.
+		segment->setLength(writePos.offset, payload.size());
+		writePos.offset += recordSize;
+		stat.numAppended++;
+		updateDepth();
+		return true;
+	}
+
+	bool decode(const uint8_t *payload, const size_t &size,
+		    Record &record)
+	{
+		PayloadReader reader(payload, size);
+		record.type = static_cast<RecordType>(reader.getValue<uint8_t>());
+		reader.get(record.appendedTime);
+		const uint32_t count = reader.getValue<uint32_t>();
+		record.eventList.clear();
+		record.itemList.clear();
+		for (uint32_t i = 0; i < count && !reader.broken; i++) {
+			if (record.type == RECORD_EVENTS) {
+				record.eventList.push_back(EventInfo());
+				reader.get(record.eventList.back());
+			} else if (record.type == RECORD_ITEMS) {
+				record.itemList.push_back(ItemInfo());
+				reader.get(record.itemList.back());
+			} else {
+				return false;
+			}
+		}
+		return !reader.broken;
+	}
+};
+
+IngestionSpool::Position::Position(void)
+: segment(0),
+  offset(0)
+{
+}
+
+IngestionSpool::Stat::Stat(void)
+: numAppended(0),
+  numRead(0),
+  numRejected(0),
+  numSegments(0),
+  depthBytes(0)
+{
+}
+
+// ---------------------------------------------------------------------------
+// Public methods
+// ---------------------------------------------------------------------------
+IngestionSpool::IngestionSpool(const string &directory,
+			       const size_t &segmentSize,
+			       const size_t &maxNumSegments)
+: m_impl(new Impl(directory, segmentSize, maxNumSegments))
+{
+}
+
+IngestionSpool::~IngestionSpool()
+{
+}
+
+bool IngestionSpool::open(void)
+{
+	AutoMutex autoLock(&m_impl->lock);
+	Impl &impl = *m_impl;
+	if (g_mkdir_with_parents(impl.directory.c_str(), 0700) < 0) {
+		MLPL_ERR("Failed to create %s: %s\n",
+			 impl.directory.c_str(), strerror(errno));
+		return false;
+	}
+
+	const bool hasCheckpoint = impl.loadCheckpoint();
+	vector<uint64_t> seqs;
+	impl.listSegments(seqs);
+	for (auto seq : seqs) {
+		if (hasCheckpoint && seq < impl.checkpointPos.segment) {
+			unlink(impl.getSegmentPath(seq).c_str());
+			continue;
+		}
+		if (!impl.openSegment(seq, false))
+			return false;
+	}
+
+	if (impl.segments.empty()) {
+		const uint64_t seq = hasCheckpoint ?
+		  max(impl.checkpointPos.segment, (uint64_t)1) : 1;
+		if (!impl.openSegment(seq, true))
+			return false;
+	}
+	SpoolSegment *first = impl.segments.begin()->second;
+	if (!hasCheckpoint || impl.checkpointPos.segment < first->seq ||
+	    impl.checkpointPos.offset < SEGMENT_HEADER_SIZE) {
+		impl.checkpointPos.segment = first->seq;
+		impl.checkpointPos.offset = SEGMENT_HEADER_SIZE;
+	}
+
+	SpoolSegment *last = impl.segments.rbegin()->second;
+	// The last segment may be a sparse one written before a crash.
+	// The records in it can still be read when it can't be allocated.
+	impl.writable = last->allocate();
+	if (!impl.writable) {
+		MLPL_ERR("No records are appended to the ingestion spool: "
+			 "%s\n", impl.directory.c_str());
+	}
+	const size_t startOffset =
+	  (last->seq == impl.checkpointPos.segment) ?
+	    impl.checkpointPos.offset : SEGMENT_HEADER_SIZE;
+	impl.recoverWritePosition(*last, startOffset);
+	impl.readPos = impl.checkpointPos;
+	impl.opened = true;
+	impl.updateDepth();
+	MLPL_INFO("Opened ingestion spool: %s, segments: %zd, "
+		  "pending: %" PRIu64 " bytes\n",
+		  impl.directory.c_str(), impl.segments.size(),
+		  impl.stat.depthBytes);
+	return true;
+}
+
+bool IngestionSpool::append(const EventInfoList &eventList)
+{
+	PayloadWriter writer;
+	writer.addValue<uint8_t>(RECORD_EVENTS);
+	writer.add(SmartTime(SmartTime::INIT_CURR_TIME).getAsTimespec());
+	writer.addValue<uint32_t>(eventList.size());
+	for (auto &event : eventList)
+		writer.add(event);
+	return m_impl->append(writer.buf);
+}
+
+bool IngestionSpool::append(const ItemInfoList &itemList)
+{
+	PayloadWriter writer;
+	writer.addValue<uint8_t>(RECORD_ITEMS);
+	writer.add(SmartTime(SmartTime::INIT_CURR_TIME).getAsTimespec());
+	writer.addValue<uint32_t>(itemList.size());
+	for (auto &item : itemList)
+		writer.add(item);
+	return m_impl->append(writer.buf);
+}
+
+bool IngestionSpool::read(Record &record)
+{
+	AutoMutex autoLock(&m_impl->lock);
+	Impl &impl = *m_impl;
+	while (impl.opened) {
+		Position &pos = impl.readPos;
+		SpoolSegment *segment = impl.getSegment(pos.segment);
+		if (!segment)
+			return false;
+		const bool isLast = (pos.segment == impl.writePos.segment);
+		if (isLast && pos.offset >= impl.writePos.offset)
+			return false;
+
+		const uint32_t length = (pos.offset + RECORD_HEADER_SIZE <=
+					 segment->size) ?
+		  segment->getLength(pos.offset) : ROTATE_MARK;
+		const ssize_t payloadSize = segment->validate(pos.offset);
+		if (payloadSize < 0) {
+			if (isLast)
+				return false;
+			if (length != ROTATE_MARK) {
+				MLPL_ERR("Skip a broken spool segment: %s "
+					 "at %" PRIu64 "\n",
+					 segment->path.c_str(), pos.offset);
+			}
+			pos.segment++;
+			pos.offset = SEGMENT_HEADER_SIZE;
+			continue;
+		}
+
+		const uint8_t *payload =
+		  segment->data + pos.offset + RECORD_HEADER_SIZE;
+		pos.offset += alignRecordSize(payloadSize);
+		if (!impl.decode(payload, payloadSize, record)) {
+			MLPL_ERR("Skip an undecodable spool record\n");
+			continue;
+		}
+		record.next = pos;
+		impl.stat.numRead++;
+		return true;
+	}
+	return false;
+}
+
+bool IngestionSpool::checkpoint(const Position &position)
+{
+	AutoMutex autoLock(&m_impl->lock);
+	Impl &impl = *m_impl;
+	if (!impl.saveCheckpoint(position))
+		return false;
+	impl.checkpointPos = position;
+	auto it = impl.segments.begin();
+	while (it != impl.segments.end() && it->first < position.segment) {
+		SpoolSegment *segment = it->second;
+		unlink(segment->path.c_str());
+		delete segment;
+		it = impl.segments.erase(it);
+	}
+	impl.updateDepth();
+	return true;
+}
+
+void IngestionSpool::rewind(void)
+{
+	AutoMutex autoLock(&m_impl->lock);
+	m_impl->readPos = m_impl->checkpointPos;
+}
+
+void IngestionSpool::sync(void)
+{
+	// Flushing may take long. It's done without the lock with
+	// duplicated descriptors.
+	vector<int> fds;
+	{
+		AutoMutex autoLock(&m_impl->lock);
+		for (auto &pair : m_impl->segments) {
+			if (pair.first < m_impl->readPos.segment)
+				continue;
+			const int fd = dup(pair.second->fd);
+			if (fd >= 0)
+				fds.push_back(fd);
+		}
+	}
+	for (auto fd : fds) {
+		if (fdatasync(fd) < 0)
+			MLPL_ERR("Failed to sync spool: %s\n", strerror(errno));
+		close(fd);
+	}
+}
+
+void IngestionSpool::getStat(Stat &stat)
+{
+	AutoMutex autoLock(&m_impl->lock);
+	stat = m_impl->stat;
+}
+
+const string &IngestionSpool::getDirectory(void) const
+{
+	return m_impl->directory;
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IngestionSpool_h
+#define IngestionSpool_h
+
+#include <memory>
+#include <string>
+#include "Monitoring.h"
+
+/**
+ * IngestionSpool is an append-only local queue of events and items that
+ * haven't been stored in the DB yet.
+ *
+ * Records are appended to memory-mapped segment files of a fixed size
+ * in a directory. A new segment is created when the current one is full.
+ * A reader takes the records in the order of appending and marks them
+ * consumed with checkpoint(). The checkpoint is saved in a file with an
+ * atomic rename, and segments before it are removed. After a restart,
+ * reading starts at the saved checkpoint, so the records are read at
+ * least once.
+ *
+ * The blocks of a segment are allocated when it's created, so that a full
+ * disk makes append() fail instead of killing the process with SIGBUS.
+ *
+ * An appended record survives a crash of the process because it's in
+ * a shared mapping. sync() flushes the segment being written to the disk.
+ * Each record has a checksum and a torn record at the tail is discarded
+ * on open().
+ *
+ * All methods are thread safe.
+ */
+class IngestionSpool {
+public:
+	static const size_t DEFAULT_SEGMENT_SIZE;
+	static const size_t DEFAULT_MAX_NUM_SEGMENTS;
+
+	enum RecordType {
+		RECORD_EVENTS = 1,
+		RECORD_ITEMS  = 2,
+	};
+
+	struct Position {
+		uint64_t segment;
+		uint64_t offset;
+
+		Position(void);
+	};
+
+	struct Record {
+		RecordType    type;
+		EventInfoList eventList;
+		ItemInfoList  itemList;
+		// The time when the record was appended.
+		timespec      appendedTime;
+		// The position just after the record.
+		Position      next;
+	};
+
+	struct Stat {
+		uint64_t numAppended;
+		uint64_t numRead;
+		uint64_t numRejected;
+		size_t   numSegments;
+		// The bytes that haven't been checkpointed.
+		uint64_t depthBytes;
+
+		Stat(void);
+	};
+
+	IngestionSpool(const std::string &directory,
+		       const size_t &segmentSize = DEFAULT_SEGMENT_SIZE,
+		       const size_t &maxNumSegments = DEFAULT_MAX_NUM_SEGMENTS);
+	virtual ~IngestionSpool();
+
+	/**
+	 * Open the directory and recover the state from the files in it.
+	 *
+	 * @return true on success. Otherwise false.
+	 */
+	bool open(void);
+
+	/**
+	 * Append records.
+	 *
+	 * @return
+	 * true if the record is appended. false if the spool is full, a new
+	 * segment can't be allocated, or an error occurred. The caller has
+	 * to store the data by itself then.
+	 */
+	bool append(const EventInfoList &eventList);
+	bool append(const ItemInfoList &itemList);
+
+	/**
+	 * Read the next record that hasn't been read.
+	 *
+	 * @param record A read record is stored.
+	 * @return true if a record is read. false if there's no record.
+	 */
+	bool read(Record &record);
+
+	/**
+	 * Mark the records before a position consumed and save it.
+	 *
+	 * @param position A position returned as Record::next.
+	 * @return true on success. Otherwise false.
+	 */
+	bool checkpoint(const Position &position);
+
+	/**
+	 * Go back to the last checkpoint. The records after it are read
+	 * again.
+	 */
+	void rewind(void);
+
+	/**
+	 * Flush the appended records to the disk.
+	 */
+	void sync(void);
+
+	void getStat(Stat &stat);
+
+	const std::string &getDirectory(void) const;
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> m_impl;
+};
+
+#endif // IngestionSpool_h
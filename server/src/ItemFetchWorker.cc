@@ -17,10 +17,10 @@
  * <http://www.gnu.org/licenses/>.
  */
 
-#include <errno.h>
-#include <semaphore.h>
-#include <ReadWriteLock.h>
-#include <Reaper.h>
+#include <map>
+#include <deque>
+#include <Mutex.h>
+#include <SimpleSemaphore.h>
 #include <SmartTime.h>
 #include "ItemFetchWorker.h"
 #include "UnifiedDataStore.h"
@@ -28,42 +28,230 @@
 using namespace std;
 using namespace mlpl;
 
-struct FetcherJob {
-	LocalHostIdType hostId;
-	DataStore *dataStore;
+const timespec ItemFetchWorker::DEFAULT_MIN_UPDATE_INTERVAL = {10, 0};
+const size_t   ItemFetchWorker::DEFAULT_MAX_RUNNING_FETCHERS = 8;
+
+// A fetch target is a whole server (ALL_LOCAL_HOSTS) or a host in it.
+typedef pair<ServerIdType, LocalHostIdType> FetchTargetKey;
+
+// A request waits for one or more fetch targets.
+struct FetchRequest {
+	size_t    numWaitingTargets;
+	Closure0 *closure;
 };
+typedef shared_ptr<FetchRequest> FetchRequestPtr;
 
-struct ItemFetchWorker::Impl
+struct FetchTarget {
+	SmartTime               lastFetchTime;
+	bool                    fetching;
+	vector<FetchRequestPtr> requests;
+
+	FetchTarget(void)
+	: fetching(false)
+	{
+	}
+};
+
+struct PendingFetch {
+	FetchTargetKey  key;
+	DataStore      *dataStore;
+};
+
+struct ItemFetchWorker::FetchContext : public ClosureTemplate0<ItemFetchWorker>
 {
-	const static size_t      maxRunningFetchers = 8;
-	const static timespec    minUpdateInterval;
-
-	ReadWriteLock           rwlock;
-	std::deque<FetcherJob>  fetcherJobQueue;
-	size_t                  remainingFetchersCount;
-	SmartTime               nextAllowedUpdateTime;
-	sem_t                   updatedSemaphore;
-	Signal0                 itemFetchedSignal;
-
-	Impl(void)
-	: remainingFetchersCount(0)
+	FetchTargetKey  key;
+	DataStore      *dataStore;
+
+	FetchContext(ItemFetchWorker *worker, const FetchTargetKey &_key,
+		     DataStore *ds)
+	: ClosureTemplate0<ItemFetchWorker>(
+	    worker, &ItemFetchWorker::fetchedCallback),
+	  key(_key),
+	  dataStore(ds)
 	{
-		sem_init(&updatedSemaphore, 0, 0);
 	}
 
-	virtual ~Impl()
+	virtual ~FetchContext()
 	{
-		sem_destroy(&updatedSemaphore);
-	};
+		dataStore->unref();
+	}
 };
 
-const timespec ItemFetchWorker::Impl::minUpdateInterval = {10, 0};
+struct ItemFetchWorker::Impl
+{
+	ItemFetchWorker                *worker;
+	Mutex                           lock;
+	timespec                        minUpdateInterval;
+	size_t                          maxRunningFetchers;
+	size_t                          numRunningFetchers;
+	map<FetchTargetKey, FetchTarget> targets;
+	deque<PendingFetch>             pendingFetches;
+
+	Impl(ItemFetchWorker *_worker)
+	: worker(_worker),
+	  minUpdateInterval(DEFAULT_MIN_UPDATE_INTERVAL),
+	  maxRunningFetchers(DEFAULT_MAX_RUNNING_FETCHERS),
+	  numRunningFetchers(0)
+	{
+	}
+
+	// Should be called with the lock.
+	bool isFresh(const FetchTargetKey &key, const SmartTime &now)
+	{
+		auto isFreshTarget = [&](const FetchTargetKey &k) {
+			auto it = targets.find(k);
+			if (it == targets.end())
+				return false;
+			SmartTime expireTime = it->second.lastFetchTime;
+			expireTime += minUpdateInterval;
+			return now < expireTime;
+		};
+		if (isFreshTarget(key))
+			return true;
+		// A fetch of the whole server also makes its hosts fresh.
+		if (key.second == ALL_LOCAL_HOSTS)
+			return false;
+		return isFreshTarget(FetchTargetKey(key.first,
+						    ALL_LOCAL_HOSTS));
+	}
+
+	// Should be called with the lock.
+	void pruneTargets(const SmartTime &now)
+	{
+		// A stale target is the same as an unknown one. Dropping them
+		// also evicts the targets of removed servers and hosts.
+		auto it = targets.begin();
+		while (it != targets.end()) {
+			const FetchTarget &target = it->second;
+			SmartTime expireTime = target.lastFetchTime;
+			expireTime += minUpdateInterval;
+			if (target.fetching || now < expireTime)
+				++it;
+			else
+				it = targets.erase(it);
+		}
+	}
+
+	// Should be called with the lock.
+	FetchTarget *findFetchingTarget(const FetchTargetKey &key)
+	{
+		auto it = targets.find(
+		  FetchTargetKey(key.first, ALL_LOCAL_HOSTS));
+		if (it != targets.end() && it->second.fetching)
+			return &it->second;
+		it = targets.find(key);
+		if (it != targets.end() && it->second.fetching)
+			return &it->second;
+		return NULL;
+	}
+
+	bool start(const ServerIdType &targetServerId,
+		   const LocalHostIdType &targetHostId, Closure0 *closure)
+	{
+		DataStoreVector allDataStores = worker->getDataStoreVector();
+		FetchRequestPtr request(new FetchRequest{0, closure});
+		vector<PendingFetch> runnableFetches;
+		SmartTime now(SmartTime::INIT_CURR_TIME);
+
+		lock.lock();
+		pruneTargets(now);
+		for (auto dataStore : allDataStores) {
+			const ServerIdType serverId =
+			  dataStore->getMonitoringServerInfo().id;
+			const FetchTargetKey key(serverId, targetHostId);
+			if ((targetServerId != ALL_SERVERS &&
+			     targetServerId != serverId) ||
+			    !dataStore->isFetchItemsSupported() ||
+			    isFresh(key, now)) {
+				dataStore->unref();
+				continue;
+			}
+
+			request->numWaitingTargets++;
+			FetchTarget *fetchingTarget = findFetchingTarget(key);
+			if (fetchingTarget) {
+				fetchingTarget->requests.push_back(request);
+				dataStore->unref();
+				continue;
+			}
+
+			FetchTarget &target = targets[key];
+			target.fetching = true;
+			target.requests.push_back(request);
+			if (numRunningFetchers < maxRunningFetchers) {
+				numRunningFetchers++;
+				runnableFetches.push_back({key, dataStore});
+			} else {
+				pendingFetches.push_back({key, dataStore});
+			}
+		}
+		const bool started = (request->numWaitingTargets > 0);
+		lock.unlock();
+
+		for (auto &fetch : runnableFetches)
+			runFetcher(fetch);
+		return started;
+	}
+
+	void runFetcher(const PendingFetch &fetch)
+	{
+		LocalHostIdVector targetHostIds;
+		if (fetch.key.second != ALL_LOCAL_HOSTS)
+			targetHostIds.push_back(fetch.key.second);
+		FetchContext *context =
+		  new FetchContext(worker, fetch.key, fetch.dataStore);
+		if (fetch.dataStore->startOnDemandFetchItems(targetHostIds,
+							     context)) {
+			return;
+		}
+		MLPL_WARN("Failed to start fetching items: server: %"
+		          FMT_SERVER_ID "\n", fetch.key.first);
+		delete context;
+		finish(fetch.key, false);
+	}
+
+	void finish(const FetchTargetKey &key, const bool &succeeded)
+	{
+		vector<FetchRequestPtr> completedRequests;
+		PendingFetch nextFetch;
+		bool hasNextFetch = false;
+
+		lock.lock();
+		FetchTarget &target = targets[key];
+		target.fetching = false;
+		if (succeeded)
+			target.lastFetchTime.setCurrTime();
+		for (auto &request : target.requests) {
+			if (--request->numWaitingTargets == 0)
+				completedRequests.push_back(request);
+		}
+		target.requests.clear();
+		if (pendingFetches.empty()) {
+			numRunningFetchers--;
+		} else {
+			nextFetch = pendingFetches.front();
+			pendingFetches.pop_front();
+			hasNextFetch = true;
+		}
+		lock.unlock();
+
+		if (hasNextFetch)
+			runFetcher(nextFetch);
+		for (auto &request : completedRequests) {
+			Closure0 *closure = request->closure;
+			if (!closure)
+				continue;
+			(*closure)();
+			delete closure;
+		}
+	}
+};
 
 // ---------------------------------------------------------------------------
 // Public methods
 // ---------------------------------------------------------------------------
 ItemFetchWorker::ItemFetchWorker(void)
-: m_impl(new Impl())
+: m_impl(new Impl(this))
 {
 }
 
@@ -74,121 +262,79 @@ ItemFetchWorker::~ItemFetchWorker()
 bool ItemFetchWorker::start(
   const ItemsQueryOption &option, Closure0 *closure)
 {
-	DataStoreVector allDataStores =
-	  UnifiedDataStore::getInstance()->getDataStoreVector();
-
-	const ServerIdType targetServerId = option.getTargetServerId();
-	const LocalHostIdType targetHostId = option.getTargetHostId();
-	LocalHostIdVector targetHostIds;
-	if (targetHostId != ALL_LOCAL_HOSTS) {
-		targetHostIds.push_back(targetHostId);
-	}
+	return m_impl->start(option.getTargetServerId(),
+			     option.getTargetHostId(), closure);
+}
 
-	if (allDataStores.empty())
-		return false;
+bool ItemFetchWorker::fetch(const ServerIdType &serverId,
+			    const LocalHostIdType &hostId)
+{
+	struct CompletionNotifier : public Closure0 {
+		SimpleSemaphore &sem;
 
-	m_impl->rwlock.writeLock();
-	if (closure)
-		m_impl->itemFetchedSignal.connect(closure);
-	m_impl->remainingFetchersCount = allDataStores.size();
-	for (size_t i = 0; i < allDataStores.size(); i++) {
-		DataStore *dataStore = allDataStores[i];
-
-		bool shouldWake = true;
-		if (targetServerId != ALL_SERVERS &&
-		    targetServerId != dataStore->getMonitoringServerInfo().id)
-			shouldWake = false;
-		else if (!dataStore->isFetchItemsSupported())
-			shouldWake = false;
-
-		if (!shouldWake) {
-			m_impl->remainingFetchersCount--;
-			dataStore->unref();
-			continue;
+		CompletionNotifier(SimpleSemaphore &_sem)
+		: sem(_sem)
+		{
 		}
 
-		if (i < Impl::maxRunningFetchers){
-			if (!runFetcher(targetHostIds, dataStore))
-				m_impl->remainingFetchersCount--;
-		} else {
-			m_impl->fetcherJobQueue.push_back({targetHostId, dataStore});
+		virtual void operator()(void) override
+		{
+			sem.post();
 		}
-	}
-
-	bool started = m_impl->remainingFetchersCount > 0;
-	m_impl->rwlock.unlock();
+	};
 
-	return started;
+	SimpleSemaphore sem(0);
+	CompletionNotifier *notifier = new CompletionNotifier(sem);
+	if (!m_impl->start(serverId, hostId, notifier)) {
+		delete notifier;
+		return false;
+	}
+	sem.wait();
+	return true;
 }
 
-bool ItemFetchWorker::updateIsNeeded(void)
+bool ItemFetchWorker::updateIsNeeded(const ServerIdType &serverId,
+				     const LocalHostIdType &hostId)
 {
-	m_impl->rwlock.readLock();
-	Reaper<ReadWriteLock> lockReaper(&m_impl->rwlock, ReadWriteLock::unlock);
-
-	if (m_impl->remainingFetchersCount > 0)
-		return false;
+	DataStoreVector allDataStores = getDataStoreVector();
+	SmartTime now(SmartTime::INIT_CURR_TIME);
+	bool needed = false;
+
+	AutoMutex autoLock(&m_impl->lock);
+	for (auto dataStore : allDataStores) {
+		const ServerIdType id = dataStore->getMonitoringServerInfo().id;
+		if ((serverId == ALL_SERVERS || serverId == id) &&
+		    dataStore->isFetchItemsSupported() &&
+		    !m_impl->isFresh(FetchTargetKey(id, hostId), now)) {
+			needed = true;
+		}
+		dataStore->unref();
+	}
+	return needed;
+}
 
-	SmartTime currTime(SmartTime::INIT_CURR_TIME);
-	return currTime >= m_impl->nextAllowedUpdateTime;
+void ItemFetchWorker::setMinUpdateInterval(const timespec &interval)
+{
+	AutoMutex autoLock(&m_impl->lock);
+	m_impl->minUpdateInterval = interval;
 }
 
-void ItemFetchWorker::waitCompletion(void)
+size_t ItemFetchWorker::getNumberOfTargets(void)
 {
-	if (sem_wait(&m_impl->updatedSemaphore) == -1)
-		MLPL_ERR("Failed to call sem_wait: %d\n", errno);
+	AutoMutex autoLock(&m_impl->lock);
+	return m_impl->targets.size();
 }
 
 // ---------------------------------------------------------------------------
 // Protected methods
 // ---------------------------------------------------------------------------
-void ItemFetchWorker::updatedCallback(Closure0 *closure)
+DataStoreVector ItemFetchWorker::getDataStoreVector(void)
 {
-	m_impl->rwlock.writeLock();
-	Reaper<ReadWriteLock> lockReaper(&m_impl->rwlock, ReadWriteLock::unlock);
-
-	auto &fetcherJob = m_impl->fetcherJobQueue;
-	if (!fetcherJob.empty()) {
-		runFetcher({fetcherJob.front().hostId}, fetcherJob.front().dataStore);
-		fetcherJob.pop_front();
-	}
-
-	if (m_impl->remainingFetchersCount <= 0)
-		return;
-	else
-		m_impl->remainingFetchersCount--;
-
-	if (m_impl->remainingFetchersCount > 0)
-		return;
-
-	if (sem_post(&m_impl->updatedSemaphore) == -1)
-		MLPL_ERR("Failed to call sem_post: %d\n", errno);
-	m_impl->nextAllowedUpdateTime.setCurrTime();
-	m_impl->nextAllowedUpdateTime += m_impl->minUpdateInterval;
-	m_impl->itemFetchedSignal();
-	m_impl->itemFetchedSignal.clear();
+	return UnifiedDataStore::getInstance()->getDataStoreVector();
 }
 
-bool ItemFetchWorker::runFetcher(const LocalHostIdVector targetHostIds,
-				 DataStore *dataStore)
+void ItemFetchWorker::fetchedCallback(Closure0 *closure)
 {
-	struct ClosureWithDataStore : public ClosureTemplate0<ItemFetchWorker>
-	{
-		DataStore *dataStore;
-
-		ClosureWithDataStore(ItemFetchWorker *impl, DataStore *ds)
-		: ClosureTemplate0<ItemFetchWorker>(
-		    impl, &ItemFetchWorker::updatedCallback),
-		  dataStore(ds)
-		{
-		}
-
-		~ClosureWithDataStore()
-		{
-			dataStore->unref();
-		}
-	};
-
-	return dataStore->startOnDemandFetchItems(
-	  targetHostIds, new ClosureWithDataStore(this, dataStore));
+	FetchContext *context = static_cast<FetchContext *>(closure);
+	m_impl->finish(context->key, true);
 }
@@ -20,27 +20,85 @@
 #ifndef ItemFetchWorker_h
 #define ItemFetchWorker_h
 
-#include <deque>
 #include "Params.h"
 #include "Closure.h"
 #include "DataStore.h"
 #include "DBTablesMonitoring.h"
 
+/**
+ * ItemFetchWorker schedules on-demand item fetches of monitoring servers.
+ *
+ * The last fetch time is tracked for each server and each host. A request
+ * is answered from the DB when its target was fetched recently enough.
+ * Requests for a target that is being fetched are joined to it. Fetches
+ * of different servers run in parallel and one slow server doesn't delay
+ * the requests of the others.
+ */
 class ItemFetchWorker
 {
 public:
+	static const timespec DEFAULT_MIN_UPDATE_INTERVAL;
+	static const size_t   DEFAULT_MAX_RUNNING_FETCHERS;
+
 	ItemFetchWorker(void);
 	virtual ~ItemFetchWorker();
 
+	/**
+	 * Start fetching items of the servers and the host specified by
+	 * the option if they aren't fresh.
+	 *
+	 * @param option A query option. The target server ID and the target
+	 *               host ID are used.
+	 * @param closure A closure called when all needed fetches complete.
+	 *                It is deleted after the call. It isn't touched
+	 *                when this method returns false.
+	 * @return true if the closure will be called. false if there's
+	 *         nothing to fetch.
+	 */
 	bool start(const ItemsQueryOption &option,
 	           Closure0 *closure = NULL);
-	bool updateIsNeeded(void);
-	void waitCompletion(void);
+
+	/**
+	 * Fetch items synchronously if they aren't fresh.
+	 *
+	 * @param serverId A target server ID or ALL_SERVERS.
+	 * @param hostId A target host ID or ALL_LOCAL_HOSTS.
+	 * @return true if fetches ran. false if the data was fresh enough.
+	 */
+	bool fetch(const ServerIdType &serverId,
+	           const LocalHostIdType &hostId = ALL_LOCAL_HOSTS);
+
+	bool updateIsNeeded(const ServerIdType &serverId = ALL_SERVERS,
+	                    const LocalHostIdType &hostId = ALL_LOCAL_HOSTS);
+
+	/**
+	 * Set the interval in which the fetched items are regarded as fresh.
+	 *
+	 * @param interval An interval.
+	 */
+	void setMinUpdateInterval(const timespec &interval);
+
+	/**
+	 * Get the number of the tracked fetch targets.
+	 * The targets that are no longer fresh are dropped on start().
+	 * This is mainly for the test.
+	 *
+	 * @return The number of the targets.
+	 */
+	size_t getNumberOfTargets(void);
 
 protected:
-	void updatedCallback(Closure0 *closure);
-	bool runFetcher(const LocalHostIdVector hostIds,
-	                DataStore *dataStore);
+	struct FetchContext;
+
+	/**
+	 * Get the data stores to be fetched.
+	 *
+	 * @return
+	 * A DataStoreVector instance. The caller must call unref() for
+	 * each DataStore instance in it.
+	 */
+	virtual DataStoreVector getDataStoreVector(void);
+	void fetchedCallback(Closure0 *closure);
 
 private:
 	struct Impl;
@@ -0,0 +1,812 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <deque>
+#include <map>
+#include <set>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <Logger.h>
+#include <Mutex.h>
+#include <Reaper.h>
+#include <AtomicValue.h>
+#include <SimpleSemaphore.h>
+#include "HatoholThreadBase.h"
+#include "HatoholException.h"
+#include "ProcessSpawner.h"
+
+using namespace std;
+using namespace mlpl;
+
+extern char **environ;
+
+#ifndef __NR_pidfd_open
+#define __NR_pidfd_open 434
+#endif
+
+// P_PIDFD (Linux 5.4) isn't defined in old headers.
+static const idtype_t IDTYPE_PIDFD = static_cast<idtype_t>(3);
+
+static const size_t MAX_REQUEST_SIZE = 64 * 1024;
+static const size_t MAX_RECORDS_PER_BATCH = 128;
+static const int    MAX_EPOLL_EVENTS = 64;
+static const int    READY_TIMEOUT_MSEC = 5000;
+
+enum RecordType {
+	RECORD_READY,
+	RECORD_SPAWNED,
+	RECORD_SPAWN_FAILED,
+	RECORD_CHDIR_FAILED,
+	RECORD_EXITED,
+};
+
+// A message from the helper is an array of this.
+struct SpawnRecord {
+	uint64_t requestId;
+	uint32_t type;
+	int32_t  pid;
+	// errno for RECORD_READY and RECORD_*_FAILED, si_code for
+	// RECORD_EXITED.
+	int32_t  code;
+	int32_t  status;
+};
+
+// A request to the helper. This is followed by NUL-terminated arguments,
+// environment variables, and a working directory (may be empty).
+struct SpawnRequestHeader {
+	uint64_t requestId;
+	uint32_t numArgs;
+	uint32_t numEnvs;
+};
+
+static int openPidfd(const pid_t &pid)
+{
+	return syscall(__NR_pidfd_open, pid, 0);
+}
+
+static SpawnRecord makeRecord(const uint64_t &requestId, const RecordType &type,
+                              const pid_t &pid = 0, const int &code = 0,
+                              const int &status = 0)
+{
+	SpawnRecord record;
+	record.requestId = requestId;
+	record.type      = type;
+	record.pid       = pid;
+	record.code      = code;
+	record.status    = status;
+	return record;
+}
+
+static GSpawnError getSpawnErrorCode(const int &err)
+{
+	switch (err) {
+	case EACCES:
+		return G_SPAWN_ERROR_ACCES;
+	case EPERM:
+		return G_SPAWN_ERROR_PERM;
+	case E2BIG:
+		return G_SPAWN_ERROR_TOO_BIG;
+	case ENOEXEC:
+		return G_SPAWN_ERROR_NOEXEC;
+	case ENAMETOOLONG:
+		return G_SPAWN_ERROR_NAMETOOLONG;
+	case ENOENT:
+		return G_SPAWN_ERROR_NOENT;
+	case ENOMEM:
+		return G_SPAWN_ERROR_NOMEM;
+	case ENOTDIR:
+		return G_SPAWN_ERROR_NOTDIR;
+	case ELOOP:
+		return G_SPAWN_ERROR_LOOP;
+	case ETXTBSY:
+		return G_SPAWN_ERROR_TXTBUSY;
+	case EIO:
+		return G_SPAWN_ERROR_IO;
+	case ENFILE:
+		return G_SPAWN_ERROR_NFILE;
+	case EMFILE:
+		return G_SPAWN_ERROR_MFILE;
+	case EINVAL:
+		return G_SPAWN_ERROR_INVAL;
+	case EISDIR:
+		return G_SPAWN_ERROR_ISDIR;
+	case ELIBBAD:
+		return G_SPAWN_ERROR_LIBBAD;
+	}
+	return G_SPAWN_ERROR_FAILED;
+}
+
+// ---------------------------------------------------------------------------
+// SpawnerHelper (runs in the helper process)
+// ---------------------------------------------------------------------------
+class SpawnerHelper {
+public:
+	SpawnerHelper(const int &sock)
+	: m_socket(sock),
+	  m_epollFd(-1),
+	  m_initialDirFd(-1)
+	{
+	}
+
+	/**
+	 * The main routine of the helper process. This never returns.
+	 */
+	void run(void)
+	{
+		closeInheritedFds();
+		const int err = setup();
+		m_records.push_back(makeRecord(0, RECORD_READY, getpid(), err));
+		if (!flush() || err)
+			_exit(EXIT_FAILURE);
+		while (poll())
+			;
+		_exit(EXIT_SUCCESS);
+	}
+
+private:
+	struct Child {
+		pid_t    pid;
+		uint64_t requestId;
+	};
+
+	int                 m_socket;
+	int                 m_epollFd;
+	int                 m_initialDirFd;
+	posix_spawnattr_t   m_spawnAttr;
+	map<int, Child>     m_children; // The key is a pidfd.
+	vector<SpawnRecord> m_records;
+	vector<char>        m_buffer;
+
+	// File descriptors of the server (DB connections, sockets, ...)
+	// must not be kept open by the helper and the actions.
+	void closeInheritedFds(void)
+	{
+		vector<int> fds;
+		DIR *dir = opendir("/proc/self/fd");
+		if (!dir) {
+			for (int fd = STDERR_FILENO + 1; fd < 1024; fd++)
+				fds.push_back(fd);
+		} else {
+			while (struct dirent *entry = readdir(dir)) {
+				const int fd = atoi(entry->d_name);
+				if (fd > STDERR_FILENO && fd != dirfd(dir))
+					fds.push_back(fd);
+			}
+			closedir(dir);
+		}
+		for (auto fd : fds) {
+			if (fd != m_socket)
+				close(fd);
+		}
+	}
+
+	int setup(void)
+	{
+		const int pidfd = openPidfd(getpid());
+		if (pidfd == -1)
+			return errno;
+		close(pidfd);
+
+		m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+		if (m_epollFd == -1)
+			return errno;
+		if (!watch(m_socket))
+			return errno;
+		m_initialDirFd = open(".", O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+		if (m_initialDirFd == -1)
+			return errno;
+
+		// Give an action the same signal state as a new process.
+		sigset_t sigMask, sigDefault;
+		sigemptyset(&sigMask);
+		sigfillset(&sigDefault);
+		posix_spawnattr_init(&m_spawnAttr);
+		posix_spawnattr_setsigmask(&m_spawnAttr, &sigMask);
+		posix_spawnattr_setsigdefault(&m_spawnAttr, &sigDefault);
+		posix_spawnattr_setflags(
+		  &m_spawnAttr, POSIX_SPAWN_SETSIGMASK|POSIX_SPAWN_SETSIGDEF);
+
+		m_buffer.resize(MAX_REQUEST_SIZE);
+		return 0;
+	}
+
+	bool watch(const int &fd)
+	{
+		struct epoll_event event;
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN;
+		event.data.fd = fd;
+		return epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+	}
+
+	/**
+	 * Handle events once and send the results as a batch.
+	 *
+	 * @return false when the server has gone.
+	 */
+	bool poll(void)
+	{
+		struct epoll_event events[MAX_EPOLL_EVENTS];
+		const int numEvents =
+		  epoll_wait(m_epollFd, events, MAX_EPOLL_EVENTS, -1);
+		if (numEvents == -1)
+			return errno == EINTR;
+
+		bool alive = true;
+		for (int i = 0; i < numEvents; i++) {
+			const int fd = events[i].data.fd;
+			if (fd == m_socket)
+				alive = receiveRequests();
+			else
+				collect(fd);
+		}
+		return flush() && alive;
+	}
+
+	bool receiveRequests(void)
+	{
+		while (true) {
+			const ssize_t size =
+			  recv(m_socket, &m_buffer[0], m_buffer.size(),
+			       MSG_DONTWAIT);
+			if (size == 0)
+				return false;
+			if (size == -1) {
+				if (errno == EINTR)
+					continue;
+				return errno == EAGAIN || errno == EWOULDBLOCK;
+			}
+			handleRequest(size);
+		}
+	}
+
+	void handleRequest(const size_t &size)
+	{
+		SpawnRequestHeader header;
+		if (size < sizeof(header))
+			return;
+		memcpy(&header, &m_buffer[0], sizeof(header));
+
+		const size_t numStrings = header.numArgs + header.numEnvs + 1;
+		vector<char *> strings;
+		char *pos = &m_buffer[sizeof(header)];
+		char *end = &m_buffer[0] + size;
+		while (pos < end && strings.size() < numStrings) {
+			char *term =
+			  static_cast<char *>(memchr(pos, '\0', end - pos));
+			if (!term)
+				break;
+			strings.push_back(pos);
+			pos = term + 1;
+		}
+		if (header.numArgs == 0 || strings.size() != numStrings) {
+			m_records.push_back(makeRecord(header.requestId,
+			                               RECORD_SPAWN_FAILED,
+			                               0, EINVAL));
+			return;
+		}
+
+		vector<char *> argv(strings.begin(),
+		                    strings.begin() + header.numArgs);
+		argv.push_back(NULL);
+		vector<char *> envp(strings.begin() + header.numArgs,
+		                    strings.end() - 1);
+		envp.push_back(NULL);
+		spawn(header.requestId, &argv[0],
+		      header.numEnvs ? &envp[0] : environ, strings.back());
+	}
+
+	void spawn(const uint64_t &requestId, char **argv, char **envp,
+	           const char *workingDirectory)
+	{
+		// The helper is single-threaded. So it can change the
+		// current directory for posix_spawn().
+		const bool changeDir = workingDirectory[0] != '\0';
+		if (changeDir && chdir(workingDirectory) == -1) {
+			m_records.push_back(makeRecord(
+			  requestId, RECORD_CHDIR_FAILED, 0, errno));
+			return;
+		}
+		pid_t pid = 0;
+		const int err =
+		  posix_spawn(&pid, argv[0], NULL, &m_spawnAttr, argv, envp);
+		if (changeDir && fchdir(m_initialDirFd) == -1)
+			_exit(EXIT_FAILURE);
+		if (err) {
+			m_records.push_back(makeRecord(
+			  requestId, RECORD_SPAWN_FAILED, 0, err));
+			return;
+		}
+		m_records.push_back(makeRecord(requestId, RECORD_SPAWNED, pid));
+
+		const int pidfd = openPidfd(pid);
+		if (pidfd != -1 && watch(pidfd)) {
+			Child child = {pid, requestId};
+			m_children[pidfd] = child;
+			return;
+		}
+		// We can't watch it. So we stop it here rather than leaving
+		// a process whose exit is never reported.
+		if (pidfd != -1)
+			close(pidfd);
+		kill(pid, SIGKILL);
+		siginfo_t siginfo;
+		memset(&siginfo, 0, sizeof(siginfo));
+		while (waitid(P_PID, pid, &siginfo, WEXITED) == -1) {
+			if (errno != EINTR)
+				break;
+		}
+		addExitRecord(requestId, pid, siginfo);
+	}
+
+	void collect(const int &pidfd)
+	{
+		map<int, Child>::iterator it = m_children.find(pidfd);
+		if (it == m_children.end())
+			return;
+		const Child child = it->second;
+		m_children.erase(it);
+
+		siginfo_t siginfo;
+		memset(&siginfo, 0, sizeof(siginfo));
+		int ret;
+		while ((ret = waitid(IDTYPE_PIDFD, pidfd, &siginfo,
+		                     WEXITED)) == -1 && errno == EINTR)
+			;
+		// Linux 5.3 has pidfd_open() but doesn't have P_PIDFD.
+		// The process has already exited here. So this doesn't block.
+		while (ret == -1 && errno != ECHILD) {
+			ret = waitid(P_PID, child.pid, &siginfo, WEXITED);
+		}
+		epoll_ctl(m_epollFd, EPOLL_CTL_DEL, pidfd, NULL);
+		close(pidfd);
+		addExitRecord(child.requestId, child.pid, siginfo);
+	}
+
+	void addExitRecord(const uint64_t &requestId, const pid_t &pid,
+	                   const siginfo_t &siginfo)
+	{
+		int code = siginfo.si_code;
+		int status = siginfo.si_status;
+		if (siginfo.si_pid != pid) {
+			// Shouldn't happen. We report it as killed so that
+			// the server doesn't wait for it forever.
+			code = CLD_KILLED;
+			status = SIGKILL;
+		}
+		m_records.push_back(makeRecord(requestId, RECORD_EXITED,
+		                               pid, code, status));
+	}
+
+	bool flush(void)
+	{
+		size_t offset = 0;
+		while (offset < m_records.size()) {
+			const size_t numRecords =
+			  min(MAX_RECORDS_PER_BATCH, m_records.size() - offset);
+			const ssize_t ret =
+			  send(m_socket, &m_records[offset],
+			       sizeof(SpawnRecord) * numRecords, MSG_NOSIGNAL);
+			if (ret == -1) {
+				if (errno == EINTR)
+					continue;
+				m_records.clear();
+				return false;
+			}
+			offset += numRecords;
+		}
+		m_records.clear();
+		return true;
+	}
+};
+
+// ---------------------------------------------------------------------------
+// Impl
+// ---------------------------------------------------------------------------
+struct PendingRequest {
+	SpawnRecord     result;
+	bool            lost;
+	SimpleSemaphore replied;
+	SimpleSemaphore registered;
+
+	PendingRequest(void)
+	: lost(false),
+	  replied(0),
+	  registered(0)
+	{
+	}
+};
+
+typedef shared_ptr<PendingRequest> PendingRequestPtr;
+
+struct ProcessSpawner::Impl {
+	// Note: 'Impl' in this class is HatoholThreadBase::Impl.
+	struct Thread : public HatoholThreadBase {
+		ProcessSpawner::Impl &impl;
+		void (ProcessSpawner::Impl::*routine)(void);
+
+		Thread(ProcessSpawner::Impl &_impl,
+		       void (ProcessSpawner::Impl::*_routine)(void))
+		: impl(_impl),
+		  routine(_routine)
+		{
+		}
+
+	protected:
+		virtual gpointer mainThread(HatoholThreadArg *arg) override
+		{
+			(impl.*routine)();
+			return NULL;
+		}
+	};
+
+	int               socket;
+	pid_t             helperPid;
+	ExitedFunc        exitedFunc;
+	void             *exitedData;
+	AtomicValue<bool> available;
+	AtomicValue<bool> stopping;
+
+	// The followings are protected by 'lock'.
+	Mutex                               lock;
+	uint64_t                            lastRequestId;
+	map<uint64_t, PendingRequestPtr>    pendingRequests;
+	set<pid_t>                          runningPids;
+
+	Mutex             exitLock;
+	deque<siginfo_t>  exitQueue;
+	SimpleSemaphore   exitSem;
+
+	unique_ptr<Thread> receiver;
+	unique_ptr<Thread> notifier;
+
+	Impl(void)
+	: socket(-1),
+	  helperPid(0),
+	  exitedFunc(NULL),
+	  exitedData(NULL),
+	  available(false),
+	  stopping(false),
+	  lastRequestId(0),
+	  exitSem(0)
+	{
+	}
+
+	virtual ~Impl()
+	{
+		available = false;
+		stopping = true;
+		// The helper exits when it gets EOF.
+		if (socket != -1)
+			shutdown(socket, SHUT_RDWR);
+		receiver.reset();
+		// An empty queue stops the notifier.
+		exitSem.post();
+		notifier.reset();
+		if (socket != -1)
+			close(socket);
+	}
+
+	bool waitReady(void)
+	{
+		struct pollfd pfd;
+		pfd.fd = socket;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		int ret;
+		while ((ret = ::poll(&pfd, 1, READY_TIMEOUT_MSEC)) == -1 &&
+		       errno == EINTR)
+			;
+		if (ret != 1) {
+			MLPL_ERR("The process spawner isn't ready.\n");
+			return false;
+		}
+		SpawnRecord record;
+		if (recv(socket, &record, sizeof(record), 0) !=
+		    sizeof(record) || record.type != RECORD_READY) {
+			MLPL_ERR("Failed to start the process spawner.\n");
+			return false;
+		}
+		if (record.code) {
+			MLPL_INFO("The process spawner isn't available: %s\n",
+			          g_strerror(record.code));
+			return false;
+		}
+		return true;
+	}
+
+	void stopHelper(void)
+	{
+		kill(helperPid, SIGKILL);
+		close(socket);
+		socket = -1;
+		while (waitpid(helperPid, NULL, 0) == -1 && errno == EINTR)
+			;
+		helperPid = 0;
+	}
+
+	bool sendRequest(string &message, const PendingRequestPtr &request)
+	{
+		AutoMutex autoMutex(&lock);
+		if (!available)
+			return false;
+		const uint64_t requestId = ++lastRequestId;
+		memcpy(&message[0], &requestId, sizeof(requestId));
+		pendingRequests[requestId] = request;
+		ssize_t ret;
+		while ((ret = send(socket, message.c_str(), message.size(),
+		                   MSG_NOSIGNAL)) == -1 && errno == EINTR)
+			;
+		if (ret == -1) {
+			MLPL_ERR("Failed to send a request to the process "
+			         "spawner: %s\n", g_strerror(errno));
+			pendingRequests.erase(requestId);
+			return false;
+		}
+		return true;
+	}
+
+	void receive(void)
+	{
+		vector<SpawnRecord> records(MAX_RECORDS_PER_BATCH);
+		while (true) {
+			const ssize_t size =
+			  recv(socket, &records[0],
+			       sizeof(SpawnRecord) * records.size(), 0);
+			if (size == -1 && errno == EINTR)
+				continue;
+			if (size <= 0)
+				break;
+			const size_t numRecords = size / sizeof(SpawnRecord);
+			for (size_t i = 0; i < numRecords; i++)
+				dispatch(records[i]);
+		}
+		if (!stopping)
+			onHelperLost();
+		while (waitpid(helperPid, NULL, 0) == -1 && errno == EINTR)
+			;
+	}
+
+	void dispatch(const SpawnRecord &record)
+	{
+		if (record.type == RECORD_EXITED) {
+			lock.lock();
+			runningPids.erase(record.pid);
+			lock.unlock();
+			pushExit(record.pid, record.code, record.status);
+			return;
+		}
+
+		PendingRequestPtr request;
+		lock.lock();
+		map<uint64_t, PendingRequestPtr>::iterator it =
+		  pendingRequests.find(record.requestId);
+		if (it != pendingRequests.end()) {
+			request = it->second;
+			pendingRequests.erase(it);
+			if (record.type == RECORD_SPAWNED)
+				runningPids.insert(record.pid);
+		}
+		lock.unlock();
+		if (!request) {
+			MLPL_BUG("Unknown request: %" PRIu64 "\n",
+			         record.requestId);
+			return;
+		}
+		request->result = record;
+		request->replied.post();
+		// The exit of the process must not be reported before the
+		// caller of spawn() registers the PID.
+		request->registered.wait();
+	}
+
+	void onHelperLost(void)
+	{
+		MLPL_ERR("The process spawner (%d) has gone.\n", helperPid);
+		AutoMutex autoMutex(&lock);
+		available = false;
+		map<uint64_t, PendingRequestPtr>::iterator it =
+		  pendingRequests.begin();
+		for (; it != pendingRequests.end(); ++it) {
+			it->second->lost = true;
+			it->second->replied.post();
+		}
+		pendingRequests.clear();
+
+		// Nobody reports the exits of them any more.
+		for (auto pid : runningPids) {
+			MLPL_WARN("Kill an orphaned process: %d\n", pid);
+			kill(pid, SIGKILL);
+			pushExit(pid, CLD_KILLED, SIGKILL);
+		}
+		runningPids.clear();
+	}
+
+	void pushExit(const pid_t &pid, const int &code, const int &status)
+	{
+		siginfo_t siginfo;
+		memset(&siginfo, 0, sizeof(siginfo));
+		siginfo.si_signo  = SIGCHLD;
+		siginfo.si_pid    = pid;
+		siginfo.si_code   = code;
+		siginfo.si_status = status;
+		exitLock.lock();
+		exitQueue.push_back(siginfo);
+		exitLock.unlock();
+		exitSem.post();
+	}
+
+	void notify(void)
+	{
+		while (true) {
+			exitSem.wait();
+			exitLock.lock();
+			if (exitQueue.empty()) {
+				exitLock.unlock();
+				break;
+			}
+			const siginfo_t siginfo = exitQueue.front();
+			exitQueue.pop_front();
+			exitLock.unlock();
+			(*exitedFunc)(&siginfo, exitedData);
+		}
+	}
+
+	static bool encodeRequest(string &message,
+	                          const StringVector &args,
+	                          const StringVector &envs,
+	                          const string &workingDirectory)
+	{
+		SpawnRequestHeader header;
+		header.requestId = 0; // set in sendRequest()
+		header.numArgs   = args.size();
+		header.numEnvs   = envs.size();
+		message.append(reinterpret_cast<const char *>(&header),
+		               sizeof(header));
+		for (auto &arg : args)
+			message.append(arg.c_str(), arg.size() + 1);
+		for (auto &env : envs)
+			message.append(env.c_str(), env.size() + 1);
+		message.append(workingDirectory.c_str(),
+		               workingDirectory.size() + 1);
+		return message.size() <= MAX_REQUEST_SIZE;
+	}
+
+	static GError *createError(const SpawnRecord &record,
+	                           const string &path,
+	                           const string &workingDirectory)
+	{
+		if (record.type == RECORD_CHDIR_FAILED) {
+			return g_error_new(
+			  G_SPAWN_ERROR, G_SPAWN_ERROR_CHDIR,
+			  "Failed to change to directory '%s' (%s)",
+			  workingDirectory.c_str(), g_strerror(record.code));
+		}
+		return g_error_new(
+		  G_SPAWN_ERROR, getSpawnErrorCode(record.code),
+		  "Failed to execute child process \"%s\" (%s)",
+		  path.c_str(), g_strerror(record.code));
+	}
+};
+
+// ---------------------------------------------------------------------------
+// SpawnCallback
+// ---------------------------------------------------------------------------
+ProcessSpawner::SpawnCallback::~SpawnCallback()
+{
+}
+
+// ---------------------------------------------------------------------------
+// Public methods
+// ---------------------------------------------------------------------------
+ProcessSpawner::ProcessSpawner(void)
+: m_impl(new Impl())
+{
+}
+
+ProcessSpawner::~ProcessSpawner()
+{
+}
+
+bool ProcessSpawner::start(ExitedFunc exitedFunc, void *data)
+{
+	HATOHOL_ASSERT(exitedFunc, "exitedFunc is NULL.");
+	HATOHOL_ASSERT(m_impl->socket == -1, "Already started.");
+
+	int fds[2];
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET|SOCK_CLOEXEC, 0, fds) == -1) {
+		MLPL_ERR("Failed to create a socket pair: %s\n",
+		         g_strerror(errno));
+		return false;
+	}
+	const pid_t pid = fork();
+	if (pid == -1) {
+		MLPL_ERR("Failed to fork: %s\n", g_strerror(errno));
+		close(fds[0]);
+		close(fds[1]);
+		return false;
+	}
+	if (pid == 0) {
+		close(fds[0]);
+		SpawnerHelper helper(fds[1]);
+		helper.run();
+	}
+	close(fds[1]);
+	m_impl->socket = fds[0];
+	m_impl->helperPid = pid;
+	if (!m_impl->waitReady()) {
+		m_impl->stopHelper();
+		return false;
+	}
+
+	m_impl->exitedFunc = exitedFunc;
+	m_impl->exitedData = data;
+	m_impl->available = true;
+	m_impl->notifier.reset(new Impl::Thread(*m_impl, &Impl::notify));
+	m_impl->notifier->start();
+	m_impl->receiver.reset(new Impl::Thread(*m_impl, &Impl::receive));
+	m_impl->receiver->start();
+	MLPL_INFO("Started the process spawner: %d\n", pid);
+	return true;
+}
+
+bool ProcessSpawner::isAvailable(void) const
+{
+	return m_impl->available;
+}
+
+bool ProcessSpawner::spawn(const StringVector &args, const StringVector &envs,
+                           const string &workingDirectory,
+                           SpawnCallback &callback)
+{
+	if (args.empty() || !m_impl->available)
+		return false;
+	string message;
+	if (!Impl::encodeRequest(message, args, envs, workingDirectory))
+		return false;
+	PendingRequestPtr request = make_shared<PendingRequest>();
+	if (!m_impl->sendRequest(message, request))
+		return false;
+	request->replied.wait();
+	if (request->lost)
+		return false;
+
+	// Let the receiver go on even if the callback throws an exception.
+	Reaper<SimpleSemaphore> resumer(&request->registered,
+	                                SimpleSemaphore::post);
+	const SpawnRecord &result = request->result;
+	if (result.type == RECORD_SPAWNED) {
+		callback.onSpawned(result.pid, NULL);
+		return true;
+	}
+	GError *error = Impl::createError(result, args[0], workingDirectory);
+	Reaper<GError> errorFree(error, g_error_free);
+	callback.onSpawned(0, error);
+	return true;
+}
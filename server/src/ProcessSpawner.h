@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ProcessSpawner_h
+#define ProcessSpawner_h
+
+#include <memory>
+#include <string>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <glib.h>
+#include <StringUtils.h>
+
+/**
+ * ProcessSpawner launches processes in a small helper process.
+ *
+ * The helper is forked once when start() is called. After that, a new
+ * process is created with posix_spawn() in the helper instead of forking
+ * this (typically large) process. The helper watches the exits of the
+ * children with pidfds in an epoll loop and reports them in batches.
+ */
+class ProcessSpawner {
+public:
+	/**
+	 * Called when a process launched by spawn() exits. This is called
+	 * on a thread owned by ProcessSpawner. si_code of 'siginfo' is any
+	 * of CLD_EXITED, CLD_KILLED, and CLD_DUMPED.
+	 */
+	typedef void (*ExitedFunc)(const siginfo_t *siginfo, void *data);
+
+	struct SpawnCallback {
+		virtual ~SpawnCallback();
+
+		/**
+		 * Called in spawn() with the result of the launch.
+		 * The exit of the process is never reported until this
+		 * method returns. So the caller can register the PID here.
+		 *
+		 * @param pid
+		 * A PID of the launched process or 0 on failure.
+		 *
+		 * @param gerror
+		 * A GError object (G_SPAWN_ERROR domain) on failure.
+		 * Otherwise NULL.
+		 */
+		virtual void onSpawned(const pid_t &pid, GError *gerror) = 0;
+	};
+
+	ProcessSpawner(void);
+	virtual ~ProcessSpawner();
+
+	/**
+	 * Fork the helper process.
+	 * This should be called before other threads are started as
+	 * daemon(3), because the helper is a fork of this process.
+	 *
+	 * @param exitedFunc A function called when a process exits.
+	 * @param data An arbitrary pointer passed to exitedFunc.
+	 *
+	 * @return
+	 * true if the helper is ready. false if it isn't available
+	 * (e.g. the kernel doesn't support pidfd).
+	 */
+	bool start(ExitedFunc exitedFunc, void *data);
+
+	/**
+	 * Check if the helper is running.
+	 */
+	bool isAvailable(void) const;
+
+	/**
+	 * Launch a process in the helper.
+	 *
+	 * argv[0] is used as a path of the executable. The environment of
+	 * this process is inherited when 'envs' is empty.
+	 *
+	 * @return
+	 * true if the helper has handled the request. In that case
+	 * callback.onSpawned() has been called. false if the helper isn't
+	 * available or the request is too large. The caller should launch
+	 * the process by itself in that case.
+	 */
+	bool spawn(const mlpl::StringVector &args,
+	           const mlpl::StringVector &envs,
+	           const std::string &workingDirectory,
+	           SpawnCallback &callback);
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> m_impl;
+};
+
+#endif // ProcessSpawner_h
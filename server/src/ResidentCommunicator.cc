@@ -28,6 +28,40 @@ using namespace mlpl;
 
 struct ResidentCommunicator::Impl {
 	SmartBuffer sbuf;
+
+	static uint32_t calcNotifyEventBodySize(const EventInfo &eventInfo)
+	{
+		const size_t lenNullTerm = 1;
+		return RESIDENT_PROTO_EVENT_BODY_BASE_LEN +
+		       eventInfo.hostIdInServer.size() + lenNullTerm +
+		       eventInfo.id.size()             + lenNullTerm +
+		       eventInfo.triggerId.size()      + lenNullTerm;
+	}
+
+	/**
+	 * Write a body of NOTIFY_EVENT at the current index. The buffer
+	 * must have a space of calcNotifyEventBodySize(). The index is
+	 * moved to the end of the body.
+	 */
+	void addNotifyEventBody(const ActionIdType &actionId,
+	                        const EventInfo &eventInfo,
+	                        const string &sessionId)
+	{
+		size_t bodyIdx =
+		  sbuf.index() + RESIDENT_PROTO_EVENT_BODY_BASE_LEN;
+		sbuf.add32(actionId);
+		sbuf.add32(eventInfo.serverId);
+		bodyIdx = sbuf.insertString(eventInfo.hostIdInServer, bodyIdx);
+		sbuf.add64(eventInfo.time.tv_sec);
+		sbuf.add32(eventInfo.time.tv_nsec);
+		bodyIdx = sbuf.insertString(eventInfo.id, bodyIdx);
+		sbuf.add16(eventInfo.type);
+		bodyIdx = sbuf.insertString(eventInfo.triggerId, bodyIdx);
+		sbuf.add16(eventInfo.status);
+		sbuf.add16(eventInfo.severity);
+		sbuf.add(sessionId.c_str(), HATOHOL_SESSION_ID_LEN);
+		sbuf.setIndex(bodyIdx);
+	}
 };
 
 // This variable is only used for consistency check on the build.
@@ -112,27 +146,33 @@ void ResidentCommunicator::setNotifyEventBody(
   const ActionIdType &actionId, const EventInfo &eventInfo,
   const string &sessionId)
 {
-	const size_t lenNullTerm = 1;
-	const uint32_t bodySize =
-	  RESIDENT_PROTO_EVENT_BODY_BASE_LEN +
-	  eventInfo.hostIdInServer.size() + lenNullTerm +
-	  eventInfo.id.size()             + lenNullTerm +
-	  eventInfo.triggerId.size()      + lenNullTerm;
-	size_t bodyIdx =
-	  RESIDENT_PROTO_HEADER_LEN + RESIDENT_PROTO_EVENT_BODY_BASE_LEN;
-	setHeader(bodySize,
+	setHeader(Impl::calcNotifyEventBodySize(eventInfo),
 	          RESIDENT_PROTO_PKT_TYPE_NOTIFY_EVENT);
-	m_impl->sbuf.add32(actionId);
-	m_impl->sbuf.add32(eventInfo.serverId);
-	bodyIdx = m_impl->sbuf.insertString(eventInfo.hostIdInServer, bodyIdx);
-	m_impl->sbuf.add64(eventInfo.time.tv_sec);
-	m_impl->sbuf.add32(eventInfo.time.tv_nsec);
-	bodyIdx = m_impl->sbuf.insertString(eventInfo.id, bodyIdx);
-	m_impl->sbuf.add16(eventInfo.type);
-	bodyIdx = m_impl->sbuf.insertString(eventInfo.triggerId, bodyIdx);
-	m_impl->sbuf.add16(eventInfo.status);
-	m_impl->sbuf.add16(eventInfo.severity);
-	m_impl->sbuf.add(sessionId.c_str(), HATOHOL_SESSION_ID_LEN);
+	m_impl->addNotifyEventBody(actionId, eventInfo, sessionId);
+}
+
+void ResidentCommunicator::setNotifyEventBatchHeader(void)
+{
+	setHeader(RESIDENT_PROTO_EVENT_BATCH_NUM_EVENTS_LEN,
+	          RESIDENT_PROTO_PKT_TYPE_NOTIFY_EVENT_BATCH);
+	m_impl->sbuf.add32(0);
+}
+
+void ResidentCommunicator::addNotifyEventToBatch(
+  const ActionIdType &actionId, const EventInfo &eventInfo,
+  const string &sessionId)
+{
+	SmartBuffer &sbuf = m_impl->sbuf;
+	const size_t numEventsIdx = RESIDENT_PROTO_HEADER_LEN;
+	const uint32_t bodySize = Impl::calcNotifyEventBodySize(eventInfo);
+	sbuf.ensureRemainingSize(
+	  RESIDENT_PROTO_EVENT_BATCH_BODY_SIZE_LEN + bodySize);
+	sbuf.add32(bodySize);
+	m_impl->addNotifyEventBody(actionId, eventInfo, sessionId);
+
+	const uint32_t numEvents = sbuf.getValue<uint32_t>(numEventsIdx);
+	sbuf.setAt(numEventsIdx, numEvents + 1);
+	sbuf.setAt(0, sbuf.index() - RESIDENT_PROTO_HEADER_LEN);
 }
 
 void ResidentCommunicator::setNotifyEventAck(uint32_t resultCode)
@@ -141,3 +181,12 @@ void ResidentCommunicator::setNotifyEventAck(uint32_t resultCode)
 	          RESIDENT_PROTO_PKT_TYPE_NOTIFY_EVENT_ACK);
 	m_impl->sbuf.add32(resultCode);
 }
+
+void ResidentCommunicator::addNotifyEventAck(uint32_t resultCode)
+{
+	SmartBuffer &sbuf = m_impl->sbuf;
+	sbuf.ensureRemainingSize(RESIDENT_PROTO_EVENT_ACK_PKT_LEN);
+	sbuf.add32(RESIDENT_PROTO_EVENT_ACK_CODE_LEN);
+	sbuf.add16(RESIDENT_PROTO_PKT_TYPE_NOTIFY_EVENT_ACK);
+	sbuf.add32(resultCode);
+}
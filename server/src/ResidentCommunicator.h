@@ -55,8 +55,29 @@ public:
 	void setNotifyEventBody(const ActionIdType &actionId,
 	                        const EventInfo &eventInfo,
 	                        const std::string &sessionId);
+
+	/**
+	 * Start a NOTIFY_EVENT_BATCH packet without events.
+	 * Events are added by addNotifyEventToBatch().
+	 */
+	void setNotifyEventBatchHeader(void);
+
+	/**
+	 * Add an event to the packet started by setNotifyEventBatchHeader().
+	 * The body size and the number of events in the packet are updated.
+	 */
+	void addNotifyEventToBatch(const ActionIdType &actionId,
+	                           const EventInfo &eventInfo,
+	                           const std::string &sessionId);
+
 	void setNotifyEventAck(uint32_t resuletCode);
 
+	/**
+	 * Append a NOTIFY_EVENT_ACK packet after the packets in the buffer.
+	 * This is used to push acks of a batch at once.
+	 */
+	void addNotifyEventAck(uint32_t resultCode);
+
 private:
 	struct Impl;
 	std::unique_ptr<Impl> m_impl;
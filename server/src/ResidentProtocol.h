@@ -32,6 +32,7 @@ enum
 	RESIDENT_PROTO_PKT_TYPE_PARAMETERS,
 	RESIDENT_PROTO_PKT_TYPE_NOTIFY_EVENT,
 	RESIDENT_PROTO_PKT_TYPE_NOTIFY_EVENT_ACK,
+	RESIDENT_PROTO_PKT_TYPE_NOTIFY_EVENT_BATCH,
 };
 
 static const uint16_t HATOHOL_SESSION_ID_LEN = 36;
@@ -136,14 +137,36 @@ static const size_t RESIDENT_PROTO_EVENT_BODY_BASE_LEN =
  RESIDENT_PROTO_EVENT_TRIGGER_SEVERITY_LEN +
  HATOHOL_SESSION_ID_LEN;
 
+// [Notify Event Batch]
+// Direction: Master -> Slave
+// packet type: RESIDENT_PROTO_PKT_TYPE_NOTIFY_EVENT_BATCH
+// <Body>
+// Bytes: Description
+//    4U: Number of events (N).
+//    The following pair is repeated N times.
+//    4U: Size of the event body.
+//     V: An event body. The layout is the same as the body of
+//        [Notify Event].
+//
+// The slave handles the events in the order and replies an independent
+// [Notify Event Ack] for each of them. The master may send the next
+// [Notify Event] or [Notify Event Batch] before it receives the acks of
+// the previous ones as long as the number of the events without an ack
+// doesn't exceed its window.
+
+static const size_t RESIDENT_PROTO_EVENT_BATCH_NUM_EVENTS_LEN = 4;
+static const size_t RESIDENT_PROTO_EVENT_BATCH_BODY_SIZE_LEN  = 4;
+
 // [Notify Event Ack]
 // Direction: Slave -> Master
-// packet type: RESIDENT_PROTO_PKT_TYPE_NOTIFY_EVENT
+// packet type: RESIDENT_PROTO_PKT_TYPE_NOTIFY_EVENT_ACK
 // <Body>
 // Bytes: Description
 //    4U: result code.
 
 static const size_t RESIDENT_PROTO_EVENT_ACK_CODE_LEN = 4;
+static const size_t RESIDENT_PROTO_EVENT_ACK_PKT_LEN =
+  RESIDENT_PROTO_HEADER_LEN + RESIDENT_PROTO_EVENT_ACK_CODE_LEN;
 
 //
 // Module information
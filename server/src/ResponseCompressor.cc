@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <Logger.h>
+#include "ResponseCompressor.h"
+
+using namespace std;
+using namespace mlpl;
+
+const char *ResponseCompressor::ENCODING_NAMES[NUM_ENCODINGS] = {
+  "identity", "gzip", "deflate",
+};
+
+__thread ResponseCompressor *ResponseCompressor::tls_instance = NULL;
+
+// ---------------------------------------------------------------------------
+// Public methods
+// ---------------------------------------------------------------------------
+ResponseCompressor::ResponseCompressor(void)
+{
+	for (int i = 0; i < NUM_ENCODINGS; i++)
+		m_converters[i] = NULL;
+}
+
+ResponseCompressor::~ResponseCompressor()
+{
+	for (int i = 0; i < NUM_ENCODINGS; i++) {
+		if (m_converters[i])
+			g_object_unref(m_converters[i]);
+	}
+}
+
+ResponseCompressor::Encoding ResponseCompressor::chooseEncoding(
+  SoupMessage *msg)
+{
+	const char *acceptEncoding =
+	  soup_message_headers_get_list(msg->request_headers,
+	                                "Accept-Encoding");
+	if (!acceptEncoding)
+		return ENCODING_IDENTITY;
+
+	// The list is sorted by the quality values. The encodings
+	// with 'q=0' are not included.
+	GSList *list = soup_header_parse_quality_list(acceptEncoding, NULL);
+	Encoding encoding = ENCODING_IDENTITY;
+	for (GSList *it = list; it; it = g_slist_next(it)) {
+		const char *name = static_cast<const char *>(it->data);
+		if (!strcasecmp(name, "identity"))
+			break;
+		if (!strcasecmp(name, "gzip") ||
+		    !strcasecmp(name, "x-gzip") ||
+		    !strcmp(name, "*")) {
+			encoding = ENCODING_GZIP;
+			break;
+		}
+		if (!strcasecmp(name, "deflate")) {
+			encoding = ENCODING_DEFLATE;
+			break;
+		}
+	}
+	soup_header_free_list(list);
+	return encoding;
+}
+
+bool ResponseCompressor::compress(const Encoding &encoding, const string &src,
+				  gchar *&dest, gsize &destSize)
+{
+	GConverter *converter = getConverter(encoding);
+	gsize bufSize = src.size() / 4 + 128;
+	gchar *buf = static_cast<gchar *>(g_malloc(bufSize));
+	gsize srcPos = 0;
+	destSize = 0;
+	while (true) {
+		if (destSize == bufSize) {
+			bufSize *= 2;
+			buf = static_cast<gchar *>(g_realloc(buf, bufSize));
+		}
+		gsize bytesRead = 0, bytesWritten = 0;
+		GError *error = NULL;
+		GConverterResult result = g_converter_convert(
+		  converter, src.data() + srcPos, src.size() - srcPos,
+		  buf + destSize, bufSize - destSize,
+		  G_CONVERTER_INPUT_AT_END,
+		  &bytesRead, &bytesWritten, &error);
+		if (result == G_CONVERTER_ERROR) {
+			if (g_error_matches(error, G_IO_ERROR,
+			                    G_IO_ERROR_NO_SPACE)) {
+				// Nothing is written. Only the buffer is
+				// expanded, and destSize is kept as it is.
+				g_error_free(error);
+				bufSize *= 2;
+				buf = static_cast<gchar *>(
+				  g_realloc(buf, bufSize));
+				continue;
+			}
+			MLPL_ERR("Failed to compress: %s\n",
+			         error ? error->message : "?");
+			if (error)
+				g_error_free(error);
+			g_free(buf);
+			g_converter_reset(converter);
+			return false;
+		}
+		srcPos += bytesRead;
+		destSize += bytesWritten;
+		if (result == G_CONVERTER_FINISHED)
+			break;
+	}
+	g_converter_reset(converter);
+	dest = buf;
+	return true;
+}
+
+ResponseCompressor *ResponseCompressor::getThreadInstance(void)
+{
+	return tls_instance;
+}
+
+void ResponseCompressor::setThreadInstance(ResponseCompressor *compressor)
+{
+	tls_instance = compressor;
+}
+
+// ---------------------------------------------------------------------------
+// Private methods
+// ---------------------------------------------------------------------------
+GConverter *ResponseCompressor::getConverter(const Encoding &encoding)
+{
+	if (m_converters[encoding])
+		return m_converters[encoding];
+	GZlibCompressorFormat format =
+	  (encoding == ENCODING_GZIP) ?
+	    G_ZLIB_COMPRESSOR_FORMAT_GZIP :
+	    G_ZLIB_COMPRESSOR_FORMAT_ZLIB;
+	// -1 means the default level of zlib
+	m_converters[encoding] =
+	  G_CONVERTER(g_zlib_compressor_new(format, -1));
+	return m_converters[encoding];
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ResponseCompressor_h
+#define ResponseCompressor_h
+
+#include <string>
+#include <gio/gio.h>
+#include <libsoup/soup.h>
+
+class ResponseCompressor {
+public:
+	enum Encoding {
+		ENCODING_IDENTITY,
+		ENCODING_GZIP,
+		ENCODING_DEFLATE,
+		NUM_ENCODINGS,
+	};
+	static const char *ENCODING_NAMES[NUM_ENCODINGS];
+
+	ResponseCompressor(void);
+	~ResponseCompressor();
+
+	/**
+	 * Choose a content encoding from the Accept-Encoding header.
+	 *
+	 * @param msg A request message.
+	 * @return The encoding with the highest quality value we support.
+	 */
+	static Encoding chooseEncoding(SoupMessage *msg);
+
+	/**
+	 * Compress data.
+	 *
+	 * @param encoding An encoding other than ENCODING_IDENTITY.
+	 * @param src Data to be compressed.
+	 * @param dest
+	 * A buffer allocated with g_malloc() that has the compressed data
+	 * is returned on success. The caller must free it.
+	 * @param destSize The size of the compressed data is returned.
+	 *
+	 * @return true on success. Otherwise false.
+	 */
+	bool compress(const Encoding &encoding, const std::string &src,
+		      gchar *&dest, gsize &destSize);
+
+	static ResponseCompressor *getThreadInstance(void);
+	static void setThreadInstance(ResponseCompressor *compressor);
+
+private:
+	GConverter *getConverter(const Encoding &encoding);
+
+	// A compressor is reused in a worker thread since creating it
+	// allocates large zlib's internal buffers.
+	static __thread ResponseCompressor *tls_instance;
+	GConverter *m_converters[NUM_ENCODINGS];
+};
+
+#endif // ResponseCompressor_h
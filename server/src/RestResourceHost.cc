@@ -19,6 +19,7 @@
 
 #include "RestResourceHost.h"
 #include "UnifiedDataStore.h"
+#include "HistoryStore.h"
 #include <string.h>
 
 using namespace std;
@@ -37,31 +38,35 @@ void RestResourceHost::registerFactories(FaceRest *faceRest)
 	faceRest->addResourceHandlerFactory(
 	  pathForOverview,
 	  new RestResourceHostFactory(
-	    faceRest, &RestResourceHost::handlerGetOverview));
+	    faceRest, &RestResourceHost::handlerGetOverview, true),
+	  FaceRest::PRIORITY_HIGH);
 	faceRest->addResourceHandlerFactory(
 	  pathForHost,
 	  new RestResourceHostFactory(
-	    faceRest, &RestResourceHost::handlerGetHost));
+	    faceRest, &RestResourceHost::handlerGetHost, true));
 	faceRest->addResourceHandlerFactory(
 	  pathForHostgroup,
 	  new RestResourceHostFactory(
-	    faceRest, &RestResourceHost::handlerGetHostgroup));
+	    faceRest, &RestResourceHost::handlerGetHostgroup, true));
 	faceRest->addResourceHandlerFactory(
 	  pathForTrigger,
 	  new RestResourceHostFactory(
-	    faceRest, &RestResourceHost::handlerGetTrigger));
+	    faceRest, &RestResourceHost::handlerGetTrigger, true));
 	faceRest->addResourceHandlerFactory(
 	  pathForEvent,
 	  new RestResourceHostFactory(
-	    faceRest, &RestResourceHost::handlerGetEvent));
+	    faceRest, &RestResourceHost::handlerGetEvent, true),
+	  FaceRest::PRIORITY_LOW);
 	faceRest->addResourceHandlerFactory(
 	  pathForItem,
 	  new RestResourceHostFactory(
-	    faceRest, &RestResourceHost::handlerGetItem));
+	    faceRest, &RestResourceHost::handlerGetItem),
+	  FaceRest::PRIORITY_LOW);
 	faceRest->addResourceHandlerFactory(
 	  pathForHistory,
 	  new RestResourceHostFactory(
-	    faceRest, &RestResourceHost::handlerGetHistory));
+	    faceRest, &RestResourceHost::handlerGetHistory),
+	  FaceRest::PRIORITY_LOW);
 }
 
 RestResourceHost::RestResourceHost(FaceRest *faceRest, HandlerFunc handler)
@@ -283,9 +288,90 @@ HatoholError RestResourceHost::parseEventParameter(EventsQueryOption &option,
 		return err;
 	option.setEndTime(endTime);
 
+	// cursor
+	const char *cursor =
+	  static_cast<const char *>(g_hash_table_lookup(query, "cursor"));
+	if (cursor && *cursor) {
+		timespec cursorTime = { 0, 0 };
+		uint64_t cursorUnifiedId = 0;
+		if (!decodeEventCursor(cursor, cursorTime, cursorUnifiedId))
+			return HatoholError(HTERR_INVALID_PARAMETER,
+					    StringUtils::sprintf(
+					      "cursor: %s", cursor));
+		// Rows can be skipped or repeated without a defined order.
+		if (sortDirection == DataQueryOption::SORT_DONT_CARE) {
+			return HatoholError(HTERR_INVALID_PARAMETER,
+					    "cursor needs sortOrder");
+		}
+		option.setCursor(cursorTime, cursorUnifiedId);
+		// The cursor already tells where the page starts.
+		option.setOffset(0);
+	}
+
 	return HatoholError(HTERR_OK);
 }
 
+static void toURLSafeBase64(string &str)
+{
+	for (size_t i = 0; i < str.size(); i++) {
+		if (str[i] == '+')
+			str[i] = '-';
+		else if (str[i] == '/')
+			str[i] = '_';
+	}
+	const size_t pos = str.find('=');
+	if (pos != string::npos)
+		str.erase(pos);
+}
+
+string RestResourceHost::encodeEventCursor(const EventInfo &eventInfo)
+{
+	const string plain = StringUtils::sprintf(
+	  "%ld.%ld.%" PRIu64,
+	  eventInfo.time.tv_sec, eventInfo.time.tv_nsec, eventInfo.unifiedId);
+	gchar *encoded = g_base64_encode(
+	  reinterpret_cast<const guchar *>(plain.c_str()), plain.size());
+	string cursor = encoded;
+	g_free(encoded);
+	toURLSafeBase64(cursor);
+	return cursor;
+}
+
+bool RestResourceHost::decodeEventCursor(const string &cursor,
+					 timespec &time, uint64_t &unifiedId)
+{
+	string base64 = cursor;
+	for (size_t i = 0; i < base64.size(); i++) {
+		const char c = base64[i];
+		if (c == '-')
+			base64[i] = '+';
+		else if (c == '_')
+			base64[i] = '/';
+		else if (!g_ascii_isalnum(c))
+			return false;
+	}
+	while (base64.size() % 4)
+		base64 += '=';
+
+	gsize length = 0;
+	guchar *decoded = g_base64_decode(base64.c_str(), &length);
+	const string plain(reinterpret_cast<const char *>(decoded), length);
+	g_free(decoded);
+
+	long sec = 0, nsec = 0;
+	uint64_t id = 0;
+	char garbage;
+	if (sscanf(plain.c_str(), "%ld.%ld.%" SCNu64 "%c",
+		   &sec, &nsec, &id, &garbage) != 3)
+		return false;
+	if (sec < 0 || nsec < 0 || nsec >= 1000000000L || id == 0)
+		return false;
+	time.tv_sec = sec;
+	time.tv_nsec = nsec;
+	unifiedId = id;
+	return true;
+}
+
 static HatoholError parseItemParameter(ItemsQueryOption &option,
 				       GHashTable *query)
 {
@@ -674,6 +760,11 @@ void RestResourceHost::handlerGetEvent(void)
 	}
 	agent.endArray();
 	agent.add("numberOfEvents", eventList.size());
+	// A full page means that more events may follow.
+	if (option.getMaximumNumber() > 0 &&
+	    eventList.size() == option.getMaximumNumber()) {
+		agent.add("nextCursor", encodeEventCursor(eventList.back()));
+	}
 	addServersMap(agent, NULL, false);
 	agent.endObject();
 
@@ -843,6 +934,61 @@ static HatoholError parseHistoryParameter(
 	return HatoholError(HTERR_OK);
 }
 
+static HatoholError parseHistoryDownsampleParameter(
+  GHashTable *query, const time_t &beginTime, const time_t &endTime,
+  unique_ptr<HistoryDownsampler> &downsampler)
+{
+	// Roughly the number of pixels of a graph.
+	const int DEFAULT_MAX_POINTS = 1000;
+	HatoholError err;
+
+	// aggregate
+	HistoryDownsampler::Function func = HistoryDownsampler::FUNC_AVG;
+	const char *funcName =
+	  static_cast<const char *>(g_hash_table_lookup(query, "aggregate"));
+	if (funcName && !HistoryDownsampler::parseFunction(funcName, func)) {
+		return HatoholError(HTERR_INVALID_PARAMETER,
+		                    StringUtils::sprintf("aggregate: %s",
+		                                         funcName));
+	}
+
+	// bucketWidth
+	time_t bucketWidth = 0;
+	err = getParam<time_t>(query, "bucketWidth", "%ld", bucketWidth);
+	if (err != HTERR_OK && err != HTERR_NOT_FOUND_PARAMETER)
+		return err;
+	const bool hasBucketWidth = (err == HTERR_OK);
+	if (hasBucketWidth && bucketWidth <= 0) {
+		return HatoholError(HTERR_INVALID_PARAMETER,
+		                    StringUtils::sprintf("bucketWidth: %ld",
+		                                         bucketWidth));
+	}
+
+	// maxPoints
+	int maxPoints = DEFAULT_MAX_POINTS;
+	err = getParam<int>(query, "maxPoints", "%d", maxPoints);
+	if (err != HTERR_OK && err != HTERR_NOT_FOUND_PARAMETER)
+		return err;
+	const bool hasMaxPoints = (err == HTERR_OK);
+	if (hasMaxPoints && maxPoints <= 0) {
+		return HatoholError(HTERR_INVALID_PARAMETER,
+		                    StringUtils::sprintf("maxPoints: %d",
+		                                         maxPoints));
+	}
+
+	// Raw samples are returned without any of the parameters.
+	if (!funcName && !hasBucketWidth && !hasMaxPoints)
+		return HatoholError(HTERR_OK);
+
+	if (!hasBucketWidth) {
+		bucketWidth = HistoryDownsampler::calcBucketWidth(
+		                beginTime, endTime, maxPoints);
+	}
+	downsampler.reset(
+	  new HistoryDownsampler(func, bucketWidth, beginTime));
+	return HatoholError(HTERR_OK);
+}
+
 void RestResourceHost::handlerGetHistory(void)
 {
 	ServerIdType serverId = ALL_SERVERS;
@@ -857,6 +1003,12 @@ void RestResourceHost::handlerGetHistory(void)
 		replyError(err);
 		return;
 	}
+	err = parseHistoryDownsampleParameter(m_query, beginTime, endTime,
+	                                      m_historyDownsampler);
+	if (err != HTERR_OK) {
+		replyError(err);
+		return;
+	}
 
 	UnifiedDataStore *unifiedDataStore = UnifiedDataStore::getInstance();
 
@@ -883,8 +1035,10 @@ void RestResourceHost::handlerGetHistory(void)
 	    this, &RestResourceHost::historyFetchedCallback,
 	    unifiedDataStore->getDataStore(serverId));
 	if (closure->m_dataStorePtr.hasData()) {
-		closure->m_dataStorePtr->startOnDemandFetchHistory(
-		  itemInfo, beginTime, endTime, closure);
+		// Only the part that isn't in the local store is fetched.
+		HistoryStore::getInstance()->fetch(
+		  closure->m_dataStorePtr, itemInfo, beginTime, endTime,
+		  closure);
 	} else {
 		HistoryInfoVect historyInfoVect;
 		(*closure)(historyInfoVect);
@@ -892,12 +1046,58 @@ void RestResourceHost::handlerGetHistory(void)
 	}
 }
 
+static string formatAggregatedValue(const double &value)
+{
+	return StringUtils::sprintf("%.15g", value);
+}
+
+static bool addDownsampledHistory(
+  JSONBuilder &agent, const HistoryDownsampler &downsampler,
+  const HistoryInfoVect &historyInfoVect)
+{
+	vector<HistoryDownsampler::Point> points;
+	// Samples of a text item can't be aggregated.
+	if (!downsampler.run(historyInfoVect, points))
+		return false;
+
+	const bool isMinMax =
+	  (downsampler.getFunction() == HistoryDownsampler::FUNC_MIN_MAX);
+	agent.add("aggregate",
+	          HistoryDownsampler::getFunctionName(
+	            downsampler.getFunction()));
+	agent.add("bucketWidth", downsampler.getBucketWidth());
+	agent.startArray("history");
+	for (size_t i = 0; i < points.size(); i++) {
+		const HistoryDownsampler::Point &point = points[i];
+		agent.startObject();
+		agent.add("value", formatAggregatedValue(point.value));
+		if (isMinMax) {
+			agent.add("min", formatAggregatedValue(point.min));
+			agent.add("max", formatAggregatedValue(point.max));
+		}
+		agent.add("clock", point.time);
+		agent.add("ns",    0);
+		agent.add("count", point.numSamples);
+		agent.endObject();
+	}
+	agent.endArray();
+	return true;
+}
+
 void RestResourceHost::historyFetchedCallback(
   Closure1<HistoryInfoVect> *closure, const HistoryInfoVect &historyInfoVect)
 {
 	JSONBuilder agent;
 	agent.startObject();
 	addHatoholError(agent, HatoholError(HTERR_OK));
+	if (m_historyDownsampler &&
+	    addDownsampledHistory(agent, *m_historyDownsampler,
+	                          historyInfoVect)) {
+		agent.endObject();
+		replyJSONData(agent);
+		unpauseResponse();
+		return;
+	}
 	agent.startArray("history");
 	HistoryInfoVectConstIterator it = historyInfoVect.begin();
 	for (; it != historyInfoVect.end(); ++it) {
@@ -986,9 +1186,11 @@ void RestResourceHost::handlerGetHostgroup(void)
 }
 
 RestResourceHostFactory::RestResourceHostFactory(
-  FaceRest *faceRest, RestResourceHost::HandlerFunc handler)
+  FaceRest *faceRest, RestResourceHost::HandlerFunc handler,
+  bool singleFlight)
 : FaceRest::ResourceHandlerFactory(faceRest, NULL), m_handlerFunc(handler)
 {
+	m_singleFlight = singleFlight;
 }
 
 FaceRest::ResourceHandler *RestResourceHostFactory::createHandler()
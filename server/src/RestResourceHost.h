@@ -20,7 +20,9 @@
 #ifndef RestResourceHost_h
 #define RestResourceHost_h
 
+#include <memory>
 #include "FaceRestPrivate.h"
+#include "HistoryDownsampler.h"
 
 struct RestResourceHost : public FaceRest::ResourceHandler
 {
@@ -50,6 +52,27 @@ struct RestResourceHost : public FaceRest::ResourceHandler
 	static bool parseExtendedInfo(const std::string &extendedInfo,
 	                              std::string &extendedInfoValue);
 
+	/**
+	 * Make an opaque cursor string that points the specified event.
+	 * It can be passed to /event as the 'cursor' parameter to get
+	 * the next page.
+	 *
+	 * @param eventInfo The last event in the current page.
+	 * @return An URL-safe cursor string.
+	 */
+	static std::string encodeEventCursor(const EventInfo &eventInfo);
+
+	/**
+	 * Parse a cursor made by encodeEventCursor().
+	 *
+	 * @param cursor A cursor string.
+	 * @param time The time of the event is stored in it.
+	 * @param unifiedId The unified ID of the event is stored in it.
+	 * @return true on success. Otherwise false.
+	 */
+	static bool decodeEventCursor(const std::string &cursor,
+	                              timespec &time, uint64_t &unifiedId);
+
 	static const char *pathForOverview;
 	static const char *pathForHost;
 	static const char *pathForTrigger;
@@ -59,12 +82,15 @@ struct RestResourceHost : public FaceRest::ResourceHandler
 	static const char *pathForHostgroup;
 
 	HandlerFunc m_handlerFunc;
+	// Set when /history is requested with aggregation parameters.
+	std::unique_ptr<HistoryDownsampler> m_historyDownsampler;
 };
 
 struct RestResourceHostFactory : public FaceRest::ResourceHandlerFactory
 {
 	RestResourceHostFactory(FaceRest *faceRest,
-				RestResourceHost::HandlerFunc handler);
+				RestResourceHost::HandlerFunc handler,
+				bool singleFlight = false);
 	virtual FaceRest::ResourceHandler *createHandler(void) override;
 
 	RestResourceHost::HandlerFunc m_handlerFunc;
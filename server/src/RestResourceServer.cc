@@ -38,7 +38,8 @@ void RestResourceServer::registerFactories(FaceRest *faceRest)
 	faceRest->addResourceHandlerFactory(
 	  pathForServer,
 	  new RestResourceServerFactory(
-	    faceRest, &RestResourceServer::handlerServer));
+	    faceRest, &RestResourceServer::handlerServer),
+	  FaceRest::PRIORITY_HIGH);
 	faceRest->addResourceHandlerFactory(
 	  pathForServerType,
 	  new RestResourceServerFactory(
@@ -46,7 +47,8 @@ void RestResourceServer::registerFactories(FaceRest *faceRest)
 	faceRest->addResourceHandlerFactory(
 	  pathForServerConnStat,
 	  new RestResourceServerFactory(
-	    faceRest, &RestResourceServer::handlerServerConnStat));
+	    faceRest, &RestResourceServer::handlerServerConnStat),
+	  FaceRest::PRIORITY_HIGH);
 }
 
 RestResourceServer::RestResourceServer(
@@ -34,7 +34,8 @@ void RestResourceUser::registerFactories(FaceRest *faceRest)
 	faceRest->addResourceHandlerFactory(
 	  pathForUser,
 	  new RestResourceUserFactory(faceRest,
-				      &RestResourceUser::handlerUser));
+				      &RestResourceUser::handlerUser),
+	  FaceRest::PRIORITY_HIGH);
 	faceRest->addResourceHandlerFactory(
 	  pathForUserRole,
 	  new RestResourceUserFactory(faceRest,
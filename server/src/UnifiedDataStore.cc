@@ -32,6 +32,7 @@
 #include "DataStoreFactory.h"
 #include "ArmIncidentTracker.h"
 #include "IncidentSenderManager.h"
+#include "IngestionPipeline.h"
 
 using namespace std;
 using namespace mlpl;
@@ -366,14 +367,7 @@ void UnifiedDataStore::fetchItems(const ServerIdType &targetServerId)
 {
 	if (!getCopyOnDemandEnabled())
 		return;
-	if (!m_impl->itemFetchWorker.updateIsNeeded())
-		return;
-
-	bool started = m_impl->itemFetchWorker.start(targetServerId, NULL);
-	if (!started)
-		return;
-
-	m_impl->itemFetchWorker.waitCompletion();
+	m_impl->itemFetchWorker.fetch(targetServerId);
 }
 
 void UnifiedDataStore::getTriggerList(TriggerInfoList &triggerList,
@@ -424,9 +418,6 @@ bool UnifiedDataStore::fetchItemsAsync(Closure0 *closure,
 {
 	if (!getCopyOnDemandEnabled())
 		return false;
-	if (!m_impl->itemFetchWorker.updateIsNeeded())
-		return false;
-
 	return m_impl->itemFetchWorker.start(option, closure);
 }
 
@@ -628,9 +619,15 @@ HatoholError UnifiedDataStore::addAction(ActionDef &actionDef,
 
 void UnifiedDataStore::addEventList(EventInfoList &eventList)
 {
-	ThreadLocalDBCache cache;
+	// The events are committed by the writer of the server together
+	// with the ones from other callers. The callers expect that the
+	// actions have been executed when this method returns, so they are
+	// checked on this thread.
+	if (!IngestionPipeline::getInstance().commitEventList(eventList)) {
+		THROW_HATOHOL_EXCEPTION("Failed to store %zd events.",
+		                        eventList.size());
+	}
 	ActionManager actionManager;
-	cache.getMonitoring().addEventInfoList(eventList);
 	actionManager.checkEvents(eventList);
 }
 
@@ -61,8 +61,10 @@ public:
 
 	/**
 	 * Add events in the Hatohol DB and executes action if needed.
+	 * The events are committed by IngestionPipeline. This method returns
+	 * after the actions are executed.
 	 *
-	 * @param eventList A list of EventInfo.
+	 * @param eventList A list of EventInfo of one server.
 	 */
 	void addEventList(EventInfoList &eventList);
 
@@ -94,8 +94,13 @@ static gboolean writePipeCb
 static void eventCb(GIOStatus stat, SmartBuffer &sbuf, size_t size,
                     Impl *impl);
 
-static void gotNotifyEventBodyCb(GIOStatus stat, mlpl::SmartBuffer &sbuf,
-                                 size_t size, Impl *impl)
+/**
+ * Parse a body of NOTIFY_EVENT at the current index of sbuf and pass it
+ * to the module.
+ *
+ * @return A result code from the module.
+ */
+static uint32_t notifyEvent(Impl *impl, SmartBuffer &sbuf)
 {
 	ResidentNotifyEventArg arg;
 	arg.actionId        = *sbuf.getPointerAndIncIndex<uint32_t>();
@@ -116,7 +121,19 @@ static void gotNotifyEventBodyCb(GIOStatus stat, mlpl::SmartBuffer &sbuf,
 	sbuf.incIndex(HATOHOL_SESSION_ID_LEN);
 
 	// call a user action
-	uint32_t resultCode = (*impl->module->notifyEvent)(&arg);
+	return (*impl->module->notifyEvent)(&arg);
+}
+
+static void gotNotifyEventBodyCb(GIOStatus stat, mlpl::SmartBuffer &sbuf,
+                                 size_t size, Impl *impl)
+{
+	if (stat != G_IO_STATUS_NORMAL) {
+		MLPL_ERR("Error: status: %x\n", stat);
+		requestQuit(impl);
+		return;
+	}
+
+	uint32_t resultCode = notifyEvent(impl, sbuf);
 	ResidentCommunicator comm;
 	comm.setNotifyEventAck(resultCode);
 	comm.push(impl->pipeWr);
@@ -125,6 +142,55 @@ static void gotNotifyEventBodyCb(GIOStatus stat, mlpl::SmartBuffer &sbuf,
 	impl->pullHeader(eventCb);
 }
 
+static void gotNotifyEventBatchBodyCb(GIOStatus stat, mlpl::SmartBuffer &sbuf,
+                                      size_t size, Impl *impl)
+{
+	if (stat != G_IO_STATUS_NORMAL) {
+		MLPL_ERR("Error: status: %x\n", stat);
+		requestQuit(impl);
+		return;
+	}
+
+	const size_t headerLen = RESIDENT_PROTO_EVENT_BATCH_NUM_EVENTS_LEN;
+	if (size < headerLen) {
+		MLPL_ERR("Too small batch: %zd\n", size);
+		requestQuit(impl);
+		return;
+	}
+	const uint32_t numEvents = *sbuf.getPointerAndIncIndex<uint32_t>();
+	size_t pos = headerLen;
+
+	// The acks are sent with a single push after all events are handled.
+	// They are sent in the same order as the events so that the master
+	// can match them with the events it sent.
+	ResidentCommunicator comm;
+	for (uint32_t i = 0; i < numEvents; i++) {
+		if (pos + RESIDENT_PROTO_EVENT_BATCH_BODY_SIZE_LEN > size) {
+			MLPL_ERR("Broken batch: %" PRIu32 "/%" PRIu32 "\n",
+			         i, numEvents);
+			requestQuit(impl);
+			return;
+		}
+		sbuf.setIndex(pos);
+		const uint32_t bodySize =
+		  *sbuf.getPointerAndIncIndex<uint32_t>();
+		pos += RESIDENT_PROTO_EVENT_BATCH_BODY_SIZE_LEN;
+		if (bodySize < RESIDENT_PROTO_EVENT_BODY_BASE_LEN ||
+		    pos + bodySize > size) {
+			MLPL_ERR("Invalid body size: %" PRIu32 "\n", bodySize);
+			requestQuit(impl);
+			return;
+		}
+		comm.addNotifyEventAck(notifyEvent(impl, sbuf));
+		pos += bodySize;
+	}
+	if (numEvents > 0)
+		comm.push(impl->pipeWr);
+
+	// request to get the envet
+	impl->pullHeader(eventCb);
+}
+
 static void eventCb(GIOStatus stat, SmartBuffer &sbuf, size_t size,
                     Impl *impl)
 {
@@ -139,6 +205,9 @@ static void eventCb(GIOStatus stat, SmartBuffer &sbuf, size_t size,
 		// request to get the body
 		impl->pullData(ResidentCommunicator::getBodySize(sbuf),
 		               gotNotifyEventBodyCb);
+	} else if (pktType == RESIDENT_PROTO_PKT_TYPE_NOTIFY_EVENT_BATCH) {
+		impl->pullData(ResidentCommunicator::getBodySize(sbuf),
+		               gotNotifyEventBatchBodyCb);
 	} else {
 		MLPL_ERR("Unexpected packet: %d\n", pktType);
 		requestQuit(impl);
@@ -232,6 +232,9 @@ int mainRoutine(int argc, char *argv[])
 	} else {
 		pidFilePath.clear();
 	}
+	// The spawner is a fork of this process. So it should be started
+	// before other threads as daemonize().
+	ChildProcessManager::startSpawner();
 	hatoholInitChildProcessManager();
 
 	// setup signal handlers for exit
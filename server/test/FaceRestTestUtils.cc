@@ -19,6 +19,7 @@
 
 #include <cppcutter.h>
 #include <Mutex.h>
+#include <glib/gstdio.h>
 #include "Hatohol.h"
 #include "FaceRest.h"
 #include "Helpers.h"
@@ -35,19 +36,23 @@ static const unsigned int TEST_PORT = 53194;
 
 static FaceRest *g_faceRest = NULL;
 
-void startFaceRest(void)
+void startFaceRest(const size_t &numWorkers, FaceRestSetupFunc setupFunc)
 {
 	struct : public FaceRestParam {
 		Mutex mutex;
+		FaceRestSetupFunc setupFunc;
 		virtual void setupDoneNotifyFunc(void) 
 		{
+			if (setupFunc)
+				(*setupFunc)(g_faceRest);
 			mutex.unlock();
 		}
 	} param;
+	param.setupFunc = setupFunc;
 
 	ConfigManager::getInstance()->setFaceRestPort(TEST_PORT);
 	g_faceRest = new FaceRest(&param);
-	g_faceRest->setNumberOfPreLoadWorkers(1);
+	g_faceRest->setNumberOfPreLoadWorkers(numWorkers);
 
 	param.mutex.lock();
 	g_faceRest->start();
@@ -70,6 +75,11 @@ void stopFaceRest(void)
 	}
 }
 
+FaceRest *getFaceRest(void)
+{
+	return g_faceRest;
+}
+
 string makeSessionIdHeader(const string &sessionId)
 {
 	string header =
@@ -145,7 +155,7 @@ static bool parseStatusLine(RequestArg &arg, const gchar *line)
 	return succeeded;
 }
 
-void getServerResponse(RequestArg &arg)
+static string makeCurlCommand(RequestArg &arg)
 {
 	getSessionId(arg);
 
@@ -170,13 +180,14 @@ void getServerResponse(RequestArg &arg)
 		headers += "\" ";
 	}
 
-	// get reply with wget
-	string getCmd =
-	  StringUtils::sprintf("curl -X %s %s %s -i http://localhost:%u%s%s",
-	                       arg.request.c_str(), headers.c_str(),
-	                       postDataArg.c_str(), TEST_PORT, arg.url.c_str(),
-	                       joinedQueryParams.c_str());
-	arg.response = executeCommand(getCmd);
+	return StringUtils::sprintf(
+	  "curl -X %s %s %s -i http://localhost:%u%s%s",
+	  arg.request.c_str(), headers.c_str(), postDataArg.c_str(),
+	  TEST_PORT, arg.url.c_str(), joinedQueryParams.c_str());
+}
+
+static void parseResponse(RequestArg &arg)
+{
 	const string separator = "\r\n\r\n";
 	size_t pos = arg.response.find(separator);
 	if (pos != string::npos) {
@@ -193,6 +204,44 @@ void getServerResponse(RequestArg &arg)
 	}
 }
 
+void getServerResponse(RequestArg &arg)
+{
+	// get reply with curl
+	arg.response = executeCommand(makeCurlCommand(arg));
+	parseResponse(arg);
+}
+
+void getServerResponsesInParallel(vector<RequestArg> &args)
+{
+	GError *error = NULL;
+	gchar *dir = g_dir_make_tmp("hatohol-test-XXXXXX", &error);
+	gcut_assert_error(error);
+	cut_take_string(dir);
+
+	// Each curl writes the response to its own file so that
+	// the responses aren't mixed.
+	string script;
+	for (size_t i = 0; i < args.size(); i++) {
+		script += makeCurlCommand(args[i]);
+		script += StringUtils::sprintf(" -s -o %s/%zd & ", dir, i);
+	}
+	script += "wait";
+	executeCommand(StringUtils::sprintf("/bin/sh -c '%s'",
+	                                    script.c_str()));
+
+	for (size_t i = 0; i < args.size(); i++) {
+		const string path = StringUtils::sprintf("%s/%zd", dir, i);
+		gchar *contents = NULL;
+		g_file_get_contents(path.c_str(), &contents, NULL, &error);
+		gcut_assert_error(error);
+		args[i].response = contents;
+		g_free(contents);
+		g_unlink(path.c_str());
+		parseResponse(args[i]);
+	}
+	g_rmdir(dir);
+}
+
 JSONParser *getResponseAsJSONParser(RequestArg &arg)
 {
 	getServerResponse(arg);
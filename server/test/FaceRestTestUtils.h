@@ -55,11 +55,29 @@ struct RequestArg {
 	}
 };
 
-void startFaceRest(void);
+class FaceRest;
+
+/**
+ * A function called on the thread of FaceRest after the default handlers
+ * are registered and before the requests are accepted. It can be used to
+ * register additional handlers for the test.
+ */
+typedef void (*FaceRestSetupFunc)(FaceRest *faceRest);
+
+void startFaceRest(const size_t &numWorkers = 1,
+                   FaceRestSetupFunc setupFunc = NULL);
 void stopFaceRest(void);
+FaceRest *getFaceRest(void);
 std::string makeSessionIdHeader(const std::string &sessionId);
 
 void getServerResponse(RequestArg &arg);
+
+/**
+ * Send the requests at the same time and wait for all the responses.
+ *
+ * @param args Requests. The responses are stored as getServerResponse().
+ */
+void getServerResponsesInParallel(std::vector<RequestArg> &args);
 JSONParser *getResponseAsJSONParser(RequestArg &arg);
 JSONParser *getServerResponseAsJSONParserWithFailure(RequestArg &arg);
 
@@ -506,8 +506,59 @@ void ZabbixAPIEmulator::APIHandlerItemGet(APIHandlerArg &arg)
 	soup_message_set_status(arg.msg, SOUP_STATUS_OK);
 }
 
+void ZabbixAPIEmulator::APIHandlerGetStatWithFile(
+  APIHandlerArg &arg, const string &dataFile, const string &idName)
+{
+	string path = getFixturesDir() + dataFile;
+	gchar *contents;
+	gsize length;
+	gboolean succeeded =
+	  g_file_get_contents(path.c_str(), &contents, &length, NULL);
+	if (!succeeded)
+		THROW_HATOHOL_EXCEPTION("Failed to read file: %s", path.c_str());
+	JSONParser parser(contents);
+	g_free(contents);
+	if (parser.hasError())
+		THROW_HATOHOL_EXCEPTION("Failed to parse: %s", path.c_str());
+	startObject(parser, "result");
+	const unsigned int count = parser.countElements();
+	uint64_t maxId = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		string id;
+		parser.startElement(i);
+		parser.read(idName, id);
+		parser.endElement();
+		const uint64_t value = StringUtils::toUint64(id);
+		if (value > maxId)
+			maxId = value;
+	}
+
+	string sendData;
+	if (hasParameterTempl<bool>(arg, "countOutput", true)) {
+		sendData = StringUtils::sprintf(
+		  "{\"jsonrpc\":\"2.0\",\"result\":\"%u\","
+		  "\"id\":%" PRId64 "}", count, arg.id);
+	} else {
+		string slice;
+		if (count > 0) {
+			slice = StringUtils::sprintf(
+			  "{\"%s\":\"%" PRIu64 "\"}", idName.c_str(), maxId);
+		}
+		sendData = addJSONResponse(slice, arg);
+	}
+	soup_message_body_append(arg.msg->response_body, SOUP_MEMORY_COPY,
+	                         sendData.c_str(), sendData.size());
+	soup_message_set_status(arg.msg, SOUP_STATUS_OK);
+}
+
 void ZabbixAPIEmulator::APIHandlerHostGet(APIHandlerArg &arg)
 {
+	if (hasParameterTempl<bool>(arg, "countOutput", true) ||
+	    hasParameter(arg, "sortfield", "hostid")) {
+		APIHandlerGetStatWithFile(arg, "zabbix-api-res-hosts-002.json",
+		                          "hostid");
+		return;
+	}
 	const char *dataFileName;
 	if (hasParameter(arg, "selectGroups", "refer"))
 		dataFileName = "zabbix-api-res-hosts-002.json";
@@ -518,6 +569,12 @@ void ZabbixAPIEmulator::APIHandlerHostGet(APIHandlerArg &arg)
 
 void ZabbixAPIEmulator::APIHandlerHostgroupGet(APIHandlerArg &arg)
 {
+	if (hasParameterTempl<bool>(arg, "countOutput", true) ||
+	    hasParameter(arg, "sortfield", "groupid")) {
+		APIHandlerGetStatWithFile(
+		  arg, "zabbix-api-res-hostgroup-002-refer.json", "groupid");
+		return;
+	}
 	const char *dataFileName;
 	if (hasParameter(arg, "selectHosts", "refer"))
 		dataFileName = "zabbix-api-res-hostgroup-002-refer.json";
@@ -86,6 +86,9 @@ protected:
 	void handlerAPIDispatch(APIHandlerArg &arg);
 	void APIHandlerGetWithFile(APIHandlerArg &arg,
 	                           const std::string &dataFile);
+	void APIHandlerGetStatWithFile(APIHandlerArg &arg,
+	                               const std::string &dataFile,
+	                               const std::string &idName);
 	void APIHandlerAPIVersion(APIHandlerArg &arg);
 	void APIHandlerUserLogin(APIHandlerArg &arg);
 	void APIHandlerTriggerGet(APIHandlerArg &arg);
@@ -160,6 +160,22 @@ uint64_t ZabbixAPITestee::callGetLastEventId(void)
 	return getEndEventId(false);
 }
 
+void ZabbixAPITestee::callPrefetchGroupsAndTriggers(void)
+{
+	HatoholError queryRet;
+	beginPrefetch();
+	cppcut_assert_null(queryGroup(queryRet));
+	cppcut_assert_equal(HTERR_OK, queryRet.getCode());
+	cppcut_assert_null(queryTrigger(queryRet));
+	cppcut_assert_equal(HTERR_OK, queryRet.getCode());
+	endPrefetch();
+}
+
+void ZabbixAPITestee::callDiscardPrefetchedQueries(void)
+{
+	discardPrefetchedQueries();
+}
+
 ItemTablePtr ZabbixAPITestee::callGetHistory(
   const ItemIdType &itemId, const ZabbixAPI::ValueType &valueType,
   const time_t &beginTime, const time_t &endTime)
@@ -54,6 +54,8 @@ public:
 	ItemTablePtr callMergePlainTriggersAndExpandedDescriptions(
 	  const ItemTablePtr triggers, const ItemTablePtr expandedDescriptions);
 	uint64_t callGetLastEventId(void);
+	void callPrefetchGroupsAndTriggers(void);
+	void callDiscardPrefetchedQueries(void);
 	ItemTablePtr callGetHistory(const ItemIdType &itemId,
 				    const ZabbixAPI::ValueType &valueType,
 				    const time_t &beginTime,
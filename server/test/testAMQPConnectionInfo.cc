@@ -88,6 +88,17 @@ namespace defaultValue {
 	{
 		cppcut_assert_equal(string(""), info->getPublisherQueueName());
 	}
+
+	void test_manualAck(void)
+	{
+		cppcut_assert_equal(false, info->isManualAckEnabled());
+	}
+
+	void test_prefetchCount(void)
+	{
+		cppcut_assert_equal(static_cast<uint16_t>(0),
+				    info->getPrefetchCount());
+	}
 }
 
 namespace setter {
@@ -106,6 +117,32 @@ namespace setter {
 		info.setPublisherQueueName(queueName);
 		cppcut_assert_equal(queueName, info.getPublisherQueueName());
 	}
+
+	void test_manualAck(void)
+	{
+		AMQPConnectionInfo info;
+		info.setManualAckEnabled(true);
+		cppcut_assert_equal(true, info.isManualAckEnabled());
+	}
+
+	void test_prefetchCount(void)
+	{
+		AMQPConnectionInfo info;
+		info.setPrefetchCount(32);
+		cppcut_assert_equal(static_cast<uint16_t>(32),
+				    info.getPrefetchCount());
+	}
+
+	void test_copyKeepsFlowControlSettings(void)
+	{
+		AMQPConnectionInfo info;
+		info.setManualAckEnabled(true);
+		info.setPrefetchCount(16);
+		AMQPConnectionInfo copied(info);
+		cppcut_assert_equal(true, copied.isManualAckEnabled());
+		cppcut_assert_equal(static_cast<uint16_t>(16),
+				    copied.getPrefetchCount());
+	}
 }
 
 } // namespace testAMQPConnectionInfo
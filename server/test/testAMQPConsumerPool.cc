@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <gcutter.h>
+#include <cppcutter.h>
+#include <atomic>
+#include <unistd.h>
+
+#include <AMQPConnection.h>
+#include <AMQPConsumerPool.h>
+#include <AMQPPublisher.h>
+
+using namespace std;
+using namespace mlpl;
+
+namespace testAMQPConsumerPool {
+	AMQPConnectionInfo *connectionInfo;
+	AMQPConsumerPool::Subscription *subscription;
+
+	class EchoHandler : public AMQPConsumerPool::Handler {
+	public:
+		EchoHandler()
+		: m_numMessages(0)
+		{
+		}
+
+		virtual void handle(AMQPConsumerPool::Subscription &sub,
+				    const AMQPMessage &message) override
+		{
+			m_numMessages++;
+			AMQPConsumerPool::getInstance().publish(&sub, message);
+		}
+
+		atomic<size_t> m_numMessages;
+	};
+
+	EchoHandler *handler;
+
+	AMQPConnectionInfo &getConnectionInfo(void)
+	{
+		if (!connectionInfo)
+			cut_omit("TEST_AMQP_URL isn't set");
+		return *connectionInfo;
+	}
+
+	GTimer *startTimer(void)
+	{
+		GTimer *timer = g_timer_new();
+		cut_take(timer, (CutDestroyFunction)g_timer_destroy);
+		g_timer_start(timer);
+		return timer;
+	}
+
+	void cut_setup(void)
+	{
+		const char *url = getenv("TEST_AMQP_URL");
+		if (url) {
+			connectionInfo = new AMQPConnectionInfo();
+			connectionInfo->setURL(url);
+			connectionInfo->setConsumerQueueName("test.pool-S");
+			connectionInfo->setPublisherQueueName("test.pool-T");
+			connectionInfo->setManualAckEnabled(true);
+			connectionInfo->setPrefetchCount(8);
+		} else {
+			connectionInfo = NULL;
+		}
+		subscription = NULL;
+		handler = new EchoHandler();
+	}
+
+	void cut_teardown(void)
+	{
+		AMQPConsumerPool::getInstance().unsubscribe(subscription);
+		subscription = NULL;
+		if (connectionInfo) {
+			AMQPConnectionPtr connection =
+			  AMQPConnection::create(*connectionInfo);
+			if (connection->connect())
+				connection->deleteAllQueues();
+		}
+		delete handler;
+		handler = NULL;
+		delete connectionInfo;
+		connectionInfo = NULL;
+	}
+
+	void test_subscribeAndUnsubscribe(void)
+	{
+		AMQPConsumerPool &pool = AMQPConsumerPool::getInstance();
+		AMQPConsumerPool::Stat before, after;
+		pool.getStat(before);
+		subscription = pool.subscribe(getConnectionInfo(), *handler);
+		pool.getStat(after);
+		cppcut_assert_equal(before.numSubscriptions + 1,
+				    after.numSubscriptions);
+
+		pool.unsubscribe(subscription);
+		subscription = NULL;
+		pool.getStat(after);
+		cppcut_assert_equal(before.numSubscriptions,
+				    after.numSubscriptions);
+	}
+
+	void test_echo(void)
+	{
+		AMQPConsumerPool &pool = AMQPConsumerPool::getInstance();
+		subscription = pool.subscribe(getConnectionInfo(), *handler);
+
+		AMQPJSONMessage message;
+		message.body = "{\"body\":\"example\"}";
+		AMQPConnectionInfo senderInfo(*connectionInfo);
+		senderInfo.setPublisherQueueName("test.pool-S");
+		AMQPPublisher publisher(senderInfo);
+		publisher.setMessage(message);
+		cppcut_assert_equal(true, publisher.publish());
+
+		AMQPConnectionInfo receiverInfo(*connectionInfo);
+		receiverInfo.setConsumerQueueName("test.pool-T");
+		receiverInfo.setManualAckEnabled(false);
+		AMQPConnectionPtr receiver = AMQPConnection::create(receiverInfo);
+		cppcut_assert_equal(true, receiver->connect());
+		cppcut_assert_equal(true, receiver->startConsuming());
+
+		AMQPMessage echoed;
+		bool gotMessage = false;
+		gdouble timeout = 5.0, elapsed = 0.0;
+		GTimer *timer = startTimer();
+		while (!gotMessage && elapsed < timeout) {
+			gotMessage = receiver->consume(echoed);
+			elapsed = g_timer_elapsed(timer, NULL);
+		}
+		cut_assert_true(gotMessage);
+		cppcut_assert_equal(static_cast<size_t>(1),
+				    static_cast<size_t>(handler->m_numMessages));
+		cppcut_assert_equal(message.contentType, echoed.contentType);
+		cppcut_assert_equal(message.body, echoed.body);
+	}
+
+	void test_inFlightAfterAck(void)
+	{
+		AMQPConsumerPool &pool = AMQPConsumerPool::getInstance();
+		subscription = pool.subscribe(getConnectionInfo(), *handler);
+
+		AMQPJSONMessage message;
+		message.body = "{\"body\":\"example\"}";
+		AMQPConnectionInfo senderInfo(*connectionInfo);
+		senderInfo.setPublisherQueueName("test.pool-S");
+		AMQPPublisher publisher(senderInfo);
+		publisher.setMessage(message);
+		cppcut_assert_equal(true, publisher.publish());
+
+		// The ack is sent by the I/O thread after the handler returns.
+		AMQPConsumerPool::Stat stat;
+		gdouble timeout = 5.0, elapsed = 0.0;
+		GTimer *timer = startTimer();
+		while (elapsed < timeout) {
+			pool.getStat(stat);
+			if (handler->m_numMessages > 0 && stat.numInFlight == 0)
+				break;
+			usleep(10 * 1000);
+			elapsed = g_timer_elapsed(timer, NULL);
+		}
+		cppcut_assert_equal(static_cast<size_t>(1),
+				    static_cast<size_t>(handler->m_numMessages));
+		cppcut_assert_equal(static_cast<size_t>(0), stat.numInFlight);
+		cppcut_assert_equal(static_cast<size_t>(0), stat.numBacklog);
+	}
+} // namespace testAMQPConsumerPool
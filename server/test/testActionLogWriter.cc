@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppcutter.h>
+#include "Hatohol.h"
+#include "Helpers.h"
+#include "DBTablesTest.h"
+#include "ActionLogWriter.h"
+#include "ThreadLocalDBCache.h"
+
+using namespace std;
+using namespace mlpl;
+
+namespace testActionLogWriter {
+
+static EventInfo makeRecentEvent(const EventIdType &eventId)
+{
+	EventInfo eventInfo = testEventInfo[0];
+	eventInfo.id = eventId;
+	eventInfo.time.tv_sec = time(NULL);
+	eventInfo.time.tv_nsec = 0;
+	return eventInfo;
+}
+
+static ActionLogWriter::Stat getStat(void)
+{
+	ActionLogWriter::Stat stat;
+	ActionLogWriter::getInstance().getStat(stat);
+	return stat;
+}
+
+void cut_setup(void)
+{
+	hatoholInit();
+	setupTestDB();
+}
+
+void cut_teardown(void)
+{
+	ActionLogWriter::reset();
+}
+
+// ---------------------------------------------------------------------------
+// Test cases
+// ---------------------------------------------------------------------------
+void test_mergeEndIntoCreation(void)
+{
+	ActionLogWriter &writer = ActionLogWriter::getInstance();
+	const EventInfo eventInfo = makeRecentEvent("100");
+	const ActionLogIdType logId =
+	  writer.createActionLog(testActionDef[0], eventInfo);
+	DBTablesAction::LogEndExecActionArg logArg;
+	logArg.logId = logId;
+	logArg.status = ACTLOG_STAT_SUCCEEDED;
+	logArg.exitCode = 3;
+	writer.logEndExecAction(logArg);
+	writer.flush();
+
+	ActionLogWriter::Stat stat = getStat();
+	cppcut_assert_equal(static_cast<uint64_t>(2), stat.numChanges);
+	cppcut_assert_equal(static_cast<uint64_t>(1), stat.numMergedChanges);
+	cppcut_assert_equal(static_cast<size_t>(0), stat.queueDepth);
+
+	ThreadLocalDBCache cache;
+	ActionLog actionLog;
+	cppcut_assert_equal(true, cache.getAction().getLog(actionLog, logId));
+	cppcut_assert_equal(static_cast<int>(ACTLOG_STAT_SUCCEEDED),
+	                    actionLog.status);
+	cppcut_assert_equal(3, actionLog.exitCode);
+	cppcut_assert_equal(static_cast<uint32_t>(ACTLOG_FLAG_QUEUING_TIME),
+	                    actionLog.nullFlags);
+}
+
+void test_updateWrittenLog(void)
+{
+	ActionLogWriter &writer = ActionLogWriter::getInstance();
+	const EventInfo eventInfo = makeRecentEvent("101");
+	const ActionLogIdType logId =
+	  writer.createActionLog(testActionDef[0], eventInfo,
+	                         ACTLOG_EXECFAIL_NONE, ACTLOG_STAT_QUEUING);
+	writer.flush();
+	writer.updateLogStatusToStart(logId);
+	writer.flush();
+
+	ThreadLocalDBCache cache;
+	ActionLog actionLog;
+	cppcut_assert_equal(true, cache.getAction().getLog(actionLog, logId));
+	cppcut_assert_equal(static_cast<int>(ACTLOG_STAT_STARTED),
+	                    actionLog.status);
+	cppcut_assert_equal(
+	  static_cast<uint32_t>(ACTLOG_FLAG_END_TIME | ACTLOG_FLAG_EXIT_CODE),
+	  actionLog.nullFlags);
+}
+
+void test_isLoggedWithoutDB(void)
+{
+	ActionLogWriter &writer = ActionLogWriter::getInstance();
+	ThreadLocalDBCache cache;
+	const EventInfo loggedEvent = makeRecentEvent("102");
+	const EventInfo newEvent = makeRecentEvent("103");
+	writer.createActionLog(testActionDef[0], loggedEvent);
+
+	// The log hasn't been written yet.
+	cppcut_assert_equal(true,
+	                    writer.isLogged(loggedEvent, cache.getAction()));
+	cppcut_assert_equal(false,
+	                    writer.isLogged(newEvent, cache.getAction()));
+	cppcut_assert_equal(static_cast<uint64_t>(0), getStat().numDBLookups);
+}
+
+void test_isLoggedWithLogsInDB(void)
+{
+	// The logs written before the start of the writer are loaded.
+	ThreadLocalDBCache cache;
+	const EventInfo eventInfo = makeRecentEvent("104");
+	cache.getAction().createActionLog(testActionDef[0], eventInfo);
+
+	ActionLogWriter &writer = ActionLogWriter::getInstance();
+	cppcut_assert_equal(true,
+	                    writer.isLogged(eventInfo, cache.getAction()));
+	cppcut_assert_equal(static_cast<uint64_t>(0), getStat().numDBLookups);
+	cppcut_assert_equal(static_cast<size_t>(1),
+	                    getStat().numIndexedEvents);
+}
+
+void test_isLoggedOldEvent(void)
+{
+	// The DB is queried for an event older than the allowed time.
+	ThreadLocalDBCache cache;
+	const EventInfo &eventInfo = testEventInfo[0];
+	cache.getAction().createActionLog(testActionDef[0], eventInfo);
+
+	ActionLogWriter &writer = ActionLogWriter::getInstance();
+	cppcut_assert_equal(true,
+	                    writer.isLogged(eventInfo, cache.getAction()));
+	cppcut_assert_equal(false,
+	                    writer.isLogged(testEventInfo[1],
+	                                    cache.getAction()));
+	cppcut_assert_equal(static_cast<uint64_t>(2), getStat().numDBLookups);
+}
+
+void test_logIdsAreContinuous(void)
+{
+	ThreadLocalDBCache cache;
+	const ActionLogIdType firstId =
+	  cache.getAction().createActionLog(testActionDef[0],
+	                                    makeRecentEvent("105"));
+	const ActionLogIdType secondId =
+	  ActionLogWriter::getInstance().createActionLog(
+	    testActionDef[0], makeRecentEvent("106"));
+	cppcut_assert_equal(firstId + 1, secondId);
+}
+
+void test_dropChangeThatCannotBeWritten(void)
+{
+	// Make a row that conflicts with the second log of the writer.
+	ThreadLocalDBCache cache;
+	DBTablesAction &dbAction = cache.getAction();
+	const ActionLogIdType lastId =
+	  dbAction.createActionLog(testActionDef[0], makeRecentEvent("107"));
+	DBTablesAction::ActionLogChangeVect changes(1);
+	changes[0].setNew(lastId + 2, testActionDef[0],
+	                  makeRecentEvent("108"), ACTLOG_EXECFAIL_NONE,
+	                  ACTLOG_STAT_STARTED);
+	dbAction.writeActionLogs(changes);
+
+	ActionLogWriter &writer = ActionLogWriter::getInstance();
+	const ActionLogIdType goodId =
+	  writer.createActionLog(testActionDef[0], makeRecentEvent("109"));
+	const ActionLogIdType badId =
+	  writer.createActionLog(testActionDef[0], makeRecentEvent("110"));
+	cppcut_assert_equal(lastId + 2, badId);
+	writer.flush();
+
+	// The good one is written even if it's in the same batch.
+	ActionLogWriter::Stat stat = getStat();
+	cppcut_assert_equal(static_cast<uint64_t>(1), stat.numDroppedChanges);
+	cppcut_assert_equal(static_cast<size_t>(0), stat.queueDepth);
+	ActionLog actionLog;
+	cppcut_assert_equal(true, dbAction.getLog(actionLog, goodId));
+	const ServerIdType &serverId = testEventInfo[0].serverId;
+	cppcut_assert_equal(false, dbAction.getLog(actionLog, serverId, "110"));
+}
+
+} // namespace testActionLogWriter
@@ -27,6 +27,7 @@
 #include "Hatohol.h"
 #include "Helpers.h"
 #include "ActionManager.h"
+#include "ActionLogWriter.h"
 #include "SmartBuffer.h"
 #include "ActionTp.h"
 #include "ResidentProtocol.h"
@@ -464,6 +465,7 @@ void _assertActionLogJustAfterExec(
 	if (!(expectedNullFlags & ACTLOG_STAT_QUEUING))
 		expectQueuingTime = CURR_DATETIME;
 
+	ActionLogWriter::getInstance().flush();
 	ThreadLocalDBCache cache;
 	cppcut_assert_equal(
 	  true, cache.getAction().getLog(ctx->actionLog, ctx->actorInfo.logId));
@@ -513,6 +515,7 @@ void _assertWaitForChangeActionLogStatus(ExecCommandContext *ctx,
 	do {
 		g_main_context_iteration(NULL, FALSE);
 		cppcut_assert_equal(false, ctx->timedOut);
+		ActionLogWriter::getInstance().flush();
 		cppcut_assert_equal(
 		  true, dbAction.getLog(ctx->actionLog, ctx->actorInfo.logId));
 	} while (ctx->actionLog.status == currStatus);
@@ -578,6 +581,7 @@ void _assertActionLogForFailure(ExecCommandContext *ctx, int failureCode,
   int expectedNullFlags = ACTLOG_FLAG_QUEUING_TIME|ACTLOG_FLAG_EXIT_CODE,
   int expectedExitCode = 0)
 {
+	ActionLogWriter::getInstance().flush();
 	ThreadLocalDBCache cache;
 	DBTablesAction &dbAction = cache.getAction();
 	cppcut_assert_equal(
@@ -840,6 +844,7 @@ static void deleteGlobalExecCommandCtx(size_t idx)
 
 static string g_pathForAction;
 static string g_ldLibraryPathForAction;
+static size_t g_residentNotifyWindow;
 
 static void clearEnvString(const string &envName, string &str)
 {
@@ -863,6 +868,8 @@ void cut_setup(void)
 	const char *residentYardDir =
 	  cut_build_path(getBaseDir().c_str(), "..", "src", ".libs", NULL);
 	ConfigManager::getInstance()->setResidentYardDirectory(residentYardDir);
+	g_residentNotifyWindow =
+	  ConfigManager::getInstance()->getResidentNotifyWindow();
 }
 
 void cut_teardown(void)
@@ -874,6 +881,8 @@ void cut_teardown(void)
 		deleteGlobalExecCommandCtx(i);
 	g_execCommandCtxVect.clear();
 	releaseDefaultContext();
+	ConfigManager::getInstance()->setResidentNotifyWindow(
+	  g_residentNotifyWindow);
 
 	clearEnvString(ActionManager::ENV_NAME_PATH_FOR_ACTION,
 	               g_pathForAction);
@@ -1106,6 +1115,7 @@ void test_execResidentActionWithWrongPath(void)
 
 	// reconfirm the action log. This confirms that the log is not
 	// updated in ActorCollector::checkExitProcess().
+	ActionLogWriter::getInstance().flush();
 	ThreadLocalDBCache cache;
 	cppcut_assert_equal(
 	  true, cache.getAction().getLog(ctx->actionLog, ctx->actorInfo.logId));
@@ -1138,7 +1148,7 @@ void test_execResidentActionManyEvents(void)
 	}
 }
 
-void test_execResidentActionManyEventsGenThenCheckLog(void)
+static void _assertExecResidentActionManyEventsGenThenCheckLog(void)
 {
 	g_execCommandCtx = new ExecCommandContext();
 	ExecCommandContext *ctx = g_execCommandCtx; // just an alias
@@ -1160,6 +1170,20 @@ void test_execResidentActionManyEventsGenThenCheckLog(void)
 		assertActionLogAfterExecResident(logarg);
 	}
 }
+#define assertExecResidentActionManyEventsGenThenCheckLog() \
+cut_trace(_assertExecResidentActionManyEventsGenThenCheckLog())
+
+void test_execResidentActionManyEventsGenThenCheckLog(void)
+{
+	assertExecResidentActionManyEventsGenThenCheckLog();
+}
+
+void test_execResidentActionManyEventsGenThenCheckLogWithoutWindow(void)
+{
+	// The next event is sent after the ack of the previous one.
+	ConfigManager::getInstance()->setResidentNotifyWindow(1);
+	assertExecResidentActionManyEventsGenThenCheckLog();
+}
 
 void test_execResidentActionCheckArg(void)
 {
@@ -1442,6 +1466,7 @@ void test_checkEventsWithMultipleIncidentSender(void)
 		usleep(100 * 1000);
 
 	// check action log
+	ActionLogWriter::getInstance().flush();
 	string expected
 		= StringUtils::sprintf("%" FMT_ACTION_ID, expectedActionId);
 	string statement = "select action_id from ";
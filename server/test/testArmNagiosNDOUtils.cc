@@ -17,12 +17,17 @@
  * <http://www.gnu.org/licenses/>.
  */
 
+#include <memory>
 #include <cppcutter.h>
 #include "Hatohol.h"
 #include "ArmNagiosNDOUtils.h"
+#include "DBAgentMySQL.h"
+#include "DBTablesLastInfo.h"
+#include "ThreadLocalDBCache.h"
 #include "Helpers.h"
 #include "DBTablesTest.h"
 using namespace std;
+using namespace mlpl;
 
 namespace testArmNagiosNDOUtils {
 
@@ -81,6 +86,99 @@ static void createGlobalInstance(void)
 	g_armNagiTestee->connect();
 }
 
+// The same as the constants in ArmNagiosNDOUtils.cc.
+static const size_t MAX_ROWS_PER_QUERY = 1000;
+static const size_t MAX_EVENT_QUERIES_PER_POLLING = 10;
+
+static const int HOST_OBJECT_ID = 1;
+static const int SERVICE_OBJECT_ID_BASE = 100;
+static const int HARD_STATE = 1;
+
+static unique_ptr<DBAgentMySQL> openNDOUtilsDB(void)
+{
+	return unique_ptr<DBAgentMySQL>(
+	  new DBAgentMySQL("ndoutils", "ndoutils", "admin"));
+}
+
+static void clearNDOUtilsDB(DBAgent &ndoDB)
+{
+	const char *tables[] = {
+	  "nagios_hosts", "nagios_services", "nagios_servicestatus",
+	  "nagios_statehistory",
+	};
+	for (size_t i = 0; i < ARRAY_SIZE(tables); i++)
+		ndoDB.execSql(StringUtils::sprintf("DELETE FROM %s", tables[i]));
+}
+
+static void addHostAndServices(DBAgent &ndoDB, const size_t &numServices,
+                               const time_t &updateTime)
+{
+	ndoDB.execSql(StringUtils::sprintf(
+	  "INSERT INTO nagios_hosts (instance_id, host_object_id, "
+	  "display_name) VALUES (1, %d, 'host1')", HOST_OBJECT_ID));
+
+	const string timeStr = DBAgent::makeDatetimeString(updateTime);
+	string services =
+	  "INSERT INTO nagios_services (instance_id, host_object_id, "
+	  "service_object_id, display_name) VALUES ";
+	string statuses =
+	  "INSERT INTO nagios_servicestatus (instance_id, service_object_id, "
+	  "status_update_time, output, long_output, perfdata, current_state) "
+	  "VALUES ";
+	for (size_t i = 0; i < numServices; i++) {
+		const int serviceObjectId = SERVICE_OBJECT_ID_BASE + i;
+		const char *sep = (i == 0) ? "" : ",";
+		services += StringUtils::sprintf(
+		  "%s(1, %d, %d, 'service%d')", sep,
+		  HOST_OBJECT_ID, serviceObjectId, serviceObjectId);
+		statuses += StringUtils::sprintf(
+		  "%s(1, %d, %s, 'output', '', '', 0)", sep,
+		  serviceObjectId, timeStr.c_str());
+	}
+	ndoDB.execSql(services);
+	ndoDB.execSql(statuses);
+}
+
+static void addStateHistory(DBAgent &ndoDB, const uint64_t &firstId,
+                            const size_t &num)
+{
+	// Rows are inserted in chunks to keep the statements short.
+	const size_t chunkSize = 1000;
+	const string timeStr = DBAgent::makeDatetimeString(time(NULL));
+	for (size_t done = 0; done < num; done += chunkSize) {
+		string sql =
+		  "INSERT INTO nagios_statehistory (statehistory_id, "
+		  "instance_id, state_time, object_id, state, state_type, "
+		  "output, long_output) VALUES ";
+		for (size_t i = done; i < num && i < done + chunkSize; i++) {
+			sql += StringUtils::sprintf(
+			  "%s(%" PRIu64 ", 1, %s, %d, 2, %d, 'output', '')",
+			  (i == done) ? "" : ",", firstId + i, timeStr.c_str(),
+			  SERVICE_OBJECT_ID_BASE, HARD_STATE);
+		}
+		ndoDB.execSql(sql);
+	}
+}
+
+static void assertNumberOfRows(const string &table, const size_t &expect)
+{
+	ThreadLocalDBCache cache;
+	DBAgent &dbAgent = cache.getMonitoring().getDBAgent();
+	const string statement = StringUtils::sprintf(
+	  "SELECT COUNT(*) FROM %s WHERE server_id=1", table.c_str());
+	assertDBContent(&dbAgent, statement, StringUtils::toString(expect));
+}
+
+static void assertCursor(const LastInfoType &type, const uint64_t &expect)
+{
+	ThreadLocalDBCache cache;
+	DBAgent &dbAgent = cache.getLastInfo().getDBAgent();
+	const string statement = StringUtils::sprintf(
+	  "SELECT value FROM last_info WHERE server_id=1 AND data_type=%d",
+	  type);
+	assertDBContent(&dbAgent, statement, StringUtils::toString(expect));
+}
+
 void cut_setup(void)
 {
 	hatoholInit();
@@ -115,5 +213,84 @@ void test_getEvent(void)
 	g_armNagiTestee->getEvent();
 }
 
+void test_getTriggerOverPagesWithSameUpdateTime(void)
+{
+	// The rows of the same second span pages. Every one should be read.
+	const size_t numServices = MAX_ROWS_PER_QUERY * 2 + 10;
+	const time_t updateTime = time(NULL);
+	unique_ptr<DBAgentMySQL> ndoDB = openNDOUtilsDB();
+	clearNDOUtilsDB(*ndoDB);
+	addHostAndServices(*ndoDB, numServices, updateTime);
+
+	createGlobalInstance<ArmNagiosNDOUtilsTestee>();
+	g_armNagiTestee->getTrigger();
+	assertNumberOfRows("triggers", numServices);
+	assertCursor(LAST_INFO_TRIGGER, updateTime);
+}
+
+void test_getEventWithCursorFallback(void)
+{
+	// The max event ID in the Hatohol DB is used without a saved cursor.
+	EventInfo eventInfo = testEventInfo[0];
+	eventInfo.serverId = 1;
+	eventInfo.id = StringUtils::sprintf("%020d", 5);
+	ThreadLocalDBCache cache;
+	cache.getMonitoring().addEventInfo(&eventInfo);
+
+	unique_ptr<DBAgentMySQL> ndoDB = openNDOUtilsDB();
+	clearNDOUtilsDB(*ndoDB);
+	addHostAndServices(*ndoDB, 1, time(NULL));
+	addStateHistory(*ndoDB, 1, 10);
+
+	createGlobalInstance<ArmNagiosNDOUtilsTestee>();
+	g_armNagiTestee->getEvent();
+	assertNumberOfRows("events", 1 + 5);
+	assertCursor(LAST_INFO_EVENT, 10);
+}
+
+void test_getEventWithRestoredCursor(void)
+{
+	unique_ptr<DBAgentMySQL> ndoDB = openNDOUtilsDB();
+	clearNDOUtilsDB(*ndoDB);
+	addHostAndServices(*ndoDB, 1, time(NULL));
+	addStateHistory(*ndoDB, 1, 10);
+	createGlobalInstance<ArmNagiosNDOUtilsTestee>();
+	g_armNagiTestee->getEvent();
+	assertNumberOfRows("events", 10);
+
+	// A restarted arm continues from the saved cursor even if the
+	// events have gone from the Hatohol DB.
+	delete g_armNagi;
+	g_armNagi = NULL;
+	ThreadLocalDBCache cache;
+	cache.getMonitoring().getDBAgent().execSql(
+	  "DELETE FROM events WHERE server_id=1");
+	addStateHistory(*ndoDB, 11, 2);
+	createGlobalInstance<ArmNagiosNDOUtilsTestee>();
+	g_armNagiTestee->getEvent();
+	assertNumberOfRows("events", 2);
+	assertCursor(LAST_INFO_EVENT, 12);
+}
+
+void test_getEventUpToMaxPagesPerPolling(void)
+{
+	const size_t maxEvents =
+	  MAX_ROWS_PER_QUERY * MAX_EVENT_QUERIES_PER_POLLING;
+	unique_ptr<DBAgentMySQL> ndoDB = openNDOUtilsDB();
+	clearNDOUtilsDB(*ndoDB);
+	addHostAndServices(*ndoDB, 1, time(NULL));
+	addStateHistory(*ndoDB, 1, maxEvents + 3);
+
+	createGlobalInstance<ArmNagiosNDOUtilsTestee>();
+	g_armNagiTestee->getEvent();
+	assertNumberOfRows("events", maxEvents);
+	assertCursor(LAST_INFO_EVENT, maxEvents);
+
+	// The rest is read in the next polling.
+	g_armNagiTestee->getEvent();
+	assertNumberOfRows("events", maxEvents + 3);
+	assertCursor(LAST_INFO_EVENT, maxEvents + 3);
+}
+
 } // namespace testArmNagiosNDOUtils
 
@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppcutter.h>
+#include <semaphore.h>
+#include "Hatohol.h"
+#include "ArmPollingScheduler.h"
+
+using namespace std;
+
+namespace testArmPollingScheduler {
+
+static const size_t NUM_WAKEUPS = 3;
+static sem_t wakeups[NUM_WAKEUPS];
+
+static ArmPollingScheduler::Stat getStat(void)
+{
+	ArmPollingScheduler::Stat stat;
+	ArmPollingScheduler::getInstance().getStat(stat);
+	return stat;
+}
+
+static bool isPosted(sem_t *sem)
+{
+	return sem_trywait(sem) == 0;
+}
+
+void cut_setup(void)
+{
+	hatoholInit();
+	ArmPollingScheduler::reset();
+	for (size_t i = 0; i < NUM_WAKEUPS; i++)
+		cppcut_assert_equal(0, sem_init(&wakeups[i], 0, 0));
+}
+
+void cut_teardown(void)
+{
+	ArmPollingScheduler &scheduler = ArmPollingScheduler::getInstance();
+	for (size_t i = 0; i < NUM_WAKEUPS; i++) {
+		scheduler.cancelWait(&wakeups[i]);
+		sem_destroy(&wakeups[i]);
+	}
+	ArmPollingScheduler::reset();
+}
+
+// ---------------------------------------------------------------------------
+// Test cases
+// ---------------------------------------------------------------------------
+void test_getInitialDelayMSec(void)
+{
+	ArmPollingScheduler &scheduler = ArmPollingScheduler::getInstance();
+	for (size_t i = 0; i < 100; i++) {
+		const size_t delay = scheduler.getInitialDelayMSec(3);
+		cppcut_assert_equal(true, delay < 3000);
+	}
+	cppcut_assert_equal(static_cast<size_t>(0),
+	                    scheduler.getInitialDelayMSec(0));
+}
+
+void test_getRetryDelayMSec(void)
+{
+	ArmPollingScheduler &scheduler = ArmPollingScheduler::getInstance();
+	for (size_t i = 0; i < 100; i++) {
+		const size_t delay = scheduler.getRetryDelayMSec(4);
+		cppcut_assert_equal(true, delay >= 4000 && delay <= 5000);
+	}
+}
+
+void test_limitTotal(void)
+{
+	ArmPollingScheduler &scheduler = ArmPollingScheduler::getInstance();
+	scheduler.setMaxRunningPollings(2);
+	cppcut_assert_equal(true, scheduler.tryAcquire("A", &wakeups[0]));
+	cppcut_assert_equal(true, scheduler.tryAcquire("B", &wakeups[1]));
+	cppcut_assert_equal(false, scheduler.tryAcquire("A", &wakeups[2]));
+	cppcut_assert_equal(false, isPosted(&wakeups[2]));
+
+	scheduler.release("B");
+	cppcut_assert_equal(true, isPosted(&wakeups[2]));
+	cppcut_assert_equal(true, scheduler.tryAcquire("A", &wakeups[2]));
+
+	const ArmPollingScheduler::Stat stat = getStat();
+	cppcut_assert_equal(static_cast<uint64_t>(3), stat.numPollings);
+	cppcut_assert_equal(static_cast<uint64_t>(1), stat.numDelayedPollings);
+	cppcut_assert_equal(static_cast<size_t>(2), stat.numRunning);
+	cppcut_assert_equal(static_cast<size_t>(2), stat.maxNumRunning);
+	scheduler.release("A");
+	scheduler.release("A");
+}
+
+void test_limitBackend(void)
+{
+	ArmPollingScheduler &scheduler = ArmPollingScheduler::getInstance();
+	scheduler.setMaxRunningPollings("A", 1);
+	cppcut_assert_equal(true, scheduler.tryAcquire("A", &wakeups[0]));
+	cppcut_assert_equal(false, scheduler.tryAcquire("A", &wakeups[1]));
+	cppcut_assert_equal(true, scheduler.tryAcquire("B", &wakeups[2]));
+
+	// A free slot of the other backend doesn't wake up the waiter.
+	scheduler.release("B");
+	cppcut_assert_equal(false, isPosted(&wakeups[1]));
+
+	scheduler.release("A");
+	cppcut_assert_equal(true, isPosted(&wakeups[1]));
+	cppcut_assert_equal(true, scheduler.tryAcquire("A", &wakeups[1]));
+	scheduler.release("A");
+}
+
+void test_reservedSlotIsNotTaken(void)
+{
+	ArmPollingScheduler &scheduler = ArmPollingScheduler::getInstance();
+	scheduler.setMaxRunningPollings(1);
+	cppcut_assert_equal(true, scheduler.tryAcquire("A", &wakeups[0]));
+	cppcut_assert_equal(false, scheduler.tryAcquire("B", &wakeups[1]));
+
+	// The slot is kept for the woken waiter against a newcomer.
+	scheduler.release("A");
+	cppcut_assert_equal(true, isPosted(&wakeups[1]));
+	cppcut_assert_equal(false, scheduler.tryAcquire("C", &wakeups[2]));
+	cppcut_assert_equal(true, scheduler.tryAcquire("B", &wakeups[1]));
+
+	scheduler.release("B");
+	cppcut_assert_equal(true, isPosted(&wakeups[2]));
+	cppcut_assert_equal(true, scheduler.tryAcquire("C", &wakeups[2]));
+	scheduler.release("C");
+}
+
+void test_cancelWaitPassesReservedSlot(void)
+{
+	ArmPollingScheduler &scheduler = ArmPollingScheduler::getInstance();
+	scheduler.setMaxRunningPollings(1);
+	cppcut_assert_equal(true, scheduler.tryAcquire("A", &wakeups[0]));
+	cppcut_assert_equal(false, scheduler.tryAcquire("B", &wakeups[1]));
+	cppcut_assert_equal(false, scheduler.tryAcquire("C", &wakeups[2]));
+
+	scheduler.release("A");
+	cppcut_assert_equal(true, isPosted(&wakeups[1]));
+	cppcut_assert_equal(false, isPosted(&wakeups[2]));
+
+	scheduler.cancelWait(&wakeups[1]);
+	cppcut_assert_equal(true, isPosted(&wakeups[2]));
+	cppcut_assert_equal(true, scheduler.tryAcquire("C", &wakeups[2]));
+	scheduler.release("C");
+}
+
+} // namespace testArmPollingScheduler
@@ -613,6 +613,29 @@ void test_oneProcWithoutFetchItems()
 	cppcut_assert_equal(false, itemInfoList.empty());
 }
 
+void test_mainThreadOneProcSkipsUnchangedHostsAndGroups()
+{
+	ArmZabbixAPITestee armZbxApiTestee(setupServer());
+	armZbxApiTestee.loadHostInfoCacheForEmulator();
+	cppcut_assert_equal(true, armZbxApiTestee.testMainThreadOneProc());
+	ArmZabbixAPI::Stat firstStat;
+	armZbxApiTestee.getStat(firstStat);
+	cppcut_assert_equal(static_cast<uint64_t>(1), firstStat.numHostFetches);
+	cppcut_assert_equal(static_cast<uint64_t>(1),
+	                    firstStat.numGroupFetches);
+
+	// Nothing has been changed in the emulator.
+	cppcut_assert_equal(true, armZbxApiTestee.testMainThreadOneProc());
+	ArmZabbixAPI::Stat stat;
+	armZbxApiTestee.getStat(stat);
+	cppcut_assert_equal(firstStat.numHostFetches, stat.numHostFetches);
+	cppcut_assert_equal(firstStat.numHostStores, stat.numHostStores);
+	cppcut_assert_equal(firstStat.numGroupFetches, stat.numGroupFetches);
+	cppcut_assert_equal(firstStat.numGroupStores, stat.numGroupStores);
+	cppcut_assert_equal(firstStat.numAllTriggerFetches,
+	                    stat.numAllTriggerFetches);
+}
+
 void test_oneProcWithCopyOnDemandEnabled()
 {
 	ArmZabbixAPITestee armZbxApiTestee(setupServer());
@@ -306,4 +306,28 @@ void test_getFaceRestNumWorkers(void)
 	cppcut_assert_equal(expect, actual);
 }
 
+void test_setFaceRestMaxRunningJobs(void)
+{
+	ConfigManager *mng = ConfigManager::getInstance();
+	mng->setFaceRestMaxRunningJobs("low", 2);
+	cppcut_assert_equal(2, mng->getFaceRestMaxRunningJobs("low"));
+	cppcut_assert_equal(0, mng->getFaceRestMaxRunningJobs("unknown"));
+}
+
+void test_setFaceRestMaxQueuedJobs(void)
+{
+	ConfigManager *mng = ConfigManager::getInstance();
+	mng->setFaceRestMaxQueuedJobs("high", 100);
+	cppcut_assert_equal(100, mng->getFaceRestMaxQueuedJobs("high"));
+	cppcut_assert_equal(0, mng->getFaceRestMaxQueuedJobs("unknown"));
+}
+
+void test_setArmPollingMaxRunning(void)
+{
+	ConfigManager *mng = ConfigManager::getInstance();
+	mng->setArmPollingMaxRunning("ArmZabbixAPI", 4);
+	cppcut_assert_equal(4, mng->getArmPollingMaxRunning("ArmZabbixAPI"));
+	cppcut_assert_equal(0, mng->getArmPollingMaxRunning("ArmFake"));
+}
+
 } // namespace testConfigManager
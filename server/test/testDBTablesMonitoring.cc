@@ -1260,6 +1260,43 @@ void test_getEventWithMaxNumAndOffsetAndLimitOfUnifiedIdDescending(
 	assertGetEventsWithFilter(arg);
 }
 
+void data_getEventWithCursor(void)
+{
+	prepareTestDataExcludeDefunctServers();
+}
+
+void test_getEventWithCursor(gconstpointer data)
+{
+	test_addEventInfoList(data);
+	DECLARE_DBTABLES_MONITORING(dbMonitoring);
+
+	EventsQueryOption option(USER_ID_SYSTEM);
+	option.setSortType(EventsQueryOption::SORT_TIME,
+			   DataQueryOption::SORT_DESCENDING);
+	EventInfoList expectedList;
+	assertHatoholError(
+	  HTERR_OK, dbMonitoring.getEventInfoList(expectedList, option));
+	cppcut_assert_equal(true, expectedList.size() > 2);
+
+	// Walk through all pages by the cursor
+	const size_t pageSize = 2;
+	string expected, actual;
+	for (auto &eventInfo : expectedList)
+		expected += StringUtils::toString(eventInfo.unifiedId) + "\n";
+	option.setMaximumNumber(pageSize);
+	while (true) {
+		EventInfoList page;
+		assertHatoholError(
+		  HTERR_OK, dbMonitoring.getEventInfoList(page, option));
+		for (auto &eventInfo : page)
+			actual += StringUtils::toString(eventInfo.unifiedId) + "\n";
+		if (page.size() < pageSize)
+			break;
+		option.setCursor(page.back().time, page.back().unifiedId);
+	}
+	cppcut_assert_equal(expected, actual);
+}
+
 void data_getEventWithOneAuthorizedServer(void)
 {
 	prepareTestDataExcludeDefunctServers();
@@ -18,10 +18,15 @@
  */
 
 #include <cppcutter.h>
+#include <unistd.h>
+#include <thread>
+#include <AtomicValue.h>
 #include "Hatohol.h"
 #include "FaceRest.h"
+#include "FaceRestPrivate.h"
 #include "FaceRestTestUtils.h"
 #include "Helpers.h"
+#include "DBTablesTest.h"
 using namespace std;
 using namespace mlpl;
 
@@ -67,4 +72,243 @@ void test_testError(void)
 	assertErrorCode(parserPtr.get(), HTERR_ERROR_TEST);
 }
 
+void test_priorityClassStat(void)
+{
+	TestModeStone stone;
+	startFaceRest();
+	RequestArg arg("/test");
+	getServerResponse(arg);
+	cppcut_assert_equal(200, arg.httpStatusCode);
+
+	FaceRest::PriorityClassStat stat;
+	getFaceRest()->getPriorityClassStat(FaceRest::PRIORITY_NORMAL, stat);
+	cppcut_assert_equal((uint64_t)1, stat.numHandled);
+	cppcut_assert_equal((uint64_t)0, stat.numRejected);
+	cppcut_assert_equal((size_t)0, stat.running);
+	cppcut_assert_equal((size_t)0, stat.queued);
+
+	getFaceRest()->getPriorityClassStat(FaceRest::PRIORITY_HIGH, stat);
+	cppcut_assert_equal((uint64_t)0, stat.numHandled);
+}
+
+static AtomicValue<int> g_lowerJobRunning;
+
+static void handlerLowerJobTest(FaceRest::ResourceHandler *job)
+{
+	g_lowerJobRunning = 1;
+	usleep(1000 * 1000);
+	g_lowerJobRunning = 0;
+	JSONBuilder agent;
+	agent.startObject();
+	FaceRest::ResourceHandler::addHatoholError(
+	  agent, HatoholError(HTERR_OK));
+	agent.endObject();
+	job->replyJSONData(agent);
+}
+
+static void addLowerJobTestHandler(FaceRest *faceRest)
+{
+	faceRest->addResourceHandlerFactory(
+	  "/test/lower",
+	  new FaceRest::ResourceHandlerFactory(faceRest,
+	                                       handlerLowerJobTest),
+	  FaceRest::PRIORITY_LOW);
+}
+
+void test_highClassIsServedWithOneWorker(void)
+{
+	TestModeStone stone;
+	g_lowerJobRunning = 0;
+	startFaceRest(1, addLowerJobTestHandler);
+
+	RequestArg lowerArg("/test/lower");
+	thread lowerRequest([&lowerArg] { getServerResponse(lowerArg); });
+	while (!g_lowerJobRunning)
+		usleep(10 * 1000);
+
+	RequestArg arg("/hello.html");
+	getServerResponse(arg);
+	const int lowerJobRunning = g_lowerJobRunning;
+	lowerRequest.join();
+	cppcut_assert_equal(200, arg.httpStatusCode);
+	cppcut_assert_equal(1, lowerJobRunning);
+	cppcut_assert_equal(200, lowerArg.httpStatusCode);
+}
+
+static bool hasResponseHeader(const RequestArg &arg, const string &header)
+{
+	for (size_t i = 0; i < arg.responseHeaders.size(); i++) {
+		if (arg.responseHeaders[i] == header)
+			return true;
+	}
+	return false;
+}
+
+void test_compressedResponse(void)
+{
+	TestModeStone stone;
+	startFaceRest();
+	RequestArg arg("/test");
+	arg.request = "POST";
+	arg.parameters["data"] =
+	  string(FaceRest::DEFAULT_COMPRESSION_THRESHOLD * 2, 'A');
+	arg.headers.push_back("Accept-Encoding: gzip");
+	getServerResponse(arg);
+	cppcut_assert_equal(200, arg.httpStatusCode);
+	cppcut_assert_equal(true,
+	                    hasResponseHeader(arg, "Content-Encoding: gzip"));
+
+	FaceRest::CompressionStat stat;
+	getFaceRest()->getCompressionStat(stat);
+	cppcut_assert_equal((uint64_t)1, stat.numCompressed);
+	cppcut_assert_equal(true,
+	                    stat.totalOutputBytes < stat.totalInputBytes);
+}
+
+void test_smallResponseIsNotCompressed(void)
+{
+	TestModeStone stone;
+	startFaceRest();
+	RequestArg arg("/test");
+	arg.headers.push_back("Accept-Encoding: gzip, deflate");
+	unique_ptr<JSONParser> parserPtr(getResponseAsJSONParser(arg));
+	assertErrorCode(parserPtr.get());
+	cppcut_assert_equal(false,
+	                    hasResponseHeader(arg, "Content-Encoding: gzip"));
+
+	FaceRest::CompressionStat stat;
+	getFaceRest()->getCompressionStat(stat);
+	cppcut_assert_equal((uint64_t)0, stat.numCompressed);
+	cppcut_assert_equal((uint64_t)1, stat.numSkipped);
+}
+
+static const char *pathForSlowTest = "/test/slow";
+static AtomicValue<int> g_numSlowExecutions;
+
+static void handlerSlowTest(FaceRest::ResourceHandler *job)
+{
+	const int execution = g_numSlowExecutions.add(1);
+	// Keep running long enough for the other requests to arrive.
+	usleep(1000 * 1000);
+	JSONBuilder agent;
+	agent.startObject();
+	FaceRest::ResourceHandler::addHatoholError(
+	  agent, HatoholError(HTERR_OK));
+	agent.add("execution", execution);
+	agent.endObject();
+	job->replyJSONData(agent);
+}
+
+static void addSlowTestHandler(FaceRest *faceRest)
+{
+	FaceRest::ResourceHandlerFactory *factory =
+	  new FaceRest::ResourceHandlerFactory(faceRest, handlerSlowTest);
+	factory->m_singleFlight = true;
+	faceRest->addResourceHandlerFactory(pathForSlowTest, factory);
+}
+
+static void handlerSlowAsyncTest(FaceRest::ResourceHandler *job)
+{
+	g_numSlowExecutions.add(1);
+	usleep(1000 * 1000);
+	// Reply from another thread like the callbacks of on-demand fetch.
+	job->ref();
+	thread replier([job] {
+		usleep(100 * 1000);
+		JSONBuilder agent;
+		agent.startObject();
+		FaceRest::ResourceHandler::addHatoholError(
+		  agent, HatoholError(HTERR_OK));
+		agent.endObject();
+		job->replyJSONData(agent);
+		job->unpauseResponse();
+		job->unref();
+	});
+	replier.detach();
+}
+
+static void addSlowAsyncTestHandler(FaceRest *faceRest)
+{
+	FaceRest::ResourceHandlerFactory *factory =
+	  new FaceRest::ResourceHandlerFactory(faceRest,
+	                                       handlerSlowAsyncTest);
+	factory->m_singleFlight = true;
+	faceRest->addResourceHandlerFactory(pathForSlowTest, factory);
+}
+
+static void requestSlowTestInParallel(vector<RequestArg> &args,
+                                      const UserIdType *userIds,
+                                      const size_t &numRequests)
+{
+	g_numSlowExecutions = 0;
+	for (size_t i = 0; i < numRequests; i++) {
+		args.push_back(RequestArg(pathForSlowTest));
+		args.back().userId = userIds[i];
+	}
+	getServerResponsesInParallel(args);
+	for (size_t i = 0; i < numRequests; i++)
+		cppcut_assert_equal(200, args[i].httpStatusCode);
+}
+
+void test_coalesceIdenticalRequests(void)
+{
+	TestModeStone stone;
+	setupTestDB();
+	loadTestDBUser();
+	startFaceRest(4, addSlowTestHandler);
+
+	const UserIdType userId = findUserWith(OPPRVLG_GET_ALL_SERVER);
+	const UserIdType userIds[] = {userId, userId, userId};
+	const size_t numRequests = ARRAY_SIZE(userIds);
+	vector<RequestArg> args;
+	requestSlowTestInParallel(args, userIds, numRequests);
+
+	cppcut_assert_equal(1, (int)g_numSlowExecutions);
+	for (size_t i = 1; i < numRequests; i++)
+		cppcut_assert_equal(args[0].response, args[i].response);
+	cppcut_assert_equal((uint64_t)(numRequests - 1),
+	                    getFaceRest()->getNumCoalescedRequests());
+}
+
+void test_dontCoalesceRequestsWithDifferentPrivileges(void)
+{
+	TestModeStone stone;
+	setupTestDB();
+	loadTestDBUser();
+	startFaceRest(4, addSlowTestHandler);
+
+	const UserIdType userIds[] = {
+	  findUserWith(OPPRVLG_GET_ALL_SERVER),
+	  findUserWithout(OPPRVLG_GET_ALL_SERVER),
+	};
+	const size_t numRequests = ARRAY_SIZE(userIds);
+	vector<RequestArg> args;
+	requestSlowTestInParallel(args, userIds, numRequests);
+
+	cppcut_assert_equal((int)numRequests, (int)g_numSlowExecutions);
+	cppcut_assert_equal(false, args[0].response == args[1].response);
+	cppcut_assert_equal((uint64_t)0,
+	                    getFaceRest()->getNumCoalescedRequests());
+}
+
+void test_handleEachRequestWhenLeaderRepliesLater(void)
+{
+	TestModeStone stone;
+	setupTestDB();
+	loadTestDBUser();
+	startFaceRest(4, addSlowAsyncTestHandler);
+
+	const UserIdType userId = findUserWith(OPPRVLG_GET_ALL_SERVER);
+	const UserIdType userIds[] = {userId, userId, userId};
+	const size_t numRequests = ARRAY_SIZE(userIds);
+	vector<RequestArg> args;
+	requestSlowTestInParallel(args, userIds, numRequests);
+
+	// The leader doesn't leave its response when its handler returns.
+	// The waiting requests are queued again and handled by themselves.
+	cppcut_assert_equal((int)numRequests, (int)g_numSlowExecutions);
+	cppcut_assert_equal((uint64_t)0,
+	                    getFaceRest()->getNumCoalescedRequests());
+}
+
 } // namespace testFaceRest
@@ -612,6 +612,23 @@ void test_eventsWithTimeRange(void)
 		     eventsArg);
 }
 
+void test_eventsWithCursorWithoutSortOrder(void)
+{
+	startFaceRest();
+
+	RequestArg arg("/event");
+	StringMap params;
+	params["cursor"] =
+	  RestResourceHost::encodeEventCursor(testEventInfo[0]);
+	params["sortOrder"] =
+	  StringUtils::toString(DataQueryOption::SORT_DONT_CARE);
+	arg.parameters = params;
+	arg.userId = findUserWith(OPPRVLG_GET_ALL_SERVER);
+	JSONParser *parser = getResponseAsJSONParser(arg);
+	unique_ptr<JSONParser> parserPtr(parser);
+	assertErrorCode(parser, HTERR_INVALID_PARAMETER);
+}
+
 void test_items(void)
 {
 	assertItems("/item");
@@ -710,4 +727,34 @@ void test_getHistoryWithInvalidItemId(void)
 	assertErrorCode(parser, HTERR_NOT_FOUND_TARGET_RECORD);
 }
 
+void data_getHistoryWithInvalidDownsampleParameter(void)
+{
+	gcut_add_datum("Unknown aggregate",
+	               "name", G_TYPE_STRING, "aggregate",
+	               "value", G_TYPE_STRING, "sum", NULL);
+	gcut_add_datum("Zero bucketWidth",
+	               "name", G_TYPE_STRING, "bucketWidth",
+	               "value", G_TYPE_STRING, "0", NULL);
+	gcut_add_datum("Negative maxPoints",
+	               "name", G_TYPE_STRING, "maxPoints",
+	               "value", G_TYPE_STRING, "-1", NULL);
+}
+
+void test_getHistoryWithInvalidDownsampleParameter(gconstpointer data)
+{
+	startFaceRest();
+
+	RequestArg arg("/history");
+	StringMap params;
+	params["serverId"] = StringUtils::toString(testItemInfo[0].serverId);
+	params["itemId"] = testItemInfo[0].id;
+	params[gcut_data_get_string(data, "name")] =
+	  gcut_data_get_string(data, "value");
+	arg.parameters = params;
+	arg.userId = findUserWith(OPPRVLG_GET_ALL_SERVER);
+	JSONParser *parser = getResponseAsJSONParser(arg);
+	unique_ptr<JSONParser> parserPtr(parser);
+	assertErrorCode(parser, HTERR_INVALID_PARAMETER);
+}
+
 } // namespace testFaceRestHost
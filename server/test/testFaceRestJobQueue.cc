@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppcutter.h>
+#include "FaceRestJobQueue.h"
+
+using namespace std;
+
+namespace testFaceRestJobQueue {
+
+struct TestJob {
+	int id;
+};
+
+typedef FaceRestJobQueue<TestJob> TestJobQueue;
+
+static const size_t NUM_WORKERS = 4;
+static TestJob jobs[16];
+
+static void setupLimits(TestJobQueue &queue)
+{
+	// The same as the defaults of FaceRest with 4 workers.
+	queue.setMaxLowerRunning(NUM_WORKERS - 1);
+	queue.setLimits(FaceRest::PRIORITY_HIGH, NUM_WORKERS, 8);
+	queue.setLimits(FaceRest::PRIORITY_NORMAL, NUM_WORKERS - 1, 8);
+	queue.setLimits(FaceRest::PRIORITY_LOW, NUM_WORKERS / 2, 2);
+}
+
+static TestJob *pop(TestJobQueue &queue,
+                    FaceRest::PriorityClass expectedClass)
+{
+	FaceRest::PriorityClass priorityClass = FaceRest::PRIORITY_HIGH;
+	TestJob *job = queue.pop(priorityClass);
+	cppcut_assert_not_null(job);
+	cppcut_assert_equal(expectedClass, priorityClass);
+	return job;
+}
+
+void cut_setup(void)
+{
+	for (size_t i = 0; i < sizeof(jobs) / sizeof(jobs[0]); i++)
+		jobs[i].id = i;
+}
+
+// ---------------------------------------------------------------------------
+// Test cases
+// ---------------------------------------------------------------------------
+void test_rejectWhenQueueIsFull(void)
+{
+	TestJobQueue queue;
+	setupLimits(queue);
+	cppcut_assert_equal(true, queue.push(&jobs[0], FaceRest::PRIORITY_LOW));
+	cppcut_assert_equal(true, queue.push(&jobs[1], FaceRest::PRIORITY_LOW));
+	cppcut_assert_equal(false,
+	                    queue.push(&jobs[2], FaceRest::PRIORITY_LOW));
+	// Other classes are still accepted.
+	cppcut_assert_equal(true,
+	                    queue.push(&jobs[3], FaceRest::PRIORITY_HIGH));
+
+	FaceRest::PriorityClassStat stat;
+	queue.getStat(FaceRest::PRIORITY_LOW, stat);
+	cppcut_assert_equal((uint64_t)1, stat.numRejected);
+	cppcut_assert_equal((size_t)2, stat.queued);
+}
+
+void test_popHigherClassFirst(void)
+{
+	TestJobQueue queue;
+	setupLimits(queue);
+	queue.push(&jobs[0], FaceRest::PRIORITY_LOW);
+	queue.push(&jobs[1], FaceRest::PRIORITY_NORMAL);
+	queue.push(&jobs[2], FaceRest::PRIORITY_HIGH);
+	cppcut_assert_equal(&jobs[2], pop(queue, FaceRest::PRIORITY_HIGH));
+	cppcut_assert_equal(&jobs[1], pop(queue, FaceRest::PRIORITY_NORMAL));
+	cppcut_assert_equal(&jobs[0], pop(queue, FaceRest::PRIORITY_LOW));
+}
+
+void test_lowerClassesDontStarveHighClass(void)
+{
+	TestJobQueue queue;
+	setupLimits(queue);
+	// Normal: 3 and low: 2 are allowed separately, but they can run
+	// only 3 jobs in total.
+	for (size_t i = 0; i < 3; i++)
+		queue.push(&jobs[i], FaceRest::PRIORITY_NORMAL);
+	for (size_t i = 3; i < 5; i++)
+		queue.push(&jobs[i], FaceRest::PRIORITY_LOW);
+	pop(queue, FaceRest::PRIORITY_NORMAL);
+	pop(queue, FaceRest::PRIORITY_NORMAL);
+	pop(queue, FaceRest::PRIORITY_NORMAL);
+	FaceRest::PriorityClass priorityClass;
+	cppcut_assert_null(queue.pop(priorityClass));
+
+	// The last worker is still available for the high class.
+	queue.push(&jobs[5], FaceRest::PRIORITY_HIGH);
+	cppcut_assert_equal(&jobs[5], pop(queue, FaceRest::PRIORITY_HIGH));
+}
+
+void test_lowClassRunsAfterFinish(void)
+{
+	TestJobQueue queue;
+	setupLimits(queue);
+	for (size_t i = 0; i < 3; i++)
+		queue.push(&jobs[i], FaceRest::PRIORITY_NORMAL);
+	queue.push(&jobs[3], FaceRest::PRIORITY_LOW);
+	for (size_t i = 0; i < 3; i++)
+		pop(queue, FaceRest::PRIORITY_NORMAL);
+
+	// The deferred low job must be notified.
+	cppcut_assert_equal(true,
+	                    queue.finish(FaceRest::PRIORITY_NORMAL, 1.0));
+	cppcut_assert_equal(&jobs[3], pop(queue, FaceRest::PRIORITY_LOW));
+	cppcut_assert_equal(false,
+	                    queue.finish(FaceRest::PRIORITY_LOW, 1.0));
+
+	FaceRest::PriorityClassStat stat;
+	queue.getStat(FaceRest::PRIORITY_NORMAL, stat);
+	cppcut_assert_equal((size_t)2, stat.running);
+	cppcut_assert_equal((uint64_t)1, stat.numHandled);
+}
+
+} // namespace testFaceRestJobQueue
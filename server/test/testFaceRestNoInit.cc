@@ -495,4 +495,23 @@ void test_parseEventParameterInvalidTriggerId(void)
 	  triggerId, FORCE_EMPTY_STRING, HTERR_INVALID_PARAMETER);
 }
 
+void test_normalizeQuery(void)
+{
+	GHashTable *query = g_hash_table_new(g_str_hash, g_str_equal);
+	Reaper<GHashTable> queryReaper(query, g_hash_table_unref);
+	g_hash_table_insert(query, (gpointer) "type", (gpointer) "1");
+	g_hash_table_insert(query, (gpointer) "_", (gpointer) "1423456789");
+	g_hash_table_insert(query, (gpointer) "limit", (gpointer) "50");
+	g_hash_table_insert(query, (gpointer) "hostId", (gpointer) "a&b");
+	cppcut_assert_equal(
+	  string("hostId=a%26b&limit=50&type=1"),
+	  FaceRest::ResourceHandler::normalizeQuery(query));
+}
+
+void test_normalizeQueryWithNull(void)
+{
+	cppcut_assert_equal(
+	  string(""), FaceRest::ResourceHandler::normalizeQuery(NULL));
+}
+
 } // namespace testFaceRestNoInit
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppcutter.h>
+#include "FingerprintTable.h"
+#include "HatoholThreadBase.h"
+
+using namespace std;
+
+namespace testFingerprintTable {
+
+static FingerprintTable::EntryVect makeEntries(void)
+{
+	FingerprintTable::EntryVect entries;
+	entries.push_back(make_pair("1", Fingerprint().add("foo").get()));
+	entries.push_back(make_pair("2", Fingerprint().add("bar").get()));
+	entries.push_back(make_pair("3", Fingerprint().add("baz").get()));
+	return entries;
+}
+
+void test_fingerprintDependsOnBoundary(void)
+{
+	cppcut_assert_not_equal(Fingerprint().add("ab").add("c").get(),
+				Fingerprint().add("a").add("bc").get());
+}
+
+void test_fingerprintIsStable(void)
+{
+	cppcut_assert_equal(Fingerprint().add("foo").add(5).get(),
+			    Fingerprint().add("foo").add(5).get());
+}
+
+void test_notSeeded(void)
+{
+	FingerprintTable table;
+	cppcut_assert_equal(false, table.isSeeded());
+	table.update(makeEntries());
+	cppcut_assert_equal(false, table.isSeeded());
+	cppcut_assert_equal((size_t)0, table.size());
+}
+
+void test_noDelta(void)
+{
+	FingerprintTable table;
+	table.replace(makeEntries());
+	vector<size_t> changedIndexes;
+	vector<string> removedKeys;
+	table.getDelta(makeEntries(), changedIndexes, removedKeys);
+	cppcut_assert_equal(true, changedIndexes.empty());
+	cppcut_assert_equal(true, removedKeys.empty());
+}
+
+void test_delta(void)
+{
+	FingerprintTable table;
+	table.replace(makeEntries());
+
+	FingerprintTable::EntryVect entries = makeEntries();
+	entries[1].second = Fingerprint().add("BAR").get();
+	entries.erase(entries.begin() + 2);
+	entries.push_back(make_pair("4", Fingerprint().add("qux").get()));
+
+	vector<size_t> changedIndexes;
+	vector<string> removedKeys;
+	table.getDelta(entries, changedIndexes, removedKeys);
+	cppcut_assert_equal((size_t)2, changedIndexes.size());
+	cppcut_assert_equal((size_t)1, changedIndexes[0]);
+	cppcut_assert_equal((size_t)2, changedIndexes[1]);
+	cppcut_assert_equal((size_t)1, removedKeys.size());
+	cppcut_assert_equal(string("3"), removedKeys[0]);
+}
+
+void test_clear(void)
+{
+	FingerprintTable table;
+	table.replace(makeEntries());
+	table.clear();
+	cppcut_assert_equal(false, table.isSeeded());
+	cppcut_assert_equal((size_t)0, table.size());
+}
+
+void test_invalidate(void)
+{
+	FingerprintTable table(FingerprintTable::KIND_TRIGGERS, 1);
+	table.replace(makeEntries());
+	FingerprintTable::invalidate(FingerprintTable::KIND_TRIGGERS, 2);
+	FingerprintTable::invalidate(FingerprintTable::KIND_HOSTS, 1);
+	cppcut_assert_equal(true, table.isSeeded());
+
+	FingerprintTable::invalidate(FingerprintTable::KIND_TRIGGERS, 1);
+	cppcut_assert_equal(false, table.isSeeded());
+	cppcut_assert_equal((size_t)0, table.size());
+}
+
+void test_invalidateAllServers(void)
+{
+	FingerprintTable table(FingerprintTable::KIND_HOSTGROUPS, 1);
+	table.replace(makeEntries());
+	FingerprintTable::invalidate(FingerprintTable::KIND_HOSTGROUPS,
+	                             ALL_SERVERS);
+	cppcut_assert_equal(false, table.isSeeded());
+}
+
+void test_writeInWriterScopeDoesntInvalidate(void)
+{
+	FingerprintTable table(FingerprintTable::KIND_TRIGGERS, 1);
+	table.replace(makeEntries());
+	{
+		FingerprintTable::WriterScope writerScope(table);
+		FingerprintTable::invalidate(
+		  FingerprintTable::KIND_TRIGGERS, 1);
+		cppcut_assert_equal(true, table.isSeeded());
+	}
+	FingerprintTable::invalidate(FingerprintTable::KIND_TRIGGERS, 1);
+	cppcut_assert_equal(false, table.isSeeded());
+}
+
+void test_replaceAfterWriteByOtherThread(void)
+{
+	struct Writer : public HatoholThreadBase {
+		virtual gpointer mainThread(HatoholThreadArg *arg) override
+		{
+			FingerprintTable::invalidate(
+			  FingerprintTable::KIND_TRIGGERS, 1);
+			return NULL;
+		}
+	} writer;
+
+	FingerprintTable table(FingerprintTable::KIND_TRIGGERS, 1);
+	FingerprintTable::WriterScope writerScope(table);
+	writer.start();
+	writer.waitExit();
+	// The other thread may have written rows that the entries don't
+	// have.
+	table.replace(makeEntries());
+	cppcut_assert_equal(false, table.isSeeded());
+}
+
+void test_updateAfterWriteByOtherThread(void)
+{
+	FingerprintTable table(FingerprintTable::KIND_TRIGGERS, 1);
+	table.replace(makeEntries());
+	FingerprintTable::invalidate(FingerprintTable::KIND_TRIGGERS, 1);
+	table.update(makeEntries());
+	cppcut_assert_equal(false, table.isSeeded());
+	cppcut_assert_equal((size_t)0, table.size());
+}
+
+} // namespace testFingerprintTable
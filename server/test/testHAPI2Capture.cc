@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppcutter.h>
+#include <unistd.h>
+#include <StringUtils.h>
+#include <HAPI2Capture.h>
+
+using namespace std;
+using namespace mlpl;
+
+namespace testHAPI2Capture {
+
+static string capturePath;
+
+void cut_setup(void)
+{
+	capturePath = StringUtils::sprintf("/tmp/hatohol-test-hapi2-%d.capture",
+					   getpid());
+}
+
+void cut_teardown(void)
+{
+	unlink(capturePath.c_str());
+}
+
+// ---------------------------------------------------------------------------
+// Test cases
+// ---------------------------------------------------------------------------
+void test_writeAndRead(void)
+{
+	AMQPMessage json;
+	json.contentType = "application/json";
+	json.body = "{\"jsonrpc\":\"2.0\",\"method\":\"putEvents\"}";
+	AMQPMessage binary;
+	binary.contentType = "application/x-msgpack";
+	binary.body = string("\x81\xa1" "a\n\x00", 5);
+	AMQPMessage empty;
+
+	HAPI2Capture writer;
+	cppcut_assert_equal(true, writer.openForWrite(capturePath));
+	cppcut_assert_equal(true, writer.write(json));
+	cppcut_assert_equal(true, writer.write(binary));
+	cppcut_assert_equal(true, writer.write(empty));
+	writer.close();
+
+	HAPI2Capture reader;
+	HAPI2Capture::Record record;
+	cppcut_assert_equal(true, reader.openForRead(capturePath));
+
+	cppcut_assert_equal(true, reader.read(record));
+	cppcut_assert_equal(static_cast<uint64_t>(0), record.offsetUSec);
+	cppcut_assert_equal(json.contentType, record.message.contentType);
+	cppcut_assert_equal(json.body, record.message.body);
+
+	cppcut_assert_equal(true, reader.read(record));
+	cppcut_assert_equal(binary.contentType, record.message.contentType);
+	cppcut_assert_equal(binary.body, record.message.body);
+
+	cppcut_assert_equal(true, reader.read(record));
+	cppcut_assert_equal(string(), record.message.contentType);
+	cppcut_assert_equal(string(), record.message.body);
+
+	cppcut_assert_equal(false, reader.read(record));
+}
+
+void test_appendSession(void)
+{
+	AMQPMessage first;
+	first.body = "first";
+	AMQPMessage second;
+	second.body = "second";
+
+	HAPI2Capture writer;
+	cppcut_assert_equal(true, writer.openForWrite(capturePath));
+	cppcut_assert_equal(true, writer.write(first));
+	usleep(10 * 1000);
+	cppcut_assert_equal(true, writer.write(first));
+	writer.close();
+	cppcut_assert_equal(true, writer.openForWrite(capturePath));
+	cppcut_assert_equal(true, writer.write(second));
+	writer.close();
+
+	HAPI2Capture reader;
+	HAPI2Capture::Record record;
+	cppcut_assert_equal(true, reader.openForRead(capturePath));
+	cppcut_assert_equal(true, reader.read(record));
+	cppcut_assert_equal(first.body, record.message.body);
+	cppcut_assert_equal(true, reader.read(record));
+	cppcut_assert_equal(first.body, record.message.body);
+	const uint64_t lastOffsetUSec = record.offsetUSec;
+	cppcut_assert_equal(true, lastOffsetUSec > 0);
+
+	// The second session starts at 0 in the file.
+	cppcut_assert_equal(true, reader.read(record));
+	cppcut_assert_equal(second.body, record.message.body);
+	cppcut_assert_equal(lastOffsetUSec, record.offsetUSec);
+	cppcut_assert_equal(false, reader.read(record));
+}
+
+void test_writeWithoutOpen(void)
+{
+	HAPI2Capture writer;
+	cppcut_assert_equal(false, writer.write(AMQPMessage()));
+}
+
+} // namespace testHAPI2Capture
@@ -20,6 +20,7 @@
 #include <cppcutter.h>
 #include <gcutter.h>
 #include "HapProcessCeilometer.h"
+#include "Helpers.h"
 
 using namespace std;
 using namespace mlpl;
@@ -28,9 +29,30 @@ namespace testHapProcessCeilometer {
 
 class TestHapProcessCeilometer : public HapProcessCeilometer {
 public:
+	typedef HapProcessCeilometer::AlarmTimeMap AlarmTimeMap;
+
+	vector<vector<TriggerIdType> > requestedTriggerIds;
+	map<TriggerIdType, SmartTime>  timesOfLastEvents;
+	bool                           sendSucceeds;
+	size_t                         numSentTables;
+
 	TestHapProcessCeilometer(void)
-	: HapProcessCeilometer(0, NULL)
+	: HapProcessCeilometer(0, NULL),
+	  sendSucceeds(true),
+	  numSentTables(0)
+	{
+	}
+
+	void callGetLastAlarmTimes(const StringVector &alarmIds,
+	                           vector<SmartTime> &lastTimes)
 	{
+		getLastAlarmTimes(alarmIds, lastTimes);
+	}
+
+	HatoholError callSendAlarmEvents(const string &alarmId,
+	                                 const AlarmTimeMap &alarmTimeMap)
+	{
+		return sendAlarmEvents(alarmId, alarmTimeMap);
 	}
 
 	TriggerStatusType callParseAlarmState(const std::string &state)
@@ -52,8 +74,41 @@ public:
 	{
 		return getHistoryQueryOption(lastTime);
 	}
+
+protected:
+	virtual void getTimesOfLastEvents(
+	  const vector<TriggerIdType> &triggerIds,
+	  vector<SmartTime> &lastTimes) override
+	{
+		requestedTriggerIds.push_back(triggerIds);
+		lastTimes.clear();
+		for (size_t i = 0; i < triggerIds.size(); i++)
+			lastTimes.push_back(timesOfLastEvents[triggerIds[i]]);
+	}
+
+	virtual bool sendTableSync(const HapiCommandCode &code,
+	                           const ItemTablePtr &tablePtr) override
+	{
+		numSentTables++;
+		return sendSucceeds;
+	}
 };
 
+static SmartTime makeTime(const time_t &sec)
+{
+	const timespec ts = {sec, 0};
+	return SmartTime(ts);
+}
+
+static void addAlarmHistory(TestHapProcessCeilometer::AlarmTimeMap &map,
+                            const string &alarmId, const SmartTime &time)
+{
+	VariableItemGroupPtr grp;
+	grp->addNewItem(ITEM_ID_ZBX_EVENTS_OBJECTID, alarmId);
+	grp->freeze();
+	map.insert(pair<SmartTime, ItemGroupPtr>(time, (ItemGroupPtr)grp));
+}
+
 // ---------------------------------------------------------------------------
 // Test cases
 // ---------------------------------------------------------------------------
@@ -142,4 +197,72 @@ void test_parseAlarmHistoryDetail(gconstpointer data)
 	  static_cast<EventType>(gcut_data_get_int(data, "expect")));
 }
 
+void test_getLastAlarmTimesOfNewAlarmsAtOnce(void)
+{
+	TestHapProcessCeilometer hap;
+	hap.timesOfLastEvents["alarm1"] = makeTime(1410413960);
+	hap.timesOfLastEvents["alarm3"] = makeTime(1410413970);
+
+	StringVector alarmIds;
+	alarmIds.push_back("alarm1");
+	alarmIds.push_back("alarm2");
+	alarmIds.push_back("alarm3");
+	vector<SmartTime> lastTimes;
+	hap.callGetLastAlarmTimes(alarmIds, lastTimes);
+
+	cppcut_assert_equal((size_t)1, hap.requestedTriggerIds.size());
+	cppcut_assert_equal(true, hap.requestedTriggerIds[0] == alarmIds);
+	cppcut_assert_equal((size_t)3, lastTimes.size());
+	cppcut_assert_equal(makeTime(1410413960), lastTimes[0]);
+	cppcut_assert_equal(false, lastTimes[1].hasValidTime());
+	cppcut_assert_equal(makeTime(1410413970), lastTimes[2]);
+}
+
+void test_getLastAlarmTimesUsesSentTime(void)
+{
+	TestHapProcessCeilometer hap;
+	hap.timesOfLastEvents["alarm1"] = makeTime(1410413960);
+	hap.timesOfLastEvents["alarm2"] = makeTime(1410413970);
+
+	TestHapProcessCeilometer::AlarmTimeMap alarmTimeMap;
+	addAlarmHistory(alarmTimeMap, "alarm1", makeTime(1410414000));
+	addAlarmHistory(alarmTimeMap, "alarm1", makeTime(1410414010));
+	assertHatoholError(HTERR_OK,
+	                   hap.callSendAlarmEvents("alarm1", alarmTimeMap));
+	cppcut_assert_equal((size_t)1, hap.numSentTables);
+
+	StringVector alarmIds;
+	alarmIds.push_back("alarm1");
+	alarmIds.push_back("alarm2");
+	vector<SmartTime> lastTimes;
+	hap.callGetLastAlarmTimes(alarmIds, lastTimes);
+
+	// Only the alarm whose events haven't been sent is asked.
+	cppcut_assert_equal((size_t)1, hap.requestedTriggerIds.size());
+	cppcut_assert_equal(true, hap.requestedTriggerIds[0] ==
+	                          vector<TriggerIdType>(1, "alarm2"));
+	cppcut_assert_equal(makeTime(1410414010), lastTimes[0]);
+	cppcut_assert_equal(makeTime(1410413970), lastTimes[1]);
+}
+
+void test_keepLastAlarmTimeIfSendingFailed(void)
+{
+	TestHapProcessCeilometer hap;
+	hap.timesOfLastEvents["alarm1"] = makeTime(1410413960);
+	hap.sendSucceeds = false;
+
+	TestHapProcessCeilometer::AlarmTimeMap alarmTimeMap;
+	addAlarmHistory(alarmTimeMap, "alarm1", makeTime(1410414000));
+	assertHatoholError(HTERR_HAP_INTERNAL_ERROR,
+	                   hap.callSendAlarmEvents("alarm1", alarmTimeMap));
+
+	// The events are requested again from the time in the server.
+	StringVector alarmIds;
+	alarmIds.push_back("alarm1");
+	vector<SmartTime> lastTimes;
+	hap.callGetLastAlarmTimes(alarmIds, lastTimes);
+	cppcut_assert_equal((size_t)1, hap.requestedTriggerIds.size());
+	cppcut_assert_equal(makeTime(1410413960), lastTimes[0]);
+}
+
 } // namespace testHapProcessCeilometer
@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppcutter.h>
+#include <cstring>
+#include <SmartBuffer.h>
+#include <StringUtils.h>
+#include "HapiItemTableView.h"
+
+using namespace std;
+using namespace mlpl;
+
+namespace testHapiItemTableView {
+
+enum {
+	TEST_ITEM_ID_BOOL = 100,
+	TEST_ITEM_ID_INT,
+	TEST_ITEM_ID_UINT64,
+	TEST_ITEM_ID_DOUBLE,
+	TEST_ITEM_ID_STRING,
+	TEST_ITEM_ID_NULL_STRING,
+};
+
+static const size_t NUM_TEST_ROWS = 3;
+
+static ItemTablePtr createTestItemTable(void)
+{
+	VariableItemTablePtr itemTablePtr(new ItemTable(), false);
+	for (size_t i = 0; i < NUM_TEST_ROWS; i++) {
+		VariableItemGroupPtr itemGrpPtr(new ItemGroup(), false);
+		itemGrpPtr->add(new ItemBool(TEST_ITEM_ID_BOOL, i % 2), false);
+		itemGrpPtr->addNewItem(TEST_ITEM_ID_INT, -5 * (int)i);
+		itemGrpPtr->addNewItem(TEST_ITEM_ID_UINT64,
+		                       (uint64_t)(0xfedcba9876543210 + i));
+		itemGrpPtr->addNewItem(TEST_ITEM_ID_DOUBLE, 1.5 * i);
+		itemGrpPtr->addNewItem(TEST_ITEM_ID_STRING,
+		                       StringUtils::sprintf("string-%zd", i));
+		itemGrpPtr->addNewItem(TEST_ITEM_ID_NULL_STRING, string(),
+		                       ITEM_DATA_NULL);
+		itemGrpPtr->freeze();
+		itemTablePtr->add(itemGrpPtr);
+	}
+	return (ItemTablePtr)itemTablePtr;
+}
+
+// ---------------------------------------------------------------------------
+// Test cases
+// ---------------------------------------------------------------------------
+void test_readValues(void)
+{
+	SmartBuffer sbuf;
+	ItemTablePtr srcItemTablePtr = createTestItemTable();
+	HatoholArmPluginInterface::appendItemTable(sbuf, srcItemTablePtr);
+	const size_t tableSize = sbuf.index();
+
+	sbuf.resetIndex();
+	HapiItemTableView table(sbuf);
+	cppcut_assert_equal(tableSize, sbuf.index());
+	cppcut_assert_equal(NUM_TEST_ROWS, table.getNumberOfGroups());
+
+	const ItemGroupList &srcGrpList = srcItemTablePtr->getItemGroupList();
+	ItemGroupListConstIterator srcGrpIt = srcGrpList.begin();
+	for (size_t i = 0; i < NUM_TEST_ROWS; i++, ++srcGrpIt) {
+		const ItemGroup *srcGrp = *srcGrpIt;
+		const HapiItemGroupView group = table.getGroupAt(i);
+		cppcut_assert_equal(srcGrp->getNumberOfItems(),
+		                    group.getNumberOfItems());
+
+		const HapiItemDataView boolItem =
+		  group.getItem(TEST_ITEM_ID_BOOL);
+		cppcut_assert_equal(ITEM_TYPE_BOOL, boolItem.getItemType());
+		cppcut_assert_equal((bool)(i % 2), boolItem.getBool());
+
+		cppcut_assert_equal(-5 * (int)i,
+		                    group.getItem(TEST_ITEM_ID_INT).getInt());
+		cppcut_assert_equal(
+		  (uint64_t)(0xfedcba9876543210 + i),
+		  group.getItem(TEST_ITEM_ID_UINT64).getUint64());
+		cppcut_assert_equal(
+		  1.5 * i, group.getItem(TEST_ITEM_ID_DOUBLE).getDouble());
+
+		const HapiItemDataView stringItem =
+		  group.getItem(TEST_ITEM_ID_STRING);
+		const string expect = StringUtils::sprintf("string-%zd", i);
+		cppcut_assert_equal(expect.size(),
+		                    stringItem.getStringLength());
+		cppcut_assert_equal(expect, string(stringItem.getString()));
+		cppcut_assert_equal(false, stringItem.isNull());
+
+		const HapiItemDataView nullItem =
+		  group.getItem(TEST_ITEM_ID_NULL_STRING);
+		cppcut_assert_equal(true, nullItem.isNull());
+		string actual = "dummy";
+		nullItem >> actual;
+		cppcut_assert_equal(string(), actual);
+
+		// The string is not copied.
+		const char *top = sbuf.getPointer<char>(0);
+		cppcut_assert_equal(true, stringItem.getString() > top);
+		cppcut_assert_equal(true,
+		                    stringItem.getString() < top + tableSize);
+	}
+}
+
+void test_readEmptyTable(void)
+{
+	SmartBuffer sbuf;
+	VariableItemTablePtr itemTablePtr(new ItemTable(), false);
+	HatoholArmPluginInterface::appendItemTable(sbuf,
+	                                           (ItemTablePtr)itemTablePtr);
+
+	sbuf.resetIndex();
+	HapiItemTableView table(sbuf);
+	cppcut_assert_equal((size_t)0, table.getNumberOfGroups());
+}
+
+void test_appendItemTableIsSameAsAppendItemGroup(void)
+{
+	ItemTablePtr srcItemTablePtr = createTestItemTable();
+	SmartBuffer bulkBuf;
+	HatoholArmPluginInterface::appendItemTable(bulkBuf, srcItemTablePtr);
+
+	SmartBuffer sbuf;
+	const size_t headerIndex =
+	  HatoholArmPluginInterface::appendItemTableHeader(
+	    sbuf, srcItemTablePtr->getNumberOfRows());
+	const ItemGroupList &srcGrpList = srcItemTablePtr->getItemGroupList();
+	ItemGroupListConstIterator srcGrpIt = srcGrpList.begin();
+	for (; srcGrpIt != srcGrpList.end(); ++srcGrpIt)
+		HatoholArmPluginInterface::appendItemGroup(sbuf, *srcGrpIt);
+	HatoholArmPluginInterface::completeItemTable(sbuf, headerIndex);
+
+	cppcut_assert_equal(sbuf.index(), bulkBuf.index());
+	cppcut_assert_equal(0, memcmp(sbuf.getPointer<char>(0),
+	                              bulkBuf.getPointer<char>(0),
+	                              sbuf.index()));
+}
+
+void test_getItemNotFound(void)
+{
+	SmartBuffer sbuf;
+	HatoholArmPluginInterface::appendItemTable(sbuf, createTestItemTable());
+	sbuf.resetIndex();
+	HapiItemTableView table(sbuf);
+
+	ItemDataExceptionType exceptionType = ITEM_DATA_EXCEPTION_UNKNOWN;
+	try {
+		table.getGroupAt(0).getItem(1);
+	} catch (ItemDataException &e) {
+		exceptionType = e.getType();
+	}
+	cppcut_assert_equal(ITEM_DATA_EXCEPTION_ITEM_NOT_FOUND, exceptionType);
+}
+
+void test_readWithWrongType(void)
+{
+	SmartBuffer sbuf;
+	HatoholArmPluginInterface::appendItemTable(sbuf, createTestItemTable());
+	sbuf.resetIndex();
+	HapiItemTableView table(sbuf);
+
+	bool gotException = false;
+	try {
+		table.getGroupAt(0).getItem(TEST_ITEM_ID_STRING).getInt();
+	} catch (const HatoholException &e) {
+		gotException = true;
+	}
+	cppcut_assert_equal(true, gotException);
+}
+
+void test_brokenLength(void)
+{
+	SmartBuffer sbuf;
+	HatoholArmPluginInterface::appendItemTable(sbuf, createTestItemTable());
+	HapiItemTableHeader *header = sbuf.getPointer<HapiItemTableHeader>(0);
+	header->length = EndianConverter::NtoL(
+	  EndianConverter::LtoN(header->length) + 1);
+
+	sbuf.resetIndex();
+	bool gotException = false;
+	try {
+		HapiItemTableView table(sbuf);
+	} catch (const HatoholException &e) {
+		gotException = true;
+	}
+	cppcut_assert_equal(true, gotException);
+}
+
+} // namespace testHapiItemTableView
@@ -252,8 +252,26 @@ void test_procedureHandlerExchangeProfile(void)
 		  "\"putItems\",\"putHistory\",\"putHosts\",\"putHostGroups\","
 		  "\"putHostGroupMembership\",\"putTriggers\","
 		  "\"putEvents\",\"putHostParents\",\"putArmInfo\""
-		"]},\"id\":123}";
+		"],\"encodings\":[\"json\",\"msgpack\"]},\"id\":123}";
 	cppcut_assert_equal(expected, actual);
+	cppcut_assert_equal(HAPI2_ENCODING_JSON,
+			    gate->getNegotiatedEncoding());
+}
+
+void test_procedureHandlerExchangeProfileWithEncodings(void)
+{
+	HatoholArmPluginGateHAPI2Ptr gate(
+	  new HatoholArmPluginGateHAPI2(monitoringServerInfo, false), false);
+	string json =
+		"{\"jsonrpc\":\"2.0\", \"method\":\"exchangeProfile\","
+		" \"params\":{\"procedures\":[\"putItems\"],"
+		" \"encodings\":[\"json\", \"msgpack\"],"
+		" \"name\":\"examplePlugin\"}, \"id\":123}";
+	JSONParser parser(json);
+	gate->setEstablished(true);
+	gate->interpretHandler(HAPI2_EXCHANGE_PROFILE, parser);
+	cppcut_assert_equal(HAPI2_ENCODING_MESSAGE_PACK,
+			    gate->getNegotiatedEncoding());
 }
 
 void test_procedureHandlerMonitoringServerInfo(void)
@@ -1329,6 +1347,10 @@ void test_callExchangeProfile(void)
 		"\"putEvents\","
 		"\"putHostParents\","
 		"\"putArmInfo\""
+		"\\],"
+		"\"encodings\":\\["
+		"\"json\","
+		"\"msgpack\""
 		"\\]\\},"
 		"\"id\":\\d+"
 		"\\}$";
@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppcutter.h>
+#include "HistoryDownsampler.h"
+
+using namespace std;
+
+namespace testHistoryDownsampler {
+
+typedef HistoryDownsampler::Point Point;
+
+static void addHistoryInfo(HistoryInfoVect &historyInfoVect,
+                           const time_t &sec, const string &value)
+{
+	HistoryInfo historyInfo;
+	historyInfo.serverId      = 1;
+	historyInfo.itemId        = "1";
+	historyInfo.value         = value;
+	historyInfo.clock.tv_sec  = sec;
+	historyInfo.clock.tv_nsec = 0;
+	historyInfoVect.push_back(historyInfo);
+}
+
+// Two buckets of 10 seconds from 1000: [1, 5, 3] and [-2, 4.5]
+static HistoryInfoVect createHistoryInfoVect(void)
+{
+	HistoryInfoVect historyInfoVect;
+	addHistoryInfo(historyInfoVect, 1000, "1");
+	addHistoryInfo(historyInfoVect, 1003, "5");
+	addHistoryInfo(historyInfoVect, 1009, "3");
+	addHistoryInfo(historyInfoVect, 1020, "-2");
+	addHistoryInfo(historyInfoVect, 1029, "4.5");
+	return historyInfoVect;
+}
+
+static vector<Point> downsample(const HistoryDownsampler::Function &func)
+{
+	HistoryDownsampler downsampler(func, 10, 1000);
+	vector<Point> points;
+	cppcut_assert_equal(true,
+	                    downsampler.run(createHistoryInfoVect(), points));
+	cppcut_assert_equal(static_cast<size_t>(2), points.size());
+	cppcut_assert_equal(static_cast<time_t>(1000), points[0].time);
+	cppcut_assert_equal(static_cast<time_t>(1020), points[1].time);
+	cppcut_assert_equal(static_cast<size_t>(3), points[0].numSamples);
+	cppcut_assert_equal(static_cast<size_t>(2), points[1].numSamples);
+	return points;
+}
+
+// ---------------------------------------------------------------------------
+// Test cases
+// ---------------------------------------------------------------------------
+void test_parseFunction(void)
+{
+	HistoryDownsampler::Function func;
+	cppcut_assert_equal(true,
+	                    HistoryDownsampler::parseFunction("minmax", func));
+	cppcut_assert_equal(HistoryDownsampler::FUNC_MIN_MAX, func);
+	cppcut_assert_equal(string("minmax"),
+	                    string(HistoryDownsampler::getFunctionName(func)));
+	cppcut_assert_equal(false,
+	                    HistoryDownsampler::parseFunction("sum", func));
+}
+
+void test_calcBucketWidth(void)
+{
+	// 30 days of 1000 points.
+	cppcut_assert_equal(
+	  static_cast<time_t>(2592),
+	  HistoryDownsampler::calcBucketWidth(0, 30 * 86400 - 1, 1000));
+	cppcut_assert_equal(
+	  static_cast<time_t>(1),
+	  HistoryDownsampler::calcBucketWidth(0, 9, 1000));
+}
+
+void test_avg(void)
+{
+	vector<Point> points = downsample(HistoryDownsampler::FUNC_AVG);
+	cppcut_assert_equal(3.0, points[0].value);
+	cppcut_assert_equal(1.25, points[1].value);
+}
+
+void test_min(void)
+{
+	vector<Point> points = downsample(HistoryDownsampler::FUNC_MIN);
+	cppcut_assert_equal(1.0, points[0].value);
+	cppcut_assert_equal(-2.0, points[1].value);
+}
+
+void test_max(void)
+{
+	vector<Point> points = downsample(HistoryDownsampler::FUNC_MAX);
+	cppcut_assert_equal(5.0, points[0].value);
+	cppcut_assert_equal(4.5, points[1].value);
+}
+
+void test_last(void)
+{
+	vector<Point> points = downsample(HistoryDownsampler::FUNC_LAST);
+	cppcut_assert_equal(3.0, points[0].value);
+	cppcut_assert_equal(4.5, points[1].value);
+}
+
+void test_minMax(void)
+{
+	vector<Point> points = downsample(HistoryDownsampler::FUNC_MIN_MAX);
+	cppcut_assert_equal(3.0, points[0].value);
+	cppcut_assert_equal(1.0, points[0].min);
+	cppcut_assert_equal(5.0, points[0].max);
+	cppcut_assert_equal(-2.0, points[1].min);
+	cppcut_assert_equal(4.5, points[1].max);
+}
+
+void test_unsortedSamples(void)
+{
+	HistoryInfoVect historyInfoVect = createHistoryInfoVect();
+	swap(historyInfoVect[0], historyInfoVect[4]);
+	HistoryDownsampler downsampler(HistoryDownsampler::FUNC_LAST,
+	                               10, 1000);
+	vector<Point> points;
+	cppcut_assert_equal(true, downsampler.run(historyInfoVect, points));
+	cppcut_assert_equal(static_cast<size_t>(2), points.size());
+	cppcut_assert_equal(3.0, points[0].value);
+	cppcut_assert_equal(4.5, points[1].value);
+}
+
+void test_textValue(void)
+{
+	HistoryInfoVect historyInfoVect = createHistoryInfoVect();
+	addHistoryInfo(historyInfoVect, 1030, "running");
+	HistoryDownsampler downsampler(HistoryDownsampler::FUNC_AVG, 10, 1000);
+	vector<Point> points;
+	cppcut_assert_equal(false, downsampler.run(historyInfoVect, points));
+	cppcut_assert_equal(true, points.empty());
+}
+
+} // namespace testHistoryDownsampler
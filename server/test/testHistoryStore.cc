@@ -0,0 +1,269 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppcutter.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <glib.h>
+#include <StringUtils.h>
+#include "HistoryStore.h"
+
+using namespace std;
+using namespace mlpl;
+
+namespace testHistoryStore {
+
+static const ServerIdType TEST_SERVER_ID = 3;
+static const char *TEST_ITEM_ID = "item/1";
+static string storeDir;
+
+static HistoryInfo createHistoryInfo(const time_t &sec, const long &nsec,
+                                     const string &value)
+{
+	HistoryInfo historyInfo;
+	historyInfo.serverId      = TEST_SERVER_ID;
+	historyInfo.itemId        = TEST_ITEM_ID;
+	historyInfo.value         = value;
+	historyInfo.clock.tv_sec  = sec;
+	historyInfo.clock.tv_nsec = nsec;
+	return historyInfo;
+}
+
+static void assertHistoryInfoVect(const HistoryInfoVect &expected,
+                                  const HistoryInfoVect &actual)
+{
+	cppcut_assert_equal(expected.size(), actual.size());
+	for (size_t i = 0; i < expected.size(); i++) {
+		cut_trace(cppcut_assert_equal(expected[i].value,
+		                              actual[i].value));
+		cppcut_assert_equal(expected[i].clock.tv_sec,
+		                    actual[i].clock.tv_sec);
+		cppcut_assert_equal(expected[i].clock.tv_nsec,
+		                    actual[i].clock.tv_nsec);
+		cppcut_assert_equal(expected[i].serverId, actual[i].serverId);
+		cppcut_assert_equal(expected[i].itemId, actual[i].itemId);
+	}
+}
+
+static string getHistoryFilePath(void)
+{
+	return StringUtils::sprintf("%s/%" FMT_SERVER_ID "/item%%2F1.hist",
+	                            storeDir.c_str(), TEST_SERVER_ID);
+}
+
+static void removeDirectory(const string &path)
+{
+	GDir *dir = g_dir_open(path.c_str(), 0, NULL);
+	if (!dir)
+		return;
+	const gchar *name;
+	while ((name = g_dir_read_name(dir))) {
+		const string child = path + "/" + name;
+		if (g_file_test(child.c_str(), G_FILE_TEST_IS_DIR))
+			removeDirectory(child);
+		else
+			unlink(child.c_str());
+	}
+	g_dir_close(dir);
+	rmdir(path.c_str());
+}
+
+void cut_setup(void)
+{
+	storeDir = StringUtils::sprintf("/tmp/hatohol-test-history-%d",
+					getpid());
+}
+
+void cut_teardown(void)
+{
+	removeDirectory(storeDir);
+}
+
+// ---------------------------------------------------------------------------
+// Test cases
+// ---------------------------------------------------------------------------
+void test_disabled(void)
+{
+	HistoryStore store("");
+	cppcut_assert_equal(false, store.isEnabled());
+	HistoryInfoVect historyInfoVect;
+	historyInfoVect.push_back(createHistoryInfo(1000, 0, "1"));
+	cppcut_assert_equal(false, store.add(historyInfoVect));
+}
+
+void test_addAndGetDecimals(void)
+{
+	HistoryInfoVect expected;
+	const char *values[] = {
+	  "0.0500", "0.0500", "-12.2500", "3.1416", "100000.0000", "0.0000"};
+	const size_t numValues = sizeof(values) / sizeof(values[0]);
+	for (size_t i = 0; i < numValues; i++) {
+		expected.push_back(
+		  createHistoryInfo(1000 + i * 60, i * 1000, values[i]));
+	}
+	// Integers are stored in another block.
+	expected.push_back(createHistoryInfo(2000, 0, "-7"));
+	expected.push_back(createHistoryInfo(2060, 0, "9223372036"));
+
+	HistoryStore store(storeDir);
+	cppcut_assert_equal(true, store.add(expected));
+
+	HistoryInfoVect actual;
+	store.get(actual, TEST_SERVER_ID, TEST_ITEM_ID, 0, 3000);
+	assertHistoryInfoVect(expected, actual);
+
+	HistoryStore::Stat stat;
+	store.getStat(stat);
+	cppcut_assert_equal(static_cast<uint64_t>(expected.size()),
+	                    stat.numStoredSamples);
+	cppcut_assert_equal(static_cast<uint64_t>(2), stat.numStoredBlocks);
+}
+
+void test_addAndGetStrings(void)
+{
+	HistoryInfoVect expected;
+	expected.push_back(createHistoryInfo(1000, 0, "Running"));
+	expected.push_back(createHistoryInfo(1001, 0, ""));
+	expected.push_back(createHistoryInfo(1002, 0, "1.5e3"));
+	expected.push_back(createHistoryInfo(1003, 0, "multi\nline"));
+
+	HistoryStore store(storeDir);
+	cppcut_assert_equal(true, store.add(expected));
+
+	HistoryInfoVect actual;
+	store.get(actual, TEST_SERVER_ID, TEST_ITEM_ID, 1000, 1003);
+	assertHistoryInfoVect(expected, actual);
+}
+
+void test_getInRange(void)
+{
+	HistoryInfoVect historyInfoVect;
+	for (size_t i = 0; i < 10; i++) {
+		historyInfoVect.push_back(createHistoryInfo(
+		  1000 + i, 500000000,
+		  StringUtils::sprintf("%zd", i)));
+	}
+	HistoryStore store(storeDir);
+	cppcut_assert_equal(true, store.add(historyInfoVect));
+
+	HistoryInfoVect expected(historyInfoVect.begin() + 3,
+	                         historyInfoVect.begin() + 6);
+	HistoryInfoVect actual;
+	store.get(actual, TEST_SERVER_ID, TEST_ITEM_ID, 1003, 1005);
+	assertHistoryInfoVect(expected, actual);
+}
+
+void test_laterSampleWins(void)
+{
+	HistoryStore store(storeDir);
+	HistoryInfoVect first;
+	first.push_back(createHistoryInfo(1000, 0, "1"));
+	first.push_back(createHistoryInfo(1001, 0, "2"));
+	cppcut_assert_equal(true, store.add(first));
+	HistoryInfoVect second;
+	second.push_back(createHistoryInfo(1001, 0, "3"));
+	cppcut_assert_equal(true, store.add(second));
+
+	HistoryInfoVect expected;
+	expected.push_back(first[0]);
+	expected.push_back(second[0]);
+	HistoryInfoVect actual;
+	store.get(actual, TEST_SERVER_ID, TEST_ITEM_ID, 1000, 1001);
+	assertHistoryInfoVect(expected, actual);
+}
+
+void test_findGap(void)
+{
+	HistoryStore store(storeDir);
+	HistoryInfoVect historyInfoVect;
+	historyInfoVect.push_back(createHistoryInfo(1100, 0, "1"));
+	cppcut_assert_equal(true, store.addFetched(
+	  TEST_SERVER_ID, TEST_ITEM_ID, 1000, 1199, historyInfoVect));
+
+	time_t gapBegin = 0, gapEnd = 0;
+	cppcut_assert_equal(false, store.findGap(
+	  TEST_SERVER_ID, TEST_ITEM_ID, 1000, 1199, gapBegin, gapEnd));
+	cppcut_assert_equal(true, store.findGap(
+	  TEST_SERVER_ID, TEST_ITEM_ID, 900, 1299, gapBegin, gapEnd));
+	cppcut_assert_equal(static_cast<time_t>(900), gapBegin);
+	cppcut_assert_equal(static_cast<time_t>(1299), gapEnd);
+	cppcut_assert_equal(true, store.findGap(
+	  TEST_SERVER_ID, TEST_ITEM_ID, 1100, 1299, gapBegin, gapEnd));
+	cppcut_assert_equal(static_cast<time_t>(1200), gapBegin);
+	cppcut_assert_equal(static_cast<time_t>(1299), gapEnd);
+
+	// Adjacent ranges are merged.
+	cppcut_assert_equal(true, store.addFetched(
+	  TEST_SERVER_ID, TEST_ITEM_ID, 1200, 1299, historyInfoVect));
+	cppcut_assert_equal(false, store.findGap(
+	  TEST_SERVER_ID, TEST_ITEM_ID, 1000, 1299, gapBegin, gapEnd));
+}
+
+void test_reopen(void)
+{
+	HistoryInfoVect expected;
+	expected.push_back(createHistoryInfo(1000, 0, "1.25"));
+	expected.push_back(createHistoryInfo(1060, 0, "1.50"));
+	{
+		HistoryStore store(storeDir);
+		cppcut_assert_equal(true, store.addFetched(
+		  TEST_SERVER_ID, TEST_ITEM_ID, 1000, 1099, expected));
+	}
+
+	HistoryStore store(storeDir);
+	HistoryInfoVect actual;
+	store.get(actual, TEST_SERVER_ID, TEST_ITEM_ID, 1000, 1099);
+	assertHistoryInfoVect(expected, actual);
+	time_t gapBegin, gapEnd;
+	cppcut_assert_equal(false, store.findGap(
+	  TEST_SERVER_ID, TEST_ITEM_ID, 1000, 1099, gapBegin, gapEnd));
+}
+
+void test_discardBrokenTail(void)
+{
+	HistoryInfoVect expected;
+	expected.push_back(createHistoryInfo(1000, 0, "1"));
+	HistoryInfoVect broken;
+	broken.push_back(createHistoryInfo(2000, 0, "2"));
+	{
+		HistoryStore store(storeDir);
+		cppcut_assert_equal(true, store.add(expected));
+		cppcut_assert_equal(true, store.add(broken));
+	}
+
+	// Emulate a crash in the middle of the second block.
+	struct stat st;
+	const string path = getHistoryFilePath();
+	cppcut_assert_equal(0, stat(path.c_str(), &st));
+	cppcut_assert_equal(0, truncate(path.c_str(), st.st_size - 1));
+
+	HistoryStore store(storeDir);
+	HistoryInfoVect actual;
+	store.get(actual, TEST_SERVER_ID, TEST_ITEM_ID, 0, 3000);
+	assertHistoryInfoVect(expected, actual);
+
+	// New samples are appended after the last valid block.
+	cppcut_assert_equal(true, store.add(broken));
+	expected.push_back(broken[0]);
+	actual.clear();
+	store.get(actual, TEST_SERVER_ID, TEST_ITEM_ID, 0, 3000);
+	assertHistoryInfoVect(expected, actual);
+}
+
+} // namespace testHistoryStore
@@ -539,6 +539,65 @@ void test_eventQueryOptionGetEndTime(void)
 	cppcut_assert_equal(expected.tv_nsec, actual.tv_nsec);
 }
 
+void data_eventQueryOptionWithCursorSortUnifiedId(void)
+{
+	prepareTestDataExcludeDefunctServers();
+}
+
+void test_eventQueryOptionWithCursorSortUnifiedId(gconstpointer data)
+{
+	timespec time = { 123, 456 };
+	EventsQueryOption option(USER_ID_SYSTEM);
+	option.setSortType(EventsQueryOption::SORT_UNIFIED_ID,
+			   DataQueryOption::SORT_DESCENDING);
+	option.setCursor(time, 789);
+	cppcut_assert_equal(true, option.hasCursor());
+	string expected = "unified_id<789";
+	fixupForFilteringDefunctServer(data, expected, option);
+	cppcut_assert_equal(expected, option.getCondition());
+}
+
+void data_eventQueryOptionWithCursorSortTime(void)
+{
+	prepareTestDataExcludeDefunctServers();
+}
+
+void test_eventQueryOptionWithCursorSortTime(gconstpointer data)
+{
+	timespec time = { 123, 456 };
+	EventsQueryOption option(USER_ID_SYSTEM);
+	option.setSortType(EventsQueryOption::SORT_TIME,
+			   DataQueryOption::SORT_ASCENDING);
+	option.setCursor(time, 789);
+	string expected =
+	  "(time_sec>=123 AND (time_sec>123 OR (time_sec=123 AND "
+	  "(time_ns>456 OR (time_ns=456 AND unified_id>789)))))";
+	fixupForFilteringDefunctServer(data, expected, option);
+	cppcut_assert_equal(expected, option.getCondition());
+}
+
+void test_eventQueryOptionWithCursorWithoutSortDirection(void)
+{
+	timespec time = { 123, 456 };
+	EventsQueryOption option(USER_ID_SYSTEM);
+	option.setSortType(EventsQueryOption::SORT_TIME,
+			   DataQueryOption::SORT_DONT_CARE);
+	option.setCursor(time, 789);
+	bool gotException = false;
+	try {
+		option.getCondition();
+	} catch (const HatoholException &e) {
+		gotException = true;
+	}
+	cppcut_assert_equal(true, gotException);
+}
+
+void test_eventQueryOptionWithoutCursor(void)
+{
+	EventsQueryOption option(USER_ID_SYSTEM);
+	cppcut_assert_equal(false, option.hasCursor());
+}
+
 //
 // ItemsQueryOption
 //
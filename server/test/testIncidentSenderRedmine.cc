@@ -455,4 +455,48 @@ void test_threadWithLimitOverErrors(void)
 	assertThread(retryLimit + 1, !shouldSuccessSending);
 }
 
+void test_threadSendEachEventOfSameTrigger(void)
+{
+	loadTestDBTablesConfig();
+	const IncidentTrackerInfo tracker = testIncidentTrackerInfo[2];
+	const EventInfo &event = testEventInfo[0];
+	EventInfo repeatedEvent = event;
+	repeatedEvent.id = event.id + "-repeated";
+	repeatedEvent.unifiedId = event.unifiedId + 1;
+	TestRedmineSender sender(tracker);
+	CallbackData cbData[2];
+	g_redmineEmulator.addUser(tracker.userName, tracker.password);
+
+	sender.queue(event, statusCallback, (void*)&cbData[0]);
+	sender.queue(repeatedEvent, statusCallback, (void*)&cbData[1]);
+	sender.start();
+	while (!sender.isIdling())
+		usleep(100 * 1000);
+	sender.exitSync();
+
+	// An incident belongs to one event. So an event isn't merged into
+	// another one of the same trigger.
+	cppcut_assert_equal(true, cbData[0].succeeded);
+	cppcut_assert_equal(true, cbData[1].succeeded);
+	IncidentSender::Stat stat;
+	sender.getStat(stat);
+	cppcut_assert_equal(static_cast<uint64_t>(2), stat.numSends);
+	cppcut_assert_equal(static_cast<uint64_t>(0), stat.numMergedJobs);
+	cppcut_assert_equal(static_cast<uint64_t>(2), stat.numSucceededJobs);
+	cppcut_assert_equal(static_cast<size_t>(0), stat.queueDepth);
+
+	// The events are sent in the queued order and have their own issue.
+	const RedmineIssue &issue = g_redmineEmulator.getLastIssue();
+	IncidentInfo incident;
+	makeExpectedIncidentInfo(incident, tracker, repeatedEvent, issue);
+	ThreadLocalDBCache cache;
+	DBAgent &dbAgent = cache.getMonitoring().getDBAgent();
+	string statement = StringUtils::sprintf(
+	  "select * from incidents where event_id='%s';",
+	  repeatedEvent.id.c_str());
+	assertDBContent(&dbAgent, statement, makeIncidentOutput(incident));
+	statement = "select count(distinct identifier) from incidents;";
+	assertDBContent(&dbAgent, statement, "2");
+}
+
 }
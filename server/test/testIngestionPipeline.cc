@@ -0,0 +1,441 @@
+/*
+ * Copyright (C) 2015-2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppcutter.h>
+#include <unistd.h>
+#include <glib.h>
+#include <thread>
+#include <Mutex.h>
+#include <SimpleSemaphore.h>
+#include <StringUtils.h>
+#include <SmartTime.h>
+#include "IngestionPipeline.h"
+#include "IngestionSpool.h"
+#include "HatoholException.h"
+#include "Hatohol.h"
+#include "Helpers.h"
+#include "DBTablesTest.h"
+
+using namespace std;
+using namespace mlpl;
+
+namespace testIngestionPipeline {
+
+static const size_t RETRY_INTERVAL_MSEC = 10;
+static const char *BAD_BRIEF = "bad event";
+
+static string spoolDir;
+
+// It stores the IDs of the events instead of the DB.
+class TestPipeline : public IngestionPipeline {
+public:
+	TestPipeline(const size_t &segmentSize =
+	               IngestionSpool::DEFAULT_SEGMENT_SIZE)
+	: IngestionPipeline(new IngestionSpool(spoolDir, segmentSize),
+	                    RETRY_INTERVAL_MSEC),
+	  m_dbUnavailable(false)
+	{
+	}
+
+	virtual ~TestPipeline()
+	{
+		stop();
+	}
+
+	void setDBUnavailable(const bool &unavailable)
+	{
+		AutoMutex autoLock(&m_lock);
+		m_dbUnavailable = unavailable;
+	}
+
+	vector<EventIdType> getStoredIds(void)
+	{
+		AutoMutex autoLock(&m_lock);
+		return m_storedIds;
+	}
+
+	bool waitForStored(const size_t &numEvents)
+	{
+		SmartTime startTime(SmartTime::INIT_CURR_TIME);
+		while (getStoredIds().size() < numEvents) {
+			if (isTimedOut(startTime))
+				return false;
+			usleep(10 * 1000);
+		}
+		return true;
+	}
+
+	bool waitForQuarantined(const uint64_t &numRecords)
+	{
+		SmartTime startTime(SmartTime::INIT_CURR_TIME);
+		Stat stat;
+		for (getStat(stat); stat.numQuarantined < numRecords;
+		     getStat(stat)) {
+			if (isTimedOut(startTime))
+				return false;
+			usleep(10 * 1000);
+		}
+		return true;
+	}
+
+protected:
+	virtual void commitLists(
+	  const vector<EventInfoList *> &eventLists,
+	  const vector<const ItemInfoList *> &itemLists) override
+	{
+		AutoMutex autoLock(&m_lock);
+		if (m_dbUnavailable) {
+			THROW_HATOHOL_EXCEPTION_WITH_ERROR_CODE(
+			  HTERR_FAILED_CONNECT_MYSQL, "The DB is down.");
+		}
+		vector<EventIdType> ids;
+		for (auto eventList : eventLists) {
+			for (auto &eventInfo : *eventList) {
+				if (eventInfo.brief == BAD_BRIEF)
+					THROW_HATOHOL_EXCEPTION("A bad event.");
+				ids.push_back(eventInfo.id);
+			}
+		}
+		m_storedIds.insert(m_storedIds.end(), ids.begin(), ids.end());
+	}
+
+private:
+	static bool isTimedOut(const SmartTime &startTime)
+	{
+		SmartTime elapsed(SmartTime::INIT_CURR_TIME);
+		elapsed -= startTime;
+		return elapsed.getAsMSec() > 5000;
+	}
+
+	Mutex               m_lock;
+	bool                m_dbUnavailable;
+	vector<EventIdType> m_storedIds;
+};
+
+static EventInfoList createEventList(const EventIdType &id,
+                                     const string &brief = "")
+{
+	EventInfo eventInfo = testEventInfo[0];
+	eventInfo.unifiedId = 0;
+	eventInfo.id = id;
+	if (!brief.empty())
+		eventInfo.brief = brief;
+	EventInfoList eventList;
+	eventList.push_back(eventInfo);
+	return eventList;
+}
+
+static void removeDirectory(const string &path)
+{
+	GDir *dir = g_dir_open(path.c_str(), 0, NULL);
+	if (!dir)
+		return;
+	const gchar *name;
+	while ((name = g_dir_read_name(dir))) {
+		const string child = path + "/" + name;
+		if (g_file_test(child.c_str(), G_FILE_TEST_IS_DIR))
+			removeDirectory(child);
+		else
+			unlink(child.c_str());
+	}
+	g_dir_close(dir);
+	rmdir(path.c_str());
+}
+
+void cut_setup(void)
+{
+	hatoholInit();
+	setupTestDB();
+	spoolDir = StringUtils::sprintf("/tmp/hatohol-test-pipeline-%d",
+	                                getpid());
+}
+
+void cut_teardown(void)
+{
+	removeDirectory(spoolDir);
+}
+
+void test_instanceIsSingleton(void)
+{
+	cppcut_assert_equal(&IngestionPipeline::getInstance(),
+	                    &IngestionPipeline::getInstance());
+}
+
+void test_addEventList(void)
+{
+	IngestionPipeline &pipeline = IngestionPipeline::getInstance();
+	IngestionPipeline::Stat statBefore, statAfter;
+	pipeline.getStat(statBefore);
+
+	EventInfoList eventList;
+	for (size_t i = 0; i < 3; i++) {
+		EventInfo eventInfo = testEventInfo[i];
+		eventInfo.unifiedId = 0;
+		eventList.push_back(eventInfo);
+	}
+	cppcut_assert_equal(true, pipeline.addEventList(eventList));
+
+	// The unified IDs are set by the commit.
+	for (auto &eventInfo : eventList)
+		cppcut_assert_not_equal((UnifiedEventIdType)0,
+		                        eventInfo.unifiedId);
+	pipeline.getStat(statAfter);
+	cppcut_assert_equal(statBefore.numBatches + 1, statAfter.numBatches);
+	cppcut_assert_equal(true, statAfter.numCommits > statBefore.numCommits);
+}
+
+void test_addEventListWithCallback(void)
+{
+	struct Callback : public IngestionPipeline::CommitCallback {
+		bool            &committed;
+		SimpleSemaphore &sem;
+
+		Callback(bool &_committed, SimpleSemaphore &_sem)
+		: committed(_committed),
+		  sem(_sem)
+		{
+		}
+
+		virtual void operator()(const bool &_committed) override
+		{
+			committed = _committed;
+			sem.post();
+		}
+	};
+
+	EventInfoList *eventList = new EventInfoList();
+	for (size_t i = 0; i < 2; i++) {
+		EventInfo eventInfo = testEventInfo[i];
+		eventInfo.unifiedId = 0;
+		eventList->push_back(eventInfo);
+	}
+	bool committed = false;
+	SimpleSemaphore sem(0);
+	IngestionPipeline::getInstance().addEventList(
+	  eventList, new Callback(committed, sem));
+	sem.wait();
+	cppcut_assert_equal(true, committed);
+}
+
+void test_keepOrderOfEachServer(void)
+{
+	struct Callback : public IngestionPipeline::CommitCallback {
+		Mutex                   &lock;
+		vector<vector<size_t> > &committedSeqs;
+		SimpleSemaphore         &sem;
+		const size_t             serverIndex;
+		const size_t             seq;
+
+		Callback(Mutex &_lock, vector<vector<size_t> > &_committedSeqs,
+		         SimpleSemaphore &_sem, const size_t &_serverIndex,
+		         const size_t &_seq)
+		: lock(_lock),
+		  committedSeqs(_committedSeqs),
+		  sem(_sem),
+		  serverIndex(_serverIndex),
+		  seq(_seq)
+		{
+		}
+
+		virtual void operator()(const bool &committed) override
+		{
+			AutoMutex autoLock(&lock);
+			if (committed)
+				committedSeqs[serverIndex].push_back(seq);
+			sem.post();
+		}
+	};
+
+	// Two servers that are assigned to different writers.
+	const ServerIdType serverIds[] = {1, 2};
+	const size_t numServers = ARRAY_SIZE(serverIds);
+	const size_t numBatches = 10;
+	Mutex lock;
+	vector<vector<size_t> > committedSeqs(numServers);
+	SimpleSemaphore sem(0);
+	for (size_t seq = 0; seq < numBatches; seq++) {
+		for (size_t i = 0; i < numServers; i++) {
+			EventInfo eventInfo = testEventInfo[0];
+			eventInfo.unifiedId = 0;
+			eventInfo.serverId = serverIds[i];
+			eventInfo.id = StringUtils::sprintf("order-%zd", seq);
+			EventInfoList *eventList = new EventInfoList();
+			eventList->push_back(eventInfo);
+			IngestionPipeline::getInstance().addEventList(
+			  eventList, new Callback(lock, committedSeqs, sem,
+			                          i, seq));
+		}
+	}
+	for (size_t i = 0; i < numServers * numBatches; i++)
+		sem.wait();
+
+	for (size_t i = 0; i < numServers; i++) {
+		cppcut_assert_equal(numBatches, committedSeqs[i].size());
+		for (size_t seq = 0; seq < numBatches; seq++)
+			cppcut_assert_equal(seq, committedSeqs[i][seq]);
+	}
+}
+
+void test_commitEventList(void)
+{
+	TestPipeline pipeline;
+	EventInfoList eventList = createEventList("1");
+	cppcut_assert_equal(true, pipeline.commitEventList(eventList));
+
+	// It isn't spooled and has been stored when the call returns.
+	vector<EventIdType> storedIds = pipeline.getStoredIds();
+	cppcut_assert_equal(static_cast<size_t>(1), storedIds.size());
+	cppcut_assert_equal(EventIdType("1"), storedIds[0]);
+	IngestionPipeline::Stat stat;
+	pipeline.getStat(stat);
+	cppcut_assert_equal(static_cast<uint64_t>(0), stat.numSpooled);
+}
+
+void test_addEmptyListDoesNotCommit(void)
+{
+	IngestionPipeline &pipeline = IngestionPipeline::getInstance();
+	IngestionPipeline::Stat statBefore, statAfter;
+	pipeline.getStat(statBefore);
+
+	EventInfoList eventList;
+	ItemInfoList itemList;
+	cppcut_assert_equal(true, pipeline.addEventList(eventList));
+	cppcut_assert_equal(true, pipeline.addItemList(itemList));
+	pipeline.getStat(statAfter);
+	cppcut_assert_equal(statBefore.numBatches, statAfter.numBatches);
+}
+
+void test_drainSpooledEvents(void)
+{
+	TestPipeline pipeline;
+	EventInfoList eventList = createEventList("1");
+	cppcut_assert_equal(true, pipeline.addEventList(eventList));
+	cppcut_assert_equal(true, pipeline.waitForStored(1));
+
+	IngestionPipeline::Stat stat;
+	pipeline.getStat(stat);
+	cppcut_assert_equal(static_cast<uint64_t>(1), stat.numSpooled);
+	cppcut_assert_equal(static_cast<uint64_t>(0), stat.numQuarantined);
+}
+
+void test_quarantineBadRecord(void)
+{
+	{
+		TestPipeline pipeline;
+		EventInfoList badList = createEventList("bad", BAD_BRIEF);
+		EventInfoList goodList = createEventList("good");
+		cppcut_assert_equal(true, pipeline.addEventList(badList));
+		cppcut_assert_equal(true, pipeline.addEventList(goodList));
+		cppcut_assert_equal(true, pipeline.waitForQuarantined(1));
+		cppcut_assert_equal(true, pipeline.waitForStored(1));
+
+		// The good one may be stored again when the records are
+		// retried one by one.
+		for (auto &id : pipeline.getStoredIds())
+			cppcut_assert_equal(EventIdType("good"), id);
+	}
+
+	IngestionSpool quarantine(spoolDir + "/quarantine");
+	cppcut_assert_equal(true, quarantine.open());
+	IngestionSpool::Record record;
+	cppcut_assert_equal(true, quarantine.read(record));
+	cppcut_assert_equal(static_cast<size_t>(1), record.eventList.size());
+	cppcut_assert_equal(EventIdType("bad"),
+	                    record.eventList.front().id);
+}
+
+void test_retryWhileDBIsUnavailable(void)
+{
+	TestPipeline pipeline;
+	pipeline.setDBUnavailable(true);
+	EventInfoList eventList = createEventList("1");
+	cppcut_assert_equal(true, pipeline.addEventList(eventList));
+	// Much longer than the retry interval times the maximum attempts.
+	usleep(200 * 1000);
+	cppcut_assert_equal(static_cast<size_t>(0),
+	                    pipeline.getStoredIds().size());
+
+	pipeline.setDBUnavailable(false);
+	cppcut_assert_equal(true, pipeline.waitForStored(1));
+	IngestionPipeline::Stat stat;
+	pipeline.getStat(stat);
+	cppcut_assert_equal(static_cast<uint64_t>(0), stat.numQuarantined);
+}
+
+void test_unspooledListDoesNotOvertakeSpooled(void)
+{
+	const size_t segmentSize = 4096;
+	TestPipeline pipeline(segmentSize);
+	pipeline.setDBUnavailable(true);
+	EventInfoList firstList = createEventList("first");
+	cppcut_assert_equal(true, pipeline.addEventList(firstList));
+
+	// It's too large for a segment, so it can't be spooled.
+	EventInfoList secondList =
+	  createEventList("second", string(segmentSize, 'x'));
+	bool secondAdded = false;
+	thread secondThread([&] {
+		secondAdded = pipeline.addEventList(secondList);
+	});
+	usleep(100 * 1000);
+	cppcut_assert_equal(static_cast<size_t>(0),
+	                    pipeline.getStoredIds().size());
+
+	pipeline.setDBUnavailable(false);
+	secondThread.join();
+	cppcut_assert_equal(true, secondAdded);
+	vector<EventIdType> storedIds = pipeline.getStoredIds();
+	cppcut_assert_equal(static_cast<size_t>(2), storedIds.size());
+	cppcut_assert_equal(EventIdType("first"), storedIds[0]);
+	cppcut_assert_equal(EventIdType("second"), storedIds[1]);
+}
+
+void test_fetchReplyIsCommittedBeforeReturn(void)
+{
+	TestPipeline pipeline;
+	pipeline.setDBUnavailable(true);
+	EventInfoList spooledList = createEventList("spooled");
+	cppcut_assert_equal(true, pipeline.addEventList(spooledList));
+
+	// A reply to a fetch request isn't spooled, and is stored after the
+	// spooled ones.
+	EventInfoList fetchedList = createEventList("fetched");
+	bool fetchedAdded = false;
+	thread fetchThread([&] {
+		fetchedAdded = pipeline.addEventList(fetchedList, true);
+	});
+	usleep(100 * 1000);
+	cppcut_assert_equal(static_cast<size_t>(0),
+	                    pipeline.getStoredIds().size());
+
+	pipeline.setDBUnavailable(false);
+	fetchThread.join();
+	cppcut_assert_equal(true, fetchedAdded);
+	// It has been stored when the addition returns.
+	vector<EventIdType> storedIds = pipeline.getStoredIds();
+	cppcut_assert_equal(static_cast<size_t>(2), storedIds.size());
+	cppcut_assert_equal(EventIdType("spooled"), storedIds[0]);
+	cppcut_assert_equal(EventIdType("fetched"), storedIds[1]);
+
+	IngestionPipeline::Stat stat;
+	pipeline.getStat(stat);
+	cppcut_assert_equal(static_cast<uint64_t>(1), stat.numSpooled);
+}
+
+} // namespace testIngestionPipeline
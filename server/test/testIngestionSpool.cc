@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppcutter.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <glib.h>
+#include <StringUtils.h>
+#include "IngestionSpool.h"
+#include "DBTablesTest.h"
+
+using namespace std;
+using namespace mlpl;
+
+namespace testIngestionSpool {
+
+static string spoolDir;
+
+static EventInfoList createEventList(const size_t &index)
+{
+	EventInfoList eventList;
+	EventInfo event = testEventInfo[index];
+	eventList.push_back(event);
+	return eventList;
+}
+
+static string getSegmentPath(const uint64_t &seq)
+{
+	return spoolDir + "/" +
+	       StringUtils::sprintf("segment-%016" PRIx64 ".spool", seq);
+}
+
+void cut_setup(void)
+{
+	spoolDir = StringUtils::sprintf("/tmp/hatohol-test-spool-%d",
+					getpid());
+}
+
+void cut_teardown(void)
+{
+	GDir *dir = g_dir_open(spoolDir.c_str(), 0, NULL);
+	if (!dir)
+		return;
+	const gchar *name;
+	while ((name = g_dir_read_name(dir)))
+		unlink((spoolDir + "/" + name).c_str());
+	g_dir_close(dir);
+	rmdir(spoolDir.c_str());
+}
+
+// ---------------------------------------------------------------------------
+// Test cases
+// ---------------------------------------------------------------------------
+void test_appendAndRead(void)
+{
+	IngestionSpool spool(spoolDir);
+	cppcut_assert_equal(true, spool.open());
+	cppcut_assert_equal(true, spool.append(createEventList(0)));
+	ItemInfoList itemList;
+	itemList.push_back(testItemInfo[0]);
+	cppcut_assert_equal(true, spool.append(itemList));
+
+	IngestionSpool::Record record;
+	cppcut_assert_equal(true, spool.read(record));
+	cppcut_assert_equal(IngestionSpool::RECORD_EVENTS, record.type);
+	cppcut_assert_equal(static_cast<size_t>(1), record.eventList.size());
+	const EventInfo &expectedEvent = testEventInfo[0];
+	const EventInfo &actualEvent = record.eventList.front();
+	cppcut_assert_equal(expectedEvent.serverId, actualEvent.serverId);
+	cppcut_assert_equal(expectedEvent.id, actualEvent.id);
+	cppcut_assert_equal(expectedEvent.time.tv_sec, actualEvent.time.tv_sec);
+	cppcut_assert_equal(expectedEvent.triggerId, actualEvent.triggerId);
+	cppcut_assert_equal(expectedEvent.severity, actualEvent.severity);
+	cppcut_assert_equal(expectedEvent.hostIdInServer,
+			    actualEvent.hostIdInServer);
+	cppcut_assert_equal(expectedEvent.brief, actualEvent.brief);
+
+	cppcut_assert_equal(true, spool.read(record));
+	cppcut_assert_equal(IngestionSpool::RECORD_ITEMS, record.type);
+	cppcut_assert_equal(static_cast<size_t>(1), record.itemList.size());
+	const ItemInfo &expectedItem = testItemInfo[0];
+	const ItemInfo &actualItem = record.itemList.front();
+	cppcut_assert_equal(expectedItem.id, actualItem.id);
+	cppcut_assert_equal(expectedItem.lastValue, actualItem.lastValue);
+	cppcut_assert_equal(expectedItem.valueType, actualItem.valueType);
+
+	cppcut_assert_equal(false, spool.read(record));
+}
+
+void test_reopenAfterCheckpoint(void)
+{
+	IngestionSpool::Record record;
+	{
+		IngestionSpool spool(spoolDir);
+		cppcut_assert_equal(true, spool.open());
+		for (size_t i = 0; i < 3; i++)
+			spool.append(createEventList(i));
+		cppcut_assert_equal(true, spool.read(record));
+		cppcut_assert_equal(true, spool.read(record));
+		cppcut_assert_equal(true, spool.checkpoint(record.next));
+	}
+
+	IngestionSpool spool(spoolDir);
+	cppcut_assert_equal(true, spool.open());
+	cppcut_assert_equal(true, spool.read(record));
+	cppcut_assert_equal(testEventInfo[2].id, record.eventList.front().id);
+	cppcut_assert_equal(false, spool.read(record));
+}
+
+void test_rewind(void)
+{
+	IngestionSpool spool(spoolDir);
+	cppcut_assert_equal(true, spool.open());
+	spool.append(createEventList(0));
+	spool.append(createEventList(1));
+
+	IngestionSpool::Record record;
+	cppcut_assert_equal(true, spool.read(record));
+	cppcut_assert_equal(true, spool.checkpoint(record.next));
+	cppcut_assert_equal(true, spool.read(record));
+	spool.rewind();
+	cppcut_assert_equal(true, spool.read(record));
+	cppcut_assert_equal(testEventInfo[1].id, record.eventList.front().id);
+}
+
+void test_rotateAndReject(void)
+{
+	const size_t maxNumSegments = 2;
+	IngestionSpool spool(spoolDir, 4096, maxNumSegments);
+	cppcut_assert_equal(true, spool.open());
+	size_t numAppended = 0;
+	while (spool.append(createEventList(numAppended % NumTestEventInfo)))
+		numAppended++;
+
+	IngestionSpool::Stat stat;
+	spool.getStat(stat);
+	cppcut_assert_equal(maxNumSegments, stat.numSegments);
+	cppcut_assert_equal(static_cast<uint64_t>(1), stat.numRejected);
+
+	IngestionSpool::Record record;
+	size_t numRead = 0;
+	while (spool.read(record))
+		numRead++;
+	cppcut_assert_equal(numAppended, numRead);
+
+	// The first segment is removed and the space can be used again.
+	cppcut_assert_equal(true, spool.checkpoint(record.next));
+	cppcut_assert_equal(false, g_file_test(getSegmentPath(1).c_str(),
+					       G_FILE_TEST_EXISTS));
+	cppcut_assert_equal(true, spool.append(createEventList(0)));
+}
+
+void test_rejectWhenSegmentCannotBeAllocated(void)
+{
+	const size_t segmentSize = 4096;
+	IngestionSpool spool(spoolDir, segmentSize);
+	cppcut_assert_equal(true, spool.open());
+
+	// The next segment can't be allocated as on a full disk.
+	struct rlimit savedLimit;
+	cppcut_assert_equal(0, getrlimit(RLIMIT_FSIZE, &savedLimit));
+	struct rlimit limit = savedLimit;
+	limit.rlim_cur = segmentSize - 1;
+	sighandler_t savedHandler = signal(SIGXFSZ, SIG_IGN);
+	cppcut_assert_equal(0, setrlimit(RLIMIT_FSIZE, &limit));
+	size_t numAppended = 0;
+	while (spool.append(createEventList(numAppended % NumTestEventInfo)))
+		numAppended++;
+	setrlimit(RLIMIT_FSIZE, &savedLimit);
+	signal(SIGXFSZ, savedHandler);
+
+	IngestionSpool::Stat stat;
+	spool.getStat(stat);
+	cppcut_assert_equal(static_cast<size_t>(1), stat.numSegments);
+	cppcut_assert_equal(static_cast<uint64_t>(1), stat.numRejected);
+	cppcut_assert_equal(false, g_file_test(getSegmentPath(2).c_str(),
+					       G_FILE_TEST_EXISTS));
+
+	// It's appended again when the space is available.
+	cppcut_assert_equal(true, spool.append(createEventList(0)));
+	IngestionSpool::Record record;
+	size_t numRead = 0;
+	while (spool.read(record))
+		numRead++;
+	cppcut_assert_equal(numAppended + 1, numRead);
+}
+
+void test_discardBrokenTail(void)
+{
+	IngestionSpool::Record record;
+	{
+		IngestionSpool spool(spoolDir);
+		cppcut_assert_equal(true, spool.open());
+		spool.append(createEventList(0));
+		spool.append(createEventList(1));
+		cppcut_assert_equal(true, spool.read(record));
+	}
+
+	// Break the payload of the second record.
+	const int fd = open(getSegmentPath(1).c_str(), O_RDWR);
+	cppcut_assert_equal(true, fd >= 0);
+	const char garbage = 0x55;
+	cppcut_assert_equal(static_cast<ssize_t>(1),
+			    pwrite(fd, &garbage, 1, record.next.offset + 16));
+	close(fd);
+
+	IngestionSpool spool(spoolDir);
+	cppcut_assert_equal(true, spool.open());
+	cppcut_assert_equal(true, spool.read(record));
+	cppcut_assert_equal(testEventInfo[0].id, record.eventList.front().id);
+	cppcut_assert_equal(false, spool.read(record));
+	// A record can be appended after the valid ones.
+	cppcut_assert_equal(true, spool.append(createEventList(2)));
+	cppcut_assert_equal(true, spool.read(record));
+	cppcut_assert_equal(testEventInfo[2].id, record.eventList.front().id);
+}
+
+} // namespace testIngestionSpool
@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppcutter.h>
+#include "Hatohol.h"
+#include "ItemFetchWorker.h"
+#include "DataStoreFake.h"
+
+using namespace std;
+
+namespace testItemFetchWorker {
+
+class TestDataStore : public DataStoreFake {
+public:
+	size_t               numFetches;
+	LocalHostIdVector    lastHostIds;
+	bool                 autoComplete;
+	vector<Closure0 *>   closures;
+
+	TestDataStore(const MonitoringServerInfo &serverInfo)
+	: DataStoreFake(serverInfo, false),
+	  numFetches(0),
+	  autoComplete(true)
+	{
+	}
+
+	virtual bool isFetchItemsSupported(void) override
+	{
+		return true;
+	}
+
+	virtual bool startOnDemandFetchItems(
+	  const LocalHostIdVector &hostIds, Closure0 *closure) override
+	{
+		numFetches++;
+		lastHostIds = hostIds;
+		closures.push_back(closure);
+		if (autoComplete)
+			completeFetches();
+		return true;
+	}
+
+	void completeFetches(void)
+	{
+		vector<Closure0 *> completed;
+		completed.swap(closures);
+		for (auto closure : completed) {
+			(*closure)();
+			delete closure;
+		}
+	}
+};
+
+class TestItemFetchWorker : public ItemFetchWorker {
+public:
+	vector<TestDataStore *> dataStores;
+
+	virtual ~TestItemFetchWorker()
+	{
+		for (auto dataStore : dataStores)
+			dataStore->unref();
+	}
+
+	TestDataStore *addDataStore(const ServerIdType &serverId)
+	{
+		MonitoringServerInfo serverInfo;
+		MonitoringServerInfo::initialize(serverInfo);
+		serverInfo.id = serverId;
+		TestDataStore *dataStore = new TestDataStore(serverInfo);
+		dataStores.push_back(dataStore);
+		return dataStore;
+	}
+
+	void removeDataStore(const ServerIdType &serverId)
+	{
+		auto it = dataStores.begin();
+		for (; it != dataStores.end(); ++it) {
+			if ((*it)->getMonitoringServerInfo().id != serverId)
+				continue;
+			(*it)->unref();
+			dataStores.erase(it);
+			return;
+		}
+	}
+
+protected:
+	virtual DataStoreVector getDataStoreVector(void) override
+	{
+		DataStoreVector vect;
+		for (auto dataStore : dataStores) {
+			dataStore->ref();
+			vect.push_back(dataStore);
+		}
+		return vect;
+	}
+};
+
+struct CountingClosure : public Closure0 {
+	size_t &count;
+
+	CountingClosure(size_t &_count)
+	: count(_count)
+	{
+	}
+
+	virtual void operator()(void) override
+	{
+		count++;
+	}
+};
+
+static const timespec NO_INTERVAL = {0, 0};
+
+void cut_setup(void)
+{
+	hatoholInit();
+}
+
+// ---------------------------------------------------------------------------
+// Test cases
+// ---------------------------------------------------------------------------
+void test_freshTargetIsNotFetched(void)
+{
+	TestItemFetchWorker worker;
+	TestDataStore *dataStore = worker.addDataStore(1);
+	cppcut_assert_equal(true, worker.updateIsNeeded(1));
+	cppcut_assert_equal(true, worker.fetch(1));
+	cppcut_assert_equal(false, worker.updateIsNeeded(1));
+	cppcut_assert_equal(false, worker.fetch(1));
+	cppcut_assert_equal((size_t)1, dataStore->numFetches);
+}
+
+void test_setMinUpdateInterval(void)
+{
+	TestItemFetchWorker worker;
+	TestDataStore *dataStore = worker.addDataStore(1);
+	worker.setMinUpdateInterval(NO_INTERVAL);
+	cppcut_assert_equal(true, worker.fetch(1));
+	cppcut_assert_equal(true, worker.updateIsNeeded(1));
+	cppcut_assert_equal(true, worker.fetch(1));
+	cppcut_assert_equal((size_t)2, dataStore->numFetches);
+
+	worker.setMinUpdateInterval(
+	  ItemFetchWorker::DEFAULT_MIN_UPDATE_INTERVAL);
+	cppcut_assert_equal(false, worker.fetch(1));
+	cppcut_assert_equal((size_t)2, dataStore->numFetches);
+}
+
+void test_serverFetchMakesHostsFresh(void)
+{
+	TestItemFetchWorker worker;
+	TestDataStore *dataStore = worker.addDataStore(1);
+	cppcut_assert_equal(true, worker.fetch(1));
+	cppcut_assert_equal(false, worker.fetch(1, "10"));
+	cppcut_assert_equal((size_t)1, dataStore->numFetches);
+}
+
+void test_hostFetchDoesntMakeServerFresh(void)
+{
+	TestItemFetchWorker worker;
+	TestDataStore *dataStore = worker.addDataStore(1);
+	cppcut_assert_equal(true, worker.fetch(1, "10"));
+	cppcut_assert_equal((size_t)1, dataStore->lastHostIds.size());
+	cppcut_assert_equal(string("10"), dataStore->lastHostIds[0]);
+	cppcut_assert_equal(false, worker.updateIsNeeded(1, "10"));
+	cppcut_assert_equal(true, worker.updateIsNeeded(1, "20"));
+	cppcut_assert_equal(true, worker.updateIsNeeded(1));
+
+	cppcut_assert_equal(true, worker.fetch(1));
+	cppcut_assert_equal((size_t)2, dataStore->numFetches);
+	cppcut_assert_equal(true, dataStore->lastHostIds.empty());
+}
+
+void test_onlyStaleServersAreFetched(void)
+{
+	TestItemFetchWorker worker;
+	TestDataStore *dataStore1 = worker.addDataStore(1);
+	TestDataStore *dataStore2 = worker.addDataStore(2);
+	cppcut_assert_equal(true, worker.fetch(1));
+	cppcut_assert_equal(true, worker.fetch(ALL_SERVERS));
+	cppcut_assert_equal((size_t)1, dataStore1->numFetches);
+	cppcut_assert_equal((size_t)1, dataStore2->numFetches);
+	cppcut_assert_equal(false, worker.fetch(ALL_SERVERS));
+}
+
+void test_joinFetchingTarget(void)
+{
+	TestItemFetchWorker worker;
+	TestDataStore *dataStore = worker.addDataStore(1);
+	dataStore->autoComplete = false;
+	ItemsQueryOption option(USER_ID_SYSTEM);
+	option.setTargetServerId(1);
+	size_t numCalls = 0;
+	cppcut_assert_equal(
+	  true, worker.start(option, new CountingClosure(numCalls)));
+	cppcut_assert_equal(
+	  true, worker.start(option, new CountingClosure(numCalls)));
+	cppcut_assert_equal((size_t)1, dataStore->numFetches);
+	cppcut_assert_equal((size_t)0, numCalls);
+
+	dataStore->completeFetches();
+	cppcut_assert_equal((size_t)2, numCalls);
+}
+
+void test_slowServerDoesntBlockOthers(void)
+{
+	TestItemFetchWorker worker;
+	TestDataStore *slowDataStore = worker.addDataStore(1);
+	slowDataStore->autoComplete = false;
+	worker.addDataStore(2);
+	ItemsQueryOption option(USER_ID_SYSTEM);
+	option.setTargetServerId(1);
+	size_t numCalls = 0;
+	cppcut_assert_equal(
+	  true, worker.start(option, new CountingClosure(numCalls)));
+
+	cppcut_assert_equal(true, worker.fetch(2));
+	cppcut_assert_equal((size_t)0, numCalls);
+	slowDataStore->completeFetches();
+	cppcut_assert_equal((size_t)1, numCalls);
+}
+
+void test_evictTargetsOfRemovedServer(void)
+{
+	TestItemFetchWorker worker;
+	worker.addDataStore(1);
+	cppcut_assert_equal(true, worker.fetch(1, "10"));
+	cppcut_assert_equal(true, worker.fetch(1));
+	cppcut_assert_equal((size_t)2, worker.getNumberOfTargets());
+
+	worker.removeDataStore(1);
+	worker.setMinUpdateInterval(NO_INTERVAL);
+	cppcut_assert_equal(false, worker.fetch(ALL_SERVERS));
+	cppcut_assert_equal((size_t)0, worker.getNumberOfTargets());
+}
+
+} // namespace testItemFetchWorker
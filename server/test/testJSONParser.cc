@@ -270,4 +270,50 @@ void test_valueType(gconstpointer data)
 	    gcut_data_get_int(data, "expected"));
 	cppcut_assert_equal(expected, parser.getValueType("value"));
 }
+
+void test_parseMessagePack(void)
+{
+	// {"a":1,"b":"xy","c":[true,nil],"d":-2,"e":1.5,"f":nil}
+	const char msgpack[] =
+	  "\x86"
+	  "\xa1" "a" "\x01"
+	  "\xa1" "b" "\xa2" "xy"
+	  "\xa1" "c" "\x92\xc3\xc0"
+	  "\xa1" "d" "\xfe"
+	  "\xa1" "e" "\xcb\x3f\xf8\x00\x00\x00\x00\x00\x00"
+	  "\xa1" "f" "\xc0";
+	JSONParser parser(string(msgpack, sizeof(msgpack) - 1),
+			  JSONParser::DATA_FORMAT_MESSAGE_PACK);
+	cppcut_assert_equal(false, parser.hasError());
+	assertReadWord(int64_t, parser, "a", 1);
+	assertReadWord(string, parser, "b", "xy");
+	assertReadWord(int64_t, parser, "d", -2);
+	assertReadWord(double, parser, "e", 1.5);
+	cppcut_assert_equal(JSONParser::VALUE_TYPE_ARRAY,
+			    parser.getValueType("c"));
+	cppcut_assert_equal(true, parser.startObject("c"));
+	cppcut_assert_equal(2U, parser.countElements());
+	parser.endObject();
+	bool isNull = false;
+	cppcut_assert_equal(true, parser.isNull("f", isNull));
+	cppcut_assert_equal(true, isNull);
+}
+
+void test_parseMessagePackWithLargeInteger(void)
+{
+	// {"v":uint32 4000000000}
+	const char msgpack[] = "\x81\xa1" "v" "\xce\xee\x6b\x28\x00";
+	JSONParser parser(string(msgpack, sizeof(msgpack) - 1),
+			  JSONParser::DATA_FORMAT_MESSAGE_PACK);
+	assertReadWord(int64_t, parser, "v", 4000000000);
+}
+
+void test_parseBrokenMessagePack(void)
+{
+	// A map that claims two members but has only one.
+	const char msgpack[] = "\x82\xa1" "a" "\x01";
+	JSONParser parser(string(msgpack, sizeof(msgpack) - 1),
+			  JSONParser::DATA_FORMAT_MESSAGE_PACK);
+	cppcut_assert_equal(true, parser.hasError());
+}
 } //namespace testJSONParser
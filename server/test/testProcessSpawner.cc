@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppcutter.h>
+#include <deque>
+#include <set>
+#include <signal.h>
+#include <Mutex.h>
+#include <SimpleSemaphore.h>
+#include "ProcessSpawner.h"
+
+using namespace std;
+using namespace mlpl;
+
+namespace testProcessSpawner {
+
+static const size_t TIMEOUT_MSEC = 5000;
+
+struct ExitCollector {
+	Mutex             lock;
+	deque<siginfo_t>  exits;
+	SimpleSemaphore   sem;
+
+	ExitCollector(void)
+	: sem(0)
+	{
+	}
+
+	static void exited(const siginfo_t *siginfo, void *data)
+	{
+		ExitCollector *obj = static_cast<ExitCollector *>(data);
+		obj->lock.lock();
+		obj->exits.push_back(*siginfo);
+		obj->lock.unlock();
+		obj->sem.post();
+	}
+
+	siginfo_t wait(void)
+	{
+		cppcut_assert_equal(SimpleSemaphore::STAT_OK,
+		                    sem.timedWait(TIMEOUT_MSEC));
+		AutoMutex autoMutex(&lock);
+		siginfo_t siginfo = exits.front();
+		exits.pop_front();
+		return siginfo;
+	}
+};
+
+struct SpawnResult : public ProcessSpawner::SpawnCallback {
+	pid_t pid;
+	int   errorCode;
+
+	SpawnResult(void)
+	: pid(0),
+	  errorCode(-1)
+	{
+	}
+
+	virtual void onSpawned(const pid_t &_pid, GError *gerror) override
+	{
+		pid = _pid;
+		if (gerror)
+			errorCode = gerror->code;
+	}
+};
+
+static ProcessSpawner *spawner = NULL;
+static ExitCollector  *collector = NULL;
+
+static pid_t spawnShell(const string &script,
+                        const StringVector &envs = StringVector(),
+                        const string &workingDirectory = "")
+{
+	StringVector args;
+	args.push_back("/bin/sh");
+	args.push_back("-c");
+	args.push_back(script);
+	SpawnResult result;
+	cppcut_assert_equal(
+	  true, spawner->spawn(args, envs, workingDirectory, result));
+	cppcut_assert_not_equal(0, result.pid);
+	cppcut_assert_equal(-1, result.errorCode);
+	return result.pid;
+}
+
+static void _assertExit(const pid_t &pid, const int &code, const int &status)
+{
+	const siginfo_t siginfo = collector->wait();
+	cppcut_assert_equal(pid, siginfo.si_pid);
+	cppcut_assert_equal(code, siginfo.si_code);
+	cppcut_assert_equal(status, siginfo.si_status);
+}
+#define assertExit(P,C,S) cut_trace(_assertExit(P,C,S))
+
+void cut_setup(void)
+{
+	collector = new ExitCollector();
+	spawner = new ProcessSpawner();
+	if (!spawner->start(ExitCollector::exited, collector))
+		cut_omit("The process spawner isn't available.");
+}
+
+void cut_teardown(void)
+{
+	delete spawner;
+	spawner = NULL;
+	delete collector;
+	collector = NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Test cases
+// ---------------------------------------------------------------------------
+void test_exitCode(void)
+{
+	const pid_t pid = spawnShell("exit 3");
+	assertExit(pid, CLD_EXITED, 3);
+}
+
+void test_env(void)
+{
+	StringVector envs;
+	envs.push_back("A=123");
+	const pid_t pid = spawnShell("test \"$A\" = 123", envs);
+	assertExit(pid, CLD_EXITED, 0);
+}
+
+void test_workingDirectory(void)
+{
+	const pid_t pid =
+	  spawnShell("test \"$(pwd)\" = /tmp", StringVector(), "/tmp");
+	assertExit(pid, CLD_EXITED, 0);
+}
+
+void test_killed(void)
+{
+	const pid_t pid = spawnShell("sleep 60");
+	cppcut_assert_equal(0, kill(pid, SIGKILL));
+	assertExit(pid, CLD_KILLED, SIGKILL);
+}
+
+void test_spawnNonExistingCommand(void)
+{
+	StringVector args;
+	args.push_back("/non-existing-command");
+	SpawnResult result;
+	cppcut_assert_equal(
+	  true, spawner->spawn(args, StringVector(), "", result));
+	cppcut_assert_equal(0, result.pid);
+	cppcut_assert_equal(static_cast<int>(G_SPAWN_ERROR_NOENT),
+	                    result.errorCode);
+}
+
+void test_spawnWithInvalidWorkingDirectory(void)
+{
+	StringVector args;
+	args.push_back("/bin/true");
+	SpawnResult result;
+	cppcut_assert_equal(
+	  true, spawner->spawn(args, StringVector(), "/non-existing-dir",
+	                       result));
+	cppcut_assert_equal(0, result.pid);
+	cppcut_assert_equal(static_cast<int>(G_SPAWN_ERROR_CHDIR),
+	                    result.errorCode);
+}
+
+void test_manyProcesses(void)
+{
+	const size_t numProcesses = 200;
+	set<pid_t> expected;
+	for (size_t i = 0; i < numProcesses; i++)
+		expected.insert(spawnShell("exit 0"));
+
+	set<pid_t> actual;
+	for (size_t i = 0; i < numProcesses; i++) {
+		const siginfo_t siginfo = collector->wait();
+		cppcut_assert_equal(CLD_EXITED, siginfo.si_code);
+		actual.insert(siginfo.si_pid);
+	}
+	cppcut_assert_equal(true, expected == actual);
+}
+
+} // namespace testProcessSpawner
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2015 Project Hatohol
+ *
+ * This file is part of Hatohol.
+ *
+ * Hatohol is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License, version 3
+ * as published by the Free Software Foundation.
+ *
+ * Hatohol is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Hatohol. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppcutter.h>
+#include <gcutter.h>
+#include "ResponseCompressor.h"
+
+using namespace std;
+
+namespace testResponseCompressor {
+
+static string inflate(const ResponseCompressor::Encoding &encoding,
+                      const gchar *data, const gsize &size)
+{
+	GZlibCompressorFormat format =
+	  (encoding == ResponseCompressor::ENCODING_GZIP) ?
+	    G_ZLIB_COMPRESSOR_FORMAT_GZIP :
+	    G_ZLIB_COMPRESSOR_FORMAT_ZLIB;
+	GConverter *converter =
+	  G_CONVERTER(g_zlib_decompressor_new(format));
+	string inflated;
+	gsize srcPos = 0;
+	char buf[4096];
+	while (true) {
+		gsize bytesRead = 0, bytesWritten = 0;
+		GError *error = NULL;
+		GConverterResult result = g_converter_convert(
+		  converter, data + srcPos, size - srcPos, buf, sizeof(buf),
+		  G_CONVERTER_INPUT_AT_END, &bytesRead, &bytesWritten, &error);
+		gcut_assert_error(error);
+		cppcut_assert_not_equal(G_CONVERTER_ERROR, result);
+		srcPos += bytesRead;
+		inflated.append(buf, bytesWritten);
+		if (result == G_CONVERTER_FINISHED)
+			break;
+	}
+	g_object_unref(converter);
+	return inflated;
+}
+
+static string makeRandomBody(const size_t &size)
+{
+	// Random bytes are hardly compressed. So the output is larger than
+	// the initial buffer (a quarter of the input).
+	string body;
+	body.reserve(size);
+	guint32 seed = 12345;
+	for (size_t i = 0; i < size; i++) {
+		seed = seed * 1103515245 + 12345;
+		body += static_cast<char>(seed >> 24);
+	}
+	return body;
+}
+
+void data_roundTrip(void)
+{
+	gcut_add_datum("gzip",
+	               "encoding", G_TYPE_INT,
+	               ResponseCompressor::ENCODING_GZIP, NULL);
+	gcut_add_datum("deflate",
+	               "encoding", G_TYPE_INT,
+	               ResponseCompressor::ENCODING_DEFLATE, NULL);
+}
+
+void test_roundTrip(gconstpointer data)
+{
+	const ResponseCompressor::Encoding encoding =
+	  static_cast<ResponseCompressor::Encoding>(
+	    gcut_data_get_int(data, "encoding"));
+	const string body = makeRandomBody(256 * 1024);
+	ResponseCompressor compressor;
+	gchar *compressed = NULL;
+	gsize compressedSize = 0;
+	cppcut_assert_equal(true, compressor.compress(encoding, body,
+	                                              compressed,
+	                                              compressedSize));
+	cppcut_assert_equal(true, compressedSize > body.size() / 4 + 128);
+	const string inflated = inflate(encoding, compressed, compressedSize);
+	g_free(compressed);
+	cppcut_assert_equal(body.size(), inflated.size());
+	cppcut_assert_equal(true, body == inflated);
+}
+
+void test_reuse(void)
+{
+	// The converter is reset after each compression.
+	ResponseCompressor compressor;
+	const ResponseCompressor::Encoding encoding =
+	  ResponseCompressor::ENCODING_GZIP;
+	for (size_t i = 0; i < 2; i++) {
+		const string body = makeRandomBody(1024 * (i + 1));
+		gchar *compressed = NULL;
+		gsize compressedSize = 0;
+		cppcut_assert_equal(true,
+		                    compressor.compress(encoding, body,
+		                                        compressed,
+		                                        compressedSize));
+		const string inflated =
+		  inflate(encoding, compressed, compressedSize);
+		g_free(compressed);
+		cppcut_assert_equal(true, body == inflated);
+	}
+}
+
+} // namespace testResponseCompressor
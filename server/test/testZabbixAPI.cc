@@ -183,6 +183,45 @@ void test_verifyGroupsAndHostsGroups(void)
 	assertItemTable(expectHostsGroupsTablePtr, actualHostsGroupsTablePtr);
 }
 
+void test_getWithPrefetch(void)
+{
+	MonitoringServerInfo serverInfo;
+	ZabbixAPITestee::initServerInfoWithDefaultParam(serverInfo);
+	ZabbixAPITestee zbxApiTestee(serverInfo);
+	zbxApiTestee.testOpenSession();
+
+	ItemTablePtr expectGroupsTablePtr;
+	ItemTablePtr expectTriggersTablePtr;
+	ItemTablePtr actualGroupsTablePtr;
+	zbxApiTestee.makeGroupsItemTable(expectGroupsTablePtr);
+	zbxApiTestee.makeTriggersItemTable(expectTriggersTablePtr);
+
+	zbxApiTestee.callPrefetchGroupsAndTriggers();
+	ItemTablePtr actualTriggersTablePtr = zbxApiTestee.callGetTrigger();
+	zbxApiTestee.callGetGroups(actualGroupsTablePtr);
+
+	assertItemTable(expectTriggersTablePtr, actualTriggersTablePtr);
+	assertItemTable(expectGroupsTablePtr, actualGroupsTablePtr);
+}
+
+void test_discardPrefetchedQueries(void)
+{
+	MonitoringServerInfo serverInfo;
+	ZabbixAPITestee::initServerInfoWithDefaultParam(serverInfo);
+	ZabbixAPITestee zbxApiTestee(serverInfo);
+	zbxApiTestee.testOpenSession();
+
+	zbxApiTestee.callPrefetchGroupsAndTriggers();
+	zbxApiTestee.callDiscardPrefetchedQueries();
+
+	// The responses are got with new requests.
+	ItemTablePtr expectGroupsTablePtr;
+	ItemTablePtr actualGroupsTablePtr;
+	zbxApiTestee.makeGroupsItemTable(expectGroupsTablePtr);
+	zbxApiTestee.callGetGroups(actualGroupsTablePtr);
+	assertItemTable(expectGroupsTablePtr, actualGroupsTablePtr);
+}
+
 void test_getLastEventId(void)
 {
 	MonitoringServerInfo serverInfo;